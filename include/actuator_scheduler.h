@@ -0,0 +1,57 @@
+#ifndef ACTUATOR_SCHEDULER_H
+#define ACTUATOR_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Cooperative scheduler for actuator work that takes time, such as LED
+// patterns. (Servo moves run on ServoMotionTask, the OLED on
+// DisplayService.) A job is a short list of steps, each an action followed
+// by a hold; run() from loop() performs whatever steps are due and returns
+// at once, so nothing waits on an actuator. Each channel runs one job at a
+// time, and a new job replaces the one in progress: a newer pattern cancels
+// the rest of an older one instead of queueing behind it.
+class ActuatorScheduler
+{
+public:
+    typedef void (*StepAction)(void *context, int arg);
+
+    struct Step
+    {
+        StepAction action;
+        int arg;
+        uint32_t holdMs; // Before the next step, or before the channel is idle
+    };
+
+    static const int MAX_CHANNELS = 4;
+    static const int MAX_STEPS = 12;
+
+    ActuatorScheduler();
+
+    // The first step runs now; false if the channel or job is invalid
+    bool submit(int channel, const Step *steps, int count, void *context, uint32_t nowMs);
+    void cancel(int channel);
+
+    void run(uint32_t nowMs);
+
+    bool isBusy(int channel) const;
+    uint32_t getReplaced() const; // Jobs cut short by a newer one
+
+private:
+    struct Channel
+    {
+        Step steps[MAX_STEPS];
+        int count;
+        int next;   // Step to run at dueMs
+        uint32_t dueMs;
+        void *context;
+        bool busy;  // Steps left, or the last step's hold still running
+    };
+
+    Channel channels[MAX_CHANNELS];
+    uint32_t replaced;
+
+    void advance(Channel &channel, uint32_t nowMs);
+};
+
+#endif // ACTUATOR_SCHEDULER_H
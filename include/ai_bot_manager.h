@@ -2,65 +2,178 @@
 #define AI_BOT_MANAGER_H
 
 #include <Arduino.h>
-#include <HTTPClient.h>
-#include <EEPROM.h>
-#include "esp32cam_manager.h"
-#include "wifi_manager.h"
+#include "async_http_request.h"
+#include "cadence_scheduler.h"
+#include "config_store.h"
+#include "decision_stream.h"
+#include "hal.h"
+#include "request_body.h"
+#include "scene_gate.h"
+
+// Where the time of the last completed backend request went
+struct BotRequestTiming
+{
+    uint32_t connectMs;  // DNS, TCP and TLS handshakes, 0 on a reused connection
+    uint32_t uploadMs;   // Request head and body
+    uint32_t waitMs;     // Until the response headers (backend thinking)
+    uint32_t downloadMs; // Response body
+    bool reused;
+    uint32_t connectionsOpened; // Since boot
+    uint32_t directionMs; // Start until the decision was acted on
+    uint32_t totalMs;     // Start until the response was complete
+};
 
 class AIBotManager
 {
 public:
     AIBotManager();
-    void begin(ESP32CamManager *cam, WiFiManager *wifi);
+    // Frames to send, the link they go out on (WiFi on the board), the API
+    // settings and the time base, all from hal.h so the bot also runs on a host
+    void begin(FrameSource *frames, NetworkLink *link, ConfigStore *config, Clock *clock);
     void loop();
 
     typedef void (*BotStatusCallback)(String status);
     void setStatusCallback(BotStatusCallback callback);
+    // Once per decision, when it is acted on: as soon as a streamed answer
+    // has its direction and distance, otherwise when the answer is parsed
+    typedef void (*DecisionCallback)(const String &direction, float distance, bool goalFound);
+    void setDecisionCallback(DecisionCallback callback);
 
-    void setApiConfig(String baseUrl, String messageRoute, String healthRoute);
+    // How the frame is sent to the message route
+    enum UploadMode
+    {
+        UPLOAD_JSON = 0,      // base64 image inside a JSON body (default)
+        UPLOAD_MULTIPART = 1  // raw JPEG as a multipart/form-data file part
+    };
+
+    // False, with nothing changed, for a base URL the bot cannot reach: only
+    // http:// is supported (see AsyncHttpRequest)
+    bool setApiConfig(String baseUrl, String messageRoute, String healthRoute, UploadMode uploadMode = UPLOAD_JSON,
+                      bool streamResponses = false);
     String getApiBaseUrl();
     String getApiMessageRoute();
     String getApiHealthRoute();
-    bool testConnection();
+    UploadMode getUploadMode();
+    // Ask for a streamed answer and act as soon as direction and distance
+    // have arrived, before the description is complete
+    bool isStreamingResponses();
+
+    // Backend health check, run from loop() on the bot's connection: a bot
+    // request in flight finishes first and the next one waits for the check
+    enum HealthCheck
+    {
+        HEALTH_NONE,     // Not asked for since boot
+        HEALTH_CHECKING, // Asked for or under way
+        HEALTH_PASSED,
+        HEALTH_FAILED
+    };
+    void requestHealthCheck();
+    HealthCheck getHealthCheck();
+    int getHealthStatusCode(); // HTTP status of the last check, -1 if none came
 
     void startBot();
-    void stopBot();
+    void stopBot(); // Also cancels a request in flight
     bool isBotRunning();
+    bool isRequestInFlight(); // A bot request or health check is under way
     String getLastBotStatus();
     String getLastDirection();
     float getLastDistance();
     bool isGoalFound();
+    uint32_t getLastFrameAge(); // Age in ms of the frame sent with the last request
+
+    // Scene-change gate: skip requests while the view is unchanged
+    void setSceneChangeThreshold(int bits);
+    int getSceneChangeThreshold();
+    uint32_t getRequestsSent();
+    uint32_t getRequestsSkipped();
+
+    // Request cadence: next cycle starts once the last decision is acted on,
+    // spaced between min and max by the outcome (see CadenceScheduler)
+    void setCadence(uint32_t minIntervalMs, uint32_t maxIntervalMs);
+    uint32_t getCadenceMin();
+    uint32_t getCadenceMax();
+    uint32_t getDecisionsPerMinute();
+    uint32_t getAverageStaleness(); // Frame age when its decision was acted on, ms
+    uint32_t getAverageLatency();   // Backend round trip, ms
+    uint32_t getNextRequestIn();    // ms until the next cycle, 0 if due or busy
+    BotRequestTiming getLastRequestTiming();
+
+    // Prompt context caching: the context goes out in full until the backend
+    // has accepted it for this session, then only its hash is sent
+    bool isContextCached();
+    uint32_t getContextResends(); // Times the backend asked for it again
 
 private:
-    ESP32CamManager *camManager;
-    WiFiManager *wifiManager;
+    FrameSource *frameSource;
+    NetworkLink *network;
+    ConfigStore *config; // API section: apiBaseUrl .. streamResponses
+    Clock *clock;
+    SceneGate sceneGate;
+    CadenceScheduler cadence;
 
     String apiBaseUrl;
     String apiMessageRoute;
     String apiHealthRoute;
+    UploadMode uploadMode;
+    bool streamResponses;
     String sessionId;
 
     String lastDirection;
     float lastDistance;
     bool goalFound;
+    uint32_t lastFrameAgeMs;
 
     bool botRunning;
-    unsigned long lastRequestTime;
     String lastBotStatus;
     BotStatusCallback statusCallback;
+    DecisionCallback decisionCallback;
+
+    // Request in flight, advanced from loop(). The frame and envelope stay
+    // held until the body has been sent. Its keep-alive connection to the
+    // backend is reused by every request, health checks included.
+    AsyncHttpRequest request;
+    BotRequestTiming lastTiming;
+    AsyncHttpRequest::State requestStage;
+    RequestBody requestBody;
+    String requestPrefix;
+    String requestSuffix;
+    CapturedFrame inflightFrame;
+    bool frameHeld;
+
+    bool contextCached;     // Backend holds ROBOT_CONTEXT for sessionId
+    bool requestHasContext; // Request in flight carries the full context
+    uint32_t contextResends;
+
+    // Streamed answer of the request in flight. The body listener only
+    // feeds the scanner; the decision is acted on from pollBotRequest().
+    DecisionScanner decisionScanner;
+    SseDeltaDecoder sseDecoder;
+    String streamedText;
+    bool streamActed;
+    uint32_t decisionActedMs;
 
-    // EEPROM Configuration
-    // WiFi Manager uses first ~100 bytes. We start at 200 to be safe.
-    const int EEPROM_BASE_URL_ADDR = 200;
-    const int EEPROM_BASE_URL_SIZE = 100;
-    const int EEPROM_MSG_ROUTE_ADDR = 300;
-    const int EEPROM_MSG_ROUTE_SIZE = 50;
-    const int EEPROM_HEALTH_ROUTE_ADDR = 350;
-    const int EEPROM_HEALTH_ROUTE_SIZE = 50;
+    // Health check, sharing request with the bot
+    bool healthPending;
+    bool healthInFlight;
+    HealthCheck healthResult;
+    int healthStatusCode;
 
     void loadApiConfig();
-    void saveApiConfigToEEPROM(String baseUrl, String messageRoute, String healthRoute);
+    void saveApiConfig(String baseUrl, String messageRoute, String healthRoute, UploadMode mode, bool stream);
     void sendBotRequest();
+    void pollBotRequest();
+    void finishBotRequest();
+    void startHealthCheck();
+    void finishHealthCheck();
+    bool handleBotResponse(const char *response, size_t len);
+    void actOnStreamedDecision();
+    bool completeStreamedDecision();
+    static void onResponseBody(void *context, const char *data, size_t len);
+    static void onModelText(void *context, const char *text, size_t len);
+    void releaseInflightFrame();
+    void setStatus(const String &status);
+    void buildJsonEnvelope(String &prefix, String &suffix, bool includeContext);
+    void buildMultipartEnvelope(String &prefix, String &suffix, const String &boundary, bool includeContext);
     String getHealthUrl();
     String getMessageUrl();
 };
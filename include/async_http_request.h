@@ -0,0 +1,213 @@
+#ifndef ASYNC_HTTP_REQUEST_H
+#define ASYNC_HTTP_REQUEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "request_body.h"
+#include "tls_session.h"
+
+// Non-blocking HTTP/1.1 client over a plain or TLS socket, advanced by
+// poll() from the caller's loop: connect -> send -> await headers -> read
+// body. Each stage has its own deadline, and cancel() drops the request at
+// any point. The connection is kept alive between requests to the same host
+// and reopened transparently once the server has closed it, including when
+// that only shows once the request is on its way: a reused connection that
+// fails before any response byte is replaced and the request sent once more.
+// Resolved host names are cached, but a lookup itself blocks. Uses BSD
+// socket calls, so it runs on lwip and on a host alike.
+class AsyncHttpRequest
+{
+public:
+    enum State
+    {
+        REQ_IDLE,
+        REQ_CONNECTING,
+        REQ_SENDING,
+        REQ_AWAIT_HEADERS,
+        REQ_READING_BODY,
+        REQ_DONE,
+        REQ_FAILED
+    };
+
+    enum Error
+    {
+        ERR_NONE,
+        ERR_URL,
+        ERR_DNS,
+        ERR_CONNECT,
+        ERR_TLS, // Handshake or certificate check failed, see getTlsError()
+        ERR_SEND,
+        ERR_RECV,
+        ERR_TIMEOUT,
+        ERR_PROTOCOL,
+        ERR_TOO_LARGE,
+        ERR_CANCELLED
+    };
+
+    // Time allowed for each stage, from the moment it starts
+    struct Deadlines
+    {
+        uint32_t connectMs;
+        uint32_t sendMs;
+        uint32_t headersMs; // Includes the backend's thinking time
+        uint32_t bodyMs;
+    };
+
+    static const size_t MAX_URL_PART = 128;
+    static const size_t MAX_CONTENT_TYPE = 96;
+    static const size_t RESPONSE_CAPACITY = 8192;
+    static const size_t SEND_CHUNK = 1436;
+    static const uint32_t DNS_CACHE_MS = 600000;
+
+    AsyncHttpRequest();
+    ~AsyncHttpRequest();
+
+    void setDeadlines(const Deadlines &deadlines);
+
+    // Starts a request; body may be nullptr (e.g. GET). The body (and
+    // everything it points to) must stay valid while needsBody() is true.
+    // Returns false and enters REQ_FAILED if the URL or host is unusable.
+    bool start(const char *method, const char *url, const char *contentType, RequestBody *body, uint32_t nowMs);
+
+    // Does whatever work is possible without blocking and returns the state
+    State poll(uint32_t nowMs);
+
+    // Receives the body of 2xx responses as it arrives, chunked framing
+    // already removed, instead of it being kept for getResponse(). Called
+    // from inside poll(): it must not call back into this request.
+    typedef void (*BodyListener)(void *context, const char *data, size_t len);
+    void setBodyListener(BodyListener listener, void *context);
+
+    // Closes the socket right away; the state becomes REQ_FAILED/ERR_CANCELLED
+    void cancel();
+
+    // Back to REQ_IDLE. An idle keep-alive connection stays open.
+    void reset();
+
+    // Closes the kept-alive connection, if any
+    void disconnect();
+
+    bool isBusy() const; // Started and neither done nor failed
+    // The body may still be read: while sending, and on a reused connection
+    // until the first response byte, in case it has to go out again
+    bool needsBody() const;
+    State getState() const;
+    Error getError() const;
+    State getFailedStage() const; // Stage that was active when it failed
+    int getStatusCode() const;
+    const char *getResponseType() const; // Content-Type of the response, "" if none
+
+    // Response body, NUL-terminated (chunked encoding already removed).
+    // Empty for bodies that went to the body listener.
+    const char *getResponse() const;
+    size_t getResponseLength() const;
+
+    uint32_t getElapsedMs(uint32_t nowMs) const;
+
+    // Time spent in a stage by the last completed request. REQ_CONNECTING
+    // includes name resolution and the TLS handshake, and is 0 when the
+    // connection was reused.
+    uint32_t getStageTime(State stage) const;
+    // Time spent producing body bytes (e.g. base64 encoding) while sending, us
+    uint32_t getBodyReadUs() const;
+    bool wasReused() const;
+    bool wasRetried() const; // Sent again after the reused connection failed
+    uint32_t getConnectionsOpened() const;
+    uint32_t getDnsLookups() const; // Names resolved, not served from the cache
+    const char *getTlsError() const; // Last TLS failure, for the log
+
+    static const char *stateName(State state);
+    static const char *errorName(Error error);
+    // http:// or https://; anything else fails as ERR_URL
+    static bool supportsUrl(const char *url);
+
+private:
+    int sock;
+    State state;
+    State failedStage;
+    Error error;
+    Deadlines deadlines;
+    uint32_t startedMs;
+    uint32_t stageStartedMs;
+    uint32_t stageDeadline;
+    uint32_t stageTime[REQ_DONE];
+    uint32_t bodyReadUs;
+    bool reused;
+    bool keepAlive; // Server allows another request on this connection
+    uint32_t connectionsOpened;
+    uint32_t dnsLookups;
+
+    // Host, port and scheme the open socket is connected to
+    char connectedHost[MAX_URL_PART];
+    uint16_t connectedPort;
+    bool connectedSecure;
+    TlsSession tls; // Open while a https connection is
+
+    char dnsHost[MAX_URL_PART];
+    uint32_t dnsAddr; // Network byte order
+    uint32_t dnsResolvedMs;
+
+    char host[MAX_URL_PART];
+    char path[MAX_URL_PART];
+    char contentType[MAX_CONTENT_TYPE];
+    uint16_t port;
+    bool secure;
+
+    RequestBody *body;      // Being sent
+    RequestBody *retryBody; // Kept for a resend until the response starts
+    bool retried;
+    char head[MAX_URL_PART * 2 + MAX_CONTENT_TYPE + 128];
+    size_t headLen;
+    size_t headSent;
+    uint8_t chunk[SEND_CHUNK];
+    size_t chunkLen;
+    size_t chunkSent;
+
+    enum ChunkState
+    {
+        CHUNK_SIZE,
+        CHUNK_SIZE_LINE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        CHUNK_TRAILER,
+        CHUNK_DONE
+    };
+
+    char *response; // RESPONSE_CAPACITY + 1, allocated on first use
+    size_t responseLen;
+    size_t bodyStart;     // Offset of the body in response once headers are in
+    size_t bodyEnd;       // End of the decoded body kept in response
+    size_t bodyReceived;  // Decoded body bytes so far, kept or not
+    long contentLength;   // -1 if the body ends when the server closes
+    bool chunked;
+    ChunkState chunkState;
+    size_t chunkRemaining;
+    bool trailerLineEmpty;
+    int statusCode;
+    char responseType[48];
+
+    BodyListener bodyListener;
+    void *bodyListenerContext;
+
+    bool parseUrl(const char *url);
+    bool connectionUsable();
+    bool resolveHost(uint32_t nowMs, uint32_t &addr);
+    bool openSocket(uint32_t nowMs);
+    void enterStage(State next, uint32_t nowMs);
+    void fail(Error err);
+    void closeSocket();
+    bool retryOnNewConnection(uint32_t nowMs);
+    ssize_t sendSome(const void *data, size_t len);
+    ssize_t recvSome(void *buf, size_t len);
+
+    void pollConnect(uint32_t nowMs);
+    void pollSend(uint32_t nowMs);
+    void pollReceive(uint32_t nowMs);
+    bool parseHeaders();
+    void consumeBody(size_t raw);
+    size_t decodeChunked(const char *in, size_t len, char *out);
+    void finish(uint32_t nowMs);
+};
+
+#endif // ASYNC_HTTP_REQUEST_H
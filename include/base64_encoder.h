@@ -0,0 +1,14 @@
+#ifndef BASE64_ENCODER_H
+#define BASE64_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of characters produced for inputLength bytes (padded, no terminator)
+size_t base64EncodedLength(size_t inputLength);
+
+// Encode inputLength bytes into out. No null terminator is written.
+// Returns the number of characters written.
+size_t base64Encode(const uint8_t *input, size_t inputLength, char *out);
+
+#endif // BASE64_ENCODER_H
@@ -0,0 +1,62 @@
+#ifndef CADENCE_SCHEDULER_H
+#define CADENCE_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decides when the bot starts its next request cycle. The gap after each
+// outcome is chosen from what just happened, always within [min, max]:
+// - moving decision: min, so the robot gets fresh guidance while it moves
+// - stop decision: 4 x min; goal found: max
+// - scene unchanged (request skipped): min, to look again soon
+// - error: min (at least 500 ms) doubled per consecutive error
+// plus half the backend's recent latency, so a slow backend is not hammered.
+class CadenceScheduler
+{
+public:
+    static const int HISTORY = 64; // Decision timestamps kept for the rate
+
+    CadenceScheduler();
+
+    void configure(uint32_t minIntervalMs, uint32_t maxIntervalMs);
+    uint32_t getMinInterval() const;
+    uint32_t getMaxInterval() const;
+
+    // First cycle may start immediately
+    void reset(uint32_t nowMs);
+
+    bool isDue(uint32_t nowMs) const;
+    uint32_t getNextDelay(uint32_t nowMs) const; // 0 when due
+
+    // Report how a cycle ended. latencyMs is the request's round trip;
+    // stalenessMs is the age of the frame once its decision was acted on.
+    void onDecision(uint32_t nowMs, uint32_t latencyMs, uint32_t stalenessMs, bool moving, bool goalFound);
+    void onSkipped(uint32_t nowMs);
+    void onError(uint32_t nowMs, uint32_t latencyMs);
+
+    uint32_t getDecisionsPerMinute(uint32_t nowMs) const;
+    uint32_t getAverageStaleness() const; // Moving average, ms
+    uint32_t getAverageLatency() const;   // Moving average, ms
+    uint32_t getLastInterval() const;
+
+private:
+    uint32_t minInterval;
+    uint32_t maxInterval;
+    uint32_t nextAt;
+    uint32_t lastInterval;
+    int errorStreak;
+
+    uint32_t decisionTimes[HISTORY];
+    int decisionCount; // Entries used in decisionTimes (up to HISTORY)
+    int decisionHead;
+
+    uint32_t avgLatency;
+    uint32_t avgStaleness;
+    bool haveLatency;
+    bool haveStaleness;
+
+    void schedule(uint32_t nowMs, uint32_t baseMs);
+    static uint32_t smooth(uint32_t average, uint32_t sample, bool &have);
+};
+
+#endif // CADENCE_SCHEDULER_H
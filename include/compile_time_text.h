@@ -0,0 +1,106 @@
+#ifndef COMPILE_TIME_TEXT_H
+#define COMPILE_TIME_TEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Text transformations evaluated by the compiler, so constant strings such as
+// the bot's prompt context cost nothing at run time:
+//   constexpr auto ESCAPED = jsonEscape<jsonEscapedSize(TEXT)>(TEXT);
+//   constexpr auto HASH = hexDigest(fnv1a64(TEXT));
+
+template <size_t N>
+struct ConstText
+{
+    char data[N];
+    size_t length; // Without the terminator
+
+    const char *c_str() const { return data; }
+};
+
+// Buffer size (including the terminator) for jsonEscape(text)
+constexpr size_t jsonEscapedSize(const char *text)
+{
+    size_t n = 1;
+    for (; *text; text++)
+    {
+        switch (*text)
+        {
+        case '"':
+        case '\\':
+        case '\n':
+        case '\t':
+            n += 2;
+            break;
+        case '\r':
+            break; // Dropped
+        default:
+            n += 1;
+        }
+    }
+    return n;
+}
+
+// Escapes text for use inside a JSON string literal
+template <size_t N>
+constexpr ConstText<N> jsonEscape(const char *text)
+{
+    ConstText<N> out{};
+    size_t n = 0;
+    for (; *text; text++)
+    {
+        char c = *text;
+        if (c == '\r')
+            continue;
+        if (c == '"' || c == '\\')
+        {
+            out.data[n++] = '\\';
+            out.data[n++] = c;
+        }
+        else if (c == '\n')
+        {
+            out.data[n++] = '\\';
+            out.data[n++] = 'n';
+        }
+        else if (c == '\t')
+        {
+            out.data[n++] = '\\';
+            out.data[n++] = 't';
+        }
+        else
+        {
+            out.data[n++] = c;
+        }
+    }
+    out.data[n] = '\0';
+    out.length = n;
+    return out;
+}
+
+// 64-bit FNV-1a over the bytes of text
+constexpr uint64_t fnv1a64(const char *text)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (; *text; text++)
+    {
+        hash ^= (uint8_t)*text;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// 16 lowercase hex digits
+constexpr ConstText<17> hexDigest(uint64_t value)
+{
+    ConstText<17> out{};
+    for (int i = 15; i >= 0; i--)
+    {
+        out.data[i] = "0123456789abcdef"[value & 0xF];
+        value >>= 4;
+    }
+    out.data[16] = '\0';
+    out.length = 16;
+    return out;
+}
+
+#endif // COMPILE_TIME_TEXT_H
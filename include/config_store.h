@@ -0,0 +1,107 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Everything the bot keeps across restarts, one section per owner. Fields
+// are only ever appended (bumping ConfigStore::VERSION), so a config saved
+// by older firmware loads into the start of this one, with defaults after.
+struct BotConfig
+{
+    // WiFiManager
+    uint8_t wifiConfigured;
+    char wifiSsid[33];
+    char wifiPassword[65];
+
+    // AIBotManager
+    char apiBaseUrl[100];
+    char apiMessageRoute[50];
+    char apiHealthRoute[50];
+    uint8_t uploadMode; // AIBotManager::UploadMode
+    uint8_t streamResponses;
+    uint8_t reserved[3]; // Aligns what follows without implicit padding
+
+    // Servo calibration (main.cpp)
+    int32_t servoCenter;
+    int32_t servoLeft;
+    int32_t servoRight;
+
+    void setDefaults();
+};
+
+// BotConfig in Storage as two slots (A/B), each a header with schema
+// version, sequence number and CRC-32 followed by the struct. Loaded once
+// at boot into RAM, where readers take it from get(). save() writes the
+// slot not holding the current copy and commits, so the last good config
+// survives a write cut short by a reset, and the slots share the wear.
+// Without a valid slot, the settings are migrated from the layout used
+// before (hand-placed offsets in the first LEGACY_SIZE bytes), which is
+// left as it was.
+class ConfigStore
+{
+public:
+    static const uint16_t VERSION = 1;
+    static const size_t LEGACY_SIZE = 512;
+    static const size_t SLOT_SIZE = 512;
+    static const size_t STORAGE_SIZE = LEGACY_SIZE + 2 * SLOT_SIZE;
+
+    enum Source
+    {
+        SOURCE_DEFAULTS, // Nothing stored yet
+        SOURCE_SAVED,    // A valid slot
+        SOURCE_MIGRATED  // The legacy layout
+    };
+
+    struct Stats
+    {
+        Source source;
+        int slot;          // Holding the current config, -1 if none yet
+        uint32_t sequence; // Of the current config
+        uint32_t invalidSlots; // Found at boot: erased, torn or corrupt
+        uint32_t saves;
+        uint32_t unchanged; // save() calls with nothing to write
+        uint32_t commits;   // Storage writes, one per real change
+        uint32_t bytesWritten;
+    };
+
+    ConfigStore();
+
+    // Storage must be at least STORAGE_SIZE bytes
+    bool begin(Storage *storage);
+
+    const BotConfig &get() const;
+    // Takes a changed copy of get(); false if the write failed, in which
+    // case get() still returns what is stored
+    bool save(const BotConfig &config);
+
+    const Stats &getStats() const;
+
+    static uint32_t crc32(const void *data, size_t len, uint32_t crc = 0);
+    static const char *sourceName(Source source);
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t length; // Of the BotConfig that follows
+        uint32_t sequence;
+        uint32_t crc; // Header (this field as 0) and config
+    };
+
+    Storage *storage;
+    BotConfig config;
+    Stats stats;
+
+    static size_t slotAddress(int slot);
+    bool readSlot(int slot, BotConfig &out, uint32_t &sequence);
+    bool writeSlot(int slot, const BotConfig &value, uint32_t sequence);
+    bool migrateLegacy(BotConfig &out);
+    static void terminate(BotConfig &value);
+};
+
+static_assert(sizeof(BotConfig) <= 0xFFFF, "BotConfig length must fit the header");
+
+#endif // CONFIG_STORE_H
@@ -0,0 +1,92 @@
+#ifndef DECISION_STREAM_H
+#define DECISION_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Picks the navigation fields out of the model's JSON answer while it is
+// still arriving, so the robot can act before the description is complete.
+// Text before the first '{' (e.g. a ```json fence) is ignored. Only
+// top-level "direction", "distance_m" and "goal_found" are captured.
+class DecisionScanner
+{
+public:
+    DecisionScanner();
+    void reset();
+
+    void feed(const char *text, size_t len);
+
+    // direction and distance_m are both complete
+    bool hasDecision() const;
+    bool isComplete() const; // Top-level object closed
+
+    bool hasDirection() const;
+    const char *getDirection() const;
+    bool hasDistance() const;
+    float getDistance() const;
+    bool hasGoalFound() const;
+    bool getGoalFound() const;
+
+private:
+    enum Key
+    {
+        KEY_OTHER,
+        KEY_DIRECTION,
+        KEY_DISTANCE,
+        KEY_GOAL_FOUND
+    };
+
+    static const size_t FIELD_MAX = 24;
+
+    int depth;
+    bool started;
+    bool complete;
+    bool inString;
+    bool escape;
+    bool stringIsKey;
+    bool expectingKey;
+    bool valuePending; // After ':' at depth 1, before the value starts
+    bool capturing;    // Collecting a depth-1 value of interest
+    Key key;
+
+    char keyBuf[FIELD_MAX];
+    size_t keyLen;
+    char valueBuf[FIELD_MAX];
+    size_t valueLen;
+
+    char direction[FIELD_MAX];
+    bool directionSet;
+    float distance;
+    bool distanceSet;
+    bool goalFound;
+    bool goalFoundSet;
+
+    void feedChar(char c);
+    void resolveKey();
+    void finishValue();
+};
+
+// Unwraps a text/event-stream of {"delta": "..."} events into the plain
+// text of the deltas. "data: [DONE]" ends the stream.
+class SseDeltaDecoder
+{
+public:
+    typedef void (*TextSink)(void *context, const char *text, size_t len);
+
+    static const size_t MAX_LINE = 512;
+
+    SseDeltaDecoder();
+    void reset();
+
+    void feed(const char *data, size_t len, TextSink sink, void *context);
+    bool isDone() const;
+
+private:
+    char line[MAX_LINE];
+    size_t lineLen;
+    bool done;
+
+    void processLine(TextSink sink, void *context);
+};
+
+#endif // DECISION_STREAM_H
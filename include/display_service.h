@@ -0,0 +1,58 @@
+#ifndef DISPLAY_SERVICE_H
+#define DISPLAY_SERVICE_H
+
+#include <Arduino.h>
+#include "ui_state.h"
+
+struct DisplayServiceStats
+{
+    uint32_t updates; // Taken off the queue
+    uint32_t frames;  // Actually drawn
+    uint32_t dropped; // Queue full, oldest update discarded
+};
+
+// Owns the OLED once begun: callers post screens and return at once, and a
+// low-priority task draws at no more than MAX_FPS, always the latest state
+// (UiState), so screens replaced before their frame came up never reach
+// I2C. Held screens are transient messages shown over the current one.
+// Before begin(), or if the task could not be started, screens are drawn
+// by the caller as they used to be.
+class DisplayService
+{
+public:
+    static const uint32_t MAX_FPS = 10;
+    static const uint32_t FRAME_MS = 1000 / MAX_FPS;
+    static const int QUEUE_DEPTH = 8;
+
+    DisplayService();
+
+    bool begin(BaseType_t core = 0);
+
+    void showIntro(const String &status);
+    void showMain(const String &ip, const String &status, const String &direction, const String &distance,
+                  uint32_t holdMs = 0);
+    void showText(const String &line1, const String &line2 = "", const String &line3 = "", const String &line4 = "",
+                  uint32_t holdMs = 0);
+    void showCentered(const String &text, uint32_t holdMs = 0);
+
+    DisplayServiceStats getStats();
+
+private:
+    QueueHandle_t queue;
+    TaskHandle_t taskHandle;
+    UiState state; // Owned by the task once begun
+    uint32_t lastFrameMs;
+
+    volatile uint32_t updates;
+    volatile uint32_t frames;
+    volatile uint32_t dropped;
+
+    void post(UiUpdate &update);
+    static void taskEntry(void *arg);
+    void run();
+    void take(const UiUpdate &update);
+    void drawIfChanged();
+    static void draw(const UiScreen &screen);
+};
+
+#endif // DISPLAY_SERVICE_H
@@ -23,11 +23,55 @@
 #define HREF_GPIO_NUM 7
 #define PCLK_GPIO_NUM 13
 
+// Capture settings for one consumer of the camera.
+// frameSize and jpegQuality are switched at runtime through sensor_t.
+// fbCount and grabMode are driver settings fixed by esp_camera_init(), so
+// only the largest fbCount and the init profile's grabMode take effect.
+struct CameraProfile
+{
+    const char *name;
+    framesize_t frameSize;
+    int jpegQuality;
+    int fbCount;
+    camera_grab_mode_t grabMode;
+};
+
+// Per-profile capture cost, for picking the cheapest profile that works
+struct CameraProfileStats
+{
+    uint32_t captures;
+    uint32_t failures;
+    uint32_t switches;       // Times the sensor was reconfigured to this profile
+    uint64_t totalLatencyUs; // Including the reconfiguration, if any
+    uint32_t maxLatencyUs;
+    uint64_t totalBytes;
+};
+
 class ESP32CamManager
 {
+public:
+    enum ProfileId
+    {
+        PROFILE_AI,       // Bot requests: small enough for a vision model
+        PROFILE_STREAM,   // /stream MJPEG feed
+        PROFILE_SNAPSHOT, // /capture: full resolution
+        PROFILE_COUNT
+    };
+
 private:
     bool cameraAvailable;
-    String lastImageBase64;
+    uint8_t *lastImage; // Last /capture JPEG, served by /snapshot.jpg
+    size_t lastImageLen;
+    size_t lastImageCapacity;
+    uint32_t lastImageSeq;
+
+    CameraProfile profiles[PROFILE_COUNT];
+    CameraProfileStats profileStats[PROFILE_COUNT];
+    int activeProfile;
+    framesize_t maxFrameSize; // Frame size the driver was initialised with
+    SemaphoreHandle_t cameraMutex; // Serialises profile switch + frame grab
+
+    bool applyProfile(ProfileId id);
 
     // Status callback function type
     typedef void (*StatusCallback)(bool cameraConnected, bool statusChanged);
@@ -51,13 +95,23 @@ public:
 
     // Photo capture
     bool capturePhoto();
-    String getLastImageBase64();
+    const uint8_t *getLastImage(size_t &len);
+    uint32_t getLastImageSeq(); // Increments on every capture, used as ETag
     bool hasImage();
 
-    // Streaming support
-    camera_fb_t *getFrame();
+    // Frame access. The sensor is switched to the profile's settings first.
+    camera_fb_t *getFrame(ProfileId profile = PROFILE_STREAM);
     void releaseFrame(camera_fb_t *fb);
 
+    // 64-bit luma hash of a JPEG frame (see scene_gate.h), decoded at 1/8 scale
+    bool computeSceneSignature(const uint8_t *jpeg, size_t len, int width, int height, uint64_t &signature);
+
+    // Capture profiles
+    const CameraProfile &getProfile(ProfileId id);
+    void setProfile(ProfileId id, framesize_t frameSize, int jpegQuality);
+    CameraProfileStats getProfileStats(ProfileId id);
+    void resetProfileStats();
+
     // Utility methods
     bool ping();
 
@@ -0,0 +1,36 @@
+#ifndef FENCED_JSON_READER_H
+#define FENCED_JSON_READER_H
+
+#include <stddef.h>
+
+// Reads a model answer in place for deserializeJson(), skipping a leading
+// markdown fence (```json or ```) so the text needs no trimmed copies.
+// The closing fence needs no handling: the parser stops after the object.
+// Implements the read()/readBytes() pair ArduinoJson takes as a custom reader.
+class FencedJsonReader
+{
+public:
+    FencedJsonReader(const char *data, size_t len);
+
+    int read(); // Next byte, or -1 at the end
+    size_t readBytes(char *buffer, size_t length);
+
+private:
+    enum State
+    {
+        LEADING_SPACE, // Before the first visible character
+        BACKTICKS,     // Inside the opening ```
+        INFO_STRING,   // Rest of the fence line, e.g. "json"
+        BODY
+    };
+
+    const char *data;
+    size_t len;
+    size_t pos;
+    State state;
+    int backticks;
+
+    void skipFence();
+};
+
+#endif // FENCED_JSON_READER_H
@@ -0,0 +1,44 @@
+#ifndef FRAME_CAPTURE_TASK_H
+#define FRAME_CAPTURE_TASK_H
+
+#include <Arduino.h>
+#include "esp32cam_manager.h"
+#include "frame_ring.h"
+#include "hal.h"
+
+// Background producer that keeps a FrameRing of recent JPEG frames filled
+// from its own FreeRTOS task, so the bot can send a fresh frame without
+// waiting on the camera. Frames are copied out of the camera driver's buffers
+// into PSRAM slots, which keeps the driver's fb_count buffers free for the
+// stream and snapshot paths. Requires PSRAM.
+class FrameCaptureTask
+{
+public:
+    FrameCaptureTask();
+
+    bool begin(ESP32CamManager *cam, BaseType_t core = 0, uint32_t interval = 250);
+    bool isRunning();
+
+    // Paused tasks do not touch the camera
+    void setEnabled(bool enabled);
+
+    bool acquireLatest(CapturedFrame &frame);
+    void release(const CapturedFrame &frame);
+
+    uint32_t getFramesCaptured();
+    uint32_t getFramesOverwritten();
+
+private:
+    ESP32CamManager *camManager;
+    FrameRing ring;
+    portMUX_TYPE ringLock;
+    TaskHandle_t taskHandle;
+    volatile bool enabled;
+    uint32_t intervalMs;
+
+    static void taskEntry(void *arg);
+    void run();
+    void captureOne();
+};
+
+#endif // FRAME_CAPTURE_TASK_H
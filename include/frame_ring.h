@@ -0,0 +1,61 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bookkeeping for a small ring of captured JPEG frames shared by one producer
+// (capture task) and one consumer (bot request). The producer always writes
+// into a slot nobody is reading, overwriting the oldest ready frame when the
+// ring is full; the consumer always takes the newest ready frame.
+// Not thread-safe by itself: callers serialise calls with their own lock.
+// Slot buffers are owned and (re)allocated by the producer while it holds
+// the slot in SLOT_WRITING state.
+class FrameRing
+{
+public:
+    static const int SLOT_COUNT = 3;
+
+    enum SlotState
+    {
+        SLOT_FREE,
+        SLOT_WRITING,
+        SLOT_READY,
+        SLOT_READING
+    };
+
+    struct Slot
+    {
+        uint8_t *data;
+        size_t capacity;
+        size_t len;
+        uint32_t timestampMs;
+        uint32_t seq;
+        uint64_t signature; // Scene signature, valid if hasSignature
+        bool hasSignature;
+        SlotState state;
+    };
+
+    FrameRing();
+
+    // Producer side. beginWrite() returns a slot index or -1 if every slot
+    // is busy (only possible with a consumer holding more than one frame).
+    int beginWrite();
+    void commitWrite(int index, size_t len, uint32_t timestampMs);
+    void abortWrite(int index);
+
+    // Consumer side. acquireLatest() returns -1 when no frame is ready.
+    int acquireLatest();
+    void release(int index);
+
+    Slot &slot(int index);
+    uint32_t framesWritten() const;
+    uint32_t framesOverwritten() const;
+
+private:
+    Slot slots[SLOT_COUNT];
+    uint32_t nextSeq;
+    uint32_t overwritten;
+};
+
+#endif // FRAME_RING_H
@@ -0,0 +1,126 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Thin interfaces between the bot logic and the hardware it drives, so the
+// same code runs on the board (hal_esp32.h) and on a Linux host against
+// file-backed stand-ins (hal_native.h). Only what the bot uses is exposed.
+//
+// The HTTP client (AsyncHttpRequest) and server (HttpServer) have no
+// interface here: they are written against sockets, lwip's on the board
+// and the host's in [env:native]. Still board-only, with nothing behind
+// these interfaces yet: ESP32CamManager, WiFiManager and the route
+// handlers in main.cpp.
+
+// A JPEG frame borrowed from a FrameSource. Hand it back with release().
+struct CapturedFrame
+{
+    int slot; // Owner's bookkeeping, -1 for a frame captured on demand
+    const uint8_t *data;
+    size_t len;
+    uint32_t timestampMs;
+    uint32_t seq;
+    uint64_t signature;
+    bool hasSignature;
+};
+
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    virtual bool isAvailable() = 0;
+    // Sources with a background producer only run it while active
+    virtual void setActive(bool active) = 0;
+    // Newest frame there is; false if none could be had
+    virtual bool acquire(CapturedFrame &frame) = 0;
+    virtual void release(const CapturedFrame &frame) = 0;
+};
+
+// Byte-addressed settings memory with EEPROM semantics: unwritten bytes
+// read 0xFF and writes are only durable after commit().
+class Storage
+{
+public:
+    virtual ~Storage() {}
+
+    virtual size_t size() = 0;
+    virtual uint8_t read(size_t addr) = 0;
+    virtual void write(size_t addr, uint8_t value) = 0;
+    virtual bool commit() = 0;
+
+    // Whole ranges at once; these defaults go byte by byte
+    virtual void readBlock(size_t addr, void *data, size_t len)
+    {
+        uint8_t *bytes = (uint8_t *)data;
+        for (size_t i = 0; i < len; i++)
+            bytes[i] = read(addr + i);
+    }
+
+    virtual void writeBlock(size_t addr, const void *data, size_t len)
+    {
+        const uint8_t *bytes = (const uint8_t *)data;
+        for (size_t i = 0; i < len; i++)
+            write(addr + i, bytes[i]);
+    }
+
+    template <typename T>
+    void get(size_t addr, T &value)
+    {
+        readBlock(addr, &value, sizeof(T));
+    }
+
+    template <typename T>
+    void put(size_t addr, const T &value)
+    {
+        writeBlock(addr, &value, sizeof(T));
+    }
+};
+
+// Hobby servo. Detached servos hold no position and draw no holding current.
+class ServoOutput
+{
+public:
+    virtual ~ServoOutput() {}
+
+    virtual void attach() = 0;
+    virtual void write(int angle) = 0;
+    virtual void detach() = 0;
+};
+
+// Time since boot in the style of millis()/micros(), wrapping the same way
+class Clock
+{
+public:
+    virtual ~Clock() {}
+
+    virtual uint32_t millis() = 0;
+    virtual uint32_t micros() = 0;
+    virtual void delay(uint32_t ms) = 0;
+};
+
+// The network the backend is reached over. Requests go out through
+// AsyncHttpRequest, which runs on lwip or host sockets alike; this only
+// says whether there is a link to send them on.
+class NetworkLink
+{
+public:
+    virtual ~NetworkLink() {}
+
+    virtual bool isConnected() = 0;
+};
+
+// Monochrome panel with SH1106/SSD1306 memory layout: rows of 8-pixel-tall
+// pages, one byte per column with bit 0 on top. Takes runs of columns within
+// a page; false if the transfer failed and the panel contents are unknown.
+class DisplayPanel
+{
+public:
+    virtual ~DisplayPanel() {}
+
+    virtual bool writeRun(int page, int column, const uint8_t *data, size_t len) = 0;
+};
+
+#endif // HAL_H
@@ -0,0 +1,73 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include "esp32cam_manager.h"
+#include "frame_capture_task.h"
+#include "hal.h"
+
+// Board implementations of the hal.h interfaces
+
+class EepromStorage : public Storage
+{
+public:
+    bool begin(size_t size);
+
+    size_t size() override;
+    uint8_t read(size_t addr) override;
+    void write(size_t addr, uint8_t value) override;
+    bool commit() override;
+    void readBlock(size_t addr, void *data, size_t len) override;
+    void writeBlock(size_t addr, const void *data, size_t len) override;
+};
+
+// millis()/micros()/delay() of the Arduino core
+class ArduinoClock : public Clock
+{
+public:
+    uint32_t millis() override;
+    uint32_t micros() override;
+    void delay(uint32_t ms) override;
+};
+
+class Esp32ServoOutput : public ServoOutput
+{
+public:
+    Esp32ServoOutput(int pin, int minPulseUs = 500, int maxPulseUs = 2400);
+
+    void attach() override;
+    void write(int angle) override;
+    void detach() override;
+
+private:
+    Servo servo;
+    int pin;
+    int minPulseUs;
+    int maxPulseUs;
+};
+
+// Frames from the capture task's ring, or captured inline when it has
+// nothing ready yet (first cycle) or is not running (no PSRAM)
+class CameraFrameSource : public FrameSource
+{
+public:
+    CameraFrameSource();
+
+    // Capture on core 0 while the Arduino loop (core 1) does network I/O
+    void begin(ESP32CamManager *cam, BaseType_t core = 0);
+
+    bool isAvailable() override;
+    void setActive(bool active) override;
+    bool acquire(CapturedFrame &frame) override;
+    void release(const CapturedFrame &frame) override;
+
+private:
+    ESP32CamManager *camManager;
+    FrameCaptureTask captureTask;
+    uint8_t *inlineData; // Copy of the last inline frame; only grows
+    size_t inlineCapacity;
+    bool inlineHeld; // The inline frame is handed out
+};
+
+#endif // HAL_ESP32_H
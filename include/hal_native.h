@@ -0,0 +1,121 @@
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "page_diff_renderer.h"
+
+// Host implementations of the hal.h interfaces, for the native build
+
+uint32_t hostMillis();
+uint32_t hostMicros();
+
+// hostMillis()/hostMicros(), with delay() sleeping the thread
+class HostClock : public Clock
+{
+public:
+    uint32_t millis() override;
+    uint32_t micros() override;
+    void delay(uint32_t ms) override;
+};
+
+// The host's network is taken to be up; tests take it down to see what
+// the bot does without WiFi
+class HostLink : public NetworkLink
+{
+public:
+    HostLink();
+
+    bool isConnected() override;
+    void setConnected(bool connected);
+
+private:
+    bool connected;
+};
+
+// Settings in a file of size() bytes, loaded on begin() and rewritten on
+// commit(). A missing file reads as erased memory (all 0xFF).
+class FileStorage : public Storage
+{
+public:
+    FileStorage(const char *path, size_t size);
+
+    bool begin();
+
+    size_t size() override;
+    uint8_t read(size_t addr) override;
+    void write(size_t addr, uint8_t value) override;
+    bool commit() override;
+    void readBlock(size_t addr, void *data, size_t len) override;
+    void writeBlock(size_t addr, const void *data, size_t len) override;
+
+private:
+    std::string path;
+    std::vector<uint8_t> bytes;
+};
+
+// Logs what the servo would do and remembers where it was sent
+class ConsoleServo : public ServoOutput
+{
+public:
+    ConsoleServo();
+
+    void attach() override;
+    void write(int angle) override;
+    void detach() override;
+
+    int getAngle() const;
+    bool isAttached() const;
+    uint32_t getWrites() const;
+
+private:
+    int angle;
+    bool attached;
+    uint32_t writes;
+};
+
+// JPEG files read up front and handed out in turn, one per acquire()
+class JpegFileFrameSource : public FrameSource
+{
+public:
+    JpegFileFrameSource();
+
+    bool addFile(const char *path);
+    size_t getFileCount() const;
+
+    bool isAvailable() override;
+    void setActive(bool active) override;
+    bool acquire(CapturedFrame &frame) override;
+    void release(const CapturedFrame &frame) override;
+
+private:
+    std::vector<std::vector<uint8_t>> files;
+    size_t next;
+    uint32_t seq;
+    bool held;
+};
+
+// Panel memory kept in a framebuffer of its own, for checking what a
+// renderer sent against the frame it was given. dump() writes it out as a
+// PBM image.
+class FramebufferPanel : public DisplayPanel
+{
+public:
+    FramebufferPanel();
+
+    bool writeRun(int page, int column, const uint8_t *data, size_t len) override;
+
+    const uint8_t *getMemory() const; // PageDiffRenderer::FRAME_BYTES
+    uint32_t getRuns() const;
+    uint32_t getBytes() const;
+    bool dump(const char *path) const;
+
+private:
+    uint8_t memory[PageDiffRenderer::FRAME_BYTES];
+    uint32_t runs;
+    uint32_t bytes;
+};
+
+#endif // HAL_NATIVE_H
@@ -0,0 +1,132 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "route_table.h"
+
+// Parsed request. The strings point into the connection's receive buffer and
+// are only valid during the handler call.
+struct HttpRequest
+{
+    const char *method;
+    const char *path;        // Without the query string
+    const char *query;       // Text after '?', "" if none
+    const char *ifNoneMatch; // "" if the header is absent
+    bool keepAlive;
+    uint32_t requestIndex; // 1 for the first request on a connection
+    WiFiClient *client;
+};
+
+class HttpResponse
+{
+public:
+    // Returns false once the body has changed and the rest must not be sent
+    typedef bool (*BodyCheck)(uint32_t tag);
+
+    HttpResponse();
+
+    void send(int status, const char *contentType, const String &body);
+
+    // Body sent straight from the caller's buffer, which must stay valid
+    // while the response is written. check(tag) is polled between writes.
+    void sendBuffer(int status, const char *contentType, const uint8_t *data, size_t len,
+                    BodyCheck check = nullptr, uint32_t tag = 0);
+
+    void addHeader(const char *name, const String &value);
+
+    // The handler has taken over the connection (e.g. a stream); the server
+    // forgets it without closing it or sending anything
+    void detach();
+
+    // Close the connection after this response even if keep-alive was asked
+    void closeAfterSend();
+
+private:
+    friend class HttpServer;
+
+    int status;
+    const char *contentType;
+    String headers;
+    String body;
+    const uint8_t *buffer;
+    size_t bufferLen;
+    BodyCheck bodyCheck;
+    uint32_t bodyTag;
+    bool detached;
+    bool forceClose;
+};
+
+// Event-driven HTTP/1.1 server. loop() accepts connections and advances each
+// one's state machine (read headers -> dispatch -> write response -> wait for
+// the next keep-alive request) with non-blocking socket reads and writes, so
+// no client waits on another. Every state has a deadline.
+class HttpServer
+{
+public:
+    typedef void (*Handler)(HttpRequest &req, HttpResponse &res);
+    typedef void (*Hook)(const HttpRequest &req);
+    typedef RouteEntry<Handler> Route;
+
+    static const int MAX_CONNECTIONS = 6;
+    static const size_t RECV_BUFFER_SIZE = 1024;
+
+    HttpServer();
+    void begin(WiFiServer *server);
+
+    // Table sorted by path, then method (static_assert routeTableSorted on
+    // it); requests are matched on the exact method and path. The table is
+    // not copied.
+    void setRoutes(const Route *table, size_t count);
+    void onNotFound(Handler handler);
+
+    // Called around every dispatched request (status LED, OLED)
+    void setRequestHooks(Hook before, Hook after);
+
+    void loop();
+
+    int getConnectionCount();
+    uint32_t getRequestCount();
+
+private:
+    enum State
+    {
+        CONN_FREE,
+        CONN_READING,
+        CONN_WRITING
+    };
+
+    struct Connection
+    {
+        WiFiClient client;
+        State state;
+        char buf[RECV_BUFFER_SIZE + 1];
+        size_t len;
+        uint32_t deadline;
+        uint32_t requests;
+        bool keepAlive;
+        String head;
+        HttpResponse res;
+        size_t offset; // Progress through head + body
+    };
+
+    WiFiServer *server;
+    Connection conns[MAX_CONNECTIONS];
+    const Route *routes;
+    size_t routeCount;
+    Handler notFoundHandler;
+    Hook beforeHook;
+    Hook afterHook;
+    uint32_t requestCount;
+
+    void accept(uint32_t now);
+    void pollRead(Connection &c, uint32_t now);
+    void pollWrite(Connection &c, uint32_t now);
+    bool parseRequest(Connection &c, size_t headerEnd, HttpRequest &req);
+    void dispatch(Connection &c, HttpRequest &req, size_t headerEnd, uint32_t now);
+    void sendSimple(Connection &c, int status, const char *message, uint32_t now);
+    void startWrite(Connection &c, uint32_t now);
+    void close(Connection &c);
+};
+
+#endif // HTTP_SERVER_H
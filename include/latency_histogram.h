@@ -0,0 +1,49 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Rolling latency histogram in microseconds with log-linear buckets: exact
+// below 8 us, then four buckets per power of two (quantiles within 25%),
+// up to ~134 s. Samples land in the current window; the window before it
+// is kept too, so quantiles cover the last one to two WINDOW_MS. Recording
+// is a few integer operations, cheap enough to leave on everywhere.
+// Not thread-safe by itself: callers serialise calls with their own lock.
+class LatencyHistogram
+{
+public:
+    static const uint32_t WINDOW_MS = 60000;
+    static const int BUCKETS = 8 + 24 * 4;
+
+    LatencyHistogram();
+
+    void record(uint32_t us, uint32_t nowMs);
+
+    // Over the current and previous window; 0 if there are no samples
+    uint32_t quantile(float q, uint32_t nowMs);
+    uint32_t getWindowCount(uint32_t nowMs);
+    uint32_t getWindowMax(uint32_t nowMs);
+
+    // Since boot, for Prometheus _count/_sum
+    uint32_t getTotalCount() const;
+    uint64_t getTotalSumUs() const;
+
+    static int bucketOf(uint32_t us);
+    static uint32_t bucketUpper(int bucket); // Largest value in the bucket
+
+private:
+    uint16_t counts[2][BUCKETS]; // [current, previous], saturating
+    uint32_t windowCount[2];
+    uint32_t windowMax[2];
+    int current;
+    uint32_t windowStartMs;
+    bool started;
+
+    uint32_t totalCount;
+    uint64_t totalSumUs;
+
+    void rotate(uint32_t nowMs);
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,112 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_VERBOSE 5
+
+// Most verbose level compiled in. Calls above it disappear together with
+// their arguments; set with -D LOG_COMPILE_LEVEL=... in platformio.ini.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Leveled logging with a tag per module:
+//   static const char *TAG = "bot";
+//   LOG_I(TAG, "Next request in %u ms", interval);
+// Lines are formatted by the caller into a ring buffer and written to
+// Serial by a low-priority task, so logging never waits on the UART. When
+// the ring is full, lines are dropped and counted. Lines longer than
+// MAX_LINE are cut, with the number of bytes cut noted at the end.
+class Log
+{
+public:
+    static const size_t MAX_LINE = 160;
+    static const size_t RING_SIZE = 4096;
+    static const int MAX_TAG_LEVELS = 8;
+    static const size_t TAG_MAX = 12;
+
+    // Starts the drain task. Until then lines go straight to Serial.
+    static bool begin(BaseType_t core = 0);
+
+    // Runtime levels: one for all tags, plus overrides for single tags
+    static void setLevel(int level);
+    static int getLevel();
+    static void setTagLevel(const char *tag, int level); // level < 0 removes the override
+    static int getTagOverrideCount();
+    static const char *getTagOverride(int index, int &level);
+
+    static bool enabled(int level, const char *tag);
+    static void write(int level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+    static uint32_t getDropped();
+    static uint32_t getTruncated();
+
+    static const char *levelName(int level);
+    static int parseLevel(const char *name); // -1 if unknown
+
+private:
+    static void taskEntry(void *arg);
+    static void emit(const char *line, size_t len);
+};
+
+#define LOG_AT(level, tag, ...)                     \
+    do                                              \
+    {                                               \
+        if (Log::enabled(level, tag))               \
+            Log::write(level, tag, __VA_ARGS__);    \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(tag, ...) LOG_AT(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#else
+#define LOG_E(tag, ...) do { } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(tag, ...) LOG_AT(LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#else
+#define LOG_W(tag, ...) do { } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(tag, ...) LOG_AT(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#else
+#define LOG_I(tag, ...) do { } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(tag, ...) LOG_AT(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#else
+#define LOG_D(tag, ...) do { } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_VERBOSE
+#define LOG_V(tag, ...) LOG_AT(LOG_LEVEL_VERBOSE, tag, __VA_ARGS__)
+#else
+#define LOG_V(tag, ...) do { } while (0)
+#endif
+
+// Runs statement at most once per intervalMs from this call site, for
+// messages that would otherwise repeat every loop:
+//   LOG_EVERY_MS(5000, LOG_W(TAG, "Viewer too slow, dropping frames"));
+#define LOG_EVERY_MS(intervalMs, statement)                          \
+    do                                                               \
+    {                                                                \
+        static uint32_t logLastMs_ = 0;                              \
+        static bool logStarted_ = false;                             \
+        uint32_t logNowMs_ = millis();                               \
+        if (!logStarted_ || logNowMs_ - logLastMs_ >= (intervalMs))  \
+        {                                                            \
+            logStarted_ = true;                                      \
+            logLastMs_ = logNowMs_;                                  \
+            statement;                                               \
+        }                                                            \
+    } while (0)
+
+#endif // LOG_H
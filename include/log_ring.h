@@ -0,0 +1,39 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte ring of whole log lines, each stored as a 2-byte length and its
+// text. push() never waits: a line that does not fit is dropped and
+// counted, so a burst of logging costs the caller a copy, not UART time.
+// Not thread-safe by itself: callers serialise calls with their own lock.
+class LogRing
+{
+public:
+    LogRing(uint8_t *storage, size_t capacity);
+
+    bool push(const char *line, size_t len);
+
+    // Copies the oldest line into out (up to outSize bytes, not
+    // NUL-terminated) and returns its length; 0 if the ring is empty.
+    size_t pop(char *out, size_t outSize);
+
+    bool isEmpty() const;
+    size_t getUsed() const;
+    uint32_t getDropped() const;
+    uint32_t takeDropped(); // Returns the count and resets it
+
+private:
+    uint8_t *storage;
+    size_t capacity;
+    size_t head; // Next byte to write
+    size_t tail; // Next byte to read
+    size_t used;
+    uint32_t dropped;
+
+    void write(const uint8_t *data, size_t len);
+    void read(uint8_t *data, size_t len);
+};
+
+#endif // LOG_RING_H
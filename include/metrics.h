@@ -0,0 +1,53 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+// Where a bot cycle's time goes, as rolling latency histograms per stage,
+// plus a count of how cycles ended (by bot status). Safe to record from
+// any task. Served by /metrics as Prometheus text or JSON.
+class Metrics
+{
+public:
+    enum Stage
+    {
+        STAGE_CAPTURE,  // esp_camera_fb_get()
+        STAGE_ENCODE,   // Producing body bytes (base64) while uploading
+        STAGE_BUILD,    // Envelope around the frame
+        STAGE_UPLOAD,   // Request head and body on the socket
+        STAGE_TTFB,     // Body sent until response headers
+        STAGE_BODY,     // Response body
+        STAGE_PARSE,    // JSON deserialization
+        STAGE_ACTUATE,  // Servo move, command until settled
+        STAGE_LOOP,     // One pass of the Arduino loop(), bot cycle or not
+        STAGE_DISPLAY,  // OLED display(), changed regions over I2C
+        STAGE_HTTP,     // A web route's handler, request parsed to response ready
+        STAGE_COUNT
+    };
+
+    static const int MAX_STATUSES = 16; // The last one counts all further statuses as "other"
+    static const size_t STATUS_MAX = 24;
+
+    static void record(Stage stage, uint32_t us);
+    static void countStatus(const char *status);
+
+    static void writePrometheus(String &out);
+    static void writeJson(String &out);
+
+    static const char *stageName(Stage stage);
+};
+
+// Records the time from construction to the end of the scope:
+//   MetricsProbe probe(Metrics::STAGE_PARSE);
+class MetricsProbe
+{
+public:
+    explicit MetricsProbe(Metrics::Stage stage) : stage(stage), startUs(micros()) {}
+    ~MetricsProbe() { Metrics::record(stage, micros() - startUs); }
+
+private:
+    Metrics::Stage stage;
+    uint32_t startUs;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,55 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Time-optimal trapezoidal trajectory for one axis (here a servo angle in
+// degrees) under velocity and acceleration limits, always ending at rest on
+// the target. The start may be moving, so a move can be replanned midway:
+// a start heading away from the target, or too fast to stop in time, first
+// brakes to a stop and comes back. Short moves never reach full speed and
+// become triangular. Times are in seconds.
+class MotionProfile
+{
+public:
+    struct Limits
+    {
+        float maxVelocity;     // Units per second
+        float maxAcceleration; // Units per second squared
+    };
+
+    MotionProfile();
+
+    void plan(float from, float velocity, float to, const Limits &limits);
+
+    float getDuration() const;
+    float getTarget() const;
+    bool isDone(float t) const;
+
+    float positionAt(float t) const;
+    float velocityAt(float t) const;
+
+private:
+    // Constant acceleration from (start, position, velocity)
+    struct Segment
+    {
+        float start;
+        float duration;
+        float position;
+        float velocity;
+        float acceleration;
+    };
+
+    static const int MAX_SEGMENTS = 5; // Brake, slow down, accelerate, cruise, decelerate
+
+    Segment segments[MAX_SEGMENTS];
+    int segmentCount;
+    float duration;
+    float target;
+
+    void addSegment(float &position, float &velocity, float acceleration, float time);
+    const Segment *segmentAt(float t) const;
+};
+
+#endif // MOTION_PROFILE_H
@@ -4,6 +4,47 @@
 #include <Adafruit_SH110X.h>
 #include <Wire.h>
 #include <Fonts/Org_01.h>
+#include "page_diff_renderer.h"
+
+// SH1106 whose display() sends only what changed since the last one (see
+// PageDiffRenderer), at I2C fast-mode plus when the panel acks it
+class DiffSH1106G : public Adafruit_SH1106G, public DisplayPanel
+{
+public:
+    static const uint32_t FAST_HZ = 1000000;
+    static const uint32_t STANDARD_HZ = 400000;
+
+    DiffSH1106G(uint16_t w, uint16_t h, TwoWire *wire, int8_t resetPin);
+
+    bool begin(uint8_t address);
+    void display();
+
+    bool writeRun(int page, int column, const uint8_t *data, size_t len) override;
+
+    uint32_t getBusHz() const;
+    uint64_t getBusyUs() const;
+    const PageDiffRenderer::Stats &getStats() const;
+
+private:
+    TwoWire *wire;
+    uint8_t address;
+    uint32_t busHz;
+    uint64_t busyUs;
+    PageDiffRenderer renderer;
+
+    bool probe();
+};
+
+// Partial refresh counters, for /api/status
+struct OledStats
+{
+    uint32_t busHz;
+    uint32_t frames;
+    uint32_t unchanged;
+    uint32_t busBytes;
+    uint32_t failures;
+    uint64_t busyUs;
+};
 
 // Function declarations for OLED display management
 bool initOLED();
@@ -24,4 +65,6 @@ void setTextSize(int size);
 void setCursor(int x, int y);
 void printText(const String &text);
 
+OledStats getOledStats();
+
 #endif
@@ -0,0 +1,53 @@
+#ifndef PAGE_DIFF_RENDERER_H
+#define PAGE_DIFF_RENDERER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Retained-mode refresh for a 128x64 page-addressed OLED: keeps the frame
+// the panel is showing and sends only the column runs of each page that
+// differ from it. A redraw that changes one status line costs a few dozen
+// bytes instead of the whole 1 KB buffer. Nearby changes are sent as one
+// run when the unchanged bytes between them cost less than re-addressing.
+class PageDiffRenderer
+{
+public:
+    static const int WIDTH = 128;
+    static const int PAGES = 8;
+    static const size_t FRAME_BYTES = WIDTH * PAGES;
+
+    // Addressing per run over I2C: a command transfer (address, control,
+    // page, two column bytes) and the data transfer's address and control
+    static const int RUN_OVERHEAD = 7;
+
+    struct Stats
+    {
+        uint32_t frames;    // render() calls
+        uint32_t unchanged; // ... that had nothing to send
+        uint32_t runs;
+        uint32_t dataBytes;
+        uint32_t busBytes; // Data plus RUN_OVERHEAD per run
+        uint32_t failures; // Runs the panel did not take
+    };
+
+    PageDiffRenderer();
+
+    // The next render() sends every page (panel reset or contents unknown)
+    void invalidate();
+
+    // frame is FRAME_BYTES in panel layout (Adafruit GFX buffers are).
+    // Returns the bytes put on the bus.
+    size_t render(const uint8_t *frame, DisplayPanel *panel);
+
+    const Stats &getStats() const;
+
+private:
+    uint8_t shown[FRAME_BYTES];
+    bool valid;
+    Stats stats;
+
+    bool sendRun(DisplayPanel *panel, int page, int start, int end, const uint8_t *row, size_t &sent);
+};
+
+#endif // PAGE_DIFF_RENDERER_H
@@ -0,0 +1,33 @@
+#ifndef QUERY_STRING_H
+#define QUERY_STRING_H
+
+#include <stddef.h>
+
+// Read-only view over a URL query string ("a=1&b=x%20y"). Nothing is
+// allocated: values are url-decoded straight into the caller's buffer.
+class QueryString
+{
+public:
+    explicit QueryString(const char *query);
+
+    bool has(const char *name) const;
+
+    // Copies the decoded value of name into out, always terminated and
+    // truncated to outSize - 1 chars. Returns false if name is absent.
+    bool get(const char *name, char *out, size_t outSize) const;
+
+    // False if name is absent or not a number
+    bool getInt(const char *name, int &out) const;
+
+private:
+    // Start of the raw value of name, with its length; nullptr if absent
+    const char *find(const char *name, size_t &len) const;
+
+    const char *query;
+};
+
+// Decodes %XX escapes and '+' in src[0..len) into out (terminated).
+// Returns the decoded length.
+size_t urlDecodeTo(const char *src, size_t len, char *out, size_t outSize);
+
+#endif // QUERY_STRING_H
@@ -0,0 +1,66 @@
+#ifndef REQUEST_BODY_H
+#define REQUEST_BODY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// HTTP request body made of prefix + frame + suffix, produced on demand.
+// The frame is read straight from the caller's buffer (e.g. camera_fb_t::buf)
+// and, in base64 mode, encoded chunk by chunk as the socket asks for data, so
+// the encoded image never exists in memory as a whole.
+// Prefix, frame and suffix must stay valid until the body has been sent.
+class RequestBody
+{
+public:
+    enum FrameEncoding
+    {
+        FRAME_RAW,
+        FRAME_BASE64
+    };
+
+    RequestBody(); // Empty body
+    RequestBody(const char *prefix, size_t prefixLen,
+                const uint8_t *frame, size_t frameLen, FrameEncoding encoding,
+                const char *suffix, size_t suffixLen);
+
+    // Total body length, known up front for Content-Length
+    size_t size() const;
+    size_t remaining() const;
+
+    // Fill up to maxLen bytes. Returns 0 once the whole body has been read.
+    size_t read(uint8_t *out, size_t maxLen);
+
+    // Back to the first byte, to send the body again
+    void rewind();
+
+private:
+    enum Segment
+    {
+        SEG_PREFIX,
+        SEG_FRAME,
+        SEG_SUFFIX,
+        SEG_DONE
+    };
+
+    const char *prefix;
+    size_t prefixLen;
+    const uint8_t *frame;
+    size_t frameLen;
+    FrameEncoding encoding;
+    const char *suffix;
+    size_t suffixLen;
+
+    Segment segment;
+    size_t offset;   // Position inside the current segment's source data
+    size_t produced; // Bytes handed out so far
+
+    // Base64 quad that did not fit in the caller's buffer
+    char pending[4];
+    uint8_t pendingLen;
+    uint8_t pendingPos;
+
+    size_t frameEncodedLength() const;
+    size_t readFrame(uint8_t *out, size_t maxLen);
+};
+
+#endif // REQUEST_BODY_H
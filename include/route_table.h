@@ -0,0 +1,76 @@
+#ifndef ROUTE_TABLE_H
+#define ROUTE_TABLE_H
+
+#include <stddef.h>
+#include <string.h>
+
+// One entry of a request routing table. Tables are plain constexpr arrays
+// sorted by path, then method; routeTableSorted() lets the owner
+// static_assert that order so lookups can binary search.
+template <typename Handler>
+struct RouteEntry
+{
+    const char *method;
+    const char *path;
+    Handler handler;
+};
+
+// strcmp usable in constant expressions
+constexpr int routeStrCmp(const char *a, const char *b)
+{
+    return (*a != *b || *a == '\0') ? (int)(unsigned char)*a - (int)(unsigned char)*b
+                                    : routeStrCmp(a + 1, b + 1);
+}
+
+template <typename Handler>
+constexpr int routeOrder(const RouteEntry<Handler> &a, const RouteEntry<Handler> &b)
+{
+    return routeStrCmp(a.path, b.path) != 0 ? routeStrCmp(a.path, b.path) : routeStrCmp(a.method, b.method);
+}
+
+// True if every entry sorts strictly after the previous one (no duplicates)
+template <typename Handler, size_t N>
+constexpr bool routeTableSorted(const RouteEntry<Handler> (&table)[N], size_t i = 1)
+{
+    return i >= N || (routeOrder(table[i - 1], table[i]) < 0 && routeTableSorted(table, i + 1));
+}
+
+enum RouteMatch
+{
+    ROUTE_FOUND,
+    ROUTE_NO_PATH,
+    ROUTE_NO_METHOD // Path exists but not for this method
+};
+
+// Binary search for the exact method and path in a sorted table
+template <typename Handler>
+RouteMatch findRoute(const RouteEntry<Handler> *table, size_t count, const char *method, const char *path,
+                     Handler &handler)
+{
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(table[mid].path, path) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == count || strcmp(table[lo].path, path) != 0)
+        return ROUTE_NO_PATH;
+
+    // Entries for the same path are adjacent, ordered by method
+    for (size_t i = lo; i < count && strcmp(table[i].path, path) == 0; i++)
+    {
+        if (strcmp(table[i].method, method) == 0)
+        {
+            handler = table[i].handler;
+            return ROUTE_FOUND;
+        }
+    }
+    return ROUTE_NO_METHOD;
+}
+
+#endif // ROUTE_TABLE_H
@@ -0,0 +1,52 @@
+#ifndef SCENE_GATE_H
+#define SCENE_GATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit average-luma hash of an RGB565 image (big-endian pixels, as produced
+// by jpg2rgb565). The image is split into an 8x8 grid; each bit says whether
+// that cell is brighter than the image mean. Small lighting noise and JPEG
+// artefacts flip few bits; objects moving or the robot turning flip many.
+uint64_t sceneSignatureFromRgb565(const uint8_t *pixels, int width, int height);
+
+// Number of differing bits between two signatures (0..64)
+int sceneSignatureDistance(uint64_t a, uint64_t b);
+
+// Decides whether a frame is different enough from the one behind the last
+// decision to be worth a backend request.
+class SceneGate
+{
+public:
+    SceneGate();
+
+    // threshold: max differing bits still treated as "same scene"; 0 disables
+    // the gate. maxReuseMs: always send once the last decision is this old.
+    void configure(int threshold, uint32_t maxReuseMs);
+    int getThreshold() const;
+
+    // True if the frame should go to the backend. Counts the outcome.
+    bool shouldSend(uint64_t signature, uint32_t nowMs);
+
+    // Call when a decision was obtained for a frame with this signature
+    void recordDecision(uint64_t signature, uint32_t nowMs);
+
+    // Forget the reference frame (e.g. after a failed request)
+    void invalidate();
+
+    uint32_t getSent() const;
+    uint32_t getSkipped() const;
+    int getLastDistance() const;
+
+private:
+    int threshold;
+    uint32_t maxReuseMs;
+    bool hasReference;
+    uint64_t referenceSignature;
+    uint32_t referenceTimeMs;
+    int lastDistance;
+    uint32_t sent;
+    uint32_t skipped;
+};
+
+#endif // SCENE_GATE_H
@@ -0,0 +1,85 @@
+#ifndef SERVO_MOTION_TASK_H
+#define SERVO_MOTION_TASK_H
+
+#include <Arduino.h>
+#include "hal.h"
+#include "motion_profile.h"
+
+// Drives the servo along MotionProfile trajectories from its own FreeRTOS
+// task, updating the angle once per servo PWM frame. A move takes as long
+// as its distance needs under the velocity/acceleration limits, plus a
+// short settle, after which the servo is detached and the done callback
+// fires. A new move replaces the current one and is replanned from where
+// the servo is, at the speed it has. Only this task touches the servo once
+// begin() has been called.
+class ServoMotionTask
+{
+public:
+    // Called on the motion task when a move (every waypoint) has settled
+    typedef void (*DoneCallback)(int angle, uint32_t elapsedUs);
+
+    static const uint32_t UPDATE_MS = 20; // One 50 Hz servo frame
+    static const int MAX_WAYPOINTS = 4;
+
+    ServoMotionTask();
+
+    bool begin(ServoOutput *servo, int startAngle, BaseType_t core = 1);
+
+    // False, keeping the current limits, unless both are positive
+    bool setLimits(float maxVelocity, float maxAcceleration, uint32_t settleMs);
+    void setDoneCallback(DoneCallback callback);
+
+    void moveTo(int angle);
+    // Each waypoint is reached and settled before the next one
+    void moveThrough(const int *angles, int count);
+
+    bool isMoving();
+    int getPosition(); // Angle the servo was last sent
+    uint32_t getMovesCompleted();
+    uint32_t getMovesReplaced();
+
+private:
+    enum Phase
+    {
+        PHASE_IDLE,
+        PHASE_MOVING,
+        PHASE_SETTLING
+    };
+
+    ServoOutput *servo;
+    TaskHandle_t taskHandle;
+    portMUX_TYPE lock;
+    DoneCallback doneCallback;
+
+    // Set by moveTo(), taken by the task (under lock)
+    int pending[MAX_WAYPOINTS];
+    int pendingCount;
+    bool hasPending;
+    MotionProfile::Limits limits;
+    uint32_t settleMs;
+
+    // Owned by the task
+    MotionProfile profile;
+    int waypoints[MAX_WAYPOINTS];
+    int waypointCount;
+    int waypointIndex;
+    Phase phase;
+    uint32_t segmentStartUs;
+    uint32_t commandStartUs;
+    uint32_t settleUntilUs;
+    float position;
+    bool attached;
+
+    volatile int lastWritten;
+    volatile bool moving;
+    volatile uint32_t movesCompleted;
+    volatile uint32_t movesReplaced;
+
+    static void taskEntry(void *arg);
+    void run();
+    void update(uint32_t nowUs);
+    void startSegment(float velocity, uint32_t nowUs);
+    void writeAngle(float angle);
+};
+
+#endif // SERVO_MOTION_TASK_H
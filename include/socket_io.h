@@ -0,0 +1,12 @@
+#ifndef SOCKET_IO_H
+#define SOCKET_IO_H
+
+#include <WiFi.h>
+
+// Write as much of data as the socket accepts right now, without blocking.
+// Returns the number of bytes written (0 if the send buffer is full) or -1 if
+// the connection is broken. WiFiClient::write() would instead wait (up to its
+// timeout) until everything has been sent.
+int socketWriteSome(WiFiClient &client, const uint8_t *data, size_t len);
+
+#endif // SOCKET_IO_H
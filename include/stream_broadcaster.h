@@ -0,0 +1,94 @@
+#ifndef STREAM_BROADCASTER_H
+#define STREAM_BROADCASTER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "esp32cam_manager.h"
+
+// Per-viewer figures for the control page
+struct StreamClientStats
+{
+    bool active;
+    String remoteIP;
+    float fps;
+    uint32_t framesSent;
+    uint32_t framesDropped; // Frames published while this viewer was still busy with an older one
+};
+
+// MJPEG fan-out for /stream. Each frame is grabbed once (stream profile) by
+// a FreeRTOS task of its own, copied out of the driver into a refcounted
+// slot, and written to every viewer with non-blocking socket writes from
+// loop(), which never waits on the camera. A viewer that is still sending an
+// older frame skips the frames published meanwhile instead of holding the
+// others back; a viewer that makes no progress at all is disconnected.
+class StreamBroadcaster
+{
+public:
+    static const int MAX_CLIENTS = 4;
+    static const int SLOT_COUNT = 3;
+
+    StreamBroadcaster();
+    // Grabs on core 0, next to the frame capture task. Without the task
+    // (out of memory) loop() grabs the frames itself.
+    void begin(ESP32CamManager *cam, uint32_t frameIntervalMs = 50, BaseType_t core = 0);
+
+    // Takes over the connection and sends the multipart response header.
+    // Returns false if all viewer slots are taken.
+    bool addClient(WiFiClient &client);
+
+    // Call from the main loop; never blocks on a viewer
+    void loop();
+
+    int getClientCount();
+    StreamClientStats getClientStats(int index);
+
+private:
+    struct FrameSlot
+    {
+        uint8_t *data;
+        size_t capacity;
+        size_t len;
+        uint32_t seq;
+        int refs;
+    };
+
+    struct Viewer
+    {
+        WiFiClient client;
+        bool active;
+        int slot;         // Frame being sent, -1 when idle
+        size_t offset;    // Progress through part header + JPEG + trailer
+        char header[96];  // Multipart part header for the current frame
+        size_t headerLen;
+        uint32_t lastSeq; // Last frame started
+        uint32_t lastProgressMs;
+        uint32_t framesSent;
+        uint32_t framesDropped;
+        uint32_t fpsWindowStart;
+        uint32_t fpsWindowFrames;
+        float fps;
+    };
+
+    ESP32CamManager *camManager;
+    uint32_t frameIntervalMs;
+    uint32_t lastGrabMs;
+    TaskHandle_t taskHandle;
+    volatile int viewerCount; // Read by the task: no grabs without viewers
+    // Guards refs, len, seq and latestSlot. A slot that is neither
+    // referenced nor the latest is only touched by the grab in progress.
+    portMUX_TYPE slotLock;
+    uint32_t nextSeq;
+    int latestSlot;
+    FrameSlot slots[SLOT_COUNT];
+    Viewer viewers[MAX_CLIENTS];
+
+    static void taskEntry(void *arg);
+    void run();
+    bool grabFrame();
+    bool startLatestFrame(Viewer &viewer);
+    void finishFrame(Viewer &viewer);
+    void pump(Viewer &viewer, uint32_t now);
+    void dropViewer(Viewer &viewer);
+};
+
+#endif // STREAM_BROADCASTER_H
@@ -0,0 +1,51 @@
+#ifndef TLS_SESSION_H
+#define TLS_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// TLS client session over a connected non-blocking socket, for
+// AsyncHttpRequest. No call waits: TLS_WANT means the socket could not
+// move data yet, so try again from a later poll(). The server certificate
+// is checked against the ESP-IDF certificate bundle on the board and the
+// system store on a host, unless setTrustedCerts() names other roots.
+class TlsSession
+{
+public:
+    enum Result
+    {
+        TLS_OK,
+        TLS_WANT,   // Nothing could move without blocking
+        TLS_CLOSED, // Peer ended the session
+        TLS_ERROR   // Handshake, certificate or socket failure
+    };
+
+    TlsSession();
+    ~TlsSession();
+
+    // Sets up a session for host on sock; false if that failed (memory)
+    bool begin(int sock, const char *host);
+    Result handshake();
+    Result write(const uint8_t *data, size_t len, size_t &written);
+    Result read(uint8_t *buf, size_t len, size_t &received);
+    // Frees the session; closing the socket is left to the caller
+    void end();
+    bool isOpen() const;
+
+    // Why the last call failed, for the log
+    const char *getLastError() const;
+
+    // PEM roots to trust instead of the default set, for sessions begun
+    // after the call; nullptr goes back to the default. Not copied.
+    static void setTrustedCerts(const char *pem);
+
+private:
+    struct Impl;
+    Impl *impl;
+    char lastError[96];
+
+    TlsSession(const TlsSession &) = delete;
+    TlsSession &operator=(const TlsSession &) = delete;
+};
+
+#endif // TLS_SESSION_H
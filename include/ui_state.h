@@ -0,0 +1,67 @@
+#ifndef UI_STATE_H
+#define UI_STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One OLED screen: a layout and up to four lines of text. MAIN uses them as
+// IP, status, direction and distance; INTRO only the first (its status).
+struct UiScreen
+{
+    enum Layout
+    {
+        LAYOUT_NONE,
+        LAYOUT_INTRO,
+        LAYOUT_MAIN,
+        LAYOUT_TEXT,     // Lines top to bottom
+        LAYOUT_CENTERED, // First line in the middle
+    };
+
+    static const int LINES = 4;
+    static const size_t LINE_MAX = 32; // Including the terminator
+
+    uint8_t layout;
+    char lines[LINES][LINE_MAX];
+
+    // Zero-filled, so screens with the same text compare equal byte for byte
+    void clear(uint8_t layout);
+    void setLine(int index, const char *text);
+    bool equals(const UiScreen &other) const;
+};
+
+// A screen to show, for holdMs (a transient message) or until the next one
+struct UiUpdate
+{
+    UiScreen screen;
+    uint32_t holdMs;
+};
+
+// What the OLED should show, folded from a stream of updates. Updates with
+// no hold replace the base screen; a held update is shown over it until it
+// expires (or a newer held one replaces it), so base updates arriving in
+// the meantime are kept for afterwards rather than cutting it short. Only
+// the latest state is kept, however many updates came in between draws.
+class UiState
+{
+public:
+    UiState();
+
+    void apply(const UiUpdate &update, uint32_t nowMs);
+    // Drops a transient whose time is up
+    void expire(uint32_t nowMs);
+    // Until the transient expires, or -1 if there is none
+    int32_t msUntilExpiry(uint32_t nowMs) const;
+
+    const UiScreen &visible() const;
+    bool needsDraw() const; // visible() differs from what was last drawn
+    void markDrawn();
+
+private:
+    UiScreen base;
+    UiScreen transient;
+    UiScreen drawn;
+    bool hasTransient;
+    uint32_t transientUntilMs;
+};
+
+#endif // UI_STATE_H
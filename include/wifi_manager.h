@@ -2,24 +2,21 @@
 #define WIFI_MANAGER_H
 
 #include <WiFi.h>
-#include <EEPROM.h>
+#include "config_store.h"
+#include "hal.h"
 #include <Arduino.h>
 
-// EEPROM settings for WiFi credentials
-#define EEPROM_WIFI_FLAG 0   // 1 byte for flag
-#define EEPROM_SSID_START 1  // 33 bytes for SSID (32 + null terminator)
-#define EEPROM_PASS_START 34 // 65 bytes for password (64 + null terminator)
-
-class WiFiManager {
+class WiFiManager : public NetworkLink {
 private:
+    ConfigStore* config; // WiFi section: wifiConfigured, wifiSsid, wifiPassword
     String wifi_ssid;
     String wifi_password;
     bool wifiConfigured;
     WiFiServer* server;
     
     // Private helper methods
-    void saveCredentialsToEEPROM(String ssid, String password);
-    bool loadCredentialsFromEEPROM();
+    void saveCredentials(String ssid, String password);
+    bool loadCredentials();
     void getCredentialsFromSerial();
     
 public:
@@ -27,7 +24,7 @@ public:
     WiFiManager();
     
     // Initialization and connection
-    bool begin(int serverPort = 80);
+    bool begin(ConfigStore *settings, int serverPort = 80);
     bool connect();
     void disconnect();
     
@@ -39,7 +36,7 @@ public:
     int getPasswordLength();
     
     // Connection status
-    bool isConnected();
+    bool isConnected() override;
     String getLocalIP();
     String getGatewayIP();
     String getSubnetMask();
@@ -0,0 +1,98 @@
+#include "Arduino.h"
+
+#include <random>
+#include <time.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+
+static uint64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t sinceStartUs()
+{
+    static const uint64_t startUs = monotonicUs();
+    return monotonicUs() - startUs;
+}
+
+uint32_t millis()
+{
+    return (uint32_t)(sinceStartUs() / 1000);
+}
+
+uint32_t micros()
+{
+    return (uint32_t)sinceStartUs();
+}
+
+void delay(uint32_t ms)
+{
+    usleep((useconds_t)ms * 1000);
+}
+
+static std::mt19937 &generator()
+{
+    static std::mt19937 engine(std::random_device{}());
+    return engine;
+}
+
+long random(long howbig)
+{
+    return howbig > 0 ? (long)(generator()() % (unsigned long)howbig) : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+    return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+uint32_t esp_random()
+{
+    return generator()();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *arg,
+                                   BaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    return pdFAIL;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait)
+{
+    return 0;
+}
+
+size_t HardwareSerial::write(const uint8_t *data, size_t len)
+{
+    size_t written = fwrite(data, 1, len, stdout);
+    fflush(stdout);
+    return written;
+}
+
+size_t HardwareSerial::print(const char *text)
+{
+    return write((const uint8_t *)text, strlen(text));
+}
+
+size_t HardwareSerial::println(const char *text)
+{
+    return print(text) + print("\r\n");
+}
+
+int HardwareSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    fflush(stdout);
+    return n;
+}
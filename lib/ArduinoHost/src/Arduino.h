@@ -0,0 +1,71 @@
+#ifndef ARDUINO_HOST_H
+#define ARDUINO_HOST_H
+
+// The part of the Arduino-ESP32 core that AIBotManager, Log and Metrics
+// use, on top of the C library, so [env:native] builds them unchanged.
+// ARDUINO stays undefined: code that needs the board still checks for it.
+
+#include <math.h>
+#include <mutex>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Count from the first call, like millis() from boot
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+uint32_t esp_random();
+
+// FreeRTOS as far as Log and Metrics go. There are no tasks on the host,
+// so Log::begin() fails and lines are written straight out; critical
+// sections become a mutex, since tests may record from several threads.
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+struct portMUX_TYPE
+{
+    std::mutex lock;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->lock.lock()
+#define portEXIT_CRITICAL(mux) (mux)->lock.unlock()
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *arg,
+                                   BaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+
+// Serial is the process's stdout
+class HardwareSerial
+{
+public:
+    size_t write(const uint8_t *data, size_t len);
+    size_t print(const char *text);
+    size_t println(const char *text);
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+#endif // ARDUINO_HOST_H
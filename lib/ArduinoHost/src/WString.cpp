@@ -0,0 +1,215 @@
+#include "WString.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Digits of value in base 2..36, lowercase like utoa()
+static std::string unsignedText(unsigned long long value, unsigned char base)
+{
+    if (base < 2 || base > 36)
+        base = 10;
+    char digits[66];
+    char *p = digits + sizeof(digits);
+    *--p = '\0';
+    do
+    {
+        unsigned digit = (unsigned)(value % base);
+        *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value);
+    return p;
+}
+
+static std::string signedText(long long value, unsigned char base)
+{
+    if (value < 0 && base == 10)
+        return "-" + unsignedText(0ULL - (unsigned long long)value, base);
+    return unsignedText((unsigned long long)value, base);
+}
+
+String::String(int value, unsigned char base) : text(signedText(value, base))
+{
+}
+
+String::String(unsigned int value, unsigned char base) : text(unsignedText(value, base))
+{
+}
+
+String::String(long value, unsigned char base) : text(signedText(value, base))
+{
+}
+
+String::String(unsigned long value, unsigned char base) : text(unsignedText(value, base))
+{
+}
+
+String::String(long long value, unsigned char base) : text(signedText(value, base))
+{
+}
+
+String::String(unsigned long long value, unsigned char base) : text(unsignedText(value, base))
+{
+}
+
+String::String(float value, unsigned int decimals) : String((double)value, decimals)
+{
+}
+
+String::String(double value, unsigned int decimals)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+    text = buffer;
+}
+
+bool String::reserve(unsigned int size)
+{
+    text.reserve(size);
+    return true;
+}
+
+String &String::operator=(const char *value)
+{
+    text = value ? value : "";
+    return *this;
+}
+
+String &String::operator+=(const String &value)
+{
+    text += value.text;
+    return *this;
+}
+
+String &String::operator+=(const char *value)
+{
+    if (value)
+        text += value;
+    return *this;
+}
+
+String &String::operator+=(char value)
+{
+    text += value;
+    return *this;
+}
+
+bool String::concat(const char *value, unsigned int len)
+{
+    if (!value)
+        return false;
+    text.append(value, len);
+    return true;
+}
+
+bool String::concat(const String &value)
+{
+    text += value.text;
+    return true;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+    return text.compare(0, prefix.text.length(), prefix.text) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+    return text.length() >= suffix.text.length() &&
+           text.compare(text.length() - suffix.text.length(), suffix.text.length(), suffix.text) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t found = text.find(c, from);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+int String::indexOf(const String &value, unsigned int from) const
+{
+    size_t found = text.find(value.text, from);
+    return found == std::string::npos ? -1 : (int)found;
+}
+
+String String::substring(unsigned int from) const
+{
+    return substring(from, length());
+}
+
+// Swapped bounds are put in order and both are clamped to the length
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to)
+    {
+        unsigned int swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from >= text.length())
+        return String();
+    if (to > text.length())
+        to = length();
+    return String(text.substr(from, to - from));
+}
+
+void String::trim()
+{
+    size_t begin = 0;
+    while (begin < text.length() && isspace((unsigned char)text[begin]))
+        begin++;
+    size_t end = text.length();
+    while (end > begin && isspace((unsigned char)text[end - 1]))
+        end--;
+    text = text.substr(begin, end - begin);
+}
+
+void String::toLowerCase()
+{
+    for (char &c : text)
+        c = (char)tolower((unsigned char)c);
+}
+
+void String::toUpperCase()
+{
+    for (char &c : text)
+        c = (char)toupper((unsigned char)c);
+}
+
+long String::toInt() const
+{
+    return atol(text.c_str());
+}
+
+float String::toFloat() const
+{
+    return (float)atof(text.c_str());
+}
+
+String operator+(const String &left, const String &right)
+{
+    String sum = left;
+    sum += right;
+    return sum;
+}
+
+String operator+(const String &left, const char *right)
+{
+    String sum = left;
+    sum += right;
+    return sum;
+}
+
+String operator+(const char *left, const String &right)
+{
+    String sum = left;
+    sum += right;
+    return sum;
+}
+
+String operator+(const String &left, char right)
+{
+    String sum = left;
+    sum += right;
+    return sum;
+}
@@ -0,0 +1,66 @@
+#ifndef ARDUINO_HOST_WSTRING_H
+#define ARDUINO_HOST_WSTRING_H
+
+#include <stddef.h>
+#include <string>
+
+// Arduino String over std::string: the constructors, operators and
+// members the portable sources use, with the same results (number
+// formatting, substring() clamping, -1 from indexOf()).
+class String
+{
+public:
+    String() {}
+    String(const char *text) : text(text ? text : "") {}
+    String(const std::string &text) : text(text) {}
+    explicit String(char c) : text(1, c) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimals = 2);
+    explicit String(double value, unsigned int decimals = 2);
+
+    const char *c_str() const { return text.c_str(); }
+    unsigned int length() const { return (unsigned int)text.length(); }
+    bool isEmpty() const { return text.empty(); }
+    bool reserve(unsigned int size);
+
+    String &operator=(const char *value);
+    String &operator+=(const String &value);
+    String &operator+=(const char *value);
+    String &operator+=(char value);
+    bool concat(const char *value, unsigned int len);
+    bool concat(const String &value);
+
+    bool operator==(const String &other) const { return text == other.text; }
+    bool operator==(const char *other) const { return text == (other ? other : ""); }
+    bool operator!=(const String &other) const { return !(*this == other); }
+    bool operator!=(const char *other) const { return !(*this == other); }
+    char operator[](unsigned int index) const { return index < text.length() ? text[index] : 0; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    bool startsWith(const String &prefix) const;
+    bool endsWith(const String &suffix) const;
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &value, unsigned int from = 0) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+    void trim();
+    void toLowerCase();
+    void toUpperCase();
+    long toInt() const;
+    float toFloat() const;
+
+private:
+    std::string text;
+};
+
+String operator+(const String &left, const String &right);
+String operator+(const String &left, const char *right);
+String operator+(const char *left, const String &right);
+String operator+(const String &left, char right);
+
+#endif // ARDUINO_HOST_WSTRING_H
@@ -0,0 +1,141 @@
+#include "WiFi.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct WiFiClient::Socket
+{
+    int fd;
+
+    explicit Socket(int fd) : fd(fd) {}
+    ~Socket() { ::close(fd); }
+};
+
+WiFiClient::WiFiClient()
+{
+}
+
+WiFiClient::WiFiClient(int fd) : socket(std::make_shared<Socket>(fd))
+{
+}
+
+int WiFiClient::fd() const
+{
+    return socket ? socket->fd : -1;
+}
+
+// Open until the peer has closed (a zero-byte peek) or the socket failed;
+// unread data counts as connected, as on the board
+uint8_t WiFiClient::connected()
+{
+    if (!socket)
+        return 0;
+    char c;
+    int n = recv(socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n > 0)
+        return 1;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 1;
+    return 0;
+}
+
+int WiFiClient::available()
+{
+    int count = 0;
+    if (!socket || ioctl(socket->fd, FIONREAD, &count) < 0)
+        return 0;
+    return count;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+    if (!socket)
+        return -1;
+    int n = recv(socket->fd, buf, size, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+    return n;
+}
+
+// Blocks until everything is sent, like WiFiClient::write() on the board
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+    size_t sent = 0;
+    while (socket && sent < size)
+    {
+        int n = send(socket->fd, buf + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        sent += n;
+    }
+    return sent;
+}
+
+int WiFiClient::setNoDelay(bool nodelay)
+{
+    if (!socket)
+        return -1;
+    int flag = nodelay ? 1 : 0;
+    return setsockopt(socket->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+void WiFiClient::stop()
+{
+    socket.reset();
+}
+
+WiFiServer::WiFiServer(uint16_t port) : port(port), listenFd(-1)
+{
+}
+
+WiFiServer::~WiFiServer()
+{
+    end();
+}
+
+void WiFiServer::begin(uint16_t newPort)
+{
+    end();
+    if (newPort)
+        port = newPort;
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        return;
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 64) < 0)
+    {
+        end();
+        return;
+    }
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+}
+
+void WiFiServer::end()
+{
+    if (listenFd >= 0)
+        ::close(listenFd);
+    listenFd = -1;
+}
+
+WiFiClient WiFiServer::available()
+{
+    if (listenFd < 0)
+        return WiFiClient();
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0)
+        return WiFiClient();
+    return WiFiClient(fd);
+}
@@ -0,0 +1,50 @@
+#ifndef ARDUINO_HOST_WIFI_H
+#define ARDUINO_HOST_WIFI_H
+
+// WiFiClient and WiFiServer over the host's sockets, as far as HttpServer
+// and socket_io.cpp use them, so the web server runs on loopback in
+// [env:native]. As on the board: the server accepts without waiting,
+// available() and read() never block, and copies of a client share one
+// socket, closed when the last of them lets go.
+
+#include <memory>
+#include "Arduino.h"
+
+class WiFiClient
+{
+public:
+    WiFiClient();
+    explicit WiFiClient(int fd);
+
+    int fd() const;
+    uint8_t connected();
+    int available();
+    int read(uint8_t *buf, size_t size);
+    size_t write(const uint8_t *buf, size_t size);
+    int setNoDelay(bool nodelay);
+    void stop();
+
+    operator bool() { return connected(); }
+
+private:
+    struct Socket;
+    std::shared_ptr<Socket> socket;
+};
+
+class WiFiServer
+{
+public:
+    explicit WiFiServer(uint16_t port = 80);
+    ~WiFiServer();
+
+    // Listens on 127.0.0.1 only
+    void begin(uint16_t port = 0);
+    void end();
+    WiFiClient available();
+
+private:
+    uint16_t port;
+    int listenFd;
+};
+
+#endif // ARDUINO_HOST_WIFI_H
@@ -0,0 +1,56 @@
+# PlatformIO pre-build script: gzips web/index.html into web_page.h in the
+# build directory, so the firmware serves the control page from flash as is.
+# The header is only rewritten when its content changes.
+
+import gzip
+import hashlib
+import os
+
+Import("env")  # noqa: F821 (provided by PlatformIO)
+
+SOURCE = os.path.join(env.subst("$PROJECT_DIR"), "web", "index.html")  # noqa: F821
+OUT_DIR = os.path.join(env.subst("$BUILD_DIR"), "generated")  # noqa: F821
+
+
+def render(page):
+    packed = gzip.compress(page, 9, mtime=0)
+    etag = hashlib.sha1(page).hexdigest()[:16]
+    lines = [
+        "// Generated by scripts/embed_web.py from web/index.html. Do not edit.",
+        "#ifndef WEB_PAGE_H",
+        "#define WEB_PAGE_H",
+        "",
+        "#include <stddef.h>",
+        "#include <stdint.h>",
+        "",
+        "// %d bytes, %d gzipped" % (len(page), len(packed)),
+        "static const uint8_t WEB_PAGE_GZ[] = {",
+    ]
+    for i in range(0, len(packed), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in packed[i:i + 16]) + ",")
+    lines += [
+        "};",
+        "static const size_t WEB_PAGE_GZ_LEN = sizeof(WEB_PAGE_GZ);",
+        'static const char WEB_PAGE_ETAG[] = "\\"%s\\"";' % etag,
+        "",
+        "#endif // WEB_PAGE_H",
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def main():
+    with open(SOURCE, "rb") as f:
+        header = render(f.read())
+
+    os.makedirs(OUT_DIR, exist_ok=True)
+    path = os.path.join(OUT_DIR, "web_page.h")
+    if not os.path.exists(path) or open(path).read() != header:
+        with open(path, "w") as f:
+            f.write(header)
+        print("embed_web: wrote %s" % path)
+
+    env.Append(CPPPATH=[OUT_DIR])  # noqa: F821
+
+
+main()
@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+# Stand-in for the AI backend, for exercising the bot's request path from a
+# host or a board on the same network. Answers /health and /message with a
+# canned navigation decision and can inject delays and faults.
+#
+# Implements the prompt context cache: a request carrying "context" and
+# "context_hash" stores the context for its session_id; later requests with
+# only the hash get it re-injected. An unknown hash is answered with
+# 409 {"error": "unknown_context_hash"}, and the bot resends the context.
+#
+# Requests with "stream": true get the answer a few characters at a time,
+# like a model generating tokens: as SSE {"delta": ...} events followed by
+# "data: [DONE]", or with --stream-format chunked as the bare text.
+#
+#   python3 scripts/mock_backend.py --port 8000 --think 20 --chunked
+#   python3 scripts/mock_backend.py --think 0.5 --token-delay 0.03
+#
+# Point the bot's API URL at http://<this machine>:<port>, or at https://
+# with --tls-cert and --tls-key (PEM files; the bot must trust the cert).
+
+import argparse
+import base64
+import email.parser
+import email.policy
+import json
+import random
+import ssl
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+DIRECTIONS = ["forward", "left", "right", "stop"]
+
+
+def fnv1a64(data):
+    h = 0xcbf29ce484222325
+    for b in data.encode() if isinstance(data, str) else data:
+        h ^= b
+        h = (h * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return "%016x" % h
+
+
+def parse_fields(content_type, body):
+    """Form fields of a JSON or multipart/form-data message body."""
+    if content_type.startswith("multipart/form-data"):
+        msg = email.parser.BytesParser(policy=email.policy.HTTP).parsebytes(
+            b"Content-Type: " + content_type.encode() + b"\r\n\r\n" + body)
+        fields = {}
+        for part in msg.iter_parts():
+            name = part.get_param("name", header="content-disposition")
+            payload = part.get_payload(decode=True)
+            fields[name] = payload if part.get_filename() else payload.decode()
+        return fields
+    return json.loads(body)
+
+
+def decision():
+    # Same key order as the prompt asks for: the decision before the description
+    return {
+        "direction": random.choice(DIRECTIONS),
+        "distance_m": round(random.uniform(0.1, 0.5), 2),
+        "goal_found": False,
+        "description": "Mock backend: a grey tiled floor stretches ahead under warm light. A wooden chair "
+                       "leg stands 0.6 m ahead on the left and two shoes lie by the far wall, about 2 m "
+                       "away. No cat is visible, so the robot turns to scan the room.",
+    }
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        print("%.3f %s" % (time.time(), fmt % args), flush=True)
+
+    def do_GET(self):
+        if self.path != self.server.opts.health_route:
+            self.send_error(404)
+            return
+        self.reply(b'{"status":"ok"}')
+
+    def do_POST(self):
+        opts = self.server.opts
+        if self.path != opts.message_route:
+            self.send_error(404)
+            return
+
+        # Read the upload slowly if asked, to stretch the client's send stage
+        length = int(self.headers.get("Content-Length", 0))
+        chunks = []
+        received = 0
+        while received < length:
+            part = self.rfile.read(min(4096, length - received))
+            if not part:
+                return
+            chunks.append(part)
+            received += len(part)
+            if opts.slow_read:
+                time.sleep(opts.slow_read)
+        print("body: %d bytes, %s" % (received, self.headers.get("Content-Type")), flush=True)
+
+        if opts.drop:
+            self.close_connection = True
+            return
+
+        try:
+            fields = parse_fields(self.headers.get("Content-Type", ""), b"".join(chunks))
+            image = fields.get("image")
+            if isinstance(image, str):
+                image = base64.b64decode(image, validate=True)
+        except ValueError as e:  # binascii.Error included
+            self.reply(json.dumps({"error": "bad_request", "detail": str(e)}).encode(), 400)
+            return
+        if image is not None:
+            # What the frame arrived as, for tests to compare with what was sent
+            print("image: %d bytes, fnv1a64 %s" % (len(image), fnv1a64(image)), flush=True)
+        if not self.resolve_context(fields):
+            self.reply(b'{"error":"unknown_context_hash"}', 409)
+            return
+
+        time.sleep(opts.think)
+
+        text = json.dumps(decision())
+        if opts.fenced:
+            text = "```json\n" + text + "\n```"
+        if fields.get("stream") in (True, "true"):
+            self.stream(text)
+        else:
+            self.reply(text.encode())
+
+    def resolve_context(self, fields):
+        """Store or look up the session's context. False if it is unknown."""
+        server = self.server
+        server.message_count += 1
+        if server.opts.forget_every and server.message_count % server.opts.forget_every == 0:
+            print("forgetting %d cached contexts" % len(server.contexts), flush=True)
+            server.contexts.clear()
+
+        key = (fields.get("session_id"), fields.get("context_hash"))
+        context = fields.get("context")
+        if context is not None:
+            if key[1] and fnv1a64(context) != key[1]:
+                print("warning: context_hash %s does not match the context (%s)" % (key[1], fnv1a64(context)), flush=True)
+            server.contexts[key] = context
+            print("context: %d chars received, cached for %s" % (len(context), key), flush=True)
+            return True
+        if key in server.contexts:
+            print("context: re-injected from cache for %s" % (key,), flush=True)
+            return True
+        print("context: unknown hash for %s" % (key,), flush=True)
+        return False
+
+    def stream(self, text):
+        """Send text token by token, each as its own HTTP chunk."""
+        opts = self.server.opts
+        sse = opts.stream_format == "sse"
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream" if sse else "application/json")
+        self.send_header("Cache-Control", "no-cache")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+
+        def send_chunk(data):
+            self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+            self.wfile.flush()
+
+        started = time.time()
+        for i in range(0, len(text), opts.token_chars):
+            if opts.cut_after and i >= opts.cut_after:
+                # Connection lost mid-answer: no closing chunk
+                print("stream cut after %d chars" % i, flush=True)
+                self.close_connection = True
+                return
+            token = text[i:i + opts.token_chars]
+            if sse:
+                send_chunk(b"data: " + json.dumps({"delta": token}).encode() + b"\n\n")
+            else:
+                send_chunk(token.encode())
+            time.sleep(opts.token_delay)
+        if sse:
+            send_chunk(b"data: [DONE]\n\n")
+        self.wfile.write(b"0\r\n\r\n")
+        print("streamed %d chars in %.2f s" % (len(text), time.time() - started), flush=True)
+
+    def reply(self, payload, status=200):
+        opts = self.server.opts
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        if opts.chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            for i in range(0, len(payload), 16):
+                part = payload[i:i + 16]
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(part), part))
+                self.wfile.flush()
+                time.sleep(opts.body_delay)
+            self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.send_header("Content-Length", str(len(payload)))
+            self.end_headers()
+            time.sleep(opts.body_delay)
+            self.wfile.write(payload)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Mock AI backend for the bot")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--message-route", default="/message")
+    parser.add_argument("--health-route", default="/health")
+    parser.add_argument("--think", type=float, default=2.0, help="seconds before the response headers")
+    parser.add_argument("--body-delay", type=float, default=0.0, help="seconds between body parts")
+    parser.add_argument("--slow-read", type=float, default=0.0, help="seconds between 4 KB upload reads")
+    parser.add_argument("--chunked", action="store_true", help="send the response chunked")
+    parser.add_argument("--fenced", action="store_true", help="wrap the JSON in a markdown code fence")
+    parser.add_argument("--drop", action="store_true", help="close without answering")
+    parser.add_argument("--stream-format", choices=["sse", "chunked"], default="sse",
+                        help="framing of streamed answers")
+    parser.add_argument("--token-chars", type=int, default=4, help="characters per streamed token")
+    parser.add_argument("--token-delay", type=float, default=0.03, help="seconds between streamed tokens")
+    parser.add_argument("--cut-after", type=int, default=0, help="close streamed answers after this many characters")
+    parser.add_argument("--forget-every", type=int, default=0, help="drop cached contexts every N messages")
+    parser.add_argument("--idle-timeout", type=float, default=5.0, help="close idle keep-alive connections after this many seconds")
+    parser.add_argument("--tls-cert", help="serve https with this certificate (PEM)")
+    parser.add_argument("--tls-key", help="private key for --tls-cert (PEM)")
+    opts = parser.parse_args()
+
+    Handler.timeout = opts.idle_timeout
+
+    server = ThreadingHTTPServer((opts.host, opts.port), Handler)
+    server.opts = opts
+    server.contexts = {}
+    server.message_count = 0
+    if opts.tls_cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(opts.tls_cert, opts.tls_key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    print("mock backend on %s:%d%s" % (opts.host, opts.port, " (https)" if opts.tls_cert else ""), flush=True)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,69 @@
+#include "actuator_scheduler.h"
+
+#include <string.h>
+
+ActuatorScheduler::ActuatorScheduler() : replaced(0)
+{
+    memset(channels, 0, sizeof(channels));
+}
+
+bool ActuatorScheduler::submit(int index, const Step *steps, int count, void *context, uint32_t nowMs)
+{
+    if (index < 0 || index >= MAX_CHANNELS || count < 1 || count > MAX_STEPS)
+        return false;
+
+    Channel &channel = channels[index];
+    if (channel.busy)
+        replaced++;
+
+    memcpy(channel.steps, steps, sizeof(Step) * count);
+    channel.count = count;
+    channel.next = 0;
+    channel.dueMs = nowMs;
+    channel.context = context;
+    channel.busy = true;
+    advance(channel, nowMs);
+    return true;
+}
+
+void ActuatorScheduler::cancel(int index)
+{
+    if (index >= 0 && index < MAX_CHANNELS)
+        channels[index].busy = false;
+}
+
+// Runs every step that has come due; a step with no hold runs together
+// with the one after it
+void ActuatorScheduler::advance(Channel &channel, uint32_t nowMs)
+{
+    while (channel.busy && (int32_t)(nowMs - channel.dueMs) >= 0)
+    {
+        if (channel.next == channel.count)
+        {
+            channel.busy = false;
+            break;
+        }
+        const Step &step = channel.steps[channel.next++];
+        if (step.action)
+            step.action(channel.context, step.arg);
+        // Holds count from when the step actually ran: a servo needs its
+        // full travel time after the write even if run() came late
+        channel.dueMs = nowMs + step.holdMs;
+    }
+}
+
+void ActuatorScheduler::run(uint32_t nowMs)
+{
+    for (int i = 0; i < MAX_CHANNELS; i++)
+        advance(channels[i], nowMs);
+}
+
+bool ActuatorScheduler::isBusy(int index) const
+{
+    return index >= 0 && index < MAX_CHANNELS && channels[index].busy;
+}
+
+uint32_t ActuatorScheduler::getReplaced() const
+{
+    return replaced;
+}
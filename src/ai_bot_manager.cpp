@@ -1,8 +1,14 @@
 #include "ai_bot_manager.h"
 #include <ArduinoJson.h>
+#include "compile_time_text.h"
+#include "fenced_json_reader.h"
+#include "log.h"
+#include "metrics.h"
+
+static const char *TAG = "bot";
 
 // Context string from the user snippet
-const char *ROBOT_CONTEXT = R"raw(
+constexpr char ROBOT_CONTEXT[] = R"raw(
 You are RobotNavBrain, the vision + navigation controller for a wheeled robot. 
 Your sole mission: reach a cat safely and quickly.
 
@@ -19,11 +25,12 @@ RULES:
 
 OUTPUT: Return exactly one JSON object, no extra text:
 {
-"description": "<2–3 vivid sentences (~90–160 tokens). Mention at least 4 concrete details (colors, counts, object positions, distances) and the reason for the chosen move.>",
 "direction": "forward" | "left" | "right" | "backward" | "stop",
 "distance_m": <float>,
-"goal_found": <true|false>
+"goal_found": <true|false>,
+"description": "<2–3 vivid sentences (~90–160 tokens). Mention at least 4 concrete details (colors, counts, object positions, distances) and the reason for the chosen move.>"
 }
+Keep the keys in this order.
 
 MOVEMENT:
 - Default distances: F≤0.5, L/R≤0.4, B≤0.4 m.
@@ -32,23 +39,45 @@ MOVEMENT:
 ADDITIONAL CONTEXT (may be empty):
 )raw";
 
-AIBotManager::AIBotManager() : camManager(nullptr), wifiManager(nullptr), botRunning(false), lastRequestTime(0)
+// Escaped for JSON and hashed by the compiler. The hash identifies the
+// context to the backend, which caches it per session after the first
+// request that carries it in full.
+constexpr auto ROBOT_CONTEXT_JSON = jsonEscape<jsonEscapedSize(ROBOT_CONTEXT)>(ROBOT_CONTEXT);
+constexpr auto ROBOT_CONTEXT_HASH = hexDigest(fnv1a64(ROBOT_CONTEXT));
+
+// Stage budgets for bot requests (the backend may think for a while) and
+// for the health check, which the next bot request waits for
+static const AsyncHttpRequest::Deadlines BOT_DEADLINES = {5000, 15000, 45000, 10000};
+static const AsyncHttpRequest::Deadlines HEALTH_DEADLINES = {3000, 3000, 5000, 3000};
+
+AIBotManager::AIBotManager()
+    : frameSource(nullptr), network(nullptr), config(nullptr), clock(nullptr), botRunning(false),
+      requestStage(AsyncHttpRequest::REQ_IDLE), frameHeld(false), contextCached(false),
+      requestHasContext(false), contextResends(0), streamActed(false), decisionActedMs(0), healthPending(false),
+      healthInFlight(false), healthResult(HEALTH_NONE), healthStatusCode(-1)
 {
     apiBaseUrl = "";
     apiMessageRoute = "/message";
     apiHealthRoute = "/health";
+    uploadMode = UPLOAD_JSON;
+    streamResponses = false;
     lastBotStatus = "Idle";
     sessionId = "esp32-bot-" + String(random(100000, 999999));
     lastDirection = "None";
     lastDistance = 0.0;
     goalFound = false;
+    lastFrameAgeMs = 0;
     statusCallback = nullptr;
+    decisionCallback = nullptr;
+    memset(&lastTiming, 0, sizeof(lastTiming));
 }
 
-void AIBotManager::begin(ESP32CamManager *cam, WiFiManager *wifi)
+void AIBotManager::begin(FrameSource *frames, NetworkLink *link, ConfigStore *settings, Clock *time)
 {
-    camManager = cam;
-    wifiManager = wifi;
+    frameSource = frames;
+    network = link;
+    config = settings;
+    clock = time;
     loadApiConfig();
 }
 
@@ -57,6 +86,11 @@ void AIBotManager::setStatusCallback(BotStatusCallback callback)
     statusCallback = callback;
 }
 
+void AIBotManager::setDecisionCallback(DecisionCallback callback)
+{
+    decisionCallback = callback;
+}
+
 String AIBotManager::getLastDirection()
 {
     return lastDirection;
@@ -72,85 +106,144 @@ bool AIBotManager::isGoalFound()
     return goalFound;
 }
 
+uint32_t AIBotManager::getLastFrameAge()
+{
+    return lastFrameAgeMs;
+}
+
+void AIBotManager::setSceneChangeThreshold(int bits)
+{
+    sceneGate.configure(bits, 60000);
+}
+
+int AIBotManager::getSceneChangeThreshold()
+{
+    return sceneGate.getThreshold();
+}
+
+uint32_t AIBotManager::getRequestsSent()
+{
+    return sceneGate.getSent();
+}
+
+uint32_t AIBotManager::getRequestsSkipped()
+{
+    return sceneGate.getSkipped();
+}
+
+void AIBotManager::setCadence(uint32_t minIntervalMs, uint32_t maxIntervalMs)
+{
+    cadence.configure(minIntervalMs, maxIntervalMs);
+}
+
+uint32_t AIBotManager::getCadenceMin()
+{
+    return cadence.getMinInterval();
+}
+
+uint32_t AIBotManager::getCadenceMax()
+{
+    return cadence.getMaxInterval();
+}
+
+uint32_t AIBotManager::getDecisionsPerMinute()
+{
+    return cadence.getDecisionsPerMinute(clock->millis());
+}
+
+uint32_t AIBotManager::getAverageStaleness()
+{
+    return cadence.getAverageStaleness();
+}
+
+uint32_t AIBotManager::getAverageLatency()
+{
+    return cadence.getAverageLatency();
+}
+
+BotRequestTiming AIBotManager::getLastRequestTiming()
+{
+    return lastTiming;
+}
+
+bool AIBotManager::isContextCached()
+{
+    return contextCached;
+}
+
+uint32_t AIBotManager::getContextResends()
+{
+    return contextResends;
+}
+
+uint32_t AIBotManager::getNextRequestIn()
+{
+    if (!botRunning || request.isBusy())
+        return 0;
+    return cadence.getNextDelay(clock->millis());
+}
+
 void AIBotManager::loadApiConfig()
 {
-    // Load Base URL
-    apiBaseUrl = "";
-    for (int i = 0; i < EEPROM_BASE_URL_SIZE; i++)
-    {
-        char c = EEPROM.read(EEPROM_BASE_URL_ADDR + i);
-        if (c == 0)
-            break;
-        apiBaseUrl += c;
-    }
+    const BotConfig &settings = config->get();
+
     // Basic validation
-    if (!apiBaseUrl.startsWith("http"))
+    apiBaseUrl = settings.apiBaseUrl;
+    if (apiBaseUrl.length() > 0 && !AsyncHttpRequest::supportsUrl(apiBaseUrl.c_str()))
     {
+        // Left as stored: only a new URL from the user replaces it
+        LOG_W(TAG, "Stored API URL %s is not http:// or https://, not using it", apiBaseUrl.c_str());
+        lastBotStatus = "Err: API URL";
         apiBaseUrl = "";
     }
 
-    // Load Message Route
-    apiMessageRoute = "";
-    for (int i = 0; i < EEPROM_MSG_ROUTE_SIZE; i++)
-    {
-        char c = EEPROM.read(EEPROM_MSG_ROUTE_ADDR + i);
-        if (c == 0)
-            break;
-        apiMessageRoute += c;
-    }
+    apiMessageRoute = settings.apiMessageRoute;
     if (apiMessageRoute.length() == 0)
         apiMessageRoute = "/message";
 
-    // Load Health Route
-    apiHealthRoute = "";
-    for (int i = 0; i < EEPROM_HEALTH_ROUTE_SIZE; i++)
-    {
-        char c = EEPROM.read(EEPROM_HEALTH_ROUTE_ADDR + i);
-        if (c == 0)
-            break;
-        apiHealthRoute += c;
-    }
+    apiHealthRoute = settings.apiHealthRoute;
     if (apiHealthRoute.length() == 0)
         apiHealthRoute = "/health";
 
-    Serial.println("Loaded API Config:");
-    Serial.println("Base: " + apiBaseUrl);
-    Serial.println("Msg: " + apiMessageRoute);
-    Serial.println("Health: " + apiHealthRoute);
+    uploadMode = settings.uploadMode == UPLOAD_MULTIPART ? UPLOAD_MULTIPART : UPLOAD_JSON;
+    streamResponses = settings.streamResponses == 1;
+
+    LOG_I(TAG, "API config: base %s, msg %s, health %s, upload %s, response %s",
+          apiBaseUrl.c_str(), apiMessageRoute.c_str(), apiHealthRoute.c_str(),
+          uploadMode == UPLOAD_MULTIPART ? "multipart" : "json", streamResponses ? "streamed" : "whole");
 }
 
-void AIBotManager::saveApiConfigToEEPROM(String baseUrl, String messageRoute, String healthRoute)
+void AIBotManager::saveApiConfig(String baseUrl, String messageRoute, String healthRoute, UploadMode mode, bool stream)
 {
-    Serial.println("Saving API Config to EEPROM");
-
-    // Save Base URL
-    for (int i = 0; i < EEPROM_BASE_URL_SIZE; i++)
-    {
-        EEPROM.write(EEPROM_BASE_URL_ADDR + i, (i < baseUrl.length()) ? baseUrl[i] : 0);
-    }
-
-    // Save Message Route
-    for (int i = 0; i < EEPROM_MSG_ROUTE_SIZE; i++)
-    {
-        EEPROM.write(EEPROM_MSG_ROUTE_ADDR + i, (i < messageRoute.length()) ? messageRoute[i] : 0);
-    }
+    LOG_I(TAG, "Saving API config");
 
-    // Save Health Route
-    for (int i = 0; i < EEPROM_HEALTH_ROUTE_SIZE; i++)
-    {
-        EEPROM.write(EEPROM_HEALTH_ROUTE_ADDR + i, (i < healthRoute.length()) ? healthRoute[i] : 0);
-    }
+    BotConfig settings = config->get();
+    strncpy(settings.apiBaseUrl, baseUrl.c_str(), sizeof(settings.apiBaseUrl) - 1);
+    strncpy(settings.apiMessageRoute, messageRoute.c_str(), sizeof(settings.apiMessageRoute) - 1);
+    strncpy(settings.apiHealthRoute, healthRoute.c_str(), sizeof(settings.apiHealthRoute) - 1);
+    settings.uploadMode = (uint8_t)mode;
+    settings.streamResponses = stream ? 1 : 0;
 
-    EEPROM.commit();
+    if (!config->save(settings))
+        LOG_E(TAG, "Saving API config failed");
 
     apiBaseUrl = baseUrl;
     apiMessageRoute = messageRoute;
     apiHealthRoute = healthRoute;
+    uploadMode = mode;
+    streamResponses = stream;
 }
 
-void AIBotManager::setApiConfig(String baseUrl, String messageRoute, String healthRoute)
+bool AIBotManager::setApiConfig(String baseUrl, String messageRoute, String healthRoute, UploadMode uploadMode,
+                                bool streamResponses)
 {
     baseUrl.trim();
+    if (!AsyncHttpRequest::supportsUrl(baseUrl.c_str()))
+    {
+        LOG_W(TAG, "Refusing API URL %s: not http:// or https://", baseUrl.c_str());
+        return false;
+    }
+
     // Remove trailing slash if present
     if (baseUrl.endsWith("/"))
     {
@@ -165,7 +258,13 @@ void AIBotManager::setApiConfig(String baseUrl, String messageRoute, String heal
     if (!healthRoute.startsWith("/"))
         healthRoute = "/" + healthRoute;
 
-    saveApiConfigToEEPROM(baseUrl, messageRoute, healthRoute);
+    saveApiConfig(baseUrl, messageRoute, healthRoute, uploadMode, streamResponses);
+
+    // A different backend has not seen this session's context
+    contextCached = false;
+    if (lastBotStatus == "Err: API URL")
+        lastBotStatus = "Idle";
+    return true;
 }
 
 String AIBotManager::getApiBaseUrl()
@@ -183,6 +282,16 @@ String AIBotManager::getApiHealthRoute()
     return apiHealthRoute;
 }
 
+AIBotManager::UploadMode AIBotManager::getUploadMode()
+{
+    return uploadMode;
+}
+
+bool AIBotManager::isStreamingResponses()
+{
+    return streamResponses;
+}
+
 String AIBotManager::getHealthUrl()
 {
     return apiBaseUrl + apiHealthRoute;
@@ -193,24 +302,58 @@ String AIBotManager::getMessageUrl()
     return apiBaseUrl + apiMessageRoute;
 }
 
-bool AIBotManager::testConnection()
+void AIBotManager::requestHealthCheck()
 {
-    if (apiBaseUrl.length() == 0)
-        return false;
+    // A check under way is for the URL it started with: run another after it
+    healthPending = true;
+}
 
-    if (!wifiManager->isConnected())
-        return false;
+AIBotManager::HealthCheck AIBotManager::getHealthCheck()
+{
+    return healthPending || healthInFlight ? HEALTH_CHECKING : healthResult;
+}
+
+int AIBotManager::getHealthStatusCode()
+{
+    return healthStatusCode;
+}
+
+void AIBotManager::startHealthCheck()
+{
+    healthPending = false;
+    healthInFlight = true;
+
+    if (apiBaseUrl.length() == 0 || !network->isConnected())
+    {
+        finishHealthCheck();
+        return;
+    }
 
-    HTTPClient http;
     String healthUrl = getHealthUrl();
-    Serial.println("Testing connection to: " + healthUrl);
+    LOG_I(TAG, "Testing connection to: %s", healthUrl.c_str());
 
-    http.begin(healthUrl);
-    int httpCode = http.GET();
-    http.end();
+    request.setDeadlines(HEALTH_DEADLINES);
+    request.setBodyListener(nullptr, nullptr);
+    if (!request.start("GET", healthUrl.c_str(), nullptr, nullptr, clock->millis()))
+        finishHealthCheck();
+}
 
-    Serial.printf("Health check HTTP Code: %d\n", httpCode);
-    return (httpCode == 200);
+void AIBotManager::finishHealthCheck()
+{
+    healthStatusCode = request.getState() == AsyncHttpRequest::REQ_DONE ? request.getStatusCode() : -1;
+    healthResult = healthStatusCode == 200 ? HEALTH_PASSED : HEALTH_FAILED;
+    if (request.getState() == AsyncHttpRequest::REQ_FAILED)
+    {
+        LOG_W(TAG, "Health check failed in %s stage: %s", AsyncHttpRequest::stateName(request.getFailedStage()),
+              AsyncHttpRequest::errorName(request.getError()));
+        if (request.getError() == AsyncHttpRequest::ERR_TLS)
+            LOG_W(TAG, "TLS: %s", request.getTlsError());
+    }
+    else
+        LOG_I(TAG, "Health check HTTP code: %d (%s connection)", healthStatusCode,
+              request.wasReused() ? "reused" : "new");
+    request.reset();
+    healthInFlight = false;
 }
 
 void AIBotManager::startBot()
@@ -219,19 +362,28 @@ void AIBotManager::startBot()
     {
         botRunning = true;
         lastBotStatus = "Running";
-        Serial.println("AI Bot Started");
+        frameSource->setActive(true);
+        cadence.reset(clock->millis());
+        LOG_I(TAG, "AI bot started");
     }
     else
     {
-        Serial.println("Cannot start bot: No API URL");
+        LOG_W(TAG, "Cannot start bot: no API URL");
     }
 }
 
 void AIBotManager::stopBot()
 {
     botRunning = false;
+    if (request.isBusy() && !healthInFlight)
+    {
+        request.cancel();
+        LOG_I(TAG, "Request cancelled");
+        finishBotRequest();
+    }
     lastBotStatus = "Stopped";
-    Serial.println("AI Bot Stopped");
+    frameSource->setActive(false);
+    LOG_I(TAG, "AI bot stopped");
 }
 
 bool AIBotManager::isBotRunning()
@@ -239,6 +391,11 @@ bool AIBotManager::isBotRunning()
     return botRunning;
 }
 
+bool AIBotManager::isRequestInFlight()
+{
+    return request.isBusy();
+}
+
 String AIBotManager::getLastBotStatus()
 {
     return lastBotStatus;
@@ -246,132 +403,446 @@ String AIBotManager::getLastBotStatus()
 
 void AIBotManager::loop()
 {
+    if (healthInFlight)
+    {
+        request.poll(clock->millis());
+        if (!request.isBusy())
+            finishHealthCheck();
+        return;
+    }
+
+    if (request.isBusy())
+    {
+        pollBotRequest();
+        return;
+    }
+
+    if (healthPending)
+    {
+        startHealthCheck();
+        return;
+    }
+
     if (!botRunning)
         return;
 
-    unsigned long currentMillis = millis();
-    if (currentMillis - lastRequestTime >= 15000)
-    { // 15 seconds
-        lastRequestTime = currentMillis;
+    if (cadence.isDue(clock->millis()))
         sendBotRequest();
+}
+
+// JSON body: {"text":...,"context":...,"context_hash":...,"image":"<base64>"}
+// "context" is only included until the backend has cached it. The image
+// value is left open in prefix and closed by suffix.
+void AIBotManager::buildJsonEnvelope(String &prefix, String &suffix, bool includeContext)
+{
+    prefix.reserve(includeContext ? ROBOT_CONTEXT_JSON.length + 256 : 256);
+
+    prefix = "{";
+    prefix += "\"text\":\"Describe the scene and suggest a direction.\",";
+    prefix += streamResponses ? "\"stream\":true," : "\"stream\":false,";
+    if (includeContext)
+    {
+        prefix += "\"context\":\"";
+        prefix += ROBOT_CONTEXT_JSON.c_str();
+        prefix += "\",";
     }
+    prefix += "\"context_hash\":\"";
+    prefix += ROBOT_CONTEXT_HASH.c_str();
+    prefix += "\",";
+    prefix += "\"session_id\":\"" + sessionId + "\",";
+    prefix += "\"audioResponse\":true,";
+    prefix += "\"image\":\"";
+
+    suffix = "\"}";
+}
+
+static void appendFormField(String &out, const String &boundary, const char *name, const String &value)
+{
+    out += "--" + boundary + "\r\n";
+    out += "Content-Disposition: form-data; name=\"";
+    out += name;
+    out += "\"\r\n\r\n";
+    out += value;
+    out += "\r\n";
+}
+
+// multipart/form-data body: the same fields as the JSON body, with the raw
+// JPEG as the "image" file part. No escaping or base64 needed.
+void AIBotManager::buildMultipartEnvelope(String &prefix, String &suffix, const String &boundary, bool includeContext)
+{
+    prefix.reserve(includeContext ? sizeof(ROBOT_CONTEXT) + 1024 : 1024);
+
+    appendFormField(prefix, boundary, "text", "Describe the scene and suggest a direction.");
+    appendFormField(prefix, boundary, "stream", streamResponses ? "true" : "false");
+    if (includeContext)
+        appendFormField(prefix, boundary, "context", ROBOT_CONTEXT);
+    appendFormField(prefix, boundary, "context_hash", ROBOT_CONTEXT_HASH.c_str());
+    appendFormField(prefix, boundary, "session_id", sessionId);
+    appendFormField(prefix, boundary, "audioResponse", "true");
+
+    prefix += "--" + boundary + "\r\n";
+    prefix += "Content-Disposition: form-data; name=\"image\"; filename=\"frame.jpg\"\r\n";
+    prefix += "Content-Type: image/jpeg\r\n\r\n";
+
+    suffix = "\r\n--" + boundary + "--\r\n";
+}
+
+void AIBotManager::setStatus(const String &status)
+{
+    lastBotStatus = status;
+    if (statusCallback)
+        statusCallback(lastBotStatus);
 }
 
 void AIBotManager::sendBotRequest()
 {
-    if (!wifiManager->isConnected())
+    if (!network->isConnected())
     {
-        Serial.println("Bot: WiFi not connected");
+        LOG_EVERY_MS(10000, LOG_W(TAG, "WiFi not connected"));
         lastBotStatus = "WiFi Error";
+        Metrics::countStatus(lastBotStatus.c_str());
+        cadence.onError(clock->millis(), 0);
         return;
     }
 
-    if (!camManager->isCameraAvailable())
+    if (!frameSource->isAvailable())
     {
-        Serial.println("Bot: Camera not available");
+        LOG_EVERY_MS(10000, LOG_W(TAG, "Camera not available"));
         lastBotStatus = "Cam Error";
+        Metrics::countStatus(lastBotStatus.c_str());
+        cadence.onError(clock->millis(), 0);
         return;
     }
 
-    Serial.println("Bot: Capturing image...");
-    if (!camManager->capturePhoto())
+    CapturedFrame frame;
+    if (!frameSource->acquire(frame))
     {
-        Serial.println("Bot: Capture failed");
+        LOG_E(TAG, "Capture failed");
         lastBotStatus = "Capture Fail";
+        Metrics::countStatus(lastBotStatus.c_str());
+        cadence.onError(clock->millis(), 0);
         return;
     }
 
-    String imageBase64 = camManager->getLastImageBase64();
-    if (imageBase64.length() == 0)
+    if (frame.len == 0)
     {
-        Serial.println("Bot: Empty image");
+        LOG_E(TAG, "Empty image");
         lastBotStatus = "Image Error";
+        Metrics::countStatus(lastBotStatus.c_str());
+        frameSource->release(frame);
+        cadence.onError(clock->millis(), 0);
         return;
     }
 
-    Serial.println("Bot: Sending request...");
-    lastBotStatus = "Sending Request";
-    if (statusCallback)
-        statusCallback(lastBotStatus);
+    // Nothing changed in view since the last decision: keep acting on it
+    if (frame.hasSignature && !sceneGate.shouldSend(frame.signature, clock->millis()))
+    {
+        LOG_D(TAG, "Scene unchanged (%d bits), reusing '%s'",
+              sceneGate.getLastDistance(), lastDirection.c_str());
+        frameSource->release(frame);
+        lastBotStatus = "Scene Same";
+        Metrics::countStatus(lastBotStatus.c_str());
+        if (statusCallback)
+            statusCallback(lastBotStatus);
+        cadence.onSkipped(clock->millis());
+        return;
+    }
+
+    setStatus("Sending Request");
+
+    // Everything before and after the image is small; the image itself is
+    // read from the frame buffer while the body is being sent.
+    RequestBody::FrameEncoding encoding;
+    String contentType;
+    uint32_t buildStart = clock->micros();
+    requestPrefix = String();
+    requestSuffix = String();
+
+    if (uploadMode == UPLOAD_MULTIPART)
+    {
+        String boundary = "----esp32bot" + String(esp_random(), HEX) + String(esp_random(), HEX);
+        contentType = "multipart/form-data; boundary=" + boundary;
+        buildMultipartEnvelope(requestPrefix, requestSuffix, boundary, !contextCached);
+        encoding = RequestBody::FRAME_RAW;
+    }
+    else
+    {
+        contentType = "application/json";
+        buildJsonEnvelope(requestPrefix, requestSuffix, !contextCached);
+        encoding = RequestBody::FRAME_BASE64;
+    }
+    Metrics::record(Metrics::STAGE_BUILD, clock->micros() - buildStart);
+
+    requestHasContext = !contextCached;
+    requestBody = RequestBody(requestPrefix.c_str(), requestPrefix.length(),
+                              frame.data, frame.len, encoding,
+                              requestSuffix.c_str(), requestSuffix.length());
+
+    LOG_D(TAG, "Sending %s payload (%u bytes, frame %u bytes)",
+          uploadMode == UPLOAD_MULTIPART ? "multipart" : "JSON",
+          (unsigned)requestBody.size(), (unsigned)frame.len);
+
+    lastFrameAgeMs = clock->millis() - frame.timestampMs;
+    LOG_D(TAG, "Frame age at send: %u ms", (unsigned)lastFrameAgeMs);
+
+    // The frame stays held until the request has finished sending it
+    inflightFrame = frame;
+    frameHeld = true;
+
+    // A streamed answer is scanned as it arrives instead of being buffered
+    decisionScanner.reset();
+    sseDecoder.reset();
+    streamedText = String();
+    streamActed = false;
+    if (streamResponses)
+        request.setBodyListener(onResponseBody, this);
+    else
+        request.setBodyListener(nullptr, nullptr);
+
+    requestStage = AsyncHttpRequest::REQ_CONNECTING;
+    request.setDeadlines(BOT_DEADLINES);
+    if (!request.start("POST", getMessageUrl().c_str(), contentType.c_str(), &requestBody, clock->millis()))
+    {
+        finishBotRequest();
+    }
+}
 
-    HTTPClient http;
-    http.begin(getMessageUrl());
-    http.addHeader("Content-Type", "application/json");
-    http.setTimeout(60000); // 60s timeout to wait for AI response
+// Advance the request in flight without blocking the loop
+void AIBotManager::pollBotRequest()
+{
+    AsyncHttpRequest::State state = request.poll(clock->millis());
+    if (!streamActed && decisionScanner.hasDecision())
+        actOnStreamedDecision();
+
+    // Body handed to the socket and no resend left: the frame is no longer
+    // needed
+    if (frameHeld && !request.needsBody())
+        releaseInflightFrame();
 
-    // Construct JSON payload manually to avoid memory issues with large Base64 strings in JsonDocument
-    String payload;
-    payload.reserve(imageBase64.length() + 2048);
+    if (state == requestStage)
+        return;
+    requestStage = state;
 
-    payload = "{";
-    payload += "\"text\":\"Describe the scene and suggest a direction.\",";
-    payload += "\"stream\":false,";
-    payload += "\"context\":\"";
+    if (state == AsyncHttpRequest::REQ_AWAIT_HEADERS)
+        setStatus("Waiting AI");
+    else if (!request.isBusy())
+        finishBotRequest();
+}
 
-    String escapedContext = String(ROBOT_CONTEXT);
-    escapedContext.replace("\\", "\\\\"); // Escape backslashes first
-    escapedContext.replace("\"", "\\\""); // Escape quotes
-    escapedContext.replace("\n", "\\n");  // Escape newlines
-    escapedContext.replace("\r", "");     // Remove carriage returns
+// Body listener: unwraps SSE events when the backend sends them, otherwise
+// the body is the model's text itself
+void AIBotManager::onResponseBody(void *context, const char *data, size_t len)
+{
+    AIBotManager *self = static_cast<AIBotManager *>(context);
+    if (strncmp(self->request.getResponseType(), "text/event-stream", 17) == 0)
+        self->sseDecoder.feed(data, len, onModelText, self);
+    else
+        onModelText(self, data, len);
+}
 
-    payload += escapedContext;
-    payload += "\",";
-    payload += "\"session_id\":\"" + sessionId + "\",";
-    payload += "\"audioResponse\":true,";
-    payload += "\"image\":\"" + imageBase64 + "\"";
-    payload += "}";
+void AIBotManager::onModelText(void *context, const char *text, size_t len)
+{
+    AIBotManager *self = static_cast<AIBotManager *>(context);
+    self->decisionScanner.feed(text, len);
+    // Kept for the log and as a fallback if the scanner found nothing
+    if (self->streamedText.length() < AsyncHttpRequest::RESPONSE_CAPACITY)
+        self->streamedText.concat(text, len);
+}
 
-    Serial.println("Bot: Sending JSON payload:");
-    Serial.println(payload);
+// Direction and distance are in: move now, the rest only adds description
+void AIBotManager::actOnStreamedDecision()
+{
+    streamActed = true;
+    decisionActedMs = clock->millis();
+    lastDirection = decisionScanner.getDirection();
+    lastDistance = decisionScanner.getDistance();
+    if (decisionScanner.hasGoalFound())
+        goalFound = decisionScanner.getGoalFound();
+    lastTiming.directionMs = request.getElapsedMs(decisionActedMs);
+
+    LOG_I(TAG, "Direction '%s' %.2f m after %u ms",
+          lastDirection.c_str(), lastDistance, (unsigned)lastTiming.directionMs);
+    if (decisionCallback)
+        decisionCallback(lastDirection, lastDistance, goalFound);
+    setStatus("Direction Recv");
+}
 
-    int httpResponseCode = http.POST(payload);
+void AIBotManager::releaseInflightFrame()
+{
+    if (!frameHeld)
+        return;
+    frameSource->release(inflightFrame);
+    frameHeld = false;
+}
 
-    if (httpResponseCode > 0)
+void AIBotManager::finishBotRequest()
+{
+    releaseInflightFrame();
+    requestPrefix = String();
+    requestSuffix = String();
+    requestBody = RequestBody();
+
+    bool cancelled = request.getError() == AsyncHttpRequest::ERR_CANCELLED;
+    bool decided = false;
+    bool contextRetry = false;
+    uint32_t elapsed = request.getElapsedMs(clock->millis());
+    if (request.getState() == AsyncHttpRequest::REQ_DONE)
     {
-        String response = http.getString();
-        Serial.printf("Bot: HTTP Response code: %d\n", httpResponseCode);
-        Serial.println("Bot: Response: " + response);
-
-        // Clean up response if it contains markdown code blocks
-        String jsonStr = response;
-        jsonStr.trim();
-        if (jsonStr.startsWith("```json"))
+        lastTiming.connectMs = request.getStageTime(AsyncHttpRequest::REQ_CONNECTING);
+        lastTiming.uploadMs = request.getStageTime(AsyncHttpRequest::REQ_SENDING);
+        lastTiming.waitMs = request.getStageTime(AsyncHttpRequest::REQ_AWAIT_HEADERS);
+        lastTiming.downloadMs = request.getStageTime(AsyncHttpRequest::REQ_READING_BODY);
+        lastTiming.reused = request.wasReused();
+        lastTiming.connectionsOpened = request.getConnectionsOpened();
+        Metrics::record(Metrics::STAGE_ENCODE, request.getBodyReadUs());
+        Metrics::record(Metrics::STAGE_UPLOAD, lastTiming.uploadMs * 1000);
+        Metrics::record(Metrics::STAGE_TTFB, lastTiming.waitMs * 1000);
+        Metrics::record(Metrics::STAGE_BODY, lastTiming.downloadMs * 1000);
+
+        LOG_I(TAG, "HTTP %d in %u ms (connect %u%s, upload %u, wait %u, download %u)",
+              request.getStatusCode(), (unsigned)elapsed, (unsigned)lastTiming.connectMs,
+              lastTiming.reused ? " reused" : "", (unsigned)lastTiming.uploadMs,
+              (unsigned)lastTiming.waitMs, (unsigned)lastTiming.downloadMs);
+        if (request.getStatusCode() == 200 && streamResponses)
         {
-            jsonStr = jsonStr.substring(7);
+            if (streamActed)
+            {
+                LOG_D(TAG, "Response: %s", streamedText.c_str());
+                decided = completeStreamedDecision();
+            }
+            else
+            {
+                // Backend ignored "stream" or the keys came in another order
+                decided = handleBotResponse(streamedText.c_str(), streamedText.length());
+            }
+            if (requestHasContext)
+                contextCached = true;
         }
-        else if (jsonStr.startsWith("```"))
+        else if (request.getStatusCode() == 200)
         {
-            jsonStr = jsonStr.substring(3);
+            decided = handleBotResponse(request.getResponse(), request.getResponseLength());
+            // The backend keeps the context once it has answered a request carrying it
+            if (requestHasContext)
+                contextCached = true;
         }
-        if (jsonStr.endsWith("```"))
-        {
-            jsonStr = jsonStr.substring(0, jsonStr.length() - 3);
-        }
-        jsonStr.trim();
-
-        DynamicJsonDocument doc(2048);
-        DeserializationError error = deserializeJson(doc, jsonStr);
-
-        if (!error)
+        else if (request.getStatusCode() == 409 && strstr(request.getResponse(), "unknown_context_hash"))
         {
-            lastBotStatus = "Response Recv";
-            lastDirection = doc["direction"] | "Unknown";
-            lastDistance = doc["distance_m"] | 0.0;
-            goalFound = doc["goal_found"] | false;
+            // Backend lost the cached context (restart, eviction): resend in full
+            LOG_W(TAG, "Backend does not know the context hash, resending context");
+            contextCached = false;
+            contextResends++;
+            contextRetry = true;
+            lastBotStatus = "Context Resend";
+            sceneGate.invalidate();
         }
         else
         {
-            lastBotStatus = "JSON Error";
-            Serial.println("JSON Parsing failed");
+            lastBotStatus = "Err: HTTP " + String(request.getStatusCode());
+            sceneGate.invalidate();
         }
     }
+    else if (streamActed && !cancelled)
+    {
+        // Direction and distance came in and were acted on before the stream
+        // broke off or ran out of time: only the description is missing
+        LOG_W(TAG, "Stream ended in %s stage after the decision: %s (%u ms)",
+              AsyncHttpRequest::stateName(request.getFailedStage()),
+              AsyncHttpRequest::errorName(request.getError()), (unsigned)elapsed);
+        decided = completeStreamedDecision();
+        if (requestHasContext)
+            contextCached = true;
+    }
     else
     {
-        Serial.printf("Bot: Error code: %d\n", httpResponseCode);
-        lastBotStatus = "Err: " + String(httpResponseCode);
+        LOG_W(TAG, "Request failed in %s stage: %s (%u ms)",
+              AsyncHttpRequest::stateName(request.getFailedStage()),
+              AsyncHttpRequest::errorName(request.getError()), (unsigned)elapsed);
+        if (request.getError() == AsyncHttpRequest::ERR_TLS)
+            LOG_W(TAG, "TLS: %s", request.getTlsError());
+        lastBotStatus = "Err: " + String(AsyncHttpRequest::errorName(request.getError()));
+        sceneGate.invalidate();
     }
 
+    request.reset();
+    requestStage = AsyncHttpRequest::REQ_IDLE;
+    streamedText = String();
+    Metrics::countStatus(lastBotStatus.c_str());
     if (statusCallback)
         statusCallback(lastBotStatus);
-    http.end();
+
+    // The callback acts on the decision, so time the next cycle from here
+    uint32_t now = clock->millis();
+    if (decided)
+    {
+        lastTiming.totalMs = elapsed;
+        if (!streamActed)
+        {
+            decisionActedMs = now;
+            lastTiming.directionMs = elapsed;
+        }
+        // Compared in place: a lowered copy would be a heap allocation per decision
+        const char *direction = lastDirection.c_str();
+        bool moving = strcasecmp(direction, "forward") == 0 || strcasecmp(direction, "left") == 0 ||
+                      strcasecmp(direction, "right") == 0 || strcasecmp(direction, "backward") == 0;
+        cadence.onDecision(now, elapsed, decisionActedMs - inflightFrame.timestampMs, moving, goalFound);
+        LOG_D(TAG, "Next request in %u ms (%u/min)",
+              (unsigned)cadence.getLastInterval(), (unsigned)cadence.getDecisionsPerMinute(now));
+    }
+    else if (contextRetry)
+    {
+        cadence.onSkipped(now); // Retry soon, now with the full context
+    }
+    else if (!cancelled)
+    {
+        cadence.onError(now, elapsed);
+    }
+}
+
+// The streamed decision already acted on stands for this request
+bool AIBotManager::completeStreamedDecision()
+{
+    // goal_found may only have arrived after the decision
+    if (decisionScanner.hasGoalFound())
+        goalFound = decisionScanner.getGoalFound();
+    lastBotStatus = "Response Recv";
+    if (inflightFrame.hasSignature)
+        sceneGate.recordDecision(inflightFrame.signature, clock->millis());
+    return true;
+}
+
+// Parses the answer where it lies (response buffer or streamed text):
+// no copies, and only the three fields read are kept, in a stack document
+bool AIBotManager::handleBotResponse(const char *response, size_t len)
+{
+    LOG_D(TAG, "Response: %.*s", (int)len, response);
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(3)> filter;
+    filter["direction"] = true;
+    filter["distance_m"] = true;
+    filter["goal_found"] = true;
+
+    // Three members plus their copied keys (32 bytes) and the direction string
+    StaticJsonDocument<JSON_OBJECT_SIZE(3) + 96> doc;
+    FencedJsonReader reader(response, len);
+    uint32_t parseStart = clock->micros();
+    DeserializationError error = deserializeJson(doc, reader, DeserializationOption::Filter(filter));
+    Metrics::record(Metrics::STAGE_PARSE, clock->micros() - parseStart);
+
+    if (!error)
+    {
+        lastBotStatus = "Response Recv";
+        lastDirection = doc["direction"] | "Unknown";
+        lastDistance = doc["distance_m"] | 0.0;
+        goalFound = doc["goal_found"] | false;
+        if (inflightFrame.hasSignature)
+            sceneGate.recordDecision(inflightFrame.signature, clock->millis());
+        if (decisionCallback)
+            decisionCallback(lastDirection, lastDistance, goalFound);
+        return true;
+    }
+
+    lastBotStatus = "JSON Error";
+    LOG_W(TAG, "JSON parsing failed: %s", error.c_str());
+    sceneGate.invalidate();
+    return false;
 }
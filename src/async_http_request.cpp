@@ -0,0 +1,927 @@
+#include "async_http_request.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#ifdef ARDUINO
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+static const AsyncHttpRequest::Deadlines DEFAULT_DEADLINES = {
+    5000,  // connect
+    15000, // send
+    45000, // headers
+    10000  // body
+};
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Receive at most this much per poll() so one call stays short
+static const size_t RECV_SLICE = 2048;
+
+AsyncHttpRequest::AsyncHttpRequest()
+    : sock(-1), state(REQ_IDLE), failedStage(REQ_IDLE), error(ERR_NONE), deadlines(DEFAULT_DEADLINES),
+      startedMs(0), stageStartedMs(0), stageDeadline(0), reused(false), keepAlive(false), connectionsOpened(0), dnsLookups(0),
+      connectedPort(0), connectedSecure(false), dnsAddr(0), dnsResolvedMs(0), port(80), secure(false), body(nullptr),
+      retryBody(nullptr), retried(false), headLen(0), headSent(0), chunkLen(0), chunkSent(0),
+      response(nullptr), responseLen(0), bodyStart(0), bodyEnd(0), bodyReceived(0), contentLength(-1),
+      chunked(false), chunkState(CHUNK_SIZE), chunkRemaining(0), trailerLineEmpty(true), statusCode(0),
+      bodyListener(nullptr), bodyListenerContext(nullptr)
+{
+    host[0] = '\0';
+    path[0] = '\0';
+    contentType[0] = '\0';
+    connectedHost[0] = '\0';
+    dnsHost[0] = '\0';
+    responseType[0] = '\0';
+    memset(stageTime, 0, sizeof(stageTime));
+    bodyReadUs = 0;
+}
+
+AsyncHttpRequest::~AsyncHttpRequest()
+{
+    closeSocket();
+    free(response);
+}
+
+void AsyncHttpRequest::setDeadlines(const Deadlines &d)
+{
+    deadlines = d;
+}
+
+bool AsyncHttpRequest::supportsUrl(const char *url)
+{
+    return strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0;
+}
+
+bool AsyncHttpRequest::parseUrl(const char *url)
+{
+    if (!supportsUrl(url))
+        return false;
+    secure = url[4] == 's';
+    const char *p = url + (secure ? 8 : 7);
+
+    const char *hostEnd = p;
+    while (*hostEnd && *hostEnd != ':' && *hostEnd != '/')
+        hostEnd++;
+    size_t hostLen = hostEnd - p;
+    if (hostLen == 0 || hostLen >= sizeof(host))
+        return false;
+    memcpy(host, p, hostLen);
+    host[hostLen] = '\0';
+
+    port = secure ? 443 : 80;
+    p = hostEnd;
+    if (*p == ':')
+    {
+        char *portEnd;
+        long value = strtol(p + 1, &portEnd, 10);
+        if (value <= 0 || value > 65535)
+            return false;
+        port = (uint16_t)value;
+        p = portEnd;
+    }
+
+    const char *target = *p ? p : "/";
+    if (strlen(target) >= sizeof(path))
+        return false;
+    strcpy(path, target);
+    return true;
+}
+
+// True if the kept-alive socket goes to the requested host and the server
+// has not closed it while it sat idle. A TLS peer closes with a close_notify
+// record, which shows up here as unexpected data.
+bool AsyncHttpRequest::connectionUsable()
+{
+    if (sock < 0)
+        return false;
+
+    if (port == connectedPort && secure == connectedSecure && strcmp(host, connectedHost) == 0)
+    {
+        char c;
+        ssize_t n = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        // 0: closed by the server; > 0: unexpected data; < 0: reset
+    }
+
+    closeSocket();
+    return false;
+}
+
+bool AsyncHttpRequest::resolveHost(uint32_t nowMs, uint32_t &addr)
+{
+    struct in_addr literal;
+    if (inet_pton(AF_INET, host, &literal) == 1)
+    {
+        addr = literal.s_addr;
+        return true;
+    }
+
+    if (dnsHost[0] && strcmp(dnsHost, host) == 0 && nowMs - dnsResolvedMs < DNS_CACHE_MS)
+    {
+        addr = dnsAddr;
+        return true;
+    }
+
+    // Blocks the caller's loop for the lookup (lwip has no asynchronous
+    // getaddrinfo), but only once per DNS_CACHE_MS; IP literals never wait
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &res) != 0 || !res)
+        return false;
+    addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(res);
+    dnsLookups++;
+
+    strcpy(dnsHost, host);
+    dnsAddr = addr;
+    dnsResolvedMs = nowMs;
+    return true;
+}
+
+bool AsyncHttpRequest::openSocket(uint32_t nowMs)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    uint32_t ip;
+    if (!resolveHost(nowMs, ip))
+    {
+        fail(ERR_DNS);
+        return false;
+    }
+    addr.sin_addr.s_addr = ip;
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+    {
+        fail(ERR_CONNECT);
+        return false;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    int noDelay = 1; // The request head and the body tail go out without waiting for ACKs
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    connectionsOpened++;
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS)
+    {
+        fail(ERR_CONNECT);
+        return false;
+    }
+
+    strcpy(connectedHost, host);
+    connectedPort = port;
+    connectedSecure = secure;
+    return true;
+}
+
+bool AsyncHttpRequest::start(const char *method, const char *url, const char *type, RequestBody *requestBody,
+                             uint32_t nowMs)
+{
+    reset();
+    startedMs = nowMs;
+    body = requestBody;
+    retryBody = nullptr;
+    retried = false;
+    chunkLen = 0;
+    chunkSent = 0;
+    responseLen = 0;
+    bodyStart = 0;
+    contentLength = -1;
+    chunked = false;
+    bodyEnd = 0;
+    bodyReceived = 0;
+    responseType[0] = '\0';
+    keepAlive = false;
+    statusCode = 0;
+    memset(stageTime, 0, sizeof(stageTime));
+    bodyReadUs = 0;
+
+    if (!response)
+    {
+        response = (char *)malloc(RESPONSE_CAPACITY + 1);
+        if (!response)
+        {
+            state = REQ_CONNECTING;
+            fail(ERR_TOO_LARGE);
+            return false;
+        }
+    }
+    response[0] = '\0';
+
+    state = REQ_CONNECTING;
+    if (!parseUrl(url) || (type && strlen(type) >= sizeof(contentType)))
+    {
+        fail(ERR_URL);
+        return false;
+    }
+    strcpy(contentType, type ? type : "");
+
+    int n = snprintf(head, sizeof(head),
+                     "%s %s HTTP/1.1\r\n"
+                     "Host: %s:%u\r\n"
+                     "Connection: keep-alive\r\n",
+                     method, path, host, (unsigned)port);
+    if (body && n > 0 && (size_t)n < sizeof(head))
+    {
+        n += snprintf(head + n, sizeof(head) - n,
+                      "Content-Type: %s\r\n"
+                      "Content-Length: %u\r\n",
+                      contentType, (unsigned)body->size());
+    }
+    if (n > 0 && (size_t)n < sizeof(head))
+        n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    if (n <= 0 || (size_t)n >= sizeof(head))
+    {
+        fail(ERR_URL);
+        return false;
+    }
+    headLen = n;
+    headSent = 0;
+
+    stageStartedMs = nowMs;
+    reused = connectionUsable();
+    if (reused)
+    {
+        retryBody = body;
+        enterStage(REQ_SENDING, nowMs);
+        return true;
+    }
+
+    enterStage(REQ_CONNECTING, nowMs);
+    return openSocket(nowMs);
+}
+
+void AsyncHttpRequest::enterStage(State next, uint32_t nowMs)
+{
+    if (state < REQ_DONE)
+        stageTime[state] += nowMs - stageStartedMs;
+    stageStartedMs = nowMs;
+    state = next;
+    uint32_t budget = 0;
+    switch (next)
+    {
+    case REQ_CONNECTING:
+        budget = deadlines.connectMs;
+        break;
+    case REQ_SENDING:
+        budget = deadlines.sendMs;
+        break;
+    case REQ_AWAIT_HEADERS:
+        budget = deadlines.headersMs;
+        break;
+    case REQ_READING_BODY:
+        budget = deadlines.bodyMs;
+        break;
+    default:
+        break;
+    }
+    stageDeadline = nowMs + budget;
+}
+
+void AsyncHttpRequest::fail(Error err)
+{
+    // Refused or never answered, now or once the handshake ran out: the
+    // cached address may be stale, so look the name up again next time
+    if (state == REQ_CONNECTING && (err == ERR_CONNECT || err == ERR_TIMEOUT))
+        dnsHost[0] = '\0';
+
+    failedStage = state;
+    error = err;
+    state = REQ_FAILED;
+    body = nullptr;
+    retryBody = nullptr;
+    closeSocket();
+}
+
+// The server may close an idle connection just after connectionUsable()
+// looked at it. If the request then fails before a byte of the response
+// came back, the server cannot have acted on it: send it again, once, on a
+// new connection. False if that does not apply.
+bool AsyncHttpRequest::retryOnNewConnection(uint32_t nowMs)
+{
+    if (!reused || retried || responseLen > 0)
+        return false;
+
+    closeSocket();
+    retried = true;
+    reused = false;
+    headSent = 0;
+    chunkLen = 0;
+    chunkSent = 0;
+    body = retryBody;
+    retryBody = nullptr;
+    if (body)
+        body->rewind();
+
+    enterStage(REQ_CONNECTING, nowMs);
+    openSocket(nowMs); // Fails the request itself if it cannot
+    return true;
+}
+
+void AsyncHttpRequest::closeSocket()
+{
+    tls.end();
+    if (sock >= 0)
+    {
+        close(sock);
+        sock = -1;
+    }
+}
+
+void AsyncHttpRequest::cancel()
+{
+    if (isBusy())
+        fail(ERR_CANCELLED);
+}
+
+void AsyncHttpRequest::reset()
+{
+    // A request cut off mid-way leaves the socket unusable. Failed and
+    // non-keep-alive exchanges have closed it already.
+    if (isBusy())
+        closeSocket();
+    state = REQ_IDLE;
+    failedStage = REQ_IDLE;
+    error = ERR_NONE;
+    body = nullptr;
+    retryBody = nullptr;
+}
+
+void AsyncHttpRequest::disconnect()
+{
+    if (!isBusy())
+        closeSocket();
+}
+
+AsyncHttpRequest::State AsyncHttpRequest::poll(uint32_t nowMs)
+{
+    if (!isBusy())
+        return state;
+
+    if ((int32_t)(nowMs - stageDeadline) >= 0)
+    {
+        fail(ERR_TIMEOUT);
+        return state;
+    }
+
+    switch (state)
+    {
+    case REQ_CONNECTING:
+        pollConnect(nowMs);
+        break;
+    case REQ_SENDING:
+        pollSend(nowMs);
+        break;
+    case REQ_AWAIT_HEADERS:
+    case REQ_READING_BODY:
+        pollReceive(nowMs);
+        break;
+    default:
+        break;
+    }
+    return state;
+}
+
+void AsyncHttpRequest::pollConnect(uint32_t nowMs)
+{
+    if (!tls.isOpen())
+    {
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(sock, &writeSet);
+        struct timeval tv = {0, 0};
+        if (select(sock + 1, nullptr, &writeSet, nullptr, &tv) <= 0)
+            return; // Still connecting
+
+        int soError = 0;
+        socklen_t len = sizeof(soError);
+        if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &soError, &len) != 0 || soError != 0)
+        {
+            fail(ERR_CONNECT);
+            return;
+        }
+
+        if (secure && !tls.begin(sock, host))
+        {
+            fail(ERR_TLS);
+            return;
+        }
+    }
+
+    // The TLS handshake runs under the connect deadline, a step per poll()
+    if (secure)
+    {
+        TlsSession::Result result = tls.handshake();
+        if (result == TlsSession::TLS_WANT)
+            return;
+        if (result != TlsSession::TLS_OK)
+        {
+            fail(ERR_TLS);
+            return;
+        }
+    }
+
+    enterStage(REQ_SENDING, nowMs);
+    pollSend(nowMs);
+}
+
+// send() and recv() as the plain socket calls behave, TLS or not: -1 with
+// errno EAGAIN when nothing could move, 0 from recvSome() once the peer closed
+ssize_t AsyncHttpRequest::sendSome(const void *data, size_t len)
+{
+    if (!tls.isOpen())
+        return send(sock, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    size_t written;
+    switch (tls.write((const uint8_t *)data, len, written))
+    {
+    case TlsSession::TLS_OK:
+        return written;
+    case TlsSession::TLS_WANT:
+        errno = EAGAIN;
+        return -1;
+    default:
+        errno = EPIPE;
+        return -1;
+    }
+}
+
+ssize_t AsyncHttpRequest::recvSome(void *buf, size_t len)
+{
+    if (!tls.isOpen())
+        return recv(sock, buf, len, MSG_DONTWAIT);
+
+    size_t received;
+    switch (tls.read((uint8_t *)buf, len, received))
+    {
+    case TlsSession::TLS_OK:
+        return received;
+    case TlsSession::TLS_WANT:
+        errno = EAGAIN;
+        return -1;
+    case TlsSession::TLS_CLOSED:
+        return 0;
+    default:
+        errno = EIO;
+        return -1;
+    }
+}
+
+static uint32_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+void AsyncHttpRequest::pollSend(uint32_t nowMs)
+{
+    // Request head first, then the body one chunk at a time. Stop as soon
+    // as the socket buffer is full.
+    while (headSent < headLen)
+    {
+        ssize_t n = sendSome(head + headSent, headLen - headSent);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !retryOnNewConnection(nowMs))
+                fail(ERR_SEND);
+            return;
+        }
+        headSent += n;
+    }
+
+    while (body)
+    {
+        if (chunkSent == chunkLen)
+        {
+            uint32_t readStart = monotonicUs();
+            chunkLen = body->read(chunk, sizeof(chunk));
+            bodyReadUs += monotonicUs() - readStart;
+            chunkSent = 0;
+            if (chunkLen == 0)
+                break;
+        }
+
+        ssize_t n = sendSome(chunk + chunkSent, chunkLen - chunkSent);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !retryOnNewConnection(nowMs))
+                fail(ERR_SEND);
+            return;
+        }
+        chunkSent += n;
+    }
+
+    // Whole body handed to the socket; unless it may have to go out again,
+    // the caller may release it now
+    body = nullptr;
+    enterStage(REQ_AWAIT_HEADERS, nowMs);
+}
+
+void AsyncHttpRequest::pollReceive(uint32_t nowMs)
+{
+    size_t space = RESPONSE_CAPACITY - responseLen;
+    if (space == 0)
+    {
+        fail(ERR_TOO_LARGE);
+        return;
+    }
+
+    ssize_t n = recvSome(response + responseLen, space < RECV_SLICE ? space : RECV_SLICE);
+    if (n < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && !retryOnNewConnection(nowMs))
+            fail(ERR_RECV);
+        return;
+    }
+    if (n == 0 && retryOnNewConnection(nowMs))
+        return; // Closed without answering
+
+    bool closed = (n == 0);
+    retryBody = nullptr; // The server has answered: no resend from here on
+    size_t raw = responseLen; // Start of the bytes not looked at yet
+    responseLen += n;
+    response[responseLen] = '\0';
+
+    if (state == REQ_AWAIT_HEADERS)
+    {
+        char *end = strstr(response, "\r\n\r\n");
+        if (!end)
+        {
+            if (closed)
+                fail(ERR_PROTOCOL);
+            return;
+        }
+        bodyStart = end + 4 - response;
+        bodyEnd = bodyStart;
+        raw = bodyStart;
+        if (!parseHeaders())
+        {
+            fail(ERR_PROTOCOL);
+            return;
+        }
+        enterStage(REQ_READING_BODY, nowMs);
+    }
+
+    consumeBody(raw);
+
+    bool complete;
+    if (chunked)
+        complete = chunkState == CHUNK_DONE;
+    else if (contentLength >= 0)
+        complete = bodyReceived >= (size_t)contentLength;
+    else
+        complete = closed; // Body ends when the server closes
+
+    if (complete)
+        finish(nowMs);
+    else if (closed)
+        fail(ERR_RECV); // Closed before the whole body arrived
+}
+
+// Turns the raw bytes from response[raw] on into body bytes, in place (the
+// decoded form is never longer), then hands them to the listener or keeps
+// them in the buffer
+void AsyncHttpRequest::consumeBody(size_t raw)
+{
+    size_t rawLen = responseLen - raw;
+    size_t produced;
+    if (chunked)
+    {
+        produced = decodeChunked(response + raw, rawLen, response + bodyEnd);
+    }
+    else
+    {
+        produced = rawLen;
+        if (contentLength >= 0 && bodyReceived + produced > (size_t)contentLength)
+            produced = contentLength - bodyReceived;
+        memmove(response + bodyEnd, response + raw, produced);
+    }
+    bodyReceived += produced;
+
+    if (bodyListener && statusCode >= 200 && statusCode < 300)
+    {
+        if (produced > 0)
+            bodyListener(bodyListenerContext, response + bodyEnd, produced);
+    }
+    else
+    {
+        bodyEnd += produced;
+    }
+
+    responseLen = bodyEnd;
+    response[responseLen] = '\0';
+}
+
+static int hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Incremental Transfer-Encoding: chunked decoder. Copies chunk data from in
+// to out (out <= in) and returns its length.
+size_t AsyncHttpRequest::decodeChunked(const char *in, size_t len, char *out)
+{
+    size_t produced = 0;
+    size_t i = 0;
+    while (i < len && chunkState != CHUNK_DONE)
+    {
+        char c = in[i];
+        switch (chunkState)
+        {
+        case CHUNK_SIZE:
+        {
+            int v = hexDigitValue(c);
+            if (v >= 0)
+                chunkRemaining = chunkRemaining * 16 + v;
+            else if (c == '\n')
+                chunkState = chunkRemaining ? CHUNK_DATA : CHUNK_TRAILER;
+            else
+                chunkState = CHUNK_SIZE_LINE; // Extension or CR
+            i++;
+            break;
+        }
+        case CHUNK_SIZE_LINE:
+            if (c == '\n')
+                chunkState = chunkRemaining ? CHUNK_DATA : CHUNK_TRAILER;
+            i++;
+            break;
+        case CHUNK_DATA:
+        {
+            size_t take = len - i < chunkRemaining ? len - i : chunkRemaining;
+            memmove(out + produced, in + i, take);
+            produced += take;
+            i += take;
+            chunkRemaining -= take;
+            if (chunkRemaining == 0)
+                chunkState = CHUNK_DATA_END;
+            break;
+        }
+        case CHUNK_DATA_END:
+            if (c == '\n')
+                chunkState = CHUNK_SIZE;
+            i++;
+            break;
+        case CHUNK_TRAILER:
+            // Ends at the first empty line
+            if (c == '\n')
+            {
+                if (trailerLineEmpty)
+                    chunkState = CHUNK_DONE;
+                trailerLineEmpty = true;
+            }
+            else if (c != '\r')
+            {
+                trailerLineEmpty = false;
+            }
+            i++;
+            break;
+        case CHUNK_DONE:
+            break;
+        }
+    }
+    return produced;
+}
+
+bool AsyncHttpRequest::parseHeaders()
+{
+    if (strncmp(response, "HTTP/1.", 7) != 0)
+        return false;
+    statusCode = atoi(response + 9);
+    if (statusCode < 100)
+        return false;
+    keepAlive = response[7] == '1'; // HTTP/1.1 defaults to keep-alive
+
+    const char *line = strstr(response, "\r\n");
+    const char *end = response + bodyStart - 2;
+    while (line && line < end)
+    {
+        line += 2;
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+            contentLength = strtol(line + 15, nullptr, 10);
+        else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0)
+        {
+            const char *eol = strstr(line, "\r\n");
+            const char *v = line + 18;
+            while (v < eol && *v == ' ')
+                v++;
+            chunked = (eol - v >= 7 && strncasecmp(v, "chunked", 7) == 0);
+        }
+        else if (strncasecmp(line, "Content-Type:", 13) == 0)
+        {
+            const char *eol = strstr(line, "\r\n");
+            const char *v = line + 13;
+            while (v < eol && *v == ' ')
+                v++;
+            size_t n = eol - v;
+            if (n >= sizeof(responseType))
+                n = sizeof(responseType) - 1;
+            memcpy(responseType, v, n);
+            responseType[n] = '\0';
+        }
+        else if (strncasecmp(line, "Connection:", 11) == 0)
+        {
+            const char *eol = strstr(line, "\r\n");
+            const char *v = line + 11;
+            while (v < eol && *v == ' ')
+                v++;
+            if (eol - v >= 5 && strncasecmp(v, "close", 5) == 0)
+                keepAlive = false;
+            else if (eol - v >= 10 && strncasecmp(v, "keep-alive", 10) == 0)
+                keepAlive = true;
+        }
+        line = strstr(line, "\r\n");
+    }
+
+    if (chunked)
+    {
+        contentLength = -1;
+        chunkState = CHUNK_SIZE;
+        chunkRemaining = 0;
+        trailerLineEmpty = true;
+    }
+    else if (contentLength < 0)
+        keepAlive = false; // Body ends when the server closes
+    return true;
+}
+
+void AsyncHttpRequest::finish(uint32_t nowMs)
+{
+    retryBody = nullptr;
+    response[responseLen] = '\0';
+    enterStage(REQ_DONE, nowMs);
+    if (!keepAlive)
+        closeSocket();
+}
+
+bool AsyncHttpRequest::isBusy() const
+{
+    return state != REQ_IDLE && state != REQ_DONE && state != REQ_FAILED;
+}
+
+bool AsyncHttpRequest::needsBody() const
+{
+    return body != nullptr || retryBody != nullptr;
+}
+
+AsyncHttpRequest::State AsyncHttpRequest::getState() const
+{
+    return state;
+}
+
+AsyncHttpRequest::Error AsyncHttpRequest::getError() const
+{
+    return error;
+}
+
+AsyncHttpRequest::State AsyncHttpRequest::getFailedStage() const
+{
+    return failedStage;
+}
+
+int AsyncHttpRequest::getStatusCode() const
+{
+    return statusCode;
+}
+
+void AsyncHttpRequest::setBodyListener(BodyListener listener, void *context)
+{
+    bodyListener = listener;
+    bodyListenerContext = context;
+}
+
+const char *AsyncHttpRequest::getResponseType() const
+{
+    return responseType;
+}
+
+const char *AsyncHttpRequest::getResponse() const
+{
+    return (state == REQ_DONE && response) ? response + bodyStart : "";
+}
+
+size_t AsyncHttpRequest::getResponseLength() const
+{
+    return state == REQ_DONE ? responseLen - bodyStart : 0;
+}
+
+uint32_t AsyncHttpRequest::getElapsedMs(uint32_t nowMs) const
+{
+    return nowMs - startedMs;
+}
+
+uint32_t AsyncHttpRequest::getStageTime(State stage) const
+{
+    return stage < REQ_DONE ? stageTime[stage] : 0;
+}
+
+uint32_t AsyncHttpRequest::getBodyReadUs() const
+{
+    return bodyReadUs;
+}
+
+bool AsyncHttpRequest::wasReused() const
+{
+    return reused;
+}
+
+bool AsyncHttpRequest::wasRetried() const
+{
+    return retried;
+}
+
+uint32_t AsyncHttpRequest::getConnectionsOpened() const
+{
+    return connectionsOpened;
+}
+
+uint32_t AsyncHttpRequest::getDnsLookups() const
+{
+    return dnsLookups;
+}
+
+const char *AsyncHttpRequest::getTlsError() const
+{
+    return tls.getLastError();
+}
+
+const char *AsyncHttpRequest::stateName(State s)
+{
+    switch (s)
+    {
+    case REQ_IDLE:
+        return "idle";
+    case REQ_CONNECTING:
+        return "connect";
+    case REQ_SENDING:
+        return "send";
+    case REQ_AWAIT_HEADERS:
+        return "headers";
+    case REQ_READING_BODY:
+        return "body";
+    case REQ_DONE:
+        return "done";
+    case REQ_FAILED:
+        return "failed";
+    }
+    return "?";
+}
+
+const char *AsyncHttpRequest::errorName(Error e)
+{
+    switch (e)
+    {
+    case ERR_NONE:
+        return "none";
+    case ERR_URL:
+        return "bad url";
+    case ERR_DNS:
+        return "dns";
+    case ERR_CONNECT:
+        return "connect";
+    case ERR_TLS:
+        return "tls";
+    case ERR_SEND:
+        return "send";
+    case ERR_RECV:
+        return "recv";
+    case ERR_TIMEOUT:
+        return "timeout";
+    case ERR_PROTOCOL:
+        return "protocol";
+    case ERR_TOO_LARGE:
+        return "too large";
+    case ERR_CANCELLED:
+        return "cancelled";
+    }
+    return "?";
+}
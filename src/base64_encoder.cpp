@@ -0,0 +1,144 @@
+#include "base64_encoder.h"
+#include <string.h>
+
+static constexpr char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Two output characters for every 12-bit input value, so the kernels emit a
+// pair of characters per lookup instead of one. 8 KB built by the compiler
+// into read-only data: flash on the ESP32, read through the same cache as
+// the PSRAM frames, so it takes no internal RAM and no start-up time.
+struct PairTable
+{
+    char pairs[4096][2];
+};
+
+static constexpr PairTable buildPairTable()
+{
+    PairTable table = {};
+    for (int i = 0; i < 4096; i++)
+    {
+        table.pairs[i][0] = BASE64_ALPHABET[i >> 6];
+        table.pairs[i][1] = BASE64_ALPHABET[i & 0x3F];
+    }
+    return table;
+}
+
+static constexpr PairTable PAIR_TABLE = buildPairTable();
+
+static inline void putPair(char *out, uint32_t index)
+{
+    memcpy(out, PAIR_TABLE.pairs[index & 0xFFF], 2);
+}
+
+#if defined(BASE64_ESP32S3_KERNEL)
+static inline uint32_t loadBigEndian32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+#else
+static inline uint64_t loadBigEndian64(const uint8_t *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+#endif
+
+// Scalar encoder for short inputs and the tail left by the kernels
+static size_t encodeScalar(const uint8_t *input, size_t inputLength, char *out)
+{
+    char *start = out;
+    size_t i = 0;
+
+    for (; i + 3 <= inputLength; i += 3)
+    {
+        uint32_t triple = ((uint32_t)input[i] << 16) | ((uint32_t)input[i + 1] << 8) | input[i + 2];
+        putPair(out, triple >> 12);
+        putPair(out + 2, triple);
+        out += 4;
+    }
+
+    // Tail: 1 or 2 leftover bytes, padded with '='
+    size_t rest = inputLength - i;
+    if (rest > 0)
+    {
+        uint32_t triple = (uint32_t)input[i] << 16;
+        if (rest == 2)
+            triple |= (uint32_t)input[i + 1] << 8;
+        *out++ = BASE64_ALPHABET[(triple >> 18) & 0x3F];
+        *out++ = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+        *out++ = (rest == 2) ? BASE64_ALPHABET[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+
+    return out - start;
+}
+
+#if defined(BASE64_ESP32S3_KERNEL)
+// LX7 has no 64-bit registers: take 12 bytes as three 32-bit words and split
+// them into four 24-bit groups with shifts only.
+static size_t encodeKernel(const uint8_t *input, size_t inputLength, char *out)
+{
+    size_t i = 0;
+    for (; i + 12 <= inputLength; i += 12)
+    {
+        uint32_t w0 = loadBigEndian32(input + i);
+        uint32_t w1 = loadBigEndian32(input + i + 4);
+        uint32_t w2 = loadBigEndian32(input + i + 8);
+
+        uint32_t t0 = w0 >> 8;
+        uint32_t t1 = (w0 << 16) | (w1 >> 16);
+        uint32_t t2 = (w1 << 8) | (w2 >> 24);
+        uint32_t t3 = w2;
+
+        putPair(out, t0 >> 12);
+        putPair(out + 2, t0);
+        putPair(out + 4, t1 >> 12);
+        putPair(out + 6, t1);
+        putPair(out + 8, t2 >> 12);
+        putPair(out + 10, t2);
+        putPair(out + 12, t3 >> 12);
+        putPair(out + 14, t3);
+        out += 16;
+    }
+    return i;
+}
+#else
+// Portable SWAR kernel: one 64-bit load yields 6 input bytes (48 bits),
+// i.e. four 12-bit indices. Reads 8 bytes, so stop 2 bytes early.
+static size_t encodeKernel(const uint8_t *input, size_t inputLength, char *out)
+{
+    size_t i = 0;
+    for (; i + 14 <= inputLength; i += 12)
+    {
+        uint64_t a = loadBigEndian64(input + i);
+        uint64_t b = loadBigEndian64(input + i + 6);
+
+        putPair(out, (uint32_t)(a >> 52));
+        putPair(out + 2, (uint32_t)(a >> 40));
+        putPair(out + 4, (uint32_t)(a >> 28));
+        putPair(out + 6, (uint32_t)(a >> 16));
+        putPair(out + 8, (uint32_t)(b >> 52));
+        putPair(out + 10, (uint32_t)(b >> 40));
+        putPair(out + 12, (uint32_t)(b >> 28));
+        putPair(out + 14, (uint32_t)(b >> 16));
+        out += 16;
+    }
+    return i;
+}
+#endif
+
+size_t base64EncodedLength(size_t inputLength)
+{
+    return ((inputLength + 2) / 3) * 4;
+}
+
+size_t base64Encode(const uint8_t *input, size_t inputLength, char *out)
+{
+    size_t consumed = encodeKernel(input, inputLength, out);
+    size_t written = (consumed / 3) * 4;
+    return written + encodeScalar(input + consumed, inputLength - consumed, out + written);
+}
@@ -0,0 +1,135 @@
+#include "cadence_scheduler.h"
+
+static const uint32_t MINUTE_MS = 60000;
+
+// Error backoff starts here when min is shorter (min may be 0: back to back)
+static const uint32_t ERROR_BASE_MS = 500;
+
+CadenceScheduler::CadenceScheduler()
+    : minInterval(1000), maxInterval(30000), nextAt(0), lastInterval(0), errorStreak(0), decisionCount(0),
+      decisionHead(0), avgLatency(0), avgStaleness(0), haveLatency(false), haveStaleness(false)
+{
+}
+
+void CadenceScheduler::configure(uint32_t minMs, uint32_t maxMs)
+{
+    minInterval = minMs;
+    maxInterval = maxMs < minMs ? minMs : maxMs;
+}
+
+uint32_t CadenceScheduler::getMinInterval() const
+{
+    return minInterval;
+}
+
+uint32_t CadenceScheduler::getMaxInterval() const
+{
+    return maxInterval;
+}
+
+void CadenceScheduler::reset(uint32_t nowMs)
+{
+    nextAt = nowMs;
+    lastInterval = 0;
+    errorStreak = 0;
+}
+
+bool CadenceScheduler::isDue(uint32_t nowMs) const
+{
+    return (int32_t)(nowMs - nextAt) >= 0;
+}
+
+uint32_t CadenceScheduler::getNextDelay(uint32_t nowMs) const
+{
+    return isDue(nowMs) ? 0 : nextAt - nowMs;
+}
+
+// Exponential moving average, 1/8 weight for the new sample
+uint32_t CadenceScheduler::smooth(uint32_t average, uint32_t sample, bool &have)
+{
+    if (!have)
+    {
+        have = true;
+        return sample;
+    }
+    return (uint32_t)(((uint64_t)average * 7 + sample) / 8);
+}
+
+void CadenceScheduler::schedule(uint32_t nowMs, uint32_t baseMs)
+{
+    uint32_t interval = baseMs + avgLatency / 2;
+    if (interval < minInterval)
+        interval = minInterval;
+    if (interval > maxInterval)
+        interval = maxInterval;
+
+    lastInterval = interval;
+    nextAt = nowMs + interval;
+}
+
+void CadenceScheduler::onDecision(uint32_t nowMs, uint32_t latencyMs, uint32_t stalenessMs, bool moving, bool goalFound)
+{
+    errorStreak = 0;
+    avgLatency = smooth(avgLatency, latencyMs, haveLatency);
+    avgStaleness = smooth(avgStaleness, stalenessMs, haveStaleness);
+
+    decisionTimes[decisionHead] = nowMs;
+    decisionHead = (decisionHead + 1) % HISTORY;
+    if (decisionCount < HISTORY)
+        decisionCount++;
+
+    if (goalFound)
+        schedule(nowMs, maxInterval);
+    else if (moving)
+        schedule(nowMs, minInterval);
+    else
+        schedule(nowMs, minInterval * 4);
+}
+
+void CadenceScheduler::onSkipped(uint32_t nowMs)
+{
+    // No backend round trip, so no latency allowance either
+    lastInterval = minInterval;
+    nextAt = nowMs + minInterval;
+}
+
+void CadenceScheduler::onError(uint32_t nowMs, uint32_t latencyMs)
+{
+    avgLatency = smooth(avgLatency, latencyMs, haveLatency);
+    if (errorStreak < 16)
+        errorStreak++;
+
+    uint32_t base = minInterval > ERROR_BASE_MS ? minInterval : ERROR_BASE_MS;
+    uint32_t limit = maxInterval > base ? maxInterval : base;
+    uint64_t backoff = ((uint64_t)base << errorStreak) + avgLatency / 2;
+
+    // Not schedule(): its [min, max] clamp would undo the floor when max < 500
+    lastInterval = backoff > limit ? limit : (uint32_t)backoff;
+    nextAt = nowMs + lastInterval;
+}
+
+uint32_t CadenceScheduler::getDecisionsPerMinute(uint32_t nowMs) const
+{
+    uint32_t count = 0;
+    for (int i = 0; i < decisionCount; i++)
+    {
+        if (nowMs - decisionTimes[i] < MINUTE_MS)
+            count++;
+    }
+    return count;
+}
+
+uint32_t CadenceScheduler::getAverageStaleness() const
+{
+    return avgStaleness;
+}
+
+uint32_t CadenceScheduler::getAverageLatency() const
+{
+    return avgLatency;
+}
+
+uint32_t CadenceScheduler::getLastInterval() const
+{
+    return lastInterval;
+}
@@ -0,0 +1,286 @@
+#include "config_store.h"
+
+#include <string.h>
+
+static const uint32_t MAGIC = 0x47464342; // "BCFG"
+
+// Stored, checksummed and compared byte for byte, so no padding anywhere
+static_assert(sizeof(BotConfig) == 316, "BotConfig must not contain padding");
+
+// Where the settings lived before ConfigStore, read only to migrate
+#define LEGACY_WIFI_FLAG 0
+#define LEGACY_SSID 1
+#define LEGACY_SSID_SIZE 32
+#define LEGACY_PASS 34
+#define LEGACY_PASS_SIZE 64
+#define LEGACY_BASE_URL 200
+#define LEGACY_BASE_URL_SIZE 100
+#define LEGACY_MSG_ROUTE 300
+#define LEGACY_MSG_ROUTE_SIZE 50
+#define LEGACY_HEALTH_ROUTE 350
+#define LEGACY_HEALTH_ROUTE_SIZE 50
+#define LEGACY_UPLOAD_MODE 400
+#define LEGACY_STREAM_MODE 401
+#define LEGACY_SERVO_CENTER 500
+#define LEGACY_SERVO_LEFT 504
+#define LEGACY_SERVO_RIGHT 508
+
+void BotConfig::setDefaults()
+{
+    memset(this, 0, sizeof(*this));
+    strcpy(apiMessageRoute, "/message");
+    strcpy(apiHealthRoute, "/health");
+    servoCenter = 28;
+    servoLeft = 10;
+    servoRight = 50;
+}
+
+ConfigStore::ConfigStore() : storage(nullptr)
+{
+    config.setDefaults();
+    memset(&stats, 0, sizeof(stats));
+    stats.slot = -1;
+}
+
+size_t ConfigStore::slotAddress(int slot)
+{
+    return LEGACY_SIZE + slot * SLOT_SIZE;
+}
+
+uint32_t ConfigStore::crc32(const void *data, size_t len, uint32_t crc)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// Strings read from storage end inside their fields whatever was stored
+void ConfigStore::terminate(BotConfig &value)
+{
+    value.wifiSsid[sizeof(value.wifiSsid) - 1] = 0;
+    value.wifiPassword[sizeof(value.wifiPassword) - 1] = 0;
+    value.apiBaseUrl[sizeof(value.apiBaseUrl) - 1] = 0;
+    value.apiMessageRoute[sizeof(value.apiMessageRoute) - 1] = 0;
+    value.apiHealthRoute[sizeof(value.apiHealthRoute) - 1] = 0;
+}
+
+bool ConfigStore::readSlot(int slot, BotConfig &out, uint32_t &sequence)
+{
+    static_assert(sizeof(Header) + sizeof(BotConfig) <= SLOT_SIZE, "BotConfig and its header must fit a slot");
+    uint8_t image[SLOT_SIZE];
+    storage->readBlock(slotAddress(slot), image, sizeof(Header) + sizeof(BotConfig));
+
+    Header header;
+    memcpy(&header, image, sizeof(header));
+    if (header.magic != MAGIC || header.version == 0 || header.version > VERSION || header.length == 0 ||
+        header.length > sizeof(BotConfig))
+        return false;
+
+    uint32_t stored = header.crc;
+    header.crc = 0;
+    uint32_t crc = crc32(&header, sizeof(header));
+    if (crc32(image + sizeof(header), header.length, crc) != stored)
+        return false;
+
+    // An older, shorter config keeps the defaults of the fields it lacks
+    out.setDefaults();
+    memcpy(&out, image + sizeof(header), header.length);
+    terminate(out);
+    sequence = header.sequence;
+    return true;
+}
+
+bool ConfigStore::writeSlot(int slot, const BotConfig &value, uint32_t sequence)
+{
+    uint8_t image[sizeof(Header) + sizeof(BotConfig)];
+    Header header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.length = sizeof(BotConfig);
+    header.sequence = sequence;
+    header.crc = 0;
+    header.crc = crc32(&value, sizeof(value), crc32(&header, sizeof(header)));
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), &value, sizeof(value));
+
+    storage->writeBlock(slotAddress(slot), image, sizeof(image));
+    stats.commits++;
+    stats.bytesWritten += sizeof(image);
+    return storage->commit();
+}
+
+// Reads a legacy string field, which ends at a 0 (or erased 0xFF) byte or
+// fills its field
+static void readLegacyString(Storage *storage, size_t addr, size_t size, char *out, size_t outSize)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < size && n + 1 < outSize; i++)
+    {
+        uint8_t c = storage->read(addr + i);
+        if (c == 0 || c == 0xFF)
+            break;
+        out[n++] = (char)c;
+    }
+    out[n] = 0;
+}
+
+static bool legacyServoValid(int32_t value)
+{
+    return value != -1 && value >= -90 && value <= 270;
+}
+
+bool ConfigStore::migrateLegacy(BotConfig &out)
+{
+    out.setDefaults();
+
+    // A fresh EEPROM blob is all zeros (or 0xFF): nothing to migrate, and
+    // its zeros would otherwise pass as servo angles
+    uint8_t legacy[LEGACY_SIZE];
+    storage->readBlock(0, legacy, sizeof(legacy));
+    bool zeros = true;
+    bool ones = true;
+    for (size_t i = 0; i < sizeof(legacy); i++)
+    {
+        zeros = zeros && legacy[i] == 0x00;
+        ones = ones && legacy[i] == 0xFF;
+    }
+    if (zeros || ones)
+        return false;
+
+    // Same rules the managers used to load with
+    if (storage->read(LEGACY_WIFI_FLAG) == 1)
+    {
+        readLegacyString(storage, LEGACY_SSID, LEGACY_SSID_SIZE, out.wifiSsid, sizeof(out.wifiSsid));
+        readLegacyString(storage, LEGACY_PASS, LEGACY_PASS_SIZE, out.wifiPassword, sizeof(out.wifiPassword));
+        out.wifiConfigured = out.wifiSsid[0] != 0;
+    }
+
+    readLegacyString(storage, LEGACY_BASE_URL, LEGACY_BASE_URL_SIZE, out.apiBaseUrl, sizeof(out.apiBaseUrl));
+    if (strncmp(out.apiBaseUrl, "http", 4) != 0)
+        out.apiBaseUrl[0] = 0;
+
+    char route[LEGACY_MSG_ROUTE_SIZE + 1];
+    readLegacyString(storage, LEGACY_MSG_ROUTE, LEGACY_MSG_ROUTE_SIZE, route, sizeof(out.apiMessageRoute));
+    if (route[0])
+        strcpy(out.apiMessageRoute, route);
+    readLegacyString(storage, LEGACY_HEALTH_ROUTE, LEGACY_HEALTH_ROUTE_SIZE, route, sizeof(out.apiHealthRoute));
+    if (route[0])
+        strcpy(out.apiHealthRoute, route);
+
+    out.uploadMode = storage->read(LEGACY_UPLOAD_MODE) == 1 ? 1 : 0;
+    out.streamResponses = storage->read(LEGACY_STREAM_MODE) == 1 ? 1 : 0;
+
+    int32_t servo;
+    storage->get(LEGACY_SERVO_CENTER, servo);
+    if (legacyServoValid(servo))
+        out.servoCenter = servo;
+    storage->get(LEGACY_SERVO_LEFT, servo);
+    if (legacyServoValid(servo))
+        out.servoLeft = servo;
+    storage->get(LEGACY_SERVO_RIGHT, servo);
+    if (legacyServoValid(servo))
+        out.servoRight = servo;
+    return true;
+}
+
+bool ConfigStore::begin(Storage *settings)
+{
+    storage = settings;
+    if (storage->size() < STORAGE_SIZE)
+        return false;
+
+    BotConfig slots[2];
+    uint32_t sequences[2];
+    bool valid[2];
+    for (int i = 0; i < 2; i++)
+    {
+        valid[i] = readSlot(i, slots[i], sequences[i]);
+        if (!valid[i])
+            stats.invalidSlots++;
+    }
+
+    int newest = -1;
+    if (valid[0] && valid[1])
+        newest = (int32_t)(sequences[1] - sequences[0]) > 0 ? 1 : 0;
+    else if (valid[0] || valid[1])
+        newest = valid[0] ? 0 : 1;
+
+    if (newest >= 0)
+    {
+        config = slots[newest];
+        stats.source = SOURCE_SAVED;
+        stats.slot = newest;
+        stats.sequence = sequences[newest];
+        return true;
+    }
+
+    BotConfig migrated;
+    if (!migrateLegacy(migrated))
+    {
+        stats.source = SOURCE_DEFAULTS;
+        return true; // Written on the first save()
+    }
+
+    stats.source = SOURCE_MIGRATED;
+    if (!writeSlot(0, migrated, 1))
+    {
+        config = migrated; // Run with it; migrated again next boot
+        return false;
+    }
+    config = migrated;
+    stats.slot = 0;
+    stats.sequence = 1;
+    return true;
+}
+
+const BotConfig &ConfigStore::get() const
+{
+    return config;
+}
+
+bool ConfigStore::save(const BotConfig &value)
+{
+    stats.saves++;
+    BotConfig next = value;
+    terminate(next);
+    if (stats.slot >= 0 && memcmp(&next, &config, sizeof(next)) == 0)
+    {
+        stats.unchanged++;
+        return true;
+    }
+
+    // Never over the current copy: until this commit lands, it is the config
+    int slot = stats.slot == 0 ? 1 : 0;
+    uint32_t sequence = stats.sequence + 1;
+    if (!writeSlot(slot, next, sequence))
+        return false;
+
+    config = next;
+    stats.slot = slot;
+    stats.sequence = sequence;
+    return true;
+}
+
+const ConfigStore::Stats &ConfigStore::getStats() const
+{
+    return stats;
+}
+
+const char *ConfigStore::sourceName(Source source)
+{
+    switch (source)
+    {
+    case SOURCE_SAVED:
+        return "saved";
+    case SOURCE_MIGRATED:
+        return "migrated";
+    default:
+        return "defaults";
+    }
+}
@@ -0,0 +1,334 @@
+#include "decision_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+DecisionScanner::DecisionScanner()
+{
+    reset();
+}
+
+void DecisionScanner::reset()
+{
+    depth = 0;
+    started = false;
+    complete = false;
+    inString = false;
+    escape = false;
+    stringIsKey = false;
+    expectingKey = false;
+    valuePending = false;
+    capturing = false;
+    key = KEY_OTHER;
+    keyLen = 0;
+    valueLen = 0;
+    direction[0] = '\0';
+    directionSet = false;
+    distance = 0.0f;
+    distanceSet = false;
+    goalFound = false;
+    goalFoundSet = false;
+}
+
+void DecisionScanner::feed(const char *text, size_t len)
+{
+    for (size_t i = 0; i < len && !complete; i++)
+        feedChar(text[i]);
+}
+
+void DecisionScanner::resolveKey()
+{
+    keyBuf[keyLen] = '\0';
+    if (strcmp(keyBuf, "direction") == 0)
+        key = KEY_DIRECTION;
+    else if (strcmp(keyBuf, "distance_m") == 0)
+        key = KEY_DISTANCE;
+    else if (strcmp(keyBuf, "goal_found") == 0)
+        key = KEY_GOAL_FOUND;
+    else
+        key = KEY_OTHER;
+}
+
+void DecisionScanner::finishValue()
+{
+    capturing = false;
+    valueBuf[valueLen] = '\0';
+
+    switch (key)
+    {
+    case KEY_DIRECTION:
+        memcpy(direction, valueBuf, valueLen + 1);
+        directionSet = true;
+        break;
+    case KEY_DISTANCE:
+    {
+        char *end;
+        double value = strtod(valueBuf, &end);
+        if (end != valueBuf)
+        {
+            distance = (float)value;
+            distanceSet = true;
+        }
+        break;
+    }
+    case KEY_GOAL_FOUND:
+        goalFound = strcmp(valueBuf, "true") == 0;
+        goalFoundSet = true;
+        break;
+    default:
+        break;
+    }
+}
+
+void DecisionScanner::feedChar(char c)
+{
+    if (inString)
+    {
+        char out = c;
+        if (escape)
+        {
+            escape = false;
+            if (c == 'n')
+                out = '\n';
+            else if (c == 't')
+                out = '\t';
+        }
+        else if (c == '\\')
+        {
+            escape = true;
+            return;
+        }
+        else if (c == '"')
+        {
+            inString = false;
+            if (stringIsKey)
+                resolveKey();
+            else if (capturing)
+                finishValue();
+            return;
+        }
+
+        if (stringIsKey && keyLen < FIELD_MAX - 1)
+            keyBuf[keyLen++] = out;
+        else if (capturing && valueLen < FIELD_MAX - 1)
+            valueBuf[valueLen++] = out;
+        return;
+    }
+
+    switch (c)
+    {
+    case '"':
+        inString = true;
+        stringIsKey = depth == 1 && expectingKey;
+        if (stringIsKey)
+        {
+            keyLen = 0;
+        }
+        else if (depth == 1 && valuePending)
+        {
+            valuePending = false;
+            capturing = key != KEY_OTHER;
+            valueLen = 0;
+        }
+        break;
+    case '{':
+    case '[':
+        if (depth == 0 && c == '{')
+            started = true;
+        if (!started)
+            break;
+        depth++;
+        valuePending = false;
+        if (depth == 1)
+            expectingKey = true;
+        break;
+    case '}':
+    case ']':
+        if (!started)
+            break;
+        if (capturing)
+            finishValue();
+        depth--;
+        if (depth == 0)
+            complete = true;
+        break;
+    case ':':
+        if (depth == 1)
+        {
+            expectingKey = false;
+            valuePending = true;
+        }
+        break;
+    case ',':
+        if (capturing)
+            finishValue();
+        if (depth == 1)
+            expectingKey = true;
+        break;
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+        if (capturing)
+            finishValue();
+        break;
+    default:
+        // Start or continuation of a number / true / false / null
+        if (depth == 1 && valuePending)
+        {
+            valuePending = false;
+            capturing = key != KEY_OTHER;
+            valueLen = 0;
+        }
+        if (capturing && valueLen < FIELD_MAX - 1)
+            valueBuf[valueLen++] = c;
+        break;
+    }
+}
+
+bool DecisionScanner::hasDecision() const
+{
+    return directionSet && distanceSet;
+}
+
+bool DecisionScanner::isComplete() const
+{
+    return complete;
+}
+
+bool DecisionScanner::hasDirection() const
+{
+    return directionSet;
+}
+
+const char *DecisionScanner::getDirection() const
+{
+    return direction;
+}
+
+bool DecisionScanner::hasDistance() const
+{
+    return distanceSet;
+}
+
+float DecisionScanner::getDistance() const
+{
+    return distance;
+}
+
+bool DecisionScanner::hasGoalFound() const
+{
+    return goalFoundSet;
+}
+
+bool DecisionScanner::getGoalFound() const
+{
+    return goalFound;
+}
+
+SseDeltaDecoder::SseDeltaDecoder()
+{
+    reset();
+}
+
+void SseDeltaDecoder::reset()
+{
+    lineLen = 0;
+    done = false;
+}
+
+bool SseDeltaDecoder::isDone() const
+{
+    return done;
+}
+
+void SseDeltaDecoder::feed(const char *data, size_t len, TextSink sink, void *context)
+{
+    for (size_t i = 0; i < len && !done; i++)
+    {
+        char c = data[i];
+        if (c == '\n')
+        {
+            line[lineLen] = '\0';
+            processLine(sink, context);
+            lineLen = 0;
+        }
+        else if (c != '\r' && lineLen < MAX_LINE - 1)
+        {
+            line[lineLen++] = c;
+        }
+    }
+}
+
+static int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void SseDeltaDecoder::processLine(TextSink sink, void *context)
+{
+    if (strncmp(line, "data:", 5) != 0)
+        return; // Blank separator, comment, event: or id: line
+
+    const char *p = line + 5;
+    while (*p == ' ')
+        p++;
+    if (strcmp(p, "[DONE]") == 0)
+    {
+        done = true;
+        return;
+    }
+
+    p = strstr(p, "\"delta\"");
+    if (!p)
+        return;
+    p = strchr(p + 7, '"');
+    if (!p)
+        return;
+    p++;
+
+    // Unescape the JSON string value into a small buffer, then emit it
+    char text[MAX_LINE];
+    size_t n = 0;
+    while (*p && *p != '"')
+    {
+        char c = *p++;
+        if (c == '\\' && *p)
+        {
+            char e = *p++;
+            switch (e)
+            {
+            case 'n':
+                c = '\n';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 'u':
+            {
+                // Only ASCII code points are kept as-is
+                int value = 0;
+                for (int i = 0; i < 4 && hexNibble(*p) >= 0; i++)
+                    value = value * 16 + hexNibble(*p++);
+                c = value < 0x80 ? (char)value : '?';
+                break;
+            }
+            default:
+                c = e; // \" \\ \/
+            }
+        }
+        text[n++] = c;
+    }
+
+    if (n > 0)
+        sink(context, text, n);
+}
@@ -0,0 +1,174 @@
+#include "display_service.h"
+#include "oled_display.h"
+#include "log.h"
+
+static const char *TAG = "display";
+
+DisplayService::DisplayService()
+    : queue(nullptr), taskHandle(nullptr), lastFrameMs(0), updates(0), frames(0), dropped(0)
+{
+}
+
+bool DisplayService::begin(BaseType_t core)
+{
+    queue = xQueueCreate(QUEUE_DEPTH, sizeof(UiUpdate));
+    if (!queue)
+    {
+        LOG_E(TAG, "Failed to create queue");
+        return false;
+    }
+
+    // Lowest priority: the display waits for everything else
+    BaseType_t ok = xTaskCreatePinnedToCore(taskEntry, "display", 4096, this, 1, &taskHandle, core);
+    if (ok != pdPASS)
+    {
+        LOG_E(TAG, "Failed to create task");
+        vQueueDelete(queue);
+        queue = nullptr;
+        taskHandle = nullptr;
+        return false;
+    }
+
+    LOG_I(TAG, "Task started on core %d (%u fps max)", (int)core, (unsigned)MAX_FPS);
+    return true;
+}
+
+void DisplayService::showIntro(const String &status)
+{
+    UiUpdate update;
+    update.screen.clear(UiScreen::LAYOUT_INTRO);
+    update.screen.setLine(0, status.c_str());
+    update.holdMs = 0;
+    post(update);
+}
+
+void DisplayService::showMain(const String &ip, const String &status, const String &direction,
+                              const String &distance, uint32_t holdMs)
+{
+    UiUpdate update;
+    update.screen.clear(UiScreen::LAYOUT_MAIN);
+    update.screen.setLine(0, ip.c_str());
+    update.screen.setLine(1, status.c_str());
+    update.screen.setLine(2, direction.c_str());
+    update.screen.setLine(3, distance.c_str());
+    update.holdMs = holdMs;
+    post(update);
+}
+
+void DisplayService::showText(const String &line1, const String &line2, const String &line3, const String &line4,
+                              uint32_t holdMs)
+{
+    UiUpdate update;
+    update.screen.clear(UiScreen::LAYOUT_TEXT);
+    update.screen.setLine(0, line1.c_str());
+    update.screen.setLine(1, line2.c_str());
+    update.screen.setLine(2, line3.c_str());
+    update.screen.setLine(3, line4.c_str());
+    update.holdMs = holdMs;
+    post(update);
+}
+
+void DisplayService::showCentered(const String &text, uint32_t holdMs)
+{
+    UiUpdate update;
+    update.screen.clear(UiScreen::LAYOUT_CENTERED);
+    update.screen.setLine(0, text.c_str());
+    update.holdMs = holdMs;
+    post(update);
+}
+
+DisplayServiceStats DisplayService::getStats()
+{
+    DisplayServiceStats stats;
+    stats.updates = updates;
+    stats.frames = frames;
+    stats.dropped = dropped;
+    return stats;
+}
+
+void DisplayService::post(UiUpdate &update)
+{
+    if (!queue)
+    {
+        // No task: draw here, as before
+        take(update);
+        drawIfChanged();
+        return;
+    }
+
+    // Never wait on the display: a full queue loses its oldest update,
+    // which a newer one has most likely superseded anyway
+    while (xQueueSend(queue, &update, 0) != pdTRUE)
+    {
+        UiUpdate oldest;
+        if (xQueueReceive(queue, &oldest, 0) == pdTRUE)
+            dropped++;
+    }
+}
+
+void DisplayService::taskEntry(void *arg)
+{
+    static_cast<DisplayService *>(arg)->run();
+}
+
+void DisplayService::run()
+{
+    UiUpdate update;
+    while (true)
+    {
+        // Sleep until an update comes in or a transient message runs out
+        int32_t untilExpiry = state.msUntilExpiry(millis());
+        TickType_t wait = untilExpiry < 0 ? portMAX_DELAY : pdMS_TO_TICKS(untilExpiry) + 1;
+        if (xQueueReceive(queue, &update, wait) == pdTRUE)
+            take(update);
+
+        // Hold the frame until the rate cap allows it, then draw whatever
+        // came in by then
+        uint32_t sinceFrame = millis() - lastFrameMs;
+        if (sinceFrame < FRAME_MS)
+            vTaskDelay(pdMS_TO_TICKS(FRAME_MS - sinceFrame));
+        while (xQueueReceive(queue, &update, 0) == pdTRUE)
+            take(update);
+
+        drawIfChanged();
+    }
+}
+
+void DisplayService::take(const UiUpdate &update)
+{
+    state.apply(update, millis());
+    updates++;
+}
+
+void DisplayService::drawIfChanged()
+{
+    state.expire(millis());
+    if (!state.needsDraw())
+        return;
+    draw(state.visible());
+    state.markDrawn();
+    lastFrameMs = millis();
+    frames++;
+}
+
+void DisplayService::draw(const UiScreen &screen)
+{
+    switch (screen.layout)
+    {
+    case UiScreen::LAYOUT_INTRO:
+        drawIntro(screen.lines[0]);
+        break;
+    case UiScreen::LAYOUT_MAIN:
+        drawMain(screen.lines[0], screen.lines[1], screen.lines[2], screen.lines[3]);
+        break;
+    case UiScreen::LAYOUT_TEXT:
+        displayMultiLine(screen.lines[0], screen.lines[1], screen.lines[2], screen.lines[3]);
+        break;
+    case UiScreen::LAYOUT_CENTERED:
+        displayCenteredText(screen.lines[0]);
+        break;
+    default:
+        clearDisplay();
+        break;
+    }
+}
@@ -1,8 +1,17 @@
 #include "esp32cam_manager.h"
-#include "mbedtls/base64.h"
+#include "scene_gate.h"
+#include "img_converters.h"
+#include "log.h"
+#include "metrics.h"
 
-ESP32CamManager::ESP32CamManager() : cameraAvailable(false), statusCallback(nullptr)
+static const char *TAG = "cam";
+
+ESP32CamManager::ESP32CamManager() : cameraAvailable(false), lastImage(nullptr), lastImageLen(0), lastImageCapacity(0), lastImageSeq(0), activeProfile(-1), maxFrameSize(FRAMESIZE_UXGA), cameraMutex(nullptr), statusCallback(nullptr)
 {
+    profiles[PROFILE_AI] = {"ai", FRAMESIZE_VGA, 12, 2, CAMERA_GRAB_LATEST};
+    profiles[PROFILE_STREAM] = {"stream", FRAMESIZE_HVGA, 14, 2, CAMERA_GRAB_LATEST};
+    profiles[PROFILE_SNAPSHOT] = {"snapshot", FRAMESIZE_UXGA, 10, 2, CAMERA_GRAB_LATEST};
+    resetProfileStats();
 }
 
 bool ESP32CamManager::begin()
@@ -28,36 +37,55 @@ bool ESP32CamManager::begin()
     config.pin_reset = RESET_GPIO_NUM;
     config.xclk_freq_hz = 20000000;
     config.pixel_format = PIXFORMAT_JPEG; // for streaming
-    config.grab_mode = CAMERA_GRAB_LATEST;
 
     if (psramFound())
     {
-        config.frame_size = FRAMESIZE_UXGA;
-        config.jpeg_quality = 10;
-        config.fb_count = 2;
         config.fb_location = CAMERA_FB_IN_PSRAM;
-        Serial.println("PSRAM found, using UXGA config");
+        LOG_I(TAG, "PSRAM found, snapshot profile up to UXGA");
     }
     else
     {
-        config.frame_size = FRAMESIZE_SVGA;
-        config.jpeg_quality = 12;
-        config.fb_count = 1;
+        // Without PSRAM the frame buffers must fit in DRAM
+        profiles[PROFILE_SNAPSHOT].frameSize = FRAMESIZE_SVGA;
+        profiles[PROFILE_SNAPSHOT].jpegQuality = 12;
+        for (int i = 0; i < PROFILE_COUNT; i++)
+        {
+            profiles[i].fbCount = 1;
+            if (profiles[i].frameSize > FRAMESIZE_SVGA)
+                profiles[i].frameSize = FRAMESIZE_SVGA;
+        }
         config.fb_location = CAMERA_FB_IN_DRAM;
-        Serial.println("PSRAM not found, using SVGA config");
+        LOG_W(TAG, "PSRAM not found, snapshot profile up to SVGA");
+    }
+
+    // Driver buffers are sized for the initial frame size, so init with the
+    // largest profile; smaller ones are applied later through sensor_t
+    int initProfile = 0;
+    int fbCount = 1;
+    for (int i = 0; i < PROFILE_COUNT; i++)
+    {
+        if (profiles[i].frameSize > profiles[initProfile].frameSize)
+            initProfile = i;
+        if (profiles[i].fbCount > fbCount)
+            fbCount = profiles[i].fbCount;
     }
+    maxFrameSize = profiles[initProfile].frameSize;
+    config.frame_size = maxFrameSize;
+    config.jpeg_quality = profiles[initProfile].jpegQuality;
+    config.grab_mode = profiles[initProfile].grabMode;
+    config.fb_count = fbCount;
 
     // Camera init
     esp_err_t err = esp_camera_init(&config);
     if (err != ESP_OK)
     {
-        Serial.printf("Camera init failed with error 0x%x\n", err);
+        LOG_W(TAG, "Init failed with error 0x%x, retrying at 10 MHz XCLK", err);
         // Retry with lower XCLK
         config.xclk_freq_hz = 10000000;
         err = esp_camera_init(&config);
         if (err != ESP_OK)
         {
-            Serial.printf("Camera init retry failed with error 0x%x\n", err);
+            LOG_E(TAG, "Init retry failed with error 0x%x", err);
             cameraAvailable = false;
             return false;
         }
@@ -72,7 +100,11 @@ bool ESP32CamManager::begin()
         s->set_saturation(s, -2); // lower the saturation
     }
 
-    Serial.println("Camera initialized successfully!");
+    if (!cameraMutex)
+        cameraMutex = xSemaphoreCreateMutex();
+    activeProfile = initProfile;
+
+    LOG_I(TAG, "Camera initialized");
     cameraAvailable = true;
     return true;
 }
@@ -107,59 +139,173 @@ bool ESP32CamManager::capturePhoto()
     if (!cameraAvailable)
         return false;
 
-    camera_fb_t *fb = esp_camera_fb_get();
+    camera_fb_t *fb = getFrame(PROFILE_SNAPSHOT);
     if (!fb)
     {
-        Serial.println("Camera capture failed");
+        LOG_E(TAG, "Capture failed");
         return false;
     }
 
-    // Calculate output length for Base64
-    size_t outputLength = ((fb->len + 2) / 3) * 4;
+    // Keep the raw JPEG for /snapshot.jpg; the buffer only grows
+    if (lastImageCapacity < fb->len)
+    {
+        uint8_t *grown = (uint8_t *)(psramFound() ? ps_realloc(lastImage, fb->len) : realloc(lastImage, fb->len));
+        if (grown == NULL)
+        {
+            LOG_E(TAG, "Memory allocation failed for snapshot");
+            esp_camera_fb_return(fb);
+            return false;
+        }
+        lastImage = grown;
+        lastImageCapacity = fb->len;
+    }
+
+    memcpy(lastImage, fb->buf, fb->len);
+    lastImageLen = fb->len;
+    lastImageSeq++;
+
+    esp_camera_fb_return(fb);
+    return true;
+}
+
+const uint8_t *ESP32CamManager::getLastImage(size_t &len)
+{
+    len = lastImageLen;
+    return lastImage;
+}
+
+uint32_t ESP32CamManager::getLastImageSeq()
+{
+    return lastImageSeq;
+}
+
+bool ESP32CamManager::hasImage()
+{
+    return lastImageLen > 0;
+}
+
+camera_fb_t *ESP32CamManager::getFrame(ProfileId profile)
+{
+    if (!cameraAvailable)
+        return nullptr;
+
+    xSemaphoreTake(cameraMutex, portMAX_DELAY);
 
-    // Allocate buffer (add 1 for null terminator)
-    char *encoded = (char *)malloc(outputLength + 1);
-    if (encoded == NULL)
+    unsigned long start = micros();
+    camera_fb_t *fb = nullptr;
+    if (activeProfile == profile || applyProfile(profile))
+        fb = esp_camera_fb_get();
+    uint32_t latency = micros() - start;
+
+    CameraProfileStats &stats = profileStats[profile];
+    if (fb)
     {
-        Serial.println("Memory allocation failed for base64");
-        esp_camera_fb_return(fb);
-        return false;
+        stats.captures++;
+        stats.totalLatencyUs += latency;
+        if (latency > stats.maxLatencyUs)
+            stats.maxLatencyUs = latency;
+        stats.totalBytes += fb->len;
+        // Bot frames only: the stream would drown them out
+        if (profile == PROFILE_AI)
+            Metrics::record(Metrics::STAGE_CAPTURE, latency);
     }
+    else
+    {
+        stats.failures++;
+    }
+
+    xSemaphoreGive(cameraMutex);
+    return fb;
+}
 
-    size_t olen = 0;
-    int ret = mbedtls_base64_encode((unsigned char *)encoded, outputLength + 1, &olen, fb->buf, fb->len);
+// Caller holds cameraMutex
+bool ESP32CamManager::applyProfile(ProfileId id)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s)
+        return false;
 
-    if (ret != 0)
+    const CameraProfile &p = profiles[id];
+    if (s->set_framesize(s, p.frameSize) != 0 || s->set_quality(s, p.jpegQuality) != 0)
     {
-        Serial.println("Base64 encoding failed");
-        free(encoded);
-        esp_camera_fb_return(fb);
+        LOG_E(TAG, "Failed to apply profile %s", p.name);
+        activeProfile = -1;
         return false;
     }
 
-    encoded[olen] = '\0'; // Ensure null termination
-    lastImageBase64 = String(encoded);
-    free(encoded);
+    // The driver may already hold a frame taken with the old settings
+    camera_fb_t *stale = esp_camera_fb_get();
+    if (stale)
+        esp_camera_fb_return(stale);
 
-    esp_camera_fb_return(fb);
+    activeProfile = id;
+    profileStats[id].switches++;
     return true;
 }
 
-String ESP32CamManager::getLastImageBase64()
+bool ESP32CamManager::computeSceneSignature(const uint8_t *jpeg, size_t len, int width, int height, uint64_t &signature)
 {
-    return lastImageBase64;
+    int w = width / 8;
+    int h = height / 8;
+    if (w == 0 || h == 0)
+        return false;
+
+    // ~10 KB at VGA; short-lived, so PSRAM is fine when present
+    size_t size = (size_t)w * h * 2;
+    uint8_t *pixels = (uint8_t *)(psramFound() ? ps_malloc(size) : malloc(size));
+    if (!pixels)
+        return false;
+
+    bool ok = jpg2rgb565(jpeg, len, pixels, JPG_SCALE_8X);
+    if (ok)
+        signature = sceneSignatureFromRgb565(pixels, w, h);
+
+    free(pixels);
+    return ok;
 }
 
-bool ESP32CamManager::hasImage()
+const CameraProfile &ESP32CamManager::getProfile(ProfileId id)
 {
-    return lastImageBase64.length() > 0;
+    return profiles[id];
 }
 
-camera_fb_t *ESP32CamManager::getFrame()
+void ESP32CamManager::setProfile(ProfileId id, framesize_t frameSize, int jpegQuality)
 {
-    if (!cameraAvailable)
-        return nullptr;
-    return esp_camera_fb_get();
+    if (cameraMutex)
+        xSemaphoreTake(cameraMutex, portMAX_DELAY);
+
+    // Frames larger than the init size would not fit the driver's buffers
+    if (cameraAvailable && frameSize > maxFrameSize)
+        frameSize = maxFrameSize;
+    profiles[id].frameSize = frameSize;
+    profiles[id].jpegQuality = jpegQuality;
+
+    // Force re-application on the next grab
+    if (activeProfile == id)
+        activeProfile = -1;
+
+    if (cameraMutex)
+        xSemaphoreGive(cameraMutex);
+}
+
+CameraProfileStats ESP32CamManager::getProfileStats(ProfileId id)
+{
+    if (cameraMutex)
+        xSemaphoreTake(cameraMutex, portMAX_DELAY);
+    CameraProfileStats stats = profileStats[id];
+    if (cameraMutex)
+        xSemaphoreGive(cameraMutex);
+    return stats;
+}
+
+// Grabs update the stats while holding cameraMutex
+void ESP32CamManager::resetProfileStats()
+{
+    if (cameraMutex)
+        xSemaphoreTake(cameraMutex, portMAX_DELAY);
+    memset(profileStats, 0, sizeof(profileStats));
+    if (cameraMutex)
+        xSemaphoreGive(cameraMutex);
 }
 
 void ESP32CamManager::releaseFrame(camera_fb_t *fb)
@@ -0,0 +1,80 @@
+#include "fenced_json_reader.h"
+
+#include <string.h>
+
+FencedJsonReader::FencedJsonReader(const char *data, size_t len)
+    : data(data), len(len), pos(0), state(LEADING_SPACE), backticks(0)
+{
+}
+
+// Advances pos past any leading fence, then stays in BODY
+void FencedJsonReader::skipFence()
+{
+    while (state != BODY && pos < len)
+    {
+        char c = data[pos];
+        switch (state)
+        {
+        case LEADING_SPACE:
+            if (c == '`')
+                state = BACKTICKS;
+            else if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+                state = BODY;
+            else
+                pos++;
+            break;
+        case BACKTICKS:
+            if (c == '`')
+            {
+                backticks++;
+                pos++;
+            }
+            else
+            {
+                // Fewer than three is not a fence; let the parser report it
+                if (backticks >= 3)
+                {
+                    state = INFO_STRING;
+                }
+                else
+                {
+                    pos -= backticks;
+                    state = BODY;
+                }
+            }
+            break;
+        case INFO_STRING:
+            // Normally ends with the line; some answers start the object right away
+            if (c == '{')
+            {
+                state = BODY;
+                break;
+            }
+            pos++;
+            if (c == '\n')
+                state = BODY;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+int FencedJsonReader::read()
+{
+    if (state != BODY)
+        skipFence();
+    if (pos >= len)
+        return -1;
+    return (unsigned char)data[pos++];
+}
+
+size_t FencedJsonReader::readBytes(char *buffer, size_t length)
+{
+    if (state != BODY)
+        skipFence();
+    size_t n = len - pos < length ? len - pos : length;
+    memcpy(buffer, data + pos, n);
+    pos += n;
+    return n;
+}
@@ -0,0 +1,157 @@
+#include "frame_capture_task.h"
+#include "log.h"
+
+static const char *TAG = "capture";
+
+FrameCaptureTask::FrameCaptureTask()
+    : camManager(nullptr), taskHandle(nullptr), enabled(false), intervalMs(250)
+{
+    portMUX_INITIALIZE(&ringLock);
+}
+
+bool FrameCaptureTask::begin(ESP32CamManager *cam, BaseType_t core, uint32_t interval)
+{
+    camManager = cam;
+    intervalMs = interval;
+
+    if (!psramFound())
+    {
+        LOG_W(TAG, "No PSRAM, bot will capture inline");
+        return false;
+    }
+
+    BaseType_t ok = xTaskCreatePinnedToCore(taskEntry, "frame_capture", 4096, this, 1, &taskHandle, core);
+    if (ok != pdPASS)
+    {
+        LOG_E(TAG, "Failed to create task");
+        taskHandle = nullptr;
+        return false;
+    }
+
+    LOG_I(TAG, "Task started on core %d (%u ms)", (int)core, (unsigned)intervalMs);
+    return true;
+}
+
+bool FrameCaptureTask::isRunning()
+{
+    return taskHandle != nullptr;
+}
+
+void FrameCaptureTask::setEnabled(bool value)
+{
+    enabled = value;
+}
+
+void FrameCaptureTask::taskEntry(void *arg)
+{
+    static_cast<FrameCaptureTask *>(arg)->run();
+}
+
+void FrameCaptureTask::run()
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true)
+    {
+        if (enabled && camManager->isCameraAvailable())
+            captureOne();
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(intervalMs));
+    }
+}
+
+void FrameCaptureTask::captureOne()
+{
+    portENTER_CRITICAL(&ringLock);
+    int index = ring.beginWrite();
+    portEXIT_CRITICAL(&ringLock);
+    if (index < 0)
+        return;
+
+    // The slot is ours until commit/abort, so it can be filled unlocked
+    FrameRing::Slot &slot = ring.slot(index);
+
+    camera_fb_t *fb = camManager->getFrame(ESP32CamManager::PROFILE_AI);
+    if (!fb)
+    {
+        portENTER_CRITICAL(&ringLock);
+        ring.abortWrite(index);
+        portEXIT_CRITICAL(&ringLock);
+        return;
+    }
+
+    uint32_t timestamp = millis();
+
+    if (slot.capacity < fb->len)
+    {
+        // Some headroom so small size changes between frames don't reallocate
+        size_t capacity = fb->len + fb->len / 4;
+        uint8_t *grown = (uint8_t *)ps_realloc(slot.data, capacity);
+        if (!grown)
+        {
+            camManager->releaseFrame(fb);
+            portENTER_CRITICAL(&ringLock);
+            ring.abortWrite(index);
+            portEXIT_CRITICAL(&ringLock);
+            return;
+        }
+        slot.data = grown;
+        slot.capacity = capacity;
+    }
+
+    memcpy(slot.data, fb->buf, fb->len);
+    size_t len = fb->len;
+    int width = fb->width;
+    int height = fb->height;
+    camManager->releaseFrame(fb);
+
+    // Done here so the scene-change check costs the bot nothing at send time
+    slot.hasSignature = camManager->computeSceneSignature(slot.data, len, width, height, slot.signature);
+
+    portENTER_CRITICAL(&ringLock);
+    ring.commitWrite(index, len, timestamp);
+    portEXIT_CRITICAL(&ringLock);
+}
+
+bool FrameCaptureTask::acquireLatest(CapturedFrame &frame)
+{
+    if (!taskHandle)
+        return false;
+
+    portENTER_CRITICAL(&ringLock);
+    int index = ring.acquireLatest();
+    portEXIT_CRITICAL(&ringLock);
+    if (index < 0)
+        return false;
+
+    FrameRing::Slot &slot = ring.slot(index);
+    frame.slot = index;
+    frame.data = slot.data;
+    frame.len = slot.len;
+    frame.timestampMs = slot.timestampMs;
+    frame.seq = slot.seq;
+    frame.signature = slot.signature;
+    frame.hasSignature = slot.hasSignature;
+    return true;
+}
+
+void FrameCaptureTask::release(const CapturedFrame &frame)
+{
+    portENTER_CRITICAL(&ringLock);
+    ring.release(frame.slot);
+    portEXIT_CRITICAL(&ringLock);
+}
+
+uint32_t FrameCaptureTask::getFramesCaptured()
+{
+    portENTER_CRITICAL(&ringLock);
+    uint32_t count = ring.framesWritten();
+    portEXIT_CRITICAL(&ringLock);
+    return count;
+}
+
+uint32_t FrameCaptureTask::getFramesOverwritten()
+{
+    portENTER_CRITICAL(&ringLock);
+    uint32_t count = ring.framesOverwritten();
+    portEXIT_CRITICAL(&ringLock);
+    return count;
+}
@@ -0,0 +1,95 @@
+#include "frame_ring.h"
+
+FrameRing::FrameRing() : nextSeq(1), overwritten(0)
+{
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        slots[i].data = nullptr;
+        slots[i].capacity = 0;
+        slots[i].len = 0;
+        slots[i].timestampMs = 0;
+        slots[i].seq = 0;
+        slots[i].signature = 0;
+        slots[i].hasSignature = false;
+        slots[i].state = SLOT_FREE;
+    }
+}
+
+int FrameRing::beginWrite()
+{
+    int oldestReady = -1;
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        if (slots[i].state == SLOT_FREE)
+        {
+            slots[i].state = SLOT_WRITING;
+            return i;
+        }
+        if (slots[i].state == SLOT_READY && (oldestReady < 0 || slots[i].seq < slots[oldestReady].seq))
+            oldestReady = i;
+    }
+
+    if (oldestReady < 0)
+        return -1;
+
+    // Ring full: drop the stalest frame nobody has picked up
+    overwritten++;
+    slots[oldestReady].state = SLOT_WRITING;
+    return oldestReady;
+}
+
+void FrameRing::commitWrite(int index, size_t len, uint32_t timestampMs)
+{
+    Slot &s = slots[index];
+    s.len = len;
+    s.timestampMs = timestampMs;
+    s.seq = nextSeq++;
+    s.state = SLOT_READY;
+}
+
+void FrameRing::abortWrite(int index)
+{
+    slots[index].len = 0;
+    slots[index].state = SLOT_FREE;
+}
+
+int FrameRing::acquireLatest()
+{
+    int newest = -1;
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        if (slots[i].state == SLOT_READY && (newest < 0 || slots[i].seq > slots[newest].seq))
+            newest = i;
+    }
+
+    if (newest >= 0)
+        slots[newest].state = SLOT_READING;
+    return newest;
+}
+
+void FrameRing::release(int index)
+{
+    // Older ready frames are now staler than what was just consumed
+    uint32_t consumedSeq = slots[index].seq;
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        if (slots[i].state == SLOT_READY && slots[i].seq < consumedSeq)
+            slots[i].state = SLOT_FREE;
+    }
+    slots[index].state = SLOT_FREE;
+}
+
+FrameRing::Slot &FrameRing::slot(int index)
+{
+    return slots[index];
+}
+
+uint32_t FrameRing::framesWritten() const
+{
+    return nextSeq - 1;
+}
+
+uint32_t FrameRing::framesOverwritten() const
+{
+    return overwritten;
+}
@@ -0,0 +1,156 @@
+#include "hal_esp32.h"
+#include <EEPROM.h>
+#include "log.h"
+
+static const char *TAG = "cam";
+
+bool EepromStorage::begin(size_t size)
+{
+    return EEPROM.begin(size);
+}
+
+size_t EepromStorage::size()
+{
+    return EEPROM.length();
+}
+
+uint8_t EepromStorage::read(size_t addr)
+{
+    return EEPROM.read(addr);
+}
+
+void EepromStorage::write(size_t addr, uint8_t value)
+{
+    EEPROM.write(addr, value);
+}
+
+bool EepromStorage::commit()
+{
+    return EEPROM.commit();
+}
+
+// Out of the RAM copy EEPROM.begin() loaded
+void EepromStorage::readBlock(size_t addr, void *data, size_t len)
+{
+    EEPROM.readBytes(addr, data, len);
+}
+
+void EepromStorage::writeBlock(size_t addr, const void *data, size_t len)
+{
+    EEPROM.writeBytes(addr, data, len);
+}
+
+uint32_t ArduinoClock::millis()
+{
+    return ::millis();
+}
+
+uint32_t ArduinoClock::micros()
+{
+    return ::micros();
+}
+
+void ArduinoClock::delay(uint32_t ms)
+{
+    ::delay(ms);
+}
+
+Esp32ServoOutput::Esp32ServoOutput(int pin, int minPulseUs, int maxPulseUs)
+    : pin(pin), minPulseUs(minPulseUs), maxPulseUs(maxPulseUs)
+{
+}
+
+void Esp32ServoOutput::attach()
+{
+    servo.setPeriodHertz(50); // Standard 50 Hz servo
+    servo.attach(pin, minPulseUs, maxPulseUs);
+}
+
+void Esp32ServoOutput::write(int angle)
+{
+    servo.write(angle);
+}
+
+void Esp32ServoOutput::detach()
+{
+    servo.detach();
+}
+
+CameraFrameSource::CameraFrameSource()
+    : camManager(nullptr), inlineData(nullptr), inlineCapacity(0), inlineHeld(false)
+{
+}
+
+void CameraFrameSource::begin(ESP32CamManager *cam, BaseType_t core)
+{
+    camManager = cam;
+    captureTask.begin(cam, core);
+}
+
+bool CameraFrameSource::isAvailable()
+{
+    return camManager && camManager->isCameraAvailable();
+}
+
+void CameraFrameSource::setActive(bool active)
+{
+    captureTask.setEnabled(active);
+}
+
+bool CameraFrameSource::acquire(CapturedFrame &frame)
+{
+    if (captureTask.acquireLatest(frame))
+        return true;
+
+    // One inline frame at a time, like the ring's single reader
+    if (inlineHeld)
+        return false;
+
+    LOG_D(TAG, "Capturing image inline");
+    camera_fb_t *fb = camManager->getFrame(ESP32CamManager::PROFILE_AI);
+    if (!fb)
+        return false;
+
+    // Copied out so the driver gets its buffer back now, not after the
+    // upload: with one frame buffer (no PSRAM) the stream, /capture and
+    // /snapshot.jpg would wait on it meanwhile
+    if (inlineCapacity < fb->len)
+    {
+        size_t capacity = fb->len + fb->len / 4;
+        uint8_t *grown = (uint8_t *)(psramFound() ? ps_realloc(inlineData, capacity) : realloc(inlineData, capacity));
+        if (!grown)
+        {
+            LOG_E(TAG, "Memory allocation failed for inline frame");
+            camManager->releaseFrame(fb);
+            return false;
+        }
+        inlineData = grown;
+        inlineCapacity = capacity;
+    }
+    memcpy(inlineData, fb->buf, fb->len);
+    size_t len = fb->len;
+    int width = fb->width;
+    int height = fb->height;
+    camManager->releaseFrame(fb);
+
+    frame.slot = -1;
+    frame.data = inlineData;
+    frame.len = len;
+    frame.timestampMs = millis();
+    frame.seq = 0;
+    frame.hasSignature = camManager->computeSceneSignature(inlineData, len, width, height, frame.signature);
+    inlineHeld = true;
+    return true;
+}
+
+void CameraFrameSource::release(const CapturedFrame &frame)
+{
+    if (frame.slot >= 0)
+    {
+        captureTask.release(frame);
+    }
+    else
+    {
+        inlineHeld = false;
+    }
+}
@@ -0,0 +1,266 @@
+#ifndef ARDUINO
+
+#include "hal_native.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t monotonicUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Both count from the first call, like millis() from boot
+static const uint64_t startUs = monotonicUs();
+
+uint32_t hostMillis()
+{
+    return (uint32_t)((monotonicUs() - startUs) / 1000);
+}
+
+uint32_t hostMicros()
+{
+    return (uint32_t)(monotonicUs() - startUs);
+}
+
+uint32_t HostClock::millis()
+{
+    return hostMillis();
+}
+
+uint32_t HostClock::micros()
+{
+    return hostMicros();
+}
+
+void HostClock::delay(uint32_t ms)
+{
+    usleep((useconds_t)ms * 1000);
+}
+
+HostLink::HostLink() : connected(true)
+{
+}
+
+bool HostLink::isConnected()
+{
+    return connected;
+}
+
+void HostLink::setConnected(bool value)
+{
+    connected = value;
+}
+
+FileStorage::FileStorage(const char *path, size_t size) : path(path), bytes(size, 0xFF)
+{
+}
+
+bool FileStorage::begin()
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return true; // Erased until the first commit
+    fread(bytes.data(), 1, bytes.size(), f);
+    fclose(f);
+    return true;
+}
+
+size_t FileStorage::size()
+{
+    return bytes.size();
+}
+
+uint8_t FileStorage::read(size_t addr)
+{
+    return addr < bytes.size() ? bytes[addr] : 0xFF;
+}
+
+void FileStorage::write(size_t addr, uint8_t value)
+{
+    if (addr < bytes.size())
+        bytes[addr] = value;
+}
+
+void FileStorage::readBlock(size_t addr, void *data, size_t len)
+{
+    // Past the end reads as erased, like read()
+    size_t inside = addr < bytes.size() ? bytes.size() - addr : 0;
+    if (inside > len)
+        inside = len;
+    if (inside > 0)
+        memcpy(data, bytes.data() + addr, inside);
+    memset((uint8_t *)data + inside, 0xFF, len - inside);
+}
+
+void FileStorage::writeBlock(size_t addr, const void *data, size_t len)
+{
+    if (addr >= bytes.size())
+        return;
+    if (len > bytes.size() - addr)
+        len = bytes.size() - addr;
+    memcpy(bytes.data() + addr, data, len);
+}
+
+bool FileStorage::commit()
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    return fclose(f) == 0 && ok;
+}
+
+ConsoleServo::ConsoleServo() : angle(-1), attached(false), writes(0)
+{
+}
+
+void ConsoleServo::attach()
+{
+    attached = true;
+}
+
+void ConsoleServo::write(int value)
+{
+    if (!attached)
+        printf("servo: write %d while detached\n", value);
+    angle = value;
+    writes++;
+    printf("servo: -> %d\n", value);
+}
+
+void ConsoleServo::detach()
+{
+    attached = false;
+}
+
+int ConsoleServo::getAngle() const
+{
+    return angle;
+}
+
+bool ConsoleServo::isAttached() const
+{
+    return attached;
+}
+
+uint32_t ConsoleServo::getWrites() const
+{
+    return writes;
+}
+
+JpegFileFrameSource::JpegFileFrameSource() : next(0), seq(0), held(false)
+{
+}
+
+bool JpegFileFrameSource::addFile(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    fclose(f);
+    if (data.empty())
+        return false;
+    files.push_back(data);
+    return true;
+}
+
+size_t JpegFileFrameSource::getFileCount() const
+{
+    return files.size();
+}
+
+bool JpegFileFrameSource::isAvailable()
+{
+    return !files.empty();
+}
+
+void JpegFileFrameSource::setActive(bool)
+{
+}
+
+bool JpegFileFrameSource::acquire(CapturedFrame &frame)
+{
+    // One frame out at a time, like the capture ring's single reader
+    if (files.empty() || held)
+        return false;
+
+    const std::vector<uint8_t> &file = files[next];
+    next = (next + 1) % files.size();
+    frame.slot = 0;
+    frame.data = file.data();
+    frame.len = file.size();
+    frame.timestampMs = hostMillis();
+    frame.seq = ++seq;
+    frame.signature = 0;
+    frame.hasSignature = false; // No decoder on the host, so no scene gate
+    held = true;
+    return true;
+}
+
+void JpegFileFrameSource::release(const CapturedFrame &)
+{
+    held = false;
+}
+
+FramebufferPanel::FramebufferPanel() : runs(0), bytes(0)
+{
+    memset(memory, 0, sizeof(memory));
+}
+
+bool FramebufferPanel::writeRun(int page, int column, const uint8_t *data, size_t len)
+{
+    if (page < 0 || page >= PageDiffRenderer::PAGES || column < 0 || column + len > PageDiffRenderer::WIDTH)
+    {
+        printf("panel: run page %d columns %d+%u out of range\n", page, column, (unsigned)len);
+        return false;
+    }
+    memcpy(memory + page * PageDiffRenderer::WIDTH + column, data, len);
+    runs++;
+    bytes += len;
+    return true;
+}
+
+const uint8_t *FramebufferPanel::getMemory() const
+{
+    return memory;
+}
+
+uint32_t FramebufferPanel::getRuns() const
+{
+    return runs;
+}
+
+uint32_t FramebufferPanel::getBytes() const
+{
+    return bytes;
+}
+
+bool FramebufferPanel::dump(const char *path) const
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    int height = PageDiffRenderer::PAGES * 8;
+    fprintf(f, "P1\n%d %d\n", PageDiffRenderer::WIDTH, height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < PageDiffRenderer::WIDTH; x++)
+        {
+            uint8_t column = memory[(y / 8) * PageDiffRenderer::WIDTH + x];
+            fputc(column & (1 << (y & 7)) ? '1' : '0', f);
+        }
+        fputc('\n', f);
+    }
+    return fclose(f) == 0;
+}
+
+#endif // ARDUINO
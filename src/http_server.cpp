@@ -0,0 +1,474 @@
+#include "http_server.h"
+#include "metrics.h"
+#include "socket_io.h"
+
+// Time allowed for a new connection to deliver its request headers
+#define HTTP_HEADER_TIMEOUT_MS 5000
+// Idle time before a keep-alive connection is closed
+#define HTTP_KEEPALIVE_TIMEOUT_MS 15000
+// Time a response may make no progress before the connection is dropped
+#define HTTP_WRITE_STALL_MS 10000
+#define HTTP_MAX_REQUESTS_PER_CONNECTION 100
+// Bytes written to one connection per loop() call, so others get a turn
+#define HTTP_WRITE_SLICE 8192
+
+static bool deadlinePassed(uint32_t now, uint32_t deadline)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+static const char *statusText(int status)
+{
+    switch (status)
+    {
+    case 200:
+        return "OK";
+    case 304:
+        return "Not Modified";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 408:
+        return "Request Timeout";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "";
+    }
+}
+
+HttpResponse::HttpResponse()
+    : status(200), contentType(nullptr), buffer(nullptr), bufferLen(0), bodyCheck(nullptr), bodyTag(0),
+      detached(false), forceClose(false)
+{
+}
+
+void HttpResponse::send(int code, const char *type, const String &content)
+{
+    status = code;
+    contentType = type;
+    body = content;
+    buffer = nullptr;
+    bufferLen = 0;
+}
+
+void HttpResponse::sendBuffer(int code, const char *type, const uint8_t *data, size_t len, BodyCheck check, uint32_t tag)
+{
+    status = code;
+    contentType = type;
+    body = String();
+    buffer = data;
+    bufferLen = len;
+    bodyCheck = check;
+    bodyTag = tag;
+}
+
+void HttpResponse::addHeader(const char *name, const String &value)
+{
+    headers += name;
+    headers += ": ";
+    headers += value;
+    headers += "\r\n";
+}
+
+void HttpResponse::detach()
+{
+    detached = true;
+}
+
+void HttpResponse::closeAfterSend()
+{
+    forceClose = true;
+}
+
+HttpServer::HttpServer()
+    : server(nullptr), routes(nullptr), routeCount(0), notFoundHandler(nullptr), beforeHook(nullptr), afterHook(nullptr), requestCount(0)
+{
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        conns[i].state = CONN_FREE;
+        conns[i].len = 0;
+    }
+}
+
+void HttpServer::begin(WiFiServer *srv)
+{
+    server = srv;
+}
+
+void HttpServer::setRoutes(const Route *table, size_t count)
+{
+    routes = table;
+    routeCount = count;
+}
+
+void HttpServer::onNotFound(Handler handler)
+{
+    notFoundHandler = handler;
+}
+
+void HttpServer::setRequestHooks(Hook before, Hook after)
+{
+    beforeHook = before;
+    afterHook = after;
+}
+
+int HttpServer::getConnectionCount()
+{
+    int count = 0;
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        if (conns[i].state != CONN_FREE)
+            count++;
+    }
+    return count;
+}
+
+uint32_t HttpServer::getRequestCount()
+{
+    return requestCount;
+}
+
+void HttpServer::loop()
+{
+    if (!server)
+        return;
+
+    uint32_t now = millis();
+    accept(now);
+
+    for (int i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        Connection &c = conns[i];
+        if (c.state == CONN_READING)
+            pollRead(c, now);
+        else if (c.state == CONN_WRITING)
+            pollWrite(c, now);
+    }
+}
+
+void HttpServer::accept(uint32_t now)
+{
+    while (true)
+    {
+        // Prefer a free slot; otherwise make room by evicting an idle
+        // keep-alive connection, but only if someone is actually waiting
+        Connection *slot = nullptr;
+        Connection *idle = nullptr;
+        for (int i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            Connection &c = conns[i];
+            if (c.state == CONN_FREE)
+            {
+                slot = &c;
+                break;
+            }
+            if (c.state == CONN_READING && c.len == 0 && c.requests > 0 && !idle)
+                idle = &c;
+        }
+        if (!slot && !idle)
+            return;
+
+        WiFiClient client = server->available();
+        if (!client)
+            return;
+
+        if (!slot)
+        {
+            close(*idle);
+            slot = idle;
+        }
+
+        client.setNoDelay(true);
+        slot->client = client;
+        slot->state = CONN_READING;
+        slot->len = 0;
+        slot->requests = 0;
+        slot->keepAlive = false;
+        slot->deadline = now + HTTP_HEADER_TIMEOUT_MS;
+    }
+}
+
+void HttpServer::pollRead(Connection &c, uint32_t now)
+{
+    int avail = c.client.available();
+    if (avail > 0 && c.len < RECV_BUFFER_SIZE)
+    {
+        size_t room = RECV_BUFFER_SIZE - c.len;
+        int n = c.client.read((uint8_t *)c.buf + c.len, (size_t)avail < room ? avail : room);
+        if (n > 0)
+        {
+            c.len += n;
+            // A request has started: it gets the full header timeout
+            if (c.len == (size_t)n)
+                c.deadline = now + HTTP_HEADER_TIMEOUT_MS;
+        }
+    }
+    c.buf[c.len] = '\0';
+
+    char *end = strstr(c.buf, "\r\n\r\n");
+    if (end)
+    {
+        HttpRequest req;
+        size_t headerEnd = (end - c.buf) + 4;
+        if (parseRequest(c, headerEnd, req))
+        {
+            dispatch(c, req, headerEnd, now);
+        }
+        else
+        {
+            c.len = 0;
+            sendSimple(c, 400, "Bad request", now);
+        }
+        return;
+    }
+
+    if (c.len == RECV_BUFFER_SIZE)
+    {
+        sendSimple(c, 431, "Request headers too large", now);
+        return;
+    }
+
+    if (!c.client.connected() && c.client.available() == 0)
+    {
+        close(c);
+        return;
+    }
+
+    if (deadlinePassed(now, c.deadline))
+    {
+        // Idle keep-alive connections just go away; partial requests get 408
+        if (c.len == 0)
+            close(c);
+        else
+            sendSimple(c, 408, "Request timeout", now);
+    }
+}
+
+// Split the header block in place: request line, then the headers we use
+bool HttpServer::parseRequest(Connection &c, size_t headerEnd, HttpRequest &req)
+{
+    char *p = c.buf;
+    c.buf[headerEnd - 2] = '\0'; // Terminate the last header line
+
+    char *lineEnd = strstr(p, "\r\n");
+    if (!lineEnd)
+        return false;
+    *lineEnd = '\0';
+
+    char *target = strchr(p, ' ');
+    if (!target)
+        return false;
+    *target++ = '\0';
+    char *version = strchr(target, ' ');
+    if (!version)
+        return false;
+    *version++ = '\0';
+
+    req.method = p;
+    req.path = target;
+    req.query = "";
+    char *q = strchr(target, '?');
+    if (q)
+    {
+        *q = '\0';
+        req.query = q + 1;
+    }
+    req.ifNoneMatch = "";
+    req.keepAlive = strcmp(version, "HTTP/1.1") == 0;
+    req.requestIndex = c.requests + 1;
+    req.client = &c.client;
+
+    char *line = lineEnd + 2;
+    while (*line)
+    {
+        char *next = strstr(line, "\r\n");
+        if (next)
+            *next = '\0';
+
+        char *value = strchr(line, ':');
+        if (value)
+        {
+            *value++ = '\0';
+            while (*value == ' ')
+                value++;
+
+            if (strcasecmp(line, "Connection") == 0)
+            {
+                if (strcasestr(value, "close"))
+                    req.keepAlive = false;
+                else if (strcasestr(value, "keep-alive"))
+                    req.keepAlive = true;
+            }
+            else if (strcasecmp(line, "If-None-Match") == 0)
+            {
+                req.ifNoneMatch = value;
+            }
+            else if (strcasecmp(line, "Content-Length") == 0 && atoi(value) > 0)
+            {
+                // Request bodies are not read; don't mistake one for the next request
+                req.keepAlive = false;
+            }
+        }
+
+        if (!next)
+            break;
+        line = next + 2;
+    }
+
+    return true;
+}
+
+void HttpServer::dispatch(Connection &c, HttpRequest &req, size_t headerEnd, uint32_t now)
+{
+    requestCount++;
+    c.requests++;
+    c.res = HttpResponse();
+
+    if (beforeHook)
+        beforeHook(req);
+
+    Handler handler = nullptr;
+    RouteMatch match = findRoute(routes, routeCount, req.method, req.path, handler);
+
+    if (match == ROUTE_FOUND)
+    {
+        MetricsProbe probe(Metrics::STAGE_HTTP);
+        handler(req, c.res);
+    }
+    else if (match == ROUTE_NO_METHOD)
+        c.res.send(405, "text/plain", "Method not allowed");
+    else if (notFoundHandler)
+        notFoundHandler(req, c.res);
+    else
+        c.res.send(404, "text/plain", "Not found");
+
+    if (afterHook)
+        afterHook(req);
+
+    bool keepAlive = req.keepAlive && !c.res.forceClose && c.requests < HTTP_MAX_REQUESTS_PER_CONNECTION;
+
+    // The request strings are no longer needed; keep any pipelined bytes
+    memmove(c.buf, c.buf + headerEnd, c.len - headerEnd);
+    c.len -= headerEnd;
+
+    if (c.res.detached)
+    {
+        c.client = WiFiClient();
+        c.res = HttpResponse();
+        c.state = CONN_FREE;
+        c.len = 0;
+        return;
+    }
+
+    c.keepAlive = keepAlive;
+    startWrite(c, now);
+}
+
+void HttpServer::sendSimple(Connection &c, int status, const char *message, uint32_t now)
+{
+    c.res = HttpResponse();
+    c.res.send(status, "text/plain", message);
+    c.keepAlive = false;
+    startWrite(c, now);
+}
+
+void HttpServer::startWrite(Connection &c, uint32_t now)
+{
+    size_t bodyLen = c.res.buffer ? c.res.bufferLen : c.res.body.length();
+
+    c.head = "HTTP/1.1 " + String(c.res.status) + " " + statusText(c.res.status) + "\r\n";
+    if (c.res.contentType)
+    {
+        c.head += "Content-Type: ";
+        c.head += c.res.contentType;
+        c.head += "\r\n";
+    }
+    c.head += "Content-Length: " + String(bodyLen) + "\r\n";
+    c.head += c.res.headers;
+    c.head += c.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+    c.offset = 0;
+    c.state = CONN_WRITING;
+    c.deadline = now + HTTP_WRITE_STALL_MS;
+}
+
+void HttpServer::pollWrite(Connection &c, uint32_t now)
+{
+    size_t headLen = c.head.length();
+    const uint8_t *body = c.res.buffer ? c.res.buffer : (const uint8_t *)c.res.body.c_str();
+    size_t bodyLen = c.res.buffer ? c.res.bufferLen : c.res.body.length();
+    size_t total = headLen + bodyLen;
+    size_t budget = HTTP_WRITE_SLICE;
+
+    while (c.offset < total && budget > 0)
+    {
+        const uint8_t *src;
+        size_t avail;
+        if (c.offset < headLen)
+        {
+            src = (const uint8_t *)c.head.c_str() + c.offset;
+            avail = headLen - c.offset;
+        }
+        else
+        {
+            // Caller's buffer changed underneath us: the response is garbage now
+            if (c.res.bodyCheck && !c.res.bodyCheck(c.res.bodyTag))
+            {
+                close(c);
+                return;
+            }
+            src = body + (c.offset - headLen);
+            avail = total - c.offset;
+        }
+        if (avail > budget)
+            avail = budget;
+
+        int written = socketWriteSome(c.client, src, avail);
+        if (written < 0)
+        {
+            close(c);
+            return;
+        }
+        if (written == 0)
+            break;
+
+        c.offset += written;
+        budget -= written;
+        c.deadline = now + HTTP_WRITE_STALL_MS;
+    }
+
+    if (c.offset == total)
+    {
+        c.head = String();
+        c.res = HttpResponse();
+        if (c.keepAlive)
+        {
+            c.state = CONN_READING;
+            c.deadline = now + HTTP_KEEPALIVE_TIMEOUT_MS;
+        }
+        else
+        {
+            close(c);
+        }
+        return;
+    }
+
+    if (deadlinePassed(now, c.deadline))
+        close(c);
+}
+
+void HttpServer::close(Connection &c)
+{
+    c.client.stop();
+    c.client = WiFiClient();
+    c.head = String();
+    c.res = HttpResponse();
+    c.len = 0;
+    c.state = CONN_FREE;
+}
@@ -0,0 +1,127 @@
+#include "latency_histogram.h"
+
+#include <string.h>
+
+LatencyHistogram::LatencyHistogram()
+    : current(0), windowStartMs(0), started(false), totalCount(0), totalSumUs(0)
+{
+    memset(counts, 0, sizeof(counts));
+    memset(windowCount, 0, sizeof(windowCount));
+    memset(windowMax, 0, sizeof(windowMax));
+}
+
+int LatencyHistogram::bucketOf(uint32_t us)
+{
+    if (us < 8)
+        return us;
+    int exponent = 31 - __builtin_clz(us); // 3..31
+    if (exponent > 26)
+        return BUCKETS - 1;
+    int sub = (us >> (exponent - 2)) & 3;
+    return 8 + (exponent - 3) * 4 + sub;
+}
+
+uint32_t LatencyHistogram::bucketUpper(int bucket)
+{
+    if (bucket < 8)
+        return bucket;
+    int exponent = (bucket - 8) / 4 + 3;
+    int sub = (bucket - 8) % 4;
+    return ((uint32_t)(4 + sub + 1) << (exponent - 2)) - 1;
+}
+
+// Starts a new window once the current one is WINDOW_MS old. After a long
+// quiet spell both windows are stale and are cleared.
+void LatencyHistogram::rotate(uint32_t nowMs)
+{
+    if (!started)
+    {
+        started = true;
+        windowStartMs = nowMs;
+        return;
+    }
+
+    uint32_t age = nowMs - windowStartMs;
+    if (age < WINDOW_MS)
+        return;
+
+    int previous = 1 - current;
+    if (age >= 2 * WINDOW_MS)
+    {
+        memset(counts[current], 0, sizeof(counts[current]));
+        windowCount[current] = 0;
+        windowMax[current] = 0;
+    }
+    memset(counts[previous], 0, sizeof(counts[previous]));
+    windowCount[previous] = 0;
+    windowMax[previous] = 0;
+    current = previous;
+    windowStartMs = nowMs;
+}
+
+void LatencyHistogram::record(uint32_t us, uint32_t nowMs)
+{
+    rotate(nowMs);
+
+    uint16_t &count = counts[current][bucketOf(us)];
+    if (count < 0xFFFF)
+        count++;
+    windowCount[current]++;
+    if (us > windowMax[current])
+        windowMax[current] = us;
+
+    totalCount++;
+    totalSumUs += us;
+}
+
+uint32_t LatencyHistogram::quantile(float q, uint32_t nowMs)
+{
+    rotate(nowMs);
+
+    uint32_t total = 0;
+    for (int b = 0; b < BUCKETS; b++)
+        total += counts[0][b] + counts[1][b];
+    if (total == 0)
+        return 0;
+
+    // Rank of the sample at q, 1-based
+    uint32_t rank = (uint32_t)(q * total + 0.5f);
+    if (rank < 1)
+        rank = 1;
+
+    uint32_t seen = 0;
+    for (int b = 0; b < BUCKETS; b++)
+    {
+        seen += counts[0][b] + counts[1][b];
+        if (seen >= rank)
+        {
+            // The top bucket's bound would overstate the slowest sample
+            uint32_t max = getWindowMax(nowMs);
+            uint32_t upper = bucketUpper(b);
+            return upper < max ? upper : max;
+        }
+    }
+    return getWindowMax(nowMs);
+}
+
+uint32_t LatencyHistogram::getWindowCount(uint32_t nowMs)
+{
+    rotate(nowMs);
+    return windowCount[0] + windowCount[1];
+}
+
+uint32_t LatencyHistogram::getWindowMax(uint32_t nowMs)
+{
+    rotate(nowMs);
+    return windowMax[0] > windowMax[1] ? windowMax[0] : windowMax[1];
+}
+
+uint32_t LatencyHistogram::getTotalCount() const
+{
+    return totalCount;
+}
+
+uint64_t LatencyHistogram::getTotalSumUs() const
+{
+    return totalSumUs;
+}
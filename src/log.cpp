@@ -0,0 +1,205 @@
+#include "log.h"
+#include "log_ring.h"
+
+static uint8_t ringStorage[Log::RING_SIZE];
+static LogRing ring(ringStorage, sizeof(ringStorage));
+static portMUX_TYPE logLock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t drainTask = nullptr;
+
+static volatile int globalLevel = LOG_LEVEL_INFO;
+static volatile uint32_t truncatedLines = 0;
+static uint32_t droppedReported = 0; // Dropped lines already reported by the drain task
+
+struct TagLevel
+{
+    char tag[Log::TAG_MAX];
+    int level;
+};
+static TagLevel tagLevels[Log::MAX_TAG_LEVELS];
+static volatile int tagLevelCount = 0;
+
+static const char *LEVEL_NAMES[] = {"none", "error", "warn", "info", "debug", "verbose"};
+static const char LEVEL_LETTERS[] = "-EWIDV";
+
+bool Log::begin(BaseType_t core)
+{
+    if (drainTask)
+        return true;
+
+    BaseType_t ok = xTaskCreatePinnedToCore(taskEntry, "log_drain", 3072, nullptr, 1, &drainTask, core);
+    if (ok != pdPASS)
+    {
+        drainTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void Log::setLevel(int level)
+{
+    globalLevel = constrain(level, LOG_LEVEL_NONE, LOG_LEVEL_VERBOSE);
+}
+
+int Log::getLevel()
+{
+    return globalLevel;
+}
+
+void Log::setTagLevel(const char *tag, int level)
+{
+    portENTER_CRITICAL(&logLock);
+    int i = 0;
+    while (i < tagLevelCount && strncmp(tagLevels[i].tag, tag, TAG_MAX) != 0)
+        i++;
+
+    if (level < 0)
+    {
+        // Remove by moving the last override into its place
+        if (i < tagLevelCount)
+            tagLevels[i] = tagLevels[--tagLevelCount];
+    }
+    else if (i < tagLevelCount || tagLevelCount < MAX_TAG_LEVELS)
+    {
+        strncpy(tagLevels[i].tag, tag, TAG_MAX - 1);
+        tagLevels[i].tag[TAG_MAX - 1] = '\0';
+        tagLevels[i].level = constrain(level, LOG_LEVEL_NONE, LOG_LEVEL_VERBOSE);
+        if (i == tagLevelCount)
+            tagLevelCount++;
+    }
+    portEXIT_CRITICAL(&logLock);
+}
+
+int Log::getTagOverrideCount()
+{
+    return tagLevelCount;
+}
+
+const char *Log::getTagOverride(int index, int &level)
+{
+    if (index < 0 || index >= tagLevelCount)
+        return nullptr;
+    level = tagLevels[index].level;
+    return tagLevels[index].tag;
+}
+
+bool Log::enabled(int level, const char *tag)
+{
+    if (tagLevelCount == 0)
+        return level <= globalLevel;
+
+    int effective = globalLevel;
+    portENTER_CRITICAL(&logLock);
+    for (int i = 0; i < tagLevelCount; i++)
+    {
+        if (strncmp(tagLevels[i].tag, tag, TAG_MAX) == 0)
+        {
+            effective = tagLevels[i].level;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&logLock);
+    return level <= effective;
+}
+
+void Log::write(int level, const char *tag, const char *format, ...)
+{
+    // Room for the cut marker and the line ending after MAX_LINE
+    char line[MAX_LINE + 24];
+    uint32_t now = millis();
+    int n = snprintf(line, MAX_LINE, "[%6lu.%03lu] %c %s: ", (unsigned long)(now / 1000),
+                     (unsigned long)(now % 1000), LEVEL_LETTERS[constrain(level, 0, 5)], tag);
+    if (n < 0 || n >= (int)MAX_LINE)
+        n = MAX_LINE - 1;
+
+    va_list args;
+    va_start(args, format);
+    int body = vsnprintf(line + n, MAX_LINE - n, format, args);
+    va_end(args);
+    if (body < 0)
+        body = 0;
+
+    size_t len;
+    if ((size_t)(n + body) >= MAX_LINE)
+    {
+        // Long fields (payloads, responses) keep their head only
+        len = MAX_LINE - 1;
+        len += snprintf(line + len, sizeof(line) - len, "...(+%d)", n + body - (int)len);
+        truncatedLines++;
+    }
+    else
+    {
+        len = n + body;
+    }
+    line[len++] = '\r';
+    line[len++] = '\n';
+
+    emit(line, len);
+}
+
+void Log::emit(const char *line, size_t len)
+{
+    if (!drainTask)
+    {
+        Serial.write((const uint8_t *)line, len);
+        return;
+    }
+
+    portENTER_CRITICAL(&logLock);
+    ring.push(line, len);
+    portEXIT_CRITICAL(&logLock);
+    xTaskNotifyGive(drainTask);
+}
+
+void Log::taskEntry(void *arg)
+{
+    char line[MAX_LINE + 24];
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        while (true)
+        {
+            portENTER_CRITICAL(&logLock);
+            size_t len = ring.pop(line, sizeof(line));
+            uint32_t dropped = len == 0 ? ring.takeDropped() : 0;
+            droppedReported += dropped;
+            portEXIT_CRITICAL(&logLock);
+
+            if (dropped > 0)
+                Serial.printf("[log] %u lines dropped\r\n", (unsigned)dropped);
+            if (len == 0)
+                break;
+            Serial.write((const uint8_t *)line, len); // May wait on the UART; only this task does
+        }
+    }
+}
+
+uint32_t Log::getDropped()
+{
+    portENTER_CRITICAL(&logLock);
+    uint32_t dropped = droppedReported + ring.getDropped();
+    portEXIT_CRITICAL(&logLock);
+    return dropped;
+}
+
+uint32_t Log::getTruncated()
+{
+    return truncatedLines;
+}
+
+const char *Log::levelName(int level)
+{
+    if (level < LOG_LEVEL_NONE || level > LOG_LEVEL_VERBOSE)
+        return "?";
+    return LEVEL_NAMES[level];
+}
+
+int Log::parseLevel(const char *name)
+{
+    for (int i = LOG_LEVEL_NONE; i <= LOG_LEVEL_VERBOSE; i++)
+    {
+        if (strcmp(name, LEVEL_NAMES[i]) == 0)
+            return i;
+    }
+    return -1;
+}
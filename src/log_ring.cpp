@@ -0,0 +1,79 @@
+#include "log_ring.h"
+
+#include <string.h>
+
+LogRing::LogRing(uint8_t *storage, size_t capacity)
+    : storage(storage), capacity(capacity), head(0), tail(0), used(0), dropped(0)
+{
+}
+
+void LogRing::write(const uint8_t *data, size_t len)
+{
+    size_t first = capacity - head < len ? capacity - head : len;
+    memcpy(storage + head, data, first);
+    memcpy(storage, data + first, len - first);
+    head = (head + len) % capacity;
+    used += len;
+}
+
+void LogRing::read(uint8_t *data, size_t len)
+{
+    size_t first = capacity - tail < len ? capacity - tail : len;
+    if (data)
+    {
+        memcpy(data, storage + tail, first);
+        memcpy(data + first, storage, len - first);
+    }
+    tail = (tail + len) % capacity;
+    used -= len;
+}
+
+bool LogRing::push(const char *line, size_t len)
+{
+    if (len > 0xFFFF || len + 2 > capacity - used)
+    {
+        dropped++;
+        return false;
+    }
+
+    uint8_t header[2] = {(uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
+    write(header, 2);
+    write((const uint8_t *)line, len);
+    return true;
+}
+
+size_t LogRing::pop(char *out, size_t outSize)
+{
+    if (used == 0)
+        return 0;
+
+    uint8_t header[2];
+    read(header, 2);
+    size_t len = header[0] | ((size_t)header[1] << 8);
+    size_t n = len < outSize ? len : outSize;
+    read((uint8_t *)out, n);
+    read(nullptr, len - n); // Skip what did not fit
+    return n;
+}
+
+bool LogRing::isEmpty() const
+{
+    return used == 0;
+}
+
+size_t LogRing::getUsed() const
+{
+    return used;
+}
+
+uint32_t LogRing::getDropped() const
+{
+    return dropped;
+}
+
+uint32_t LogRing::takeDropped()
+{
+    uint32_t n = dropped;
+    dropped = 0;
+    return n;
+}
@@ -1,43 +1,70 @@
 #include <Adafruit_NeoPixel.h>
 #include <ArduinoJson.h>
-#include <EEPROM.h>
-#include <ESP32Servo.h>
 #include "oled_display.h"     // Include the OLED display helper
 #include "esp32cam_manager.h" // Include the ESP32-CAM manager
 #include "wifi_manager.h"     // Include the WiFi manager
 #include "ai_bot_manager.h"   // Include the AI Bot manager
+#include "stream_broadcaster.h" // MJPEG fan-out for /stream
+#include "http_server.h"        // Event-driven web server
+#include "query_string.h"       // Allocation-free query parsing
+#include "log.h"                // Leveled, non-blocking logging
+#include "metrics.h"            // Stage latencies for /metrics
+#include "hal_esp32.h"          // Board storage, servo and frame source
+#include "web_page.h"           // Control page, generated by scripts/embed_web.py
+#include "actuator_scheduler.h" // Timed LED jobs
+#include "servo_motion_task.h"  // Trajectory-driven servo moves
+#include "display_service.h"    // OLED drawn from its own task
+#include "config_store.h"       // Settings kept across restarts
 
 #define LED_PIN 48
 #define NUM_PIXELS 1
 #define SERVO_PIN 41
 
-// EEPROM settings (keeping for compatibility, but WiFi settings moved to WiFiManager)
-#define EEPROM_SIZE 512
+static const char *TAG = "main";
+static const char *HTTP_TAG = "http";
 
 Adafruit_NeoPixel pixels(NUM_PIXELS, LED_PIN, NEO_GRB + NEO_KHZ800);
 ESP32CamManager camManager;
 WiFiManager wifiManager;
 AIBotManager botManager;
-Servo testServo;
+StreamBroadcaster streamBroadcaster;
+HttpServer httpServer;
+EepromStorage storage;
+ConfigStore config;
+uint32_t configLoadUs = 0; // Storage and config loaded at boot
+CameraFrameSource cameraFrames;
+ArduinoClock boardClock;
+Esp32ServoOutput testServo(SERVO_PIN, 500, 2400);
+ServoMotionTask servoMotion;
+ActuatorScheduler actuators;
+DisplayService displayService;
+
+// One job at a time per channel; a new job replaces the running one
+enum ActuatorChannel
+{
+    ACT_LED
+};
+
+// How long action results stay on the OLED before the bot status returns
+#define MESSAGE_HOLD_MS 2000
 
 int servoCenter = 28;     // Default center
 int servoLeft = 10;       // Default left
 int servoRight = 50;      // Default right
 int currentServoPos = 28; // Track current position
 
-// EEPROM addresses for servo settings
-#define ADDR_SERVO_CENTER 500
-#define ADDR_SERVO_LEFT 504
-#define ADDR_SERVO_RIGHT 508
-
-// Servo movement functions
+// Servo movement functions. The motion task takes the servo there as fast
+// as the limits allow; a newer target replaces a move still under way.
 void servoMoveNext(int targetPos)
 {
-    testServo.attach(SERVO_PIN, 500, 2400);
-    testServo.write(targetPos);
     currentServoPos = targetPos;
-    delay(500);
-    testServo.detach();
+    servoMotion.moveTo(targetPos);
+}
+
+// On the motion task, once the servo has settled
+void onServoMoveDone(int angle, uint32_t elapsedUs)
+{
+    Metrics::record(Metrics::STAGE_ACTUATE, elapsedUs);
 }
 
 void servoMoveCenter()
@@ -55,72 +82,107 @@ void servoMoveRight()
     servoMoveNext(servoRight);
 }
 
-// Helper function to set color and delay
-void setPixelColor(uint8_t r, uint8_t g, uint8_t b, int delayMs = 0)
+void setPixelColor(uint8_t r, uint8_t g, uint8_t b)
 {
     pixels.setPixelColor(0, pixels.Color(r, g, b));
     pixels.show();
-    if (delayMs > 0)
+}
+
+// Solid color that shows the camera status
+void setStatusPixel()
+{
+    if (camManager.isCameraAvailable())
+    {
+        setPixelColor(0, 255, 0); // Green for camera available
+    }
+    else
     {
-        delay(delayMs);
+        setPixelColor(255, 100, 0); // Orange for no camera
     }
 }
 
-// Helper for URL decoding
-unsigned char h2int(char c)
+#define LED_STATUS -1 // LED step color: the camera status color
+
+// LED job step: a 0xRRGGBB color, or LED_STATUS
+void ledStep(void *context, int rgb)
 {
-    if (c >= '0' && c <= '9')
-        return ((unsigned char)c - '0');
-    if (c >= 'a' && c <= 'f')
-        return ((unsigned char)c - 'a' + 10);
-    if (c >= 'A' && c <= 'F')
-        return ((unsigned char)c - 'A' + 10);
-    return 0;
+    if (rgb == LED_STATUS)
+        setStatusPixel();
+    else
+        setPixelColor(rgb >> 16, (rgb >> 8) & 0xFF, rgb & 0xFF);
 }
 
-String urlDecode(String str)
+// Blinks the LED, then leaves it at finalRgb. The breathing effect waits
+// until the pattern is over.
+void flashPixel(int rgb, int times, uint32_t periodMs, int finalRgb)
 {
-    String decoded = "";
-    char c;
-    for (int i = 0; i < str.length(); i++)
+    ActuatorScheduler::Step steps[ActuatorScheduler::MAX_STEPS];
+    int count = 0;
+    for (int i = 0; i < times && count + 3 <= ActuatorScheduler::MAX_STEPS; i++)
     {
-        c = str.charAt(i);
-        if (c == '+')
-            decoded += ' ';
-        else if (c == '%')
-        {
-            i++;
-            char code0 = str.charAt(i);
-            i++;
-            char code1 = str.charAt(i);
-            decoded += (char)((h2int(code0) << 4) | h2int(code1));
-        }
-        else
-            decoded += c;
+        steps[count++] = {ledStep, rgb, periodMs};
+        steps[count++] = {ledStep, 0x000000, periodMs};
     }
-    return decoded;
+    steps[count++] = {ledStep, finalRgb, 0};
+    actuators.submit(ACT_LED, steps, count, nullptr, millis());
 }
 
-// Helper to extract query parameters
-String getQueryParam(String request, String paramName)
+// Frame sizes offered for camera profiles on the control page
+const framesize_t FRAME_SIZE_CHOICES[] = {FRAMESIZE_QVGA, FRAMESIZE_HVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA,
+                                          FRAMESIZE_XGA, FRAMESIZE_HD, FRAMESIZE_SXGA, FRAMESIZE_UXGA};
+
+bool isFrameSizeChoice(int size)
 {
-    int start = request.indexOf(paramName + "=");
-    if (start == -1)
-        return "";
-    start += paramName.length() + 1;
-    int endAmp = request.indexOf("&", start);
-    int endSpace = request.indexOf(" ", start);
-    int end = -1;
-    if (endAmp != -1 && endSpace != -1)
-        end = min(endAmp, endSpace);
-    else if (endAmp != -1)
-        end = endAmp;
-    else
-        end = endSpace;
+    for (size_t i = 0; i < sizeof(FRAME_SIZE_CHOICES) / sizeof(FRAME_SIZE_CHOICES[0]); i++)
+    {
+        if (FRAME_SIZE_CHOICES[i] == size)
+            return true;
+    }
+    return false;
+}
 
-    if (end == -1)
-        return "";
-    return request.substring(start, end);
+const char *frameSizeName(framesize_t size)
+{
+    switch (size)
+    {
+    case FRAMESIZE_QVGA:
+        return "QVGA";
+    case FRAMESIZE_HVGA:
+        return "HVGA";
+    case FRAMESIZE_VGA:
+        return "VGA";
+    case FRAMESIZE_SVGA:
+        return "SVGA";
+    case FRAMESIZE_XGA:
+        return "XGA";
+    case FRAMESIZE_HD:
+        return "HD";
+    case FRAMESIZE_SXGA:
+        return "SXGA";
+    case FRAMESIZE_UXGA:
+        return "UXGA";
+    default:
+        return "other";
+    }
+}
+
+String botDistanceText()
+{
+    return String(botManager.getLastDistance(), 1) + "m";
+}
+
+// Main UI layout with the given status; held statuses are transient
+void showMainStatus(const String &status, uint32_t holdMs = 0)
+{
+    displayService.showMain(wifiManager.getLocalIP(), status, botManager.getLastDirection(), botDistanceText(),
+                            holdMs);
+}
+
+// Helper to update OLED with Bot info. A transient message still showing
+// stays up; this is what comes back after it.
+void updateOledBotStatus()
+{
+    showMainStatus(botManager.getLastBotStatus());
 }
 
 // Camera status callback to handle status changes
@@ -128,34 +190,11 @@ void onCameraStatusChange(bool connected, bool statusChanged)
 {
     if (statusChanged)
     {
-        // Update display with status change using the main UI layout
-        drawMain(wifiManager.getLocalIP(),
-                 connected ? "Cam Connect" : "Cam Disconnect",
-                 botManager.getLastDirection(),
-                 String(botManager.getLastDistance(), 1) + "m");
-        delay(2000); // Show status for 2 seconds
+        // Show the change for 2 seconds, then the bot status again
+        showMainStatus(connected ? "Cam Connect" : "Cam Disconnect", MESSAGE_HOLD_MS);
 
-        // Flash LED to indicate status change
-        if (connected)
-        {
-            // Green flash for connected
-            for (int i = 0; i < 3; i++)
-            {
-                setPixelColor(0, 255, 0, 200);
-                setPixelColor(0, 0, 0, 200);
-            }
-            setPixelColor(0, 255, 0); // Return to green
-        }
-        else
-        {
-            // Red flash for disconnected
-            for (int i = 0; i < 3; i++)
-            {
-                setPixelColor(255, 0, 0, 200);
-                setPixelColor(0, 0, 0, 200);
-            }
-            setPixelColor(255, 100, 0); // Orange for no camera
-        }
+        // Green flashes for connected, red for disconnected
+        flashPixel(connected ? 0x00FF00 : 0xFF0000, 3, 200, LED_STATUS);
     }
 }
 
@@ -164,219 +203,697 @@ void onWiFiStatusChange(bool connected, String ip, int rssi)
 {
     if (connected)
     {
-        displayMultiLine("Wi-Fi connected!",
-                         "IP: " + ip,
-                         "RSSI: " + String(rssi) + " dBm",
-                         camManager.isCameraAvailable() ? "Camera: OK" : "Camera: FAIL");
+        displayService.showText("Wi-Fi connected!",
+                                "IP: " + ip,
+                                "RSSI: " + String(rssi) + " dBm",
+                                camManager.isCameraAvailable() ? "Camera: OK" : "Camera: FAIL",
+                                MESSAGE_HOLD_MS);
     }
 }
 
 // Display callback for WiFi manager
 void onWiFiDisplayUpdate(String line1, String line2, String line3, String line4)
 {
-    if (line2.isEmpty() && line3.isEmpty() && line4.isEmpty())
+    displayService.showText(line1, line2, line3, line4);
+}
+
+void onBotStatusChange(String status)
+{
+    updateOledBotStatus();
+}
+
+// Trigger servo based on direction, once per decision
+void onBotDecision(const String &direction, float distance, bool goalFound)
+{
+    if (strcasecmp(direction.c_str(), "left") == 0)
+    {
+        servoMoveLeft();
+    }
+    else if (strcasecmp(direction.c_str(), "right") == 0)
+    {
+        servoMoveRight();
+    }
+    else if (strcasecmp(direction.c_str(), "forward") == 0)
+    {
+        servoMoveCenter();
+    }
+}
+
+// Appends value as a JSON string literal
+void appendJsonString(String &out, const String &value)
+{
+    out += '"';
+    for (size_t i = 0; i < value.length(); i++)
     {
-        displayText(line1);
+        char c = value[i];
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if ((uint8_t)c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+const char *healthCheckName(AIBotManager::HealthCheck check)
+{
+    switch (check)
+    {
+    case AIBotManager::HEALTH_CHECKING:
+        return "checking";
+    case AIBotManager::HEALTH_PASSED:
+        return "passed";
+    case AIBotManager::HEALTH_FAILED:
+        return "failed";
+    default:
+        return "none";
+    }
+}
+
+// Everything the control page shows, polled by it from /api/status
+void writeStatusJson(String &out)
+{
+    out.reserve(1536);
+
+    out += "{\"camera\":" + String(camManager.isCameraAvailable() ? "true" : "false");
+    out += ",\"ssid\":";
+    appendJsonString(out, wifiManager.getSSID());
+    out += ",\"image_seq\":" + String(camManager.hasImage() ? camManager.getLastImageSeq() : 0);
+
+    out += ",\"bot\":{\"running\":" + String(botManager.isBotRunning() ? "true" : "false");
+    out += ",\"status\":";
+    appendJsonString(out, botManager.getLastBotStatus());
+    out += ",\"direction\":";
+    appendJsonString(out, botManager.getLastDirection());
+    out += ",\"distance\":" + String(botManager.getLastDistance(), 2);
+    out += ",\"frame_age_ms\":" + String(botManager.getLastFrameAge());
+    out += ",\"sent\":" + String(botManager.getRequestsSent());
+    out += ",\"skipped\":" + String(botManager.getRequestsSkipped());
+    out += ",\"decisions_per_min\":" + String(botManager.getDecisionsPerMinute());
+    out += ",\"avg_staleness_ms\":" + String(botManager.getAverageStaleness());
+    out += ",\"avg_latency_ms\":" + String(botManager.getAverageLatency());
+    out += ",\"next_in_ms\":" + String(botManager.getNextRequestIn());
+    out += ",\"scene_threshold\":" + String(botManager.getSceneChangeThreshold());
+    out += ",\"cadence_min\":" + String(botManager.getCadenceMin());
+    out += ",\"cadence_max\":" + String(botManager.getCadenceMax());
+    out += ",\"context_cached\":" + String(botManager.isContextCached() ? "true" : "false");
+    out += ",\"context_resends\":" + String(botManager.getContextResends());
+    BotRequestTiming timing = botManager.getLastRequestTiming();
+    out += ",\"timing\":{\"connect_ms\":" + String(timing.connectMs);
+    out += ",\"reused\":" + String(timing.reused ? "true" : "false");
+    out += ",\"upload_ms\":" + String(timing.uploadMs);
+    out += ",\"wait_ms\":" + String(timing.waitMs);
+    out += ",\"download_ms\":" + String(timing.downloadMs);
+    out += ",\"connections\":" + String(timing.connectionsOpened);
+    out += ",\"direction_ms\":" + String(timing.directionMs);
+    out += ",\"total_ms\":" + String(timing.totalMs) + "}}";
+
+    out += ",\"servo\":{\"position\":" + String(currentServoPos);
+    out += ",\"moving\":" + String(servoMotion.isMoving() ? "true" : "false");
+    out += ",\"left\":" + String(servoLeft);
+    out += ",\"center\":" + String(servoCenter);
+    out += ",\"right\":" + String(servoRight) + "}";
+
+    bool multipart = botManager.getUploadMode() == AIBotManager::UPLOAD_MULTIPART;
+    out += ",\"api\":{\"url\":";
+    appendJsonString(out, botManager.getApiBaseUrl());
+    out += ",\"msg_route\":";
+    appendJsonString(out, botManager.getApiMessageRoute());
+    out += ",\"health_route\":";
+    appendJsonString(out, botManager.getApiHealthRoute());
+    out += String(",\"upload_mode\":\"") + (multipart ? "multipart" : "json") + "\"";
+    out += String(",\"response_mode\":\"") + (botManager.isStreamingResponses() ? "stream" : "whole") + "\"";
+    out += String(",\"health\":\"") + healthCheckName(botManager.getHealthCheck()) + "\"";
+    out += ",\"health_code\":" + String(botManager.getHealthStatusCode()) + "}";
+
+    out += ",\"viewers\":[";
+    bool first = true;
+    for (int i = 0; i < StreamBroadcaster::MAX_CLIENTS; i++)
+    {
+        StreamClientStats stats = streamBroadcaster.getClientStats(i);
+        if (!stats.active)
+            continue;
+        if (!first)
+            out += ",";
+        first = false;
+        out += "{\"ip\":\"" + stats.remoteIP + "\"";
+        out += ",\"fps\":" + String(stats.fps, 1);
+        out += ",\"sent\":" + String(stats.framesSent);
+        out += ",\"dropped\":" + String(stats.framesDropped) + "}";
+    }
+
+    out += "],\"profiles\":[";
+    for (int i = 0; i < ESP32CamManager::PROFILE_COUNT; i++)
+    {
+        ESP32CamManager::ProfileId id = (ESP32CamManager::ProfileId)i;
+        const CameraProfile &profile = camManager.getProfile(id);
+        CameraProfileStats stats = camManager.getProfileStats(id);
+        uint32_t n = stats.captures > 0 ? stats.captures : 1;
+        if (i > 0)
+            out += ",";
+        out += String("{\"name\":\"") + profile.name + "\"";
+        out += String(",\"size\":\"") + frameSizeName(profile.frameSize) + "\"";
+        out += ",\"quality\":" + String(profile.jpegQuality);
+        out += ",\"captures\":" + String(stats.captures);
+        out += ",\"avg_ms\":" + String((float)stats.totalLatencyUs / n / 1000.0, 1);
+        out += ",\"max_ms\":" + String(stats.maxLatencyUs / 1000.0, 1);
+        out += ",\"avg_kb\":" + String((float)stats.totalBytes / n / 1024.0, 1) + "}";
+    }
+
+    out += "],\"frame_sizes\":[";
+    for (size_t i = 0; i < sizeof(FRAME_SIZE_CHOICES) / sizeof(FRAME_SIZE_CHOICES[0]); i++)
+    {
+        if (i > 0)
+            out += ",";
+        out += "[" + String((int)FRAME_SIZE_CHOICES[i]) + ",\"" + frameSizeName(FRAME_SIZE_CHOICES[i]) + "\"]";
+    }
+
+    String overrides;
+    for (int i = 0; i < Log::getTagOverrideCount(); i++)
+    {
+        int level;
+        const char *tag = Log::getTagOverride(i, level);
+        if (tag)
+            overrides += String(overrides.length() ? " " : "") + tag + "=" + Log::levelName(level);
+    }
+    out += String("],\"log\":{\"level\":\"") + Log::levelName(Log::getLevel()) + "\"";
+    out += ",\"overrides\":";
+    appendJsonString(out, overrides);
+    out += ",\"dropped\":" + String(Log::getDropped());
+    out += ",\"truncated\":" + String(Log::getTruncated()) + "}";
+
+    OledStats oled = getOledStats();
+    out += ",\"oled\":{\"bus_hz\":" + String(oled.busHz);
+    out += ",\"frames\":" + String(oled.frames);
+    out += ",\"unchanged\":" + String(oled.unchanged);
+    out += ",\"bytes\":" + String(oled.busBytes);
+    out += ",\"failures\":" + String(oled.failures);
+    out += ",\"busy_ms\":" + String((uint32_t)(oled.busyUs / 1000));
+    DisplayServiceStats screens = displayService.getStats();
+    out += ",\"updates\":" + String(screens.updates);
+    out += ",\"drawn\":" + String(screens.frames);
+    out += ",\"dropped\":" + String(screens.dropped) + "}";
+
+    const ConfigStore::Stats &configStats = config.getStats();
+    out += String(",\"config\":{\"source\":\"") + ConfigStore::sourceName(configStats.source) + "\"";
+    out += ",\"slot\":" + String(configStats.slot);
+    out += ",\"sequence\":" + String(configStats.sequence);
+    out += ",\"load_us\":" + String(configLoadUs);
+    out += ",\"saves\":" + String(configStats.saves);
+    out += ",\"unchanged\":" + String(configStats.unchanged);
+    out += ",\"commits\":" + String(configStats.commits);
+    out += ",\"bytes_written\":" + String(configStats.bytesWritten) + "}}";
+}
+
+// Result of a control action, shown by the page in its message line
+void sendMessage(HttpResponse &res, const String &message)
+{
+    res.send(200, "text/plain", message);
+}
+
+// Web request handlers, registered with httpServer in setup()
+// Static page from flash, gzipped at build time (scripts/embed_web.py).
+// Every browser accepts gzip, so there is no uncompressed copy.
+void handleRoot(HttpRequest &req, HttpResponse &res)
+{
+    if (strcmp(req.ifNoneMatch, WEB_PAGE_ETAG) == 0)
+    {
+        res.send(304, nullptr, "");
     }
     else
     {
-        displayMultiLine(line1, line2, line3, line4);
+        res.sendBuffer(200, "text/html", WEB_PAGE_GZ, WEB_PAGE_GZ_LEN);
+        res.addHeader("Content-Encoding", "gzip");
     }
+    // Revalidated on every load; unchanged until the next firmware
+    res.addHeader("ETag", WEB_PAGE_ETAG);
+    res.addHeader("Cache-Control", "no-cache");
 }
 
-// Helper to update OLED with Bot info
-void updateOledBotStatus()
+void handleApiStatus(HttpRequest &req, HttpResponse &res)
 {
-    String ip = wifiManager.getLocalIP();
-    String status = botManager.getLastBotStatus();
-    String direction = botManager.getLastDirection();
-    String distance = String(botManager.getLastDistance(), 1) + "m";
+    String body;
+    writeStatusJson(body);
+    res.send(200, "application/json", body);
+    res.addHeader("Cache-Control", "no-store");
+}
+
+void handleLedOn(HttpRequest &req, HttpResponse &res)
+{
+    LOG_I(TAG, "Button pressed: turning LED on");
+    setPixelColor(255, 0, 0); // Solid Red
+
+    // Update OLED display
+    showMainStatus("LED ON", MESSAGE_HOLD_MS);
 
-    drawMain(ip, status, direction, distance);
+    sendMessage(res, "LED turned ON");
 }
 
-void onBotStatusChange(String status)
+unsigned long restartAt = 0; // Set by /clearwifi, handled in loop()
+
+void handleClearWifi(HttpRequest &req, HttpResponse &res)
 {
-    updateOledBotStatus();
+    LOG_I(TAG, "Clearing WiFi credentials and restarting");
+    res.send(200, "text/html", "<!DOCTYPE html><html><body><h1>WiFi Credentials Cleared</h1><p>Device will restart in 3 seconds...</p><script>setTimeout(function(){window.close();}, 3000);</script></body></html>");
+    res.closeAfterSend();
+
+    // Give the response time to go out before restarting
+    restartAt = millis() + 1000;
+}
+
+bool snapshotUnchanged(uint32_t seq)
+{
+    return camManager.getLastImageSeq() == seq;
+}
 
-    // Trigger servo based on direction
-    String direction = botManager.getLastDirection();
-    direction.toLowerCase();
+void handleSnapshot(HttpRequest &req, HttpResponse &res)
+{
+    size_t len = 0;
+    const uint8_t *jpeg = camManager.getLastImage(len);
+    uint32_t seq = camManager.getLastImageSeq();
+    String etag = "\"" + String(seq) + "\"";
 
-    if (direction == "left")
+    if (len == 0)
     {
-        servoMoveLeft();
+        res.send(404, "text/plain", "No snapshot yet");
     }
-    else if (direction == "right")
+    else if (etag == req.ifNoneMatch)
     {
-        servoMoveRight();
+        res.send(304, nullptr, "");
+        res.addHeader("ETag", etag);
     }
-    else if (direction == "forward")
+    else
     {
-        servoMoveCenter();
+        // Straight from the snapshot buffer, no base64 or HTML wrapping.
+        // Abandoned if a new /capture overwrites the buffer meanwhile.
+        res.sendBuffer(200, "image/jpeg", jpeg, len, snapshotUnchanged, seq);
+        res.addHeader("ETag", etag);
+        res.addHeader("Cache-Control", "no-cache");
     }
 }
 
-// Generate HTML page with optional image and WiFi config
-String getHtmlPage(String message, bool showImage = false)
-{
-    String html = "<!DOCTYPE html><html>";
-    html += "<head><title>ESP32 Camera Control</title>";
-    html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-    html += "<style>";
-    html += "body { font-family: Arial, sans-serif; margin: 20px; text-align: center; }";
-    html += "button { background-color: #4CAF50; color: white; padding: 10px 20px; ";
-    html += "margin: 10px; border: none; border-radius: 4px; cursor: pointer; }";
-    html += "button:hover { background-color: #45a049; }";
-    html += ".ping-btn { background-color: #2196F3; }";
-    html += ".ping-btn:hover { background-color: #0b7dda; }";
-    html += ".stop-btn { background-color: #f44336; }";
-    html += ".clear-btn { background-color: #f44336; }";
-    html += ".clear-btn:hover { background-color: #da190b; }";
-    html += "img { margin-top: 20px; max-width: 100%; border: 1px solid #ddd; }";
-    html += ".status { background-color: #f0f0f0; padding: 10px; margin: 10px; }";
-    html += "</style></head><body>";
-    html += "<h1>ESP32 Camera Control</h1>";
-    html += "<div class='status'>";
-    html += "<p>Camera Status: " + String(camManager.isCameraAvailable() ? "Connected" : "Disconnected") + "</p>";
-    html += "<p>WiFi SSID: " + wifiManager.getSSID() + "</p>";
-    html += "<p>Bot Status: " + botManager.getLastBotStatus() + "</p>";
-    html += "<p>" + message + "</p>";
-    html += "</div>";
-    html += "<div><button onclick=\"location.href='/LED_ON'\">Turn LED ON</button>";
-    html += "<button class='ping-btn' onclick=\"location.href='/ping'\">PING Camera</button>";
-
-    html += "</div><div class='status'><h2>Servo Calibration</h2>";
-    html += "<div>";
-    html += "<button onclick=\"location.href='/servo_left'\" style='background-color: #2196F3;'>LEFT</button>";
-    html += "<button onclick=\"location.href='/servo_center'\" style='background-color: #2196F3;'>CENTER</button>";
-    html += "<button onclick=\"location.href='/servo_right'\" style='background-color: #2196F3;'>RIGHT</button>";
-    html += "</div><br>";
-    html += "<div>";
-    html += "<p>Live Position: <b>" + String(currentServoPos) + "</b></p>";
-    html += "<button onclick=\"location.href='/servo_step?dir=dec'\" style='background-color: #f44336;'> -1 </button> ";
-    html += "<button onclick=\"location.href='/servo_step?dir=inc'\" style='background-color: #4CAF50;'> +1 </button>";
-    html += "</div><br>";
-    html += "<form action='/calibrate_servo' method='get'>";
-    html += "Left: <input type='number' name='left' value='" + String(servoLeft) + "' style='width: 60px;'> ";
-    html += "Center: <input type='number' name='center' value='" + String(servoCenter) + "' style='width: 60px;'> ";
-    html += "Right: <input type='number' name='right' value='" + String(servoRight) + "' style='width: 60px;'> ";
-    html += "<br><br><input type='submit' value='Save & Test All'>";
-    html += "</form></div>";
+void handleTest(HttpRequest &req, HttpResponse &res)
+{
+    LOG_I(TAG, "Testing camera connection");
+    bool cameraStatus = camManager.checkCameraStatus();
+    sendMessage(res, "Camera: " + String(cameraStatus ? "OK" : "FAIL"));
+}
 
-    if (camManager.isCameraAvailable())
+void handleCapture(HttpRequest &req, HttpResponse &res)
+{
+    LOG_I(TAG, "Capture photo requested");
+
+    // Ensure camera is ready before capture
+    if (!camManager.ensureCameraReady())
     {
-        html += "<button onclick=\"location.href='/capture'\">Take Photo</button>";
-        html += "<button onclick=\"location.href='/stream'\">Stream Camera</button>";
-        html += "<button onclick=\"location.href='/test'\">Test Camera</button></div>";
+        sendMessage(res, "Camera not available - check connection");
+        return;
+    }
 
-        if (showImage && camManager.hasImage())
-        {
-            html += "<div><h2>Latest Image:</h2>";
-            html += "<img src='data:image/jpeg;base64," + camManager.getLastImageBase64() + "' />";
-            html += "</div>";
-        }
+    showMainStatus("Taking Photo");
+    bool success = camManager.capturePhoto();
+
+    if (success)
+    {
+        showMainStatus("Photo OK", MESSAGE_HOLD_MS);
+        sendMessage(res, "Photo captured successfully!");
     }
     else
     {
-        html += "</div><p>Camera not available</p>";
+        showMainStatus("Photo FAIL", MESSAGE_HOLD_MS);
+        sendMessage(res, "Failed to capture photo");
     }
+}
 
-    html += "<div class='status'><h2>AI Bot Configuration</h2>";
-    html += "<form action='/save_api_url' method='get'>";
-    html += "Base URL: <input type='text' name='url' value='" + botManager.getApiBaseUrl() + "' style='width: 80%;' placeholder='http://192.168.1.100:8000'><br>";
-    html += "Message Route: <input type='text' name='msg_route' value='" + botManager.getApiMessageRoute() + "' style='width: 80%;'><br>";
-    html += "Health Route: <input type='text' name='health_route' value='" + botManager.getApiHealthRoute() + "' style='width: 80%;'><br>";
-    html += "<input type='submit' value='Save & Test Connection'>";
-    html += "</form>";
+void handleStream(HttpRequest &req, HttpResponse &res)
+{
+    LOG_I(TAG, "Stream requested");
 
-    if (botManager.getApiBaseUrl().length() > 0)
+    // The broadcaster keeps the connection and feeds it from loop()
+    if (streamBroadcaster.addClient(*req.client))
     {
-        if (botManager.isBotRunning())
-        {
-            html += "<button class='stop-btn' onclick=\"location.href='/stop_bot'\">Stop AI Bot</button>";
-        }
-        else
-        {
-            html += "<button onclick=\"location.href='/start_bot'\">Start AI Bot</button>";
-        }
+        res.detach();
+        showMainStatus("Streaming x" + String(streamBroadcaster.getClientCount()));
+    }
+    else
+    {
+        res.send(503, "text/plain", "Too many stream viewers");
+    }
+}
+
+void handlePing(HttpRequest &req, HttpResponse &res)
+{
+
+    // Update OLED display
+    displayService.showText("Pinging camera...");
+
+    // Send PING command
+    bool pingSuccess = camManager.ping();
+
+    LOG_I(TAG, "Camera ping: %s", pingSuccess ? "PONG" : "FAILED");
+
+    // Update display with result
+    if (pingSuccess)
+    {
+        displayService.showText("PING: SUCCESS", "Response: PONG", "", "", MESSAGE_HOLD_MS);
+    }
+    else
+    {
+        displayService.showText("PING: FAILED",
+                                "No response",
+                                "", "", MESSAGE_HOLD_MS);
+    }
+
+    sendMessage(res, "PING Result: " + String(pingSuccess ? "SUCCESS (PONG)" : "FAILED - No response"));
+}
+
+void handleCalibrateServo(HttpRequest &req, HttpResponse &res)
+{
+    QueryString query(req.query);
+    query.getInt("center", servoCenter);
+    query.getInt("left", servoLeft);
+    query.getInt("right", servoRight);
+
+    LOG_I(TAG, "Servo config: L=%d C=%d R=%d", servoLeft, servoCenter, servoRight);
+
+    // Save with the rest of the config (no write if nothing changed)
+    BotConfig settings = config.get();
+    settings.servoCenter = servoCenter;
+    settings.servoLeft = servoLeft;
+    settings.servoRight = servoRight;
+    config.save(settings);
+
+    // Test the sequence
+    const int sequence[] = {servoLeft, servoRight, servoCenter};
+    currentServoPos = servoCenter;
+    servoMotion.moveThrough(sequence, 3);
+
+    sendMessage(res, "Servo calibrated and saved to memory.");
+}
+
+void handleServoLeft(HttpRequest &req, HttpResponse &res)
+{
+    servoMoveLeft();
+    sendMessage(res, "Servo moved Left");
+}
+
+void handleServoCenter(HttpRequest &req, HttpResponse &res)
+{
+    servoMoveCenter();
+    sendMessage(res, "Servo moved Center");
+}
+
+void handleServoRight(HttpRequest &req, HttpResponse &res)
+{
+    servoMoveRight();
+    sendMessage(res, "Servo moved Right");
+}
+
+void handleServoStep(HttpRequest &req, HttpResponse &res)
+{
+    char dir[8] = "";
+    QueryString(req.query).get("dir", dir, sizeof(dir));
+    if (strcmp(dir, "inc") == 0)
+        currentServoPos += 1;
+    else if (strcmp(dir, "dec") == 0)
+        currentServoPos -= 1;
+
+    servoMoveNext(currentServoPos);
+
+    sendMessage(res, "Servo stepped to " + String(currentServoPos));
+}
+
+void handleCameraProfile(HttpRequest &req, HttpResponse &res)
+{
+    QueryString query(req.query);
+    char profileName[12] = "";
+    query.get("profile", profileName, sizeof(profileName));
+
+    ESP32CamManager::ProfileId id = ESP32CamManager::PROFILE_AI;
+    if (strcmp(profileName, "stream") == 0)
+        id = ESP32CamManager::PROFILE_STREAM;
+    else if (strcmp(profileName, "snapshot") == 0)
+        id = ESP32CamManager::PROFILE_SNAPSHOT;
+
+    const CameraProfile &current = camManager.getProfile(id);
+    int size = current.frameSize;
+    int quality = current.jpegQuality;
+    if (query.getInt("size", size) && !isFrameSizeChoice(size))
+    {
+        res.send(400, "text/plain", "Unsupported frame size " + String(size));
+        return;
+    }
+    if (query.getInt("quality", quality))
+        quality = constrain(quality, 4, 63);
+
+    camManager.setProfile(id, (framesize_t)size, quality);
+    camManager.resetProfileStats();
+
+    sendMessage(res, "Profile " + String(current.name) + " set to " +
+                      String(frameSizeName(current.frameSize)) + " q" + String(current.jpegQuality));
+}
+
+void handleSceneGate(HttpRequest &req, HttpResponse &res)
+{
+    int threshold;
+    if (QueryString(req.query).getInt("threshold", threshold))
+        botManager.setSceneChangeThreshold(constrain(threshold, 0, 64));
+
+    sendMessage(res, "Scene change threshold: " + String(botManager.getSceneChangeThreshold()) + " bits");
+}
+
+void handleCadence(HttpRequest &req, HttpResponse &res)
+{
+    QueryString query(req.query);
+    int minMs = botManager.getCadenceMin();
+    int maxMs = botManager.getCadenceMax();
+    query.getInt("min", minMs);
+    query.getInt("max", maxMs);
+
+    botManager.setCadence(constrain(minMs, 0, 600000), constrain(maxMs, 0, 600000));
+    sendMessage(res, "Request interval: " + String(botManager.getCadenceMin()) + "-" + String(botManager.getCadenceMax()) + " ms");
+}
+
+void handleSaveApiUrl(HttpRequest &req, HttpResponse &res)
+{
+    QueryString query(req.query);
+    char url[128] = "";
+    char msgRoute[64] = "";
+    char healthRoute[64] = "";
+    char uploadMode[12] = "";
+    char responseMode[12] = "";
+    query.get("url", url, sizeof(url));
+    query.get("msg_route", msgRoute, sizeof(msgRoute));
+    query.get("health_route", healthRoute, sizeof(healthRoute));
+    query.get("upload_mode", uploadMode, sizeof(uploadMode));
+    query.get("response_mode", responseMode, sizeof(responseMode));
+
+    if (url[0] == '\0')
+    {
+        sendMessage(res, "API URL is required");
+        return;
+    }
+
+    if (!botManager.setApiConfig(url, msgRoute[0] ? msgRoute : "/message", healthRoute[0] ? healthRoute : "/health",
+                                 strcmp(uploadMode, "multipart") == 0 ? AIBotManager::UPLOAD_MULTIPART : AIBotManager::UPLOAD_JSON,
+                                 strcmp(responseMode, "stream") == 0))
+    {
+        sendMessage(res, "API URL must start with http:// or https://");
+        return;
+    }
+
+    // Run by the bot from loop(); the page shows the result from /api/status
+    botManager.requestHealthCheck();
+    sendMessage(res, "API URL Saved. Health check running...");
+}
+
+void handleLogLevel(HttpRequest &req, HttpResponse &res)
+{
+    QueryString query(req.query);
+    char levelName[12] = "";
+    char tag[Log::TAG_MAX] = "";
+    query.get("level", levelName, sizeof(levelName));
+    query.get("tag", tag, sizeof(tag));
+
+    int level = Log::parseLevel(levelName);
+    if (level < 0 && !(tag[0] && strcmp(levelName, "default") == 0))
+    {
+        sendMessage(res, "Unknown log level");
+        return;
     }
-    html += "</div>";
 
-    html += "<div><button class='clear-btn' onclick=\"if(confirm('Clear WiFi credentials and restart?')) location.href='/clearwifi'\">Clear WiFi Settings</button></div>";
-    html += "<br><a href='/'>Refresh Page</a>";
-    html += "</body></html>";
-    return html;
+    if (tag[0])
+        Log::setTagLevel(tag, level); // "default" (-1) removes the override
+    else
+        Log::setLevel(level);
+    sendMessage(res, "Log level " + String(tag[0] ? tag : "all") + ": " + String(level < 0 ? "default" : Log::levelName(level)));
+}
+
+// Prometheus text by default, JSON with ?format=json
+void handleMetrics(HttpRequest &req, HttpResponse &res)
+{
+    QueryString query(req.query);
+    char format[8] = "";
+    query.get("format", format, sizeof(format));
+
+    String body;
+    if (strcmp(format, "json") == 0)
+    {
+        Metrics::writeJson(body);
+        res.send(200, "application/json", body);
+    }
+    else
+    {
+        Metrics::writePrometheus(body);
+        res.send(200, "text/plain; version=0.0.4", body);
+    }
+}
+
+void handleStartBot(HttpRequest &req, HttpResponse &res)
+{
+    botManager.startBot();
+    sendMessage(res, "AI Bot Started");
+}
+
+void handleStopBot(HttpRequest &req, HttpResponse &res)
+{
+    botManager.stopBot();
+    sendMessage(res, "AI Bot Stopped");
+}
+
+void handleNotFound(HttpRequest &req, HttpResponse &res)
+{
+    res.send(404, "text/plain", "Not found");
+}
+
+// Runs before every request: show activity on the OLED and, once per
+// connection, flash the LED
+void onHttpRequestStart(const HttpRequest &req)
+{
+    LOG_D(HTTP_TAG, "%s %s", req.method, req.path);
+    if (req.requestIndex > 1)
+        return;
+
+    showMainStatus("Client Conn");
+
+    // Flash LED white to indicate client connection
+    flashPixel(0xFFFFFF, 3, 100, LED_STATUS);
+}
+
+void onHttpRequestDone(const HttpRequest &req)
+{
+    // Return to appropriate LED color based on camera status, unless a
+    // connection flash is still running (it ends on that color itself)
+    if (!actuators.isBusy(ACT_LED))
+        setStatusPixel();
+
+    // Update OLED display with status (a stream keeps its own status)
+    if (strcmp(req.path, "/stream") != 0)
+        updateOledBotStatus();
+}
+
+// Sorted by path, then method; checked below so lookups can binary search
+constexpr HttpServer::Route ROUTES[] = {
+    {"GET", "/", handleRoot},
+    {"GET", "/LED_ON", handleLedOn},
+    {"GET", "/api/status", handleApiStatus},
+    {"GET", "/cadence", handleCadence},
+    {"GET", "/calibrate_servo", handleCalibrateServo},
+    {"GET", "/camera_profile", handleCameraProfile},
+    {"GET", "/capture", handleCapture},
+    {"GET", "/clearwifi", handleClearWifi},
+    {"GET", "/log_level", handleLogLevel},
+    {"GET", "/metrics", handleMetrics},
+    {"GET", "/ping", handlePing},
+    {"GET", "/save_api_url", handleSaveApiUrl},
+    {"GET", "/scene_gate", handleSceneGate},
+    {"GET", "/servo_center", handleServoCenter},
+    {"GET", "/servo_left", handleServoLeft},
+    {"GET", "/servo_right", handleServoRight},
+    {"GET", "/servo_step", handleServoStep},
+    {"GET", "/snapshot.jpg", handleSnapshot},
+    {"GET", "/start_bot", handleStartBot},
+    {"GET", "/stop_bot", handleStopBot},
+    {"GET", "/stream", handleStream},
+    {"GET", "/test", handleTest},
+};
+static_assert(routeTableSorted(ROUTES), "ROUTES must be sorted by path, then method, without duplicates");
+
+void registerRoutes()
+{
+    httpServer.setRoutes(ROUTES, sizeof(ROUTES) / sizeof(ROUTES[0]));
+    httpServer.onNotFound(handleNotFound);
+    httpServer.setRequestHooks(onHttpRequestStart, onHttpRequestDone);
 }
 
 void setup()
 {
     Serial.begin(115200);
-    Serial.println("Starting ESP32-CAM Web Server...");
+    Log::begin(0);
+    LOG_I(TAG, "Starting ESP32-CAM web server");
     pixels.begin();
     pixels.setBrightness(100);
     delay(10);
     pinMode(LED_BUILTIN, OUTPUT);
 
-    // Test Servo Motor on Pin 41
-    Serial.println("Testing Servo Motor on pin 41...");
-    // Initialize EEPROM
-    EEPROM.begin(EEPROM_SIZE);
-
-    // Load Servo Settings from EEPROM
-    int storedCenter, storedLeft, storedRight;
-    EEPROM.get(ADDR_SERVO_CENTER, storedCenter);
-    EEPROM.get(ADDR_SERVO_LEFT, storedLeft);
-    EEPROM.get(ADDR_SERVO_RIGHT, storedRight);
-
-    // Validate (EEPROM returns -1 or 0xFFFFFFFF if never written)
-    if (storedCenter != -1 && storedCenter >= -90 && storedCenter <= 270)
-    {
-        servoCenter = storedCenter;
-        currentServoPos = servoCenter; // Set initial position to center
-    }
-    if (storedLeft != -1 && storedLeft >= -90 && storedLeft <= 270)
-        servoLeft = storedLeft;
-    if (storedRight != -1 && storedRight >= -90 && storedRight <= 270)
-        servoRight = storedRight;
-
-    // Test Servo Motor on Pin 41
-    Serial.println("Testing Servo Motor on pin 41...");
-    testServo.setPeriodHertz(50);           // standard 50hz servo
-    testServo.attach(SERVO_PIN, 500, 2400); // Standard pulses for many servos
-    testServo.write(servoCenter);           // Move to center
-    delay(300);
-    testServo.write(servoLeft); // Move to left limit
-    delay(300);
-    testServo.write(servoRight); // Move to right limit
-    delay(300);
-    testServo.write(servoCenter); // Back to center
-    delay(500);                   // Give it extra time to reach before detaching
-    testServo.detach();
-    Serial.println("Servo test complete.");
+    // Load settings: EEPROM.begin() reads the area into RAM in one go and
+    // the config is taken from there; the managers read their sections
+    uint32_t configStartUs = micros();
+    storage.begin(ConfigStore::STORAGE_SIZE);
+    bool configOk = config.begin(&storage);
+    configLoadUs = micros() - configStartUs;
+    const ConfigStore::Stats &configStats = config.getStats();
+    LOG_I(TAG, "Config: %s (slot %d, seq %u) in %u us", ConfigStore::sourceName(configStats.source),
+          configStats.slot, (unsigned)configStats.sequence, (unsigned)configLoadUs);
+    if (!configOk)
+        LOG_E(TAG, "Config could not be stored");
+
+    servoCenter = config.get().servoCenter;
+    servoLeft = config.get().servoLeft;
+    servoRight = config.get().servoRight;
+    currentServoPos = servoCenter; // Set initial position to center
+
+    // Test Servo Motor on Pin 41: center, both limits, back to center. The
+    // motion task runs it while setup carries on.
+    LOG_I(TAG, "Testing servo motor on pin %d", SERVO_PIN);
+    servoMotion.setDoneCallback(onServoMoveDone);
+    servoMotion.begin(&testServo, servoCenter);
+    const int servoTest[] = {servoCenter, servoLeft, servoRight, servoCenter};
+    servoMotion.moveThrough(servoTest, 4);
 
     // Initialize OLED display
     if (!initOLED())
     {
-        Serial.println("OLED initialization failed!");
+        LOG_E(TAG, "OLED initialization failed");
         while (true)
             ; // Halt if OLED fails
     }
-    drawIntro("Initializing...");
+    displayService.begin();
+    displayService.showIntro("Initializing...");
 
     // Initialize camera manager
     camManager.setStatusCallback(onCameraStatusChange);
-    drawIntro("Init Camera...");
+    displayService.showIntro("Init Camera...");
     bool camInit = camManager.begin();
     if (camInit)
     {
-        drawIntro("Camera ready!");
-        Serial.println("Camera initialized!");
+        displayService.showIntro("Camera ready!");
+        LOG_I(TAG, "Camera initialized");
     }
     else
     {
-        drawIntro("Camera failed!");
-        Serial.println("Camera initialization failed!");
+        displayService.showIntro("Camera failed!");
+        LOG_E(TAG, "Camera initialization failed");
     }
     delay(2000);
 
@@ -384,24 +901,33 @@ void setup()
     wifiManager.setStatusCallback(onWiFiStatusChange);
     wifiManager.setDisplayCallback(onWiFiDisplayUpdate);
 
+    // Initialize MJPEG broadcaster
+    streamBroadcaster.begin(&camManager);
+
     // Initialize AI Bot Manager
-    botManager.begin(&camManager, &wifiManager);
+    cameraFrames.begin(&camManager);
+    botManager.begin(&cameraFrames, &wifiManager, &config, &boardClock);
     botManager.setStatusCallback(onBotStatusChange);
+    botManager.setDecisionCallback(onBotDecision);
 
     // Initialize and connect WiFi (includes server setup)
-    drawIntro("Connecting WiFi...");
-    bool wifiConnected = wifiManager.begin(80);
+    displayService.showIntro("Connecting WiFi...");
+    bool wifiConnected = wifiManager.begin(&config, 80);
+
+    // Web routes
+    httpServer.begin(wifiManager.getServer());
+    registerRoutes();
 
     if (wifiConnected)
     {
-        drawMain(wifiManager.getLocalIP(),
-                 "Ready!",
-                 "none",
-                 "0.0m");
+        displayService.showMain(wifiManager.getLocalIP(),
+                                "Ready!",
+                                "none",
+                                "0.0m");
     }
     else
     {
-        drawIntro("No WiFi");
+        displayService.showIntro("No WiFi");
     }
 
     // Indicate server availability with green LED
@@ -410,333 +936,33 @@ void setup()
 
 void loop()
 {
+    uint32_t loopStartUs = micros();
+
     // Perform periodic camera availability check
     camManager.checkCameraAvailability();
 
     // Run AI Bot loop
     botManager.loop();
 
-    // Check for client connections
-    WiFiClient client = wifiManager.getServer()->available();
-    if (client)
-    {
-        Serial.println("New client connected!");
-        drawMain(wifiManager.getLocalIP(),
-                 "Client Conn",
-                 botManager.getLastDirection(),
-                 String(botManager.getLastDistance(), 1) + "m");
-
-        // Flash LED to indicate client connection
-        for (int i = 0; i < 3; i++)
-        {
-            setPixelColor(255, 255, 255, 100); // Flash White
-            setPixelColor(0, 0, 0, 100);       // Turn Off
-        }
+    // Serve web clients and feed connected stream viewers
+    httpServer.loop();
+    streamBroadcaster.loop();
 
-        while (client.connected())
-        {
-            if (client.available())
-            {
-                String request = client.readStringUntil('\r');
-                Serial.println("Request: " + request);
-                client.flush();
-
-                // Check for different request types
-                if (request.indexOf("/LED_ON") != -1)
-                {
-                    Serial.println("Button pressed: Turning LED ON");
-                    setPixelColor(255, 0, 0); // Solid Red
-
-                    // Update OLED display
-                    drawMain(wifiManager.getLocalIP(),
-                             "LED ON",
-                             botManager.getLastDirection(),
-                             String(botManager.getLastDistance(), 1) + "m");
-
-                    // Send web response
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("LED turned ON"));
-                }
-                else if (request.indexOf("/clearwifi") != -1)
-                {
-                    Serial.println("Clearing WiFi credentials and restarting");
-
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println("<!DOCTYPE html><html><body><h1>WiFi Credentials Cleared</h1><p>Device will restart in 3 seconds...</p><script>setTimeout(function(){window.close();}, 3000);</script></body></html>");
-
-                    delay(1000);
-                    client.stop();
-                    wifiManager.clearCredentials();
-                    delay(2000);
-                    ESP.restart();
-                }
-                else if (request.indexOf("/test") != -1)
-                {
-                    Serial.println("Testing camera connection");
-                    bool cameraStatus = camManager.checkCameraStatus();
-
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-
-                    String testResult = "Camera: " + String(cameraStatus ? "OK" : "FAIL");
-                    client.println(getHtmlPage(testResult));
-                }
-                else if (request.indexOf("/capture") != -1)
-                {
-                    Serial.println("Capture photo requested");
-
-                    // Ensure camera is ready before capture
-                    if (camManager.ensureCameraReady())
-                    {
-                        drawMain(wifiManager.getLocalIP(),
-                                 "Taking Photo",
-                                 botManager.getLastDirection(),
-                                 String(botManager.getLastDistance(), 1) + "m");
-                        bool success = camManager.capturePhoto();
-
-                        // Send web response
-                        client.println("HTTP/1.1 200 OK");
-                        client.println("Content-Type: text/html");
-                        client.println();
-
-                        if (success)
-                        {
-                            drawMain(wifiManager.getLocalIP(),
-                                     "Photo OK",
-                                     botManager.getLastDirection(),
-                                     String(botManager.getLastDistance(), 1) + "m");
-                            client.println(getHtmlPage("Photo captured successfully!", true));
-                        }
-                        else
-                        {
-                            drawMain(wifiManager.getLocalIP(),
-                                     "Photo FAIL",
-                                     botManager.getLastDirection(),
-                                     String(botManager.getLastDistance(), 1) + "m");
-                            client.println(getHtmlPage("Failed to capture photo"));
-                        }
-                    }
-                    else
-                    {
-                        client.println("HTTP/1.1 200 OK");
-                        client.println("Content-Type: text/html");
-                        client.println();
-                        client.println(getHtmlPage("Camera not available - check connection"));
-                    }
-                }
-                else if (request.indexOf("/stream") != -1)
-                {
-                    Serial.println("Stream requested");
-                    displayText("Streaming...");
-
-                    // Send MJPEG Header
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: multipart/x-mixed-replace; boundary=frame");
-                    client.println();
-
-                    while (client.connected())
-                    {
-                        camera_fb_t *fb = camManager.getFrame();
-                        if (!fb)
-                        {
-                            Serial.println("Frame capture failed");
-                            break;
-                        }
-
-                        // Send Frame Header and Data
-                        client.println("--frame");
-                        client.println("Content-Type: image/jpeg");
-                        client.println("Content-Length: " + String(fb->len));
-                        client.println();
-                        client.write(fb->buf, fb->len);
-                        client.println();
-
-                        camManager.releaseFrame(fb);
-                    }
-                    displayText("Stream ended");
-                }
-                else if (request.indexOf("/ping") != -1)
-                {
-                    Serial.println("PING camera requested");
-
-                    // Update OLED display
-                    displayText("Pinging camera...");
-
-                    // Send PING command
-                    bool pingSuccess = camManager.ping();
-
-                    Serial.println("PING response: " + String(pingSuccess ? "PONG" : "FAILED"));
-
-                    // Update display with result
-                    if (pingSuccess)
-                    {
-                        displayMultiLine("PING: SUCCESS", "Response: PONG", "", "");
-                    }
-                    else
-                    {
-                        displayMultiLine("PING: FAILED",
-                                         "No response",
-                                         "", "");
-                    }
-
-                    // Send web response
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-
-                    String result = "PING Result: " + String(pingSuccess ? "SUCCESS (PONG)" : "FAILED - No response");
-                    client.println(getHtmlPage(result));
-                }
-                else if (request.indexOf("/calibrate_servo") != -1)
-                {
-                    String cStr = getQueryParam(request, "center");
-                    String lStr = getQueryParam(request, "left");
-                    String rStr = getQueryParam(request, "right");
-
-                    if (cStr.length() > 0)
-                        servoCenter = cStr.toInt();
-                    if (lStr.length() > 0)
-                        servoLeft = lStr.toInt();
-                    if (rStr.length() > 0)
-                        servoRight = rStr.toInt();
-
-                    Serial.println("Updating Servo config: L=" + String(servoLeft) + " C=" + String(servoCenter) + " R=" + String(servoRight));
-
-                    // Save to EEPROM
-                    EEPROM.put(ADDR_SERVO_CENTER, servoCenter);
-                    EEPROM.put(ADDR_SERVO_LEFT, servoLeft);
-                    EEPROM.put(ADDR_SERVO_RIGHT, servoRight);
-                    EEPROM.commit();
-
-                    // Test the sequence
-                    testServo.attach(SERVO_PIN, 500, 2400);
-                    testServo.write(servoLeft);
-                    delay(400);
-                    testServo.write(servoRight);
-                    delay(400);
-                    testServo.write(servoCenter);
-                    delay(500);
-                    testServo.detach();
-
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("Servo calibrated and saved to memory."));
-                }
-                else if (request.indexOf("/servo_left") != -1)
-                {
-                    servoMoveLeft();
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("Servo moved Left"));
-                }
-                else if (request.indexOf("/servo_center") != -1)
-                {
-                    servoMoveCenter();
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("Servo moved Center"));
-                }
-                else if (request.indexOf("/servo_right") != -1)
-                {
-                    servoMoveRight();
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("Servo moved Right"));
-                }
-                else if (request.indexOf("/servo_step") != -1)
-                {
-                    String dir = getQueryParam(request, "dir");
-                    if (dir == "inc")
-                        currentServoPos += 1;
-                    else if (dir == "dec")
-                        currentServoPos -= 1;
-
-                    servoMoveNext(currentServoPos);
-
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("Servo stepped to " + String(currentServoPos)));
-                }
-                else if (request.indexOf("/save_api_url") != -1)
-                {
-                    String url = urlDecode(getQueryParam(request, "url"));
-                    String msgRoute = urlDecode(getQueryParam(request, "msg_route"));
-                    String healthRoute = urlDecode(getQueryParam(request, "health_route"));
-
-                    if (url.length() > 0)
-                    {
-                        if (msgRoute.length() == 0)
-                            msgRoute = "/message";
-                        if (healthRoute.length() == 0)
-                            healthRoute = "/health";
-
-                        botManager.setApiConfig(url, msgRoute, healthRoute);
-
-                        bool health = botManager.testConnection();
-                        String msg = "API URL Saved. Health Check: " + String(health ? "PASSED" : "FAILED");
-
-                        client.println("HTTP/1.1 200 OK");
-                        client.println("Content-Type: text/html");
-                        client.println();
-                        client.println(getHtmlPage(msg));
-                    }
-                }
-                else if (request.indexOf("/start_bot") != -1)
-                {
-                    botManager.startBot();
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("AI Bot Started"));
-                }
-                else if (request.indexOf("/stop_bot") != -1)
-                {
-                    botManager.stopBot();
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("AI Bot Stopped"));
-                }
-                else
-                {
-                    // Default home page
-                    client.println("HTTP/1.1 200 OK");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println(getHtmlPage("ESP32 Camera Control Panel"));
-                }
-                break;
-            }
-        }
-        client.stop();
-        Serial.println("Client disconnected.");
+    // Deferred restart after /clearwifi
+    if (restartAt != 0 && (long)(millis() - restartAt) >= 0)
+    {
+        wifiManager.clearCredentials();
+        ESP.restart();
+    }
 
-        // Return to appropriate LED color based on camera status
-        if (camManager.isCameraAvailable())
-        {
-            setPixelColor(0, 255, 0); // Green for camera available
-        }
-        else
-        {
-            setPixelColor(255, 100, 0); // Orange for no camera
-        }
+    // LED patterns
+    actuators.run(millis());
 
-        // Update OLED display with status
-        updateOledBotStatus();
-    }
-    else
+    // Breathing LED effect (color depends on camera status)
+    static unsigned long lastBreath = 0;
+    if (millis() - lastBreath >= 50 && !actuators.isBusy(ACT_LED))
     {
-        // Breathing LED effect when idle (color depends on camera status)
+        lastBreath = millis();
         static int brightness = 0;
         static int direction = 1;
         brightness += direction * 2;
@@ -751,6 +977,8 @@ void loop()
         {
             setPixelColor(brightness, brightness / 2, 0); // Orange breathing for no camera
         }
-        delay(50);
     }
+
+    Metrics::record(Metrics::STAGE_LOOP, micros() - loopStartUs);
+    delay(1);
 }
@@ -0,0 +1,161 @@
+#include "metrics.h"
+#include "latency_histogram.h"
+
+static LatencyHistogram histograms[Metrics::STAGE_COUNT];
+static portMUX_TYPE metricsLock = portMUX_INITIALIZER_UNLOCKED;
+
+struct StatusCount
+{
+    char status[Metrics::STATUS_MAX];
+    uint32_t count;
+};
+static StatusCount statusCounts[Metrics::MAX_STATUSES];
+static int statusCountUsed = 0;
+
+static const char *STAGE_NAMES[Metrics::STAGE_COUNT] = {
+    "capture", "encode", "build", "upload", "ttfb", "body", "parse", "actuate", "loop", "display", "http"};
+
+static const float QUANTILES[] = {0.5f, 0.95f, 0.99f};
+static const char *QUANTILE_NAMES[] = {"0.5", "0.95", "0.99"};
+static const char *QUANTILE_KEYS[] = {"p50_us", "p95_us", "p99_us"};
+
+// One stage's numbers, worked out from a copy taken under the lock
+struct StageSnapshot
+{
+    uint32_t quantiles[3];
+    uint32_t windowCount;
+    uint32_t windowMax;
+    uint32_t totalCount;
+    uint64_t totalSumUs;
+};
+
+static void snapshot(int stage, uint32_t nowMs, StageSnapshot &s)
+{
+    // Only the copy holds up recorders (and interrupts on this core)
+    portENTER_CRITICAL(&metricsLock);
+    LatencyHistogram h = histograms[stage];
+    portEXIT_CRITICAL(&metricsLock);
+
+    for (int q = 0; q < 3; q++)
+        s.quantiles[q] = h.quantile(QUANTILES[q], nowMs);
+    s.windowCount = h.getWindowCount(nowMs);
+    s.windowMax = h.getWindowMax(nowMs);
+    s.totalCount = h.getTotalCount();
+    s.totalSumUs = h.getTotalSumUs();
+}
+
+void Metrics::record(Stage stage, uint32_t us)
+{
+    if (stage >= STAGE_COUNT)
+        return;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&metricsLock);
+    histograms[stage].record(us, now);
+    portEXIT_CRITICAL(&metricsLock);
+}
+
+// The last entry is kept for "other", shared by statuses that find the
+// others taken
+void Metrics::countStatus(const char *status)
+{
+    portENTER_CRITICAL(&metricsLock);
+    int i = 0;
+    while (i < statusCountUsed && strncmp(statusCounts[i].status, status, STATUS_MAX - 1) != 0)
+        i++;
+    if (i == MAX_STATUSES)
+    {
+        i = MAX_STATUSES - 1;
+    }
+    else if (i == statusCountUsed)
+    {
+        if (i == MAX_STATUSES - 1)
+            strcpy(statusCounts[i].status, "other");
+        else
+            strncpy(statusCounts[i].status, status, STATUS_MAX - 1);
+        statusCounts[i].status[STATUS_MAX - 1] = '\0';
+        statusCounts[i].count = 0;
+        statusCountUsed++;
+    }
+    statusCounts[i].count++;
+    portEXIT_CRITICAL(&metricsLock);
+}
+
+const char *Metrics::stageName(Stage stage)
+{
+    return stage < STAGE_COUNT ? STAGE_NAMES[stage] : "?";
+}
+
+static String seconds(uint64_t us)
+{
+    return String((double)us / 1000000.0, 6);
+}
+
+void Metrics::writePrometheus(String &out)
+{
+    uint32_t now = millis();
+    out.reserve(3072);
+
+    out += "# HELP bot_stage_seconds Bot cycle stage latency, quantiles over the last 1-2 minutes\n";
+    out += "# TYPE bot_stage_seconds summary\n";
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        StageSnapshot s;
+        snapshot(stage, now, s);
+        String label = String("stage=\"") + STAGE_NAMES[stage] + "\"";
+        for (int q = 0; q < 3; q++)
+        {
+            out += "bot_stage_seconds{" + label + ",quantile=\"" + QUANTILE_NAMES[q] + "\"} ";
+            out += s.windowCount ? seconds(s.quantiles[q]) : String("NaN"); // No samples in the window
+            out += "\n";
+        }
+        out += "bot_stage_seconds_sum{" + label + "} " + seconds(s.totalSumUs) + "\n";
+        out += "bot_stage_seconds_count{" + label + "} " + String(s.totalCount) + "\n";
+    }
+
+    out += "# HELP bot_cycles_total Bot cycles by how they ended\n";
+    out += "# TYPE bot_cycles_total counter\n";
+    portENTER_CRITICAL(&metricsLock);
+    StatusCount counts[MAX_STATUSES];
+    int used = statusCountUsed;
+    memcpy(counts, statusCounts, sizeof(StatusCount) * used);
+    portEXIT_CRITICAL(&metricsLock);
+    for (int i = 0; i < used; i++)
+        out += String("bot_cycles_total{status=\"") + counts[i].status + "\"} " + String(counts[i].count) + "\n";
+
+    out += "# HELP bot_uptime_seconds Time since boot\n";
+    out += "# TYPE bot_uptime_seconds gauge\n";
+    out += "bot_uptime_seconds " + String(now / 1000) + "\n";
+}
+
+void Metrics::writeJson(String &out)
+{
+    uint32_t now = millis();
+    out.reserve(2048);
+
+    out += "{\"uptime_ms\":" + String(now) + ",\"stages\":{";
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        StageSnapshot s;
+        snapshot(stage, now, s);
+        if (stage > 0)
+            out += ",";
+        out += String("\"") + STAGE_NAMES[stage] + "\":{\"window_count\":" + String(s.windowCount);
+        for (int q = 0; q < 3; q++)
+            out += String(",\"") + QUANTILE_KEYS[q] + "\":" + String(s.quantiles[q]);
+        out += ",\"max_us\":" + String(s.windowMax) + ",\"count\":" + String(s.totalCount) + "}";
+    }
+    out += "},\"statuses\":{";
+
+    portENTER_CRITICAL(&metricsLock);
+    StatusCount counts[MAX_STATUSES];
+    int used = statusCountUsed;
+    memcpy(counts, statusCounts, sizeof(StatusCount) * used);
+    portEXIT_CRITICAL(&metricsLock);
+    for (int i = 0; i < used; i++)
+    {
+        if (i > 0)
+            out += ",";
+        out += String("\"") + counts[i].status + "\":" + String(counts[i].count);
+    }
+    out += "}}";
+}
@@ -0,0 +1,125 @@
+#include "motion_profile.h"
+
+#include <math.h>
+
+MotionProfile::MotionProfile() : segmentCount(0), duration(0), target(0)
+{
+}
+
+void MotionProfile::addSegment(float &position, float &velocity, float acceleration, float time)
+{
+    if (time <= 0 || segmentCount == MAX_SEGMENTS)
+        return;
+
+    Segment &s = segments[segmentCount++];
+    s.start = duration;
+    s.duration = time;
+    s.position = position;
+    s.velocity = velocity;
+    s.acceleration = acceleration;
+
+    position += velocity * time + 0.5f * acceleration * time * time;
+    velocity += acceleration * time;
+    duration += time;
+}
+
+void MotionProfile::plan(float from, float velocity, float to, const Limits &limits)
+{
+    segmentCount = 0;
+    duration = 0;
+    target = to;
+
+    float a = limits.maxAcceleration;
+    float vmax = limits.maxVelocity;
+    float p = from;
+    float v = velocity;
+
+    // Heading away, or too fast to stop before the target: brake to a stop
+    // first, then plan from rest at wherever that leaves us
+    float d = to - p;
+    float stopping = v * v / (2 * a);
+    if (v * d < 0 || (v != 0 && stopping > fabsf(d)))
+    {
+        addSegment(p, v, v > 0 ? -a : a, fabsf(v) / a);
+        v = 0;
+        d = to - p;
+    }
+    if (d == 0)
+        return;
+
+    float dir = d > 0 ? 1.0f : -1.0f;
+    float distance = fabsf(d);
+    float v0 = fabsf(v);
+
+    // Started above the speed limit: slow down to it
+    if (v0 > vmax)
+    {
+        float slowTime = (v0 - vmax) / a;
+        addSegment(p, v, -dir * a, slowTime);
+        distance -= (v0 * v0 - vmax * vmax) / (2 * a);
+        v0 = vmax;
+    }
+
+    // Peak speed where accelerating from v0 and braking to 0 just cover the
+    // distance, capped at the limit (then the rest is cruised)
+    float peak = sqrtf((2 * a * distance + v0 * v0) / 2);
+    if (peak > vmax)
+        peak = vmax;
+    if (peak < v0)
+        peak = v0;
+
+    float accelTime = (peak - v0) / a;
+    float brakeTime = peak / a;
+    float cruiseDistance = distance - (peak * peak - v0 * v0) / (2 * a) - peak * peak / (2 * a);
+    float cruiseTime = cruiseDistance > 0 && peak > 0 ? cruiseDistance / peak : 0;
+
+    addSegment(p, v, dir * a, accelTime);
+    addSegment(p, v, 0, cruiseTime);
+    addSegment(p, v, -dir * a, brakeTime);
+}
+
+float MotionProfile::getDuration() const
+{
+    return duration;
+}
+
+float MotionProfile::getTarget() const
+{
+    return target;
+}
+
+bool MotionProfile::isDone(float t) const
+{
+    return t >= duration;
+}
+
+const MotionProfile::Segment *MotionProfile::segmentAt(float t) const
+{
+    for (int i = 0; i < segmentCount; i++)
+    {
+        if (t < segments[i].start + segments[i].duration)
+            return &segments[i];
+    }
+    return nullptr;
+}
+
+float MotionProfile::positionAt(float t) const
+{
+    if (t <= 0 && segmentCount > 0)
+        return segments[0].position;
+    const Segment *s = segmentAt(t);
+    if (!s)
+        return target; // Exactly on target, whatever rounding did to the segments
+    float dt = t - s->start;
+    return s->position + s->velocity * dt + 0.5f * s->acceleration * dt * dt;
+}
+
+float MotionProfile::velocityAt(float t) const
+{
+    if (t <= 0 && segmentCount > 0)
+        return segments[0].velocity;
+    const Segment *s = segmentAt(t);
+    if (!s)
+        return 0;
+    return s->velocity + s->acceleration * (t - s->start);
+}
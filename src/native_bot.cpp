@@ -0,0 +1,199 @@
+// Not part of the unit test builds, which bring their own main()
+#if !defined(ARDUINO) && !defined(PIO_UNIT_TESTING)
+
+// Host run of AIBotManager, built by [env:native]: the firmware's bot with
+// JPEG files for the camera and a settings file for the EEPROM, moving a
+// console servo on each decision, with per-stage latency quantiles at the
+// end. Exits non-zero if any cycle ended without a decision, so it doubles
+// as an end to end regression check against scripts/mock_backend.py:
+//
+//   python3 scripts/mock_backend.py --think 0.5 &
+//   pio run -e native
+//   .pio/build/native/program http://127.0.0.1:8000/message frame.jpg --cycles 20 --stream
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ai_bot_manager.h"
+#include "config_store.h"
+#include "hal_native.h"
+#include "latency_histogram.h"
+
+enum Stage
+{
+    STAGE_UPLOAD,
+    STAGE_TTFB,
+    STAGE_BODY,
+    STAGE_DIRECTION,
+    STAGE_TOTAL,
+    STAGE_COUNT
+};
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {"upload", "ttfb", "body", "direction", "total"};
+
+static JpegFileFrameSource frames;
+static FileStorage storage(".pio/native_storage.bin", ConfigStore::STORAGE_SIZE); // Same layout as the EEPROM
+static ConfigStore config;
+static HostLink hostLink;
+static HostClock hostClock;
+static ConsoleServo servo;
+static AIBotManager bot;
+static LatencyHistogram histograms[STAGE_COUNT];
+
+// As the board boots: one read of the settings file, then the config out
+// of it (migrated from the old layout if that is what the file holds)
+static void loadSettings()
+{
+    uint32_t startUs = hostMicros();
+    storage.begin();
+    bool ok = config.begin(&storage);
+    uint32_t loadUs = hostMicros() - startUs;
+
+    const ConfigStore::Stats &stats = config.getStats();
+    printf("config: %s (slot %d, seq %u) in %u us, %u writes%s\n", ConfigStore::sourceName(stats.source), stats.slot,
+           (unsigned)stats.sequence, (unsigned)loadUs, (unsigned)stats.commits, ok ? "" : ", not stored");
+}
+
+// Same moves as onBotDecision() in main.cpp
+static void onBotDecision(const String &direction, float distance, bool goalFound)
+{
+    int angle = -1;
+    if (strcasecmp(direction.c_str(), "left") == 0)
+        angle = config.get().servoLeft;
+    else if (strcasecmp(direction.c_str(), "right") == 0)
+        angle = config.get().servoRight;
+    else if (strcasecmp(direction.c_str(), "forward") == 0)
+        angle = config.get().servoCenter;
+    if (angle < 0 || angle == servo.getAngle())
+        return;
+
+    servo.attach();
+    servo.write(angle);
+    servo.detach();
+}
+
+// One request cycle, from the bot starting it to the bot finishing it;
+// false if it ended without a decision
+static bool runCycle(int cycle)
+{
+    while (bot.getNextRequestIn() > 0)
+        hostClock.delay(1);
+    bot.loop(); // Starts the request, or ends the cycle at once (no link, no frame)
+    while (bot.isRequestInFlight())
+    {
+        hostClock.delay(1);
+        bot.loop();
+    }
+
+    String status = bot.getLastBotStatus();
+    if (status != "Response Recv")
+    {
+        printf("cycle %d: %s\n", cycle, status.c_str());
+        return false;
+    }
+
+    uint32_t now = hostMillis();
+    BotRequestTiming timing = bot.getLastRequestTiming();
+    histograms[STAGE_UPLOAD].record(timing.uploadMs * 1000, now);
+    histograms[STAGE_TTFB].record(timing.waitMs * 1000, now);
+    histograms[STAGE_BODY].record(timing.downloadMs * 1000, now);
+    histograms[STAGE_DIRECTION].record(timing.directionMs * 1000, now);
+    histograms[STAGE_TOTAL].record(timing.totalMs * 1000, now);
+
+    printf("cycle %d: '%s' %.2f m, direction after %u ms, total %u ms (%s connection)\n", cycle,
+           bot.getLastDirection().c_str(), bot.getLastDistance(), (unsigned)timing.directionMs,
+           (unsigned)timing.totalMs, timing.reused ? "reused" : "new");
+    return true;
+}
+
+static void printSummary(int cycles, int failed)
+{
+    uint32_t now = hostMillis();
+    printf("\n%d cycles, %d failed, %u connections, %u decisions/min, %u context resends\n", cycles, failed,
+           (unsigned)bot.getLastRequestTiming().connectionsOpened, (unsigned)bot.getDecisionsPerMinute(),
+           (unsigned)bot.getContextResends());
+    printf("%-10s %8s %8s %8s %8s\n", "stage", "p50 ms", "p95 ms", "p99 ms", "max ms");
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        LatencyHistogram &h = histograms[stage];
+        if (h.getWindowCount(now) == 0)
+            continue;
+        printf("%-10s %8.1f %8.1f %8.1f %8.1f\n", STAGE_NAMES[stage], h.quantile(0.5f, now) / 1000.0,
+               h.quantile(0.95f, now) / 1000.0, h.quantile(0.99f, now) / 1000.0, h.getWindowMax(now) / 1000.0);
+    }
+}
+
+static int usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s <message url> <frame.jpg>... [--cycles N] [--stream] [--multipart] [--min-ms N] [--max-ms N]\n",
+            program);
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    const char *url = nullptr;
+    int cycles = 10;
+    bool stream = false;
+    AIBotManager::UploadMode uploadMode = AIBotManager::UPLOAD_JSON;
+    uint32_t minMs = 0;
+    uint32_t maxMs = 10000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+            cycles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stream") == 0)
+            stream = true;
+        else if (strcmp(argv[i], "--multipart") == 0)
+            uploadMode = AIBotManager::UPLOAD_MULTIPART;
+        else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc)
+            minMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-ms") == 0 && i + 1 < argc)
+            maxMs = atoi(argv[++i]);
+        else if (argv[i][0] == '-')
+            return usage(argv[0]);
+        else if (!url)
+            url = argv[i];
+        else if (!frames.addFile(argv[i]))
+        {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (!url || frames.getFileCount() == 0)
+        return usage(argv[0]);
+
+    // The bot keeps the backend as base URL plus route
+    const char *scheme = strstr(url, "://");
+    const char *route = scheme ? strchr(scheme + 3, '/') : nullptr;
+    String base = route ? String(std::string(url, route - url)) : String(url);
+
+    loadSettings();
+    bot.begin(&frames, &hostLink, &config, &hostClock);
+    bot.setDecisionCallback(onBotDecision);
+    if (!bot.setApiConfig(base, route ? route : "/message", "/health", uploadMode, stream))
+    {
+        fprintf(stderr, "%s: the URL must start with http:// or https://\n", url);
+        return 2;
+    }
+    bot.setCadence(minMs, maxMs);
+    bot.startBot();
+    if (!bot.isBotRunning())
+        return usage(argv[0]);
+
+    int failed = 0;
+    for (int cycle = 1; cycle <= cycles; cycle++)
+    {
+        if (!runCycle(cycle))
+            failed++;
+    }
+    bot.stopBot();
+
+    printSummary(cycles, failed);
+    return failed == 0 ? 0 : 1;
+}
+
+#endif // !ARDUINO && !PIO_UNIT_TESTING
@@ -1,17 +1,117 @@
 #include "oled_display.h"
+#include "metrics.h"
 
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 #define OLED_SDA 40 // Adjust based on your wiring
 #define OLED_SCL 39 // Adjust based on your wiring
 #define OLED_RESET -1
+#define SH1106_COLUMN_OFFSET 2 // 128 visible columns centred in 132 of RAM
+#define SH1106_NOP 0xE3
 
 // Assets from Lopaka
 static const unsigned char PROGMEM image_direction_forward_bits[] = {0x00, 0x0f, 0x00, 0x00, 0x00, 0x0f, 0x00, 0x00, 0x00, 0x0f, 0x00, 0x00, 0x00, 0x0f, 0x00, 0x00, 0x00, 0xff, 0xf0, 0x00, 0x00, 0xff, 0xf0, 0x00, 0x00, 0xff, 0xf0, 0x00, 0x00, 0xff, 0xf0, 0x00, 0x0f, 0xff, 0xff, 0x00, 0x0f, 0xff, 0xff, 0x00, 0x0f, 0xff, 0xff, 0x00, 0x0f, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0xf0, 0xff, 0xff, 0xff, 0xf0, 0xff, 0xff, 0xff, 0xf0, 0xff, 0xff, 0xff, 0xf0};
 static const unsigned char PROGMEM image_wifi_bits[] = {0x12, 0x00, 0x4c, 0x80, 0xa1, 0x40, 0x52, 0x80, 0x21, 0x00, 0x12, 0x00, 0x0c, 0x00, 0x00, 0x00};
 
-// Create the display object
-Adafruit_SH1106G display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+// Wire's 128-byte buffer, less the control byte
+static const size_t I2C_DATA_CHUNK = 127;
+
+DiffSH1106G::DiffSH1106G(uint16_t w, uint16_t h, TwoWire *wire, int8_t resetPin)
+    : Adafruit_SH1106G(w, h, wire, resetPin, STANDARD_HZ, STANDARD_HZ), wire(wire), address(0),
+      busHz(STANDARD_HZ), busyUs(0)
+{
+}
+
+bool DiffSH1106G::begin(uint8_t addr)
+{
+    address = addr;
+    if (!Adafruit_SH1106G::begin(addr))
+        return false;
+
+    // The SH1106 is only specified to 400 kHz, but most modules run at
+    // 1 MHz; stay at 400 kHz if this one doesn't ack there
+    wire->setClock(FAST_HZ);
+    busHz = FAST_HZ;
+    if (!probe())
+    {
+        wire->setClock(STANDARD_HZ);
+        busHz = STANDARD_HZ;
+    }
+    renderer.invalidate();
+    return true;
+}
+
+bool DiffSH1106G::probe()
+{
+    for (int i = 0; i < 4; i++)
+    {
+        wire->beginTransmission(address);
+        wire->write(0x00); // Command stream
+        wire->write(SH1106_NOP);
+        if (wire->endTransmission() != 0)
+            return false;
+    }
+    return true;
+}
+
+void DiffSH1106G::display()
+{
+    uint32_t startUs = micros();
+    renderer.render(getBuffer(), this);
+    uint32_t elapsedUs = micros() - startUs;
+    busyUs += elapsedUs;
+    Metrics::record(Metrics::STAGE_DISPLAY, elapsedUs);
+}
+
+bool DiffSH1106G::writeRun(int page, int column, const uint8_t *data, size_t len)
+{
+    column += SH1106_COLUMN_OFFSET;
+    wire->beginTransmission(address);
+    wire->write(0x00);                 // Command stream
+    wire->write(0xB0 | page);          // Page address
+    wire->write(0x10 | (column >> 4)); // Column, high nibble
+    wire->write(column & 0x0F);        // Column, low nibble
+    bool ok = wire->endTransmission() == 0;
+
+    // The column address advances by itself as data is written
+    while (ok && len > 0)
+    {
+        size_t n = len < I2C_DATA_CHUNK ? len : I2C_DATA_CHUNK;
+        wire->beginTransmission(address);
+        wire->write(0x40); // Data stream
+        wire->write(data, n);
+        ok = wire->endTransmission() == 0;
+        data += n;
+        len -= n;
+    }
+
+    if (!ok && busHz == FAST_HZ)
+    {
+        // The renderer resends everything next frame, at the slower clock
+        wire->setClock(STANDARD_HZ);
+        busHz = STANDARD_HZ;
+    }
+    return ok;
+}
+
+uint32_t DiffSH1106G::getBusHz() const
+{
+    return busHz;
+}
+
+uint64_t DiffSH1106G::getBusyUs() const
+{
+    return busyUs;
+}
+
+const PageDiffRenderer::Stats &DiffSH1106G::getStats() const
+{
+    return renderer.getStats();
+}
+
+// Create the display object. Every draw below still clears and redraws the
+// whole buffer; display() works out what actually changed.
+DiffSH1106G display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
 bool initOLED()
 {
@@ -217,3 +317,16 @@ void printText(const String &text)
 {
     display.print(text);
 }
+
+OledStats getOledStats()
+{
+    const PageDiffRenderer::Stats &stats = display.getStats();
+    OledStats out;
+    out.busHz = display.getBusHz();
+    out.frames = stats.frames;
+    out.unchanged = stats.unchanged;
+    out.busBytes = stats.busBytes;
+    out.failures = stats.failures;
+    out.busyUs = display.getBusyUs();
+    return out;
+}
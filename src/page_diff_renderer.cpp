@@ -0,0 +1,86 @@
+#include "page_diff_renderer.h"
+
+#include <string.h>
+
+PageDiffRenderer::PageDiffRenderer() : valid(false)
+{
+    memset(shown, 0, sizeof(shown));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void PageDiffRenderer::invalidate()
+{
+    valid = false;
+}
+
+bool PageDiffRenderer::sendRun(DisplayPanel *panel, int page, int start, int end, const uint8_t *row, size_t &sent)
+{
+    size_t len = end - start;
+    stats.runs++;
+    stats.dataBytes += len;
+    sent += len + RUN_OVERHEAD;
+    if (panel->writeRun(page, start, row + start, len))
+        return true;
+    stats.failures++;
+    return false;
+}
+
+size_t PageDiffRenderer::render(const uint8_t *frame, DisplayPanel *panel)
+{
+    size_t sent = 0;
+    bool ok = true;
+    stats.frames++;
+
+    for (int page = 0; page < PAGES && ok; page++)
+    {
+        const uint8_t *row = frame + page * WIDTH;
+        const uint8_t *old = shown + page * WIDTH;
+
+        if (!valid)
+        {
+            ok = sendRun(panel, page, 0, WIDTH, row, sent);
+            continue;
+        }
+
+        // Runs of changed columns, bridging gaps cheaper to resend than
+        // to address around
+        int start = -1;
+        int end = 0;
+        for (int x = 0; x < WIDTH && ok; x++)
+        {
+            if (row[x] == old[x])
+                continue;
+            if (start >= 0 && x - end > RUN_OVERHEAD)
+            {
+                ok = sendRun(panel, page, start, end, row, sent);
+                start = -1;
+            }
+            if (start < 0)
+                start = x;
+            end = x + 1;
+        }
+        if (start >= 0 && ok)
+            ok = sendRun(panel, page, start, end, row, sent);
+    }
+
+    if (ok)
+    {
+        memcpy(shown, frame, FRAME_BYTES);
+        valid = true;
+    }
+    else
+    {
+        // Part of the frame may have reached the panel: resend it all
+        valid = false;
+    }
+
+    if (sent == 0)
+        stats.unchanged++;
+    stats.busBytes += sent;
+    return sent;
+}
+
+const PageDiffRenderer::Stats &PageDiffRenderer::getStats() const
+{
+    return stats;
+}
@@ -0,0 +1,108 @@
+#include "query_string.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+size_t urlDecodeTo(const char *src, size_t len, char *out, size_t outSize)
+{
+    if (outSize == 0)
+        return 0;
+
+    size_t n = 0;
+    for (size_t i = 0; i < len && n + 1 < outSize; i++)
+    {
+        char c = src[i];
+        if (c == '+')
+        {
+            c = ' ';
+        }
+        else if (c == '%' && i + 2 < len)
+        {
+            int hi = hexValue(src[i + 1]);
+            int lo = hexValue(src[i + 2]);
+            if (hi >= 0 && lo >= 0)
+            {
+                c = (char)((hi << 4) | lo);
+                i += 2;
+            }
+        }
+        out[n++] = c;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+QueryString::QueryString(const char *q) : query(q ? q : "")
+{
+}
+
+const char *QueryString::find(const char *name, size_t &len) const
+{
+    size_t nameLen = strlen(name);
+    const char *p = query;
+    while (*p)
+    {
+        const char *end = strchr(p, '&');
+        if (!end)
+            end = p + strlen(p);
+
+        if ((size_t)(end - p) >= nameLen && strncmp(p, name, nameLen) == 0)
+        {
+            const char *after = p + nameLen;
+            if (after == end)
+            {
+                len = 0;
+                return after; // "flag" with no '='
+            }
+            if (*after == '=')
+            {
+                len = end - after - 1;
+                return after + 1;
+            }
+        }
+
+        p = *end ? end + 1 : end;
+    }
+    return nullptr;
+}
+
+bool QueryString::has(const char *name) const
+{
+    size_t len;
+    return find(name, len) != nullptr;
+}
+
+bool QueryString::get(const char *name, char *out, size_t outSize) const
+{
+    size_t len;
+    const char *value = find(name, len);
+    if (!value)
+        return false;
+    urlDecodeTo(value, len, out, outSize);
+    return true;
+}
+
+bool QueryString::getInt(const char *name, int &out) const
+{
+    char buf[16];
+    if (!get(name, buf, sizeof(buf)) || buf[0] == '\0')
+        return false;
+
+    char *end;
+    long value = strtol(buf, &end, 10);
+    if (*end != '\0')
+        return false;
+    out = (int)value;
+    return true;
+}
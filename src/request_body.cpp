@@ -0,0 +1,142 @@
+#include "request_body.h"
+#include "base64_encoder.h"
+#include <string.h>
+
+RequestBody::RequestBody()
+    : prefix(nullptr), prefixLen(0), frame(nullptr), frameLen(0), encoding(FRAME_RAW),
+      suffix(nullptr), suffixLen(0), segment(SEG_PREFIX), offset(0), produced(0), pendingLen(0), pendingPos(0)
+{
+}
+
+RequestBody::RequestBody(const char *prefix, size_t prefixLen,
+                         const uint8_t *frame, size_t frameLen, FrameEncoding encoding,
+                         const char *suffix, size_t suffixLen)
+    : prefix(prefix), prefixLen(prefixLen),
+      frame(frame), frameLen(frameLen), encoding(encoding),
+      suffix(suffix), suffixLen(suffixLen),
+      segment(SEG_PREFIX), offset(0), produced(0), pendingLen(0), pendingPos(0)
+{
+}
+
+void RequestBody::rewind()
+{
+    segment = SEG_PREFIX;
+    offset = 0;
+    produced = 0;
+    pendingLen = 0;
+    pendingPos = 0;
+}
+
+size_t RequestBody::frameEncodedLength() const
+{
+    return (encoding == FRAME_BASE64) ? base64EncodedLength(frameLen) : frameLen;
+}
+
+size_t RequestBody::size() const
+{
+    return prefixLen + frameEncodedLength() + suffixLen;
+}
+
+size_t RequestBody::remaining() const
+{
+    return size() - produced;
+}
+
+size_t RequestBody::readFrame(uint8_t *out, size_t maxLen)
+{
+    if (encoding == FRAME_RAW)
+    {
+        size_t n = frameLen - offset;
+        if (n > maxLen)
+            n = maxLen;
+        memcpy(out, frame + offset, n);
+        offset += n;
+        return n;
+    }
+
+    size_t n = 0;
+
+    // Drain a quad left over from the previous call first
+    while (pendingPos < pendingLen && n < maxLen)
+        out[n++] = pending[pendingPos++];
+    if (pendingPos < pendingLen)
+        return n;
+
+    // Encode as many whole groups as fit straight into the output
+    size_t groups = (maxLen - n) / 4;
+    size_t fullGroupsLeft = (frameLen - offset) / 3;
+    if (groups > fullGroupsLeft)
+        groups = fullGroupsLeft;
+    if (groups > 0)
+    {
+        n += base64Encode(frame + offset, groups * 3, (char *)out + n);
+        offset += groups * 3;
+    }
+
+    // Output too small for a whole quad, or only the padded tail is left
+    if (n < maxLen && offset < frameLen && (maxLen - n < 4 || frameLen - offset < 3))
+    {
+        size_t take = frameLen - offset;
+        if (take > 3)
+            take = 3;
+        pendingLen = base64Encode(frame + offset, take, pending);
+        pendingPos = 0;
+        offset += take;
+        while (pendingPos < pendingLen && n < maxLen)
+            out[n++] = pending[pendingPos++];
+    }
+
+    return n;
+}
+
+size_t RequestBody::read(uint8_t *out, size_t maxLen)
+{
+    size_t n = 0;
+
+    while (n < maxLen && segment != SEG_DONE)
+    {
+        switch (segment)
+        {
+        case SEG_PREFIX:
+        {
+            size_t take = prefixLen - offset;
+            if (take > maxLen - n)
+                take = maxLen - n;
+            memcpy(out + n, prefix + offset, take);
+            offset += take;
+            n += take;
+            if (offset == prefixLen)
+            {
+                segment = SEG_FRAME;
+                offset = 0;
+            }
+            break;
+        }
+        case SEG_FRAME:
+            n += readFrame(out + n, maxLen - n);
+            if (offset == frameLen && pendingPos == pendingLen)
+            {
+                segment = SEG_SUFFIX;
+                offset = 0;
+            }
+            break;
+        case SEG_SUFFIX:
+        {
+            size_t take = suffixLen - offset;
+            if (take > maxLen - n)
+                take = maxLen - n;
+            memcpy(out + n, suffix + offset, take);
+            offset += take;
+            n += take;
+            if (offset == suffixLen)
+                segment = SEG_DONE;
+            break;
+        }
+        case SEG_DONE:
+            break;
+        }
+    }
+
+    produced += n;
+    return n;
+}
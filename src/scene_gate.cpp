@@ -0,0 +1,107 @@
+#include "scene_gate.h"
+
+uint64_t sceneSignatureFromRgb565(const uint8_t *pixels, int width, int height)
+{
+    uint32_t cellSum[64] = {0};
+    uint32_t cellCount[64] = {0};
+
+    for (int y = 0; y < height; y++)
+    {
+        int cellRow = (y * 8) / height;
+        const uint8_t *row = pixels + (size_t)y * width * 2;
+        for (int x = 0; x < width; x++)
+        {
+            uint16_t c = ((uint16_t)row[x * 2] << 8) | row[x * 2 + 1];
+            uint32_t r = (c >> 11) & 0x1F;
+            uint32_t g = (c >> 5) & 0x3F;
+            uint32_t b = c & 0x1F;
+            // Integer luma approximation on the 565 components (scaled to 6 bits)
+            uint32_t luma = (r * 2 * 77 + g * 150 + b * 2 * 29) >> 8;
+
+            int cell = cellRow * 8 + (x * 8) / width;
+            cellSum[cell] += luma;
+            cellCount[cell]++;
+        }
+    }
+
+    uint32_t cellMean[64];
+    uint32_t total = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        cellMean[i] = cellCount[i] ? cellSum[i] / cellCount[i] : 0;
+        total += cellMean[i];
+    }
+    uint32_t mean = total / 64;
+
+    uint64_t signature = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        if (cellMean[i] > mean)
+            signature |= (uint64_t)1 << i;
+    }
+    return signature;
+}
+
+int sceneSignatureDistance(uint64_t a, uint64_t b)
+{
+    return __builtin_popcountll(a ^ b);
+}
+
+SceneGate::SceneGate()
+    : threshold(6), maxReuseMs(60000), hasReference(false), referenceSignature(0), referenceTimeMs(0),
+      lastDistance(-1), sent(0), skipped(0)
+{
+}
+
+void SceneGate::configure(int newThreshold, uint32_t newMaxReuseMs)
+{
+    threshold = newThreshold < 0 ? 0 : newThreshold;
+    maxReuseMs = newMaxReuseMs;
+}
+
+int SceneGate::getThreshold() const
+{
+    return threshold;
+}
+
+bool SceneGate::shouldSend(uint64_t signature, uint32_t nowMs)
+{
+    lastDistance = hasReference ? sceneSignatureDistance(signature, referenceSignature) : -1;
+
+    bool send = threshold == 0 || !hasReference ||
+                lastDistance > threshold ||
+                nowMs - referenceTimeMs >= maxReuseMs;
+
+    if (send)
+        sent++;
+    else
+        skipped++;
+    return send;
+}
+
+void SceneGate::recordDecision(uint64_t signature, uint32_t nowMs)
+{
+    hasReference = true;
+    referenceSignature = signature;
+    referenceTimeMs = nowMs;
+}
+
+void SceneGate::invalidate()
+{
+    hasReference = false;
+}
+
+uint32_t SceneGate::getSent() const
+{
+    return sent;
+}
+
+uint32_t SceneGate::getSkipped() const
+{
+    return skipped;
+}
+
+int SceneGate::getLastDistance() const
+{
+    return lastDistance;
+}
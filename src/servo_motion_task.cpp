@@ -0,0 +1,205 @@
+#include "servo_motion_task.h"
+#include "log.h"
+
+static const char *TAG = "servo";
+
+ServoMotionTask::ServoMotionTask()
+    : servo(nullptr), taskHandle(nullptr), doneCallback(nullptr), pendingCount(0), hasPending(false), settleMs(30),
+      waypointCount(0), waypointIndex(0), phase(PHASE_IDLE), segmentStartUs(0), commandStartUs(0), settleUntilUs(0),
+      position(0), attached(false), lastWritten(0), moving(false), movesCompleted(0), movesReplaced(0)
+{
+    portMUX_INITIALIZE(&lock);
+    limits.maxVelocity = 300;      // deg/s, below a hobby servo's ~0.1 s/60 deg
+    limits.maxAcceleration = 3000; // deg/s^2
+}
+
+bool ServoMotionTask::begin(ServoOutput *output, int startAngle, BaseType_t core)
+{
+    servo = output;
+    position = startAngle;
+    lastWritten = startAngle;
+
+    // Above the Arduino loop so steering keeps its frame rate while the
+    // loop is busy with network I/O
+    BaseType_t ok = xTaskCreatePinnedToCore(taskEntry, "servo_motion", 3072, this, 3, &taskHandle, core);
+    if (ok != pdPASS)
+    {
+        LOG_E(TAG, "Failed to create task");
+        taskHandle = nullptr;
+        return false;
+    }
+    LOG_I(TAG, "Motion task started on core %d", (int)core);
+    return true;
+}
+
+bool ServoMotionTask::setLimits(float maxVelocity, float maxAcceleration, uint32_t settle)
+{
+    // plan() divides by both; written so that NaN fails too
+    if (!(maxVelocity > 0) || !(maxAcceleration > 0))
+        return false;
+
+    portENTER_CRITICAL(&lock);
+    limits.maxVelocity = maxVelocity;
+    limits.maxAcceleration = maxAcceleration;
+    settleMs = settle;
+    portEXIT_CRITICAL(&lock);
+    return true;
+}
+
+void ServoMotionTask::setDoneCallback(DoneCallback callback)
+{
+    doneCallback = callback;
+}
+
+void ServoMotionTask::moveTo(int angle)
+{
+    moveThrough(&angle, 1);
+}
+
+void ServoMotionTask::moveThrough(const int *angles, int count)
+{
+    if (count < 1 || !taskHandle)
+        return;
+    if (count > MAX_WAYPOINTS)
+        count = MAX_WAYPOINTS;
+
+    portENTER_CRITICAL(&lock);
+    memcpy(pending, angles, sizeof(int) * count);
+    pendingCount = count;
+    hasPending = true;
+    moving = true;
+    portEXIT_CRITICAL(&lock);
+    xTaskNotifyGive(taskHandle);
+}
+
+bool ServoMotionTask::isMoving()
+{
+    return moving;
+}
+
+int ServoMotionTask::getPosition()
+{
+    return lastWritten;
+}
+
+uint32_t ServoMotionTask::getMovesCompleted()
+{
+    return movesCompleted;
+}
+
+uint32_t ServoMotionTask::getMovesReplaced()
+{
+    return movesReplaced;
+}
+
+void ServoMotionTask::taskEntry(void *arg)
+{
+    static_cast<ServoMotionTask *>(arg)->run();
+}
+
+void ServoMotionTask::run()
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true)
+    {
+        // Sleep until there is something to do
+        if (phase == PHASE_IDLE && !hasPending)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            lastWake = xTaskGetTickCount();
+        }
+        update(micros());
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(UPDATE_MS));
+    }
+}
+
+// Plans from where the servo is now toward the current waypoint
+void ServoMotionTask::startSegment(float velocity, uint32_t nowUs)
+{
+    portENTER_CRITICAL(&lock);
+    MotionProfile::Limits current = limits;
+    portEXIT_CRITICAL(&lock);
+
+    profile.plan(position, velocity, waypoints[waypointIndex], current);
+    segmentStartUs = nowUs;
+    phase = PHASE_MOVING;
+    if (!attached)
+    {
+        // Straight to where it is, before the driver's default pulse moves it
+        servo->attach();
+        servo->write(lastWritten);
+        attached = true;
+    }
+}
+
+void ServoMotionTask::update(uint32_t nowUs)
+{
+    bool replan = false;
+    portENTER_CRITICAL(&lock);
+    if (hasPending)
+    {
+        memcpy(waypoints, pending, sizeof(int) * pendingCount);
+        waypointCount = pendingCount;
+        hasPending = false;
+        replan = true;
+    }
+    uint32_t settle = settleMs;
+    portEXIT_CRITICAL(&lock);
+
+    if (replan)
+    {
+        float velocity = 0;
+        if (phase == PHASE_MOVING)
+            velocity = profile.velocityAt((nowUs - segmentStartUs) / 1e6f);
+        if (phase != PHASE_IDLE)
+            movesReplaced++;
+        waypointIndex = 0;
+        commandStartUs = nowUs;
+        startSegment(velocity, nowUs);
+    }
+
+    if (phase == PHASE_MOVING)
+    {
+        float t = (nowUs - segmentStartUs) / 1e6f;
+        position = profile.positionAt(t);
+        writeAngle(position);
+        if (profile.isDone(t))
+        {
+            phase = PHASE_SETTLING;
+            settleUntilUs = nowUs + settle * 1000;
+        }
+    }
+    else if (phase == PHASE_SETTLING && (int32_t)(nowUs - settleUntilUs) >= 0)
+    {
+        if (waypointIndex + 1 < waypointCount)
+        {
+            waypointIndex++;
+            startSegment(0, nowUs);
+            return;
+        }
+
+        // Detached servos don't buzz or draw holding current
+        servo->detach();
+        attached = false;
+        phase = PHASE_IDLE;
+        movesCompleted++;
+
+        portENTER_CRITICAL(&lock);
+        moving = hasPending;
+        portEXIT_CRITICAL(&lock);
+
+        uint32_t elapsedUs = nowUs - commandStartUs;
+        LOG_D(TAG, "At %d after %u ms", lastWritten, (unsigned)(elapsedUs / 1000));
+        if (doneCallback)
+            doneCallback(lastWritten, elapsedUs);
+    }
+}
+
+void ServoMotionTask::writeAngle(float angle)
+{
+    int rounded = (int)lroundf(angle);
+    if (rounded == lastWritten)
+        return;
+    servo->write(rounded);
+    lastWritten = rounded;
+}
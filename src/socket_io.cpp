@@ -0,0 +1,28 @@
+#include "socket_io.h"
+#include <errno.h>
+
+#ifdef ARDUINO
+#include <lwip/sockets.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+int socketWriteSome(WiFiClient &client, const uint8_t *data, size_t len)
+{
+    int fd = client.fd();
+    if (fd < 0)
+        return -1;
+    if (len == 0)
+        return 0;
+
+    int sent = send(fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent >= 0)
+        return sent;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+    return -1;
+}
@@ -0,0 +1,310 @@
+#include "stream_broadcaster.h"
+#include "socket_io.h"
+#include "log.h"
+
+static const char *TAG = "stream";
+
+// Disconnect a viewer whose socket has not accepted a byte for this long
+#define STREAM_STALL_TIMEOUT_MS 5000
+// Bytes written to one viewer per loop() call, so others get a turn
+#define STREAM_WRITE_SLICE 4096
+
+static const char STREAM_PART_TRAILER[] = "\r\n";
+
+StreamBroadcaster::StreamBroadcaster()
+    : camManager(nullptr), frameIntervalMs(50), lastGrabMs(0), taskHandle(nullptr), viewerCount(0), nextSeq(1),
+      latestSlot(-1)
+{
+    portMUX_INITIALIZE(&slotLock);
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        slots[i].data = nullptr;
+        slots[i].capacity = 0;
+        slots[i].len = 0;
+        slots[i].seq = 0;
+        slots[i].refs = 0;
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        viewers[i].active = false;
+        viewers[i].slot = -1;
+    }
+}
+
+void StreamBroadcaster::begin(ESP32CamManager *cam, uint32_t interval, BaseType_t core)
+{
+    camManager = cam;
+    frameIntervalMs = interval;
+
+    BaseType_t ok = xTaskCreatePinnedToCore(taskEntry, "stream_grab", 4096, this, 1, &taskHandle, core);
+    if (ok != pdPASS)
+    {
+        LOG_E(TAG, "Failed to create task, grabbing from loop()");
+        taskHandle = nullptr;
+    }
+}
+
+void StreamBroadcaster::taskEntry(void *arg)
+{
+    static_cast<StreamBroadcaster *>(arg)->run();
+}
+
+void StreamBroadcaster::run()
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true)
+    {
+        if (viewerCount > 0 && camManager->isCameraAvailable())
+            grabFrame();
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(frameIntervalMs));
+    }
+}
+
+bool StreamBroadcaster::addClient(WiFiClient &client)
+{
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        Viewer &v = viewers[i];
+        if (v.active)
+            continue;
+
+        client.print("HTTP/1.1 200 OK\r\n"
+                     "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+                     "Cache-Control: no-cache\r\n"
+                     "\r\n");
+
+        uint32_t now = millis();
+        v.client = client;
+        v.active = true;
+        viewerCount++;
+        v.slot = -1;
+        v.offset = 0;
+        v.headerLen = 0;
+        v.lastSeq = 0;
+        v.lastProgressMs = now;
+        v.framesSent = 0;
+        v.framesDropped = 0;
+        v.fpsWindowStart = now;
+        v.fpsWindowFrames = 0;
+        v.fps = 0;
+
+        LOG_I(TAG, "Viewer %d connected (%s)", i, client.remoteIP().toString().c_str());
+        return true;
+    }
+    return false;
+}
+
+int StreamBroadcaster::getClientCount()
+{
+    int count = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (viewers[i].active)
+            count++;
+    }
+    return count;
+}
+
+StreamClientStats StreamBroadcaster::getClientStats(int index)
+{
+    StreamClientStats stats;
+    Viewer &v = viewers[index];
+    stats.active = v.active;
+    stats.remoteIP = v.active ? v.client.remoteIP().toString() : String("");
+    stats.fps = v.fps;
+    stats.framesSent = v.active ? v.framesSent : 0;
+    stats.framesDropped = v.active ? v.framesDropped : 0;
+    return stats;
+}
+
+// Copy a new frame into a slot no viewer is reading. Not the latest one
+// either, so viewers can start on that while the camera is busy.
+bool StreamBroadcaster::grabFrame()
+{
+    int target = -1;
+    portENTER_CRITICAL(&slotLock);
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        if (slots[i].refs == 0 && i != latestSlot)
+        {
+            target = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&slotLock);
+    if (target < 0)
+        return false;
+
+    camera_fb_t *fb = camManager->getFrame(ESP32CamManager::PROFILE_STREAM);
+    if (!fb)
+        return false;
+
+    FrameSlot &slot = slots[target];
+    if (slot.capacity < fb->len)
+    {
+        size_t capacity = fb->len + fb->len / 4;
+        uint8_t *grown = (uint8_t *)(psramFound() ? ps_realloc(slot.data, capacity) : realloc(slot.data, capacity));
+        if (!grown)
+        {
+            camManager->releaseFrame(fb);
+            return false;
+        }
+        slot.data = grown;
+        slot.capacity = capacity;
+    }
+
+    memcpy(slot.data, fb->buf, fb->len);
+    size_t len = fb->len;
+    camManager->releaseFrame(fb);
+
+    portENTER_CRITICAL(&slotLock);
+    slot.len = len;
+    slot.seq = nextSeq++;
+    latestSlot = target;
+    portEXIT_CRITICAL(&slotLock);
+    return true;
+}
+
+// Takes a reference on the newest frame if the viewer has not had it yet;
+// checked and taken under one lock, so the task cannot reuse the slot between
+bool StreamBroadcaster::startLatestFrame(Viewer &v)
+{
+    portENTER_CRITICAL(&slotLock);
+    int slot = latestSlot;
+    if (slot < 0 || slots[slot].seq <= v.lastSeq)
+    {
+        portEXIT_CRITICAL(&slotLock);
+        return false;
+    }
+    slots[slot].refs++;
+    uint32_t seq = slots[slot].seq;
+    size_t len = slots[slot].len;
+    portEXIT_CRITICAL(&slotLock);
+
+    if (v.lastSeq > 0)
+        v.framesDropped += seq - v.lastSeq - 1;
+    v.slot = slot;
+    v.offset = 0;
+    v.lastSeq = seq;
+    v.headerLen = snprintf(v.header, sizeof(v.header),
+                           "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
+                           (unsigned)len);
+    return true;
+}
+
+void StreamBroadcaster::finishFrame(Viewer &v)
+{
+    if (v.slot >= 0)
+    {
+        portENTER_CRITICAL(&slotLock);
+        slots[v.slot].refs--;
+        portEXIT_CRITICAL(&slotLock);
+    }
+    v.slot = -1;
+    v.offset = 0;
+}
+
+void StreamBroadcaster::dropViewer(Viewer &v)
+{
+    finishFrame(v);
+    v.client.stop();
+    v.active = false;
+    viewerCount--;
+    LOG_I(TAG, "Viewer disconnected");
+}
+
+// Send the next piece of the viewer's current part:
+// [part header][JPEG bytes][trailer], tracked by a single offset
+void StreamBroadcaster::pump(Viewer &v, uint32_t now)
+{
+    const FrameSlot &slot = slots[v.slot];
+    size_t trailerLen = sizeof(STREAM_PART_TRAILER) - 1;
+    size_t total = v.headerLen + slot.len + trailerLen;
+    size_t budget = STREAM_WRITE_SLICE;
+
+    while (v.offset < total && budget > 0)
+    {
+        const uint8_t *src;
+        size_t avail;
+        if (v.offset < v.headerLen)
+        {
+            src = (const uint8_t *)v.header + v.offset;
+            avail = v.headerLen - v.offset;
+        }
+        else if (v.offset < v.headerLen + slot.len)
+        {
+            src = slot.data + (v.offset - v.headerLen);
+            avail = v.headerLen + slot.len - v.offset;
+        }
+        else
+        {
+            src = (const uint8_t *)STREAM_PART_TRAILER + (v.offset - v.headerLen - slot.len);
+            avail = total - v.offset;
+        }
+        if (avail > budget)
+            avail = budget;
+
+        int written = socketWriteSome(v.client, src, avail);
+        if (written < 0)
+        {
+            dropViewer(v);
+            return;
+        }
+        if (written == 0)
+            break; // Socket buffer full, try again next loop
+
+        v.offset += written;
+        budget -= written;
+        v.lastProgressMs = now;
+    }
+
+    if (v.offset == total)
+    {
+        finishFrame(v);
+        v.framesSent++;
+        v.fpsWindowFrames++;
+    }
+    else if (now - v.lastProgressMs > STREAM_STALL_TIMEOUT_MS)
+    {
+        dropViewer(v);
+    }
+}
+
+void StreamBroadcaster::loop()
+{
+    if (!camManager || getClientCount() == 0)
+        return;
+
+    uint32_t now = millis();
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (viewers[i].active && !viewers[i].client.connected())
+            dropViewer(viewers[i]);
+    }
+
+    if (!taskHandle && now - lastGrabMs >= frameIntervalMs && grabFrame())
+        lastGrabMs = now;
+
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        Viewer &v = viewers[i];
+        if (!v.active)
+            continue;
+
+        // Viewers still busy with an older frame skip ahead to the newest
+        // one once they are done
+        if (v.slot < 0)
+            startLatestFrame(v);
+
+        if (v.slot >= 0)
+            pump(v, now);
+
+        if (v.active && now - v.fpsWindowStart >= 1000)
+        {
+            v.fps = v.fpsWindowFrames * 1000.0f / (now - v.fpsWindowStart);
+            v.fpsWindowStart = now;
+            v.fpsWindowFrames = 0;
+        }
+    }
+}
@@ -0,0 +1,384 @@
+#include "tls_session.h"
+
+#include <errno.h>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <esp_crt_bundle.h>
+#include <lwip/sockets.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/error.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#else
+#include <arpa/inet.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const char *trustedPem = nullptr;
+
+void TlsSession::setTrustedCerts(const char *pem)
+{
+    trustedPem = pem;
+}
+
+TlsSession::TlsSession() : impl(nullptr)
+{
+    lastError[0] = '\0';
+}
+
+TlsSession::~TlsSession()
+{
+    end();
+}
+
+bool TlsSession::isOpen() const
+{
+    return impl != nullptr;
+}
+
+const char *TlsSession::getLastError() const
+{
+    return lastError;
+}
+
+#ifdef ARDUINO
+
+// mbedtls, as ESP-IDF builds it, with the socket calls done here so that
+// none of them blocks
+struct TlsSession::Impl
+{
+    int sock;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt roots;
+};
+
+static int bioSend(void *context, const unsigned char *buf, size_t len)
+{
+    int n = send(*(int *)context, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n >= 0)
+        return n;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+static int bioRecv(void *context, unsigned char *buf, size_t len)
+{
+    int n = recv(*(int *)context, buf, len, MSG_DONTWAIT);
+    if (n >= 0)
+        return n; // 0: the peer closed
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+static TlsSession::Result resultOf(int ret, char *error, size_t errorSize)
+{
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+        return TlsSession::TLS_WANT;
+    if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY || ret == MBEDTLS_ERR_SSL_CONN_EOF)
+        return TlsSession::TLS_CLOSED;
+    mbedtls_strerror(ret, error, errorSize);
+    return TlsSession::TLS_ERROR;
+}
+
+bool TlsSession::begin(int sock, const char *host)
+{
+    end();
+    impl = new (std::nothrow) Impl;
+    if (!impl)
+    {
+        strcpy(lastError, "out of memory");
+        return false;
+    }
+    impl->sock = sock;
+    mbedtls_ssl_init(&impl->ssl);
+    mbedtls_ssl_config_init(&impl->conf);
+    mbedtls_entropy_init(&impl->entropy);
+    mbedtls_ctr_drbg_init(&impl->drbg);
+    mbedtls_x509_crt_init(&impl->roots);
+
+    int ret = mbedtls_ctr_drbg_seed(&impl->drbg, mbedtls_entropy_func, &impl->entropy, nullptr, 0);
+    if (ret == 0)
+        ret = mbedtls_ssl_config_defaults(&impl->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret == 0)
+    {
+        mbedtls_ssl_conf_authmode(&impl->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_rng(&impl->conf, mbedtls_ctr_drbg_random, &impl->drbg);
+        if (trustedPem)
+        {
+            ret = mbedtls_x509_crt_parse(&impl->roots, (const unsigned char *)trustedPem, strlen(trustedPem) + 1);
+            if (ret == 0)
+                mbedtls_ssl_conf_ca_chain(&impl->conf, &impl->roots, nullptr);
+        }
+        else
+        {
+            ret = esp_crt_bundle_attach(&impl->conf);
+        }
+    }
+    if (ret == 0)
+        ret = mbedtls_ssl_setup(&impl->ssl, &impl->conf);
+    if (ret == 0)
+        ret = mbedtls_ssl_set_hostname(&impl->ssl, host);
+    if (ret != 0)
+    {
+        mbedtls_strerror(ret, lastError, sizeof(lastError));
+        end();
+        return false;
+    }
+
+    mbedtls_ssl_set_bio(&impl->ssl, &impl->sock, bioSend, bioRecv, nullptr);
+    return true;
+}
+
+TlsSession::Result TlsSession::handshake()
+{
+    if (!impl)
+        return TLS_ERROR;
+    int ret = mbedtls_ssl_handshake(&impl->ssl);
+    return ret == 0 ? TLS_OK : resultOf(ret, lastError, sizeof(lastError));
+}
+
+TlsSession::Result TlsSession::write(const uint8_t *data, size_t len, size_t &written)
+{
+    written = 0;
+    if (!impl)
+        return TLS_ERROR;
+    int ret = mbedtls_ssl_write(&impl->ssl, data, len);
+    if (ret > 0)
+    {
+        written = ret;
+        return TLS_OK;
+    }
+    return ret == 0 ? TLS_WANT : resultOf(ret, lastError, sizeof(lastError));
+}
+
+TlsSession::Result TlsSession::read(uint8_t *buf, size_t len, size_t &received)
+{
+    received = 0;
+    if (!impl)
+        return TLS_ERROR;
+    int ret = mbedtls_ssl_read(&impl->ssl, buf, len);
+    if (ret > 0)
+    {
+        received = ret;
+        return TLS_OK;
+    }
+    return ret == 0 ? TLS_CLOSED : resultOf(ret, lastError, sizeof(lastError));
+}
+
+void TlsSession::end()
+{
+    if (!impl)
+        return;
+    mbedtls_ssl_close_notify(&impl->ssl); // Best effort: the socket is closed next
+    mbedtls_ssl_free(&impl->ssl);
+    mbedtls_ssl_config_free(&impl->conf);
+    mbedtls_ctr_drbg_free(&impl->drbg);
+    mbedtls_entropy_free(&impl->entropy);
+    mbedtls_x509_crt_free(&impl->roots);
+    delete impl;
+    impl = nullptr;
+}
+
+#else
+
+// OpenSSL on a host, through a BIO that does its own non-blocking socket
+// calls (MSG_NOSIGNAL: a closed peer is an error, not SIGPIPE)
+struct TlsSession::Impl
+{
+    SSL *ssl;
+};
+
+static int bioWrite(BIO *bio, const char *data, int len)
+{
+    BIO_clear_retry_flags(bio);
+    int n = send((int)(intptr_t)BIO_get_data(bio), data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        BIO_set_retry_write(bio);
+    return n;
+}
+
+static int bioRead(BIO *bio, char *buf, int len)
+{
+    BIO_clear_retry_flags(bio);
+    int n = recv((int)(intptr_t)BIO_get_data(bio), buf, len, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        BIO_set_retry_read(bio);
+    return n;
+}
+
+static long bioCtrl(BIO *bio, int cmd, long num, void *ptr)
+{
+    return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+static int bioCreate(BIO *bio)
+{
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+static BIO_METHOD *socketMethod()
+{
+    static BIO_METHOD *method = nullptr;
+    if (!method)
+    {
+        method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "non-blocking socket");
+        BIO_meth_set_write(method, bioWrite);
+        BIO_meth_set_read(method, bioRead);
+        BIO_meth_set_ctrl(method, bioCtrl);
+        BIO_meth_set_create(method, bioCreate);
+    }
+    return method;
+}
+
+// One context per set of trusted roots, rebuilt when they change
+static SSL_CTX *clientContext()
+{
+    static SSL_CTX *context = nullptr;
+    static const char *contextPem = nullptr;
+    if (context && contextPem == trustedPem)
+        return context;
+
+    SSL_CTX_free(context);
+    context = SSL_CTX_new(TLS_client_method());
+    contextPem = trustedPem;
+    if (!context)
+        return nullptr;
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    SSL_CTX_set_verify(context, SSL_VERIFY_PEER, nullptr);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    SSL_CTX_set_options(context, SSL_OP_IGNORE_UNEXPECTED_EOF); // Bodies may end at the close
+#endif
+    if (trustedPem)
+    {
+        BIO *pem = BIO_new_mem_buf(trustedPem, -1);
+        X509_STORE *store = SSL_CTX_get_cert_store(context);
+        X509 *cert;
+        while ((cert = PEM_read_bio_X509(pem, nullptr, nullptr, nullptr)) != nullptr)
+        {
+            X509_STORE_add_cert(store, cert);
+            X509_free(cert);
+        }
+        BIO_free(pem);
+        ERR_clear_error(); // End of the PEM text
+    }
+    else
+    {
+        SSL_CTX_set_default_verify_paths(context);
+    }
+    return context;
+}
+
+static TlsSession::Result resultOf(SSL *ssl, int ret, char *error, size_t errorSize)
+{
+    switch (SSL_get_error(ssl, ret))
+    {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        return TlsSession::TLS_WANT;
+    case SSL_ERROR_ZERO_RETURN:
+        return TlsSession::TLS_CLOSED;
+    default:
+        break;
+    }
+
+    long verify = SSL_get_verify_result(ssl);
+    unsigned long code = ERR_get_error();
+    if (verify != X509_V_OK)
+        snprintf(error, errorSize, "certificate: %s", X509_verify_cert_error_string(verify));
+    else if (code)
+        ERR_error_string_n(code, error, errorSize);
+    else
+        snprintf(error, errorSize, "socket: %s", strerror(errno));
+    ERR_clear_error();
+    return TlsSession::TLS_ERROR;
+}
+
+bool TlsSession::begin(int sock, const char *host)
+{
+    end();
+    SSL_CTX *context = clientContext();
+    SSL *ssl = context ? SSL_new(context) : nullptr;
+    BIO *bio = ssl ? BIO_new(socketMethod()) : nullptr;
+    if (!bio)
+    {
+        SSL_free(ssl);
+        ERR_error_string_n(ERR_get_error(), lastError, sizeof(lastError));
+        return false;
+    }
+    BIO_set_data(bio, (void *)(intptr_t)sock);
+    SSL_set_bio(ssl, bio, bio);
+    SSL_set_connect_state(ssl);
+
+    // The certificate must name the host: as an IP address or a DNS name
+    unsigned char ip[16];
+    if (inet_pton(AF_INET, host, ip) == 1 || inet_pton(AF_INET6, host, ip) == 1)
+    {
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), host);
+    }
+    else
+    {
+        SSL_set_tlsext_host_name(ssl, host);
+        SSL_set1_host(ssl, host);
+    }
+
+    impl = new Impl;
+    impl->ssl = ssl;
+    return true;
+}
+
+TlsSession::Result TlsSession::handshake()
+{
+    if (!impl)
+        return TLS_ERROR;
+    ERR_clear_error();
+    int ret = SSL_do_handshake(impl->ssl);
+    return ret == 1 ? TLS_OK : resultOf(impl->ssl, ret, lastError, sizeof(lastError));
+}
+
+TlsSession::Result TlsSession::write(const uint8_t *data, size_t len, size_t &written)
+{
+    written = 0;
+    if (!impl)
+        return TLS_ERROR;
+    ERR_clear_error();
+    int ret = SSL_write_ex(impl->ssl, data, len, &written);
+    return ret == 1 ? TLS_OK : resultOf(impl->ssl, ret, lastError, sizeof(lastError));
+}
+
+TlsSession::Result TlsSession::read(uint8_t *buf, size_t len, size_t &received)
+{
+    received = 0;
+    if (!impl)
+        return TLS_ERROR;
+    ERR_clear_error();
+    int ret = SSL_read_ex(impl->ssl, buf, len, &received);
+    return ret == 1 ? TLS_OK : resultOf(impl->ssl, ret, lastError, sizeof(lastError));
+}
+
+void TlsSession::end()
+{
+    if (!impl)
+        return;
+    SSL_shutdown(impl->ssl); // Best effort: the socket is closed next
+    SSL_free(impl->ssl);
+    ERR_clear_error();
+    delete impl;
+    impl = nullptr;
+}
+
+#endif
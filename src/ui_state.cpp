@@ -0,0 +1,71 @@
+#include "ui_state.h"
+
+#include <string.h>
+
+void UiScreen::clear(uint8_t value)
+{
+    memset(this, 0, sizeof(*this));
+    layout = value;
+}
+
+void UiScreen::setLine(int index, const char *text)
+{
+    if (index < 0 || index >= LINES)
+        return;
+    memset(lines[index], 0, LINE_MAX);
+    if (text)
+        strncpy(lines[index], text, LINE_MAX - 1);
+}
+
+bool UiScreen::equals(const UiScreen &other) const
+{
+    return memcmp(this, &other, sizeof(*this)) == 0;
+}
+
+UiState::UiState() : hasTransient(false), transientUntilMs(0)
+{
+    base.clear(UiScreen::LAYOUT_NONE);
+    transient.clear(UiScreen::LAYOUT_NONE);
+    drawn.clear(UiScreen::LAYOUT_NONE);
+}
+
+void UiState::apply(const UiUpdate &update, uint32_t nowMs)
+{
+    if (update.holdMs == 0)
+    {
+        base = update.screen;
+        return;
+    }
+    transient = update.screen;
+    hasTransient = true;
+    transientUntilMs = nowMs + update.holdMs;
+}
+
+void UiState::expire(uint32_t nowMs)
+{
+    if (hasTransient && (int32_t)(nowMs - transientUntilMs) >= 0)
+        hasTransient = false;
+}
+
+int32_t UiState::msUntilExpiry(uint32_t nowMs) const
+{
+    if (!hasTransient)
+        return -1;
+    int32_t left = (int32_t)(transientUntilMs - nowMs);
+    return left > 0 ? left : 0;
+}
+
+const UiScreen &UiState::visible() const
+{
+    return hasTransient ? transient : base;
+}
+
+bool UiState::needsDraw() const
+{
+    return !visible().equals(drawn);
+}
+
+void UiState::markDrawn()
+{
+    drawn = visible();
+}
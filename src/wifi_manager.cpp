@@ -1,13 +1,18 @@
 #include "wifi_manager.h"
+#include "log.h"
 
-WiFiManager::WiFiManager() : wifiConfigured(false), server(nullptr), statusCallback(nullptr), displayCallback(nullptr) {
+static const char *TAG = "wifi";
+
+WiFiManager::WiFiManager() : config(nullptr), wifiConfigured(false), server(nullptr), statusCallback(nullptr), displayCallback(nullptr) {
     wifi_ssid = "";
     wifi_password = "";
 }
 
-bool WiFiManager::begin(int serverPort) {
-    // Load WiFi credentials from EEPROM
-    wifiConfigured = loadCredentialsFromEEPROM();
+bool WiFiManager::begin(ConfigStore *settings, int serverPort) {
+    config = settings;
+
+    // Load WiFi credentials from the stored config
+    wifiConfigured = loadCredentials();
     
     if (!wifiConfigured) {
         getCredentialsFromSerial();
@@ -28,13 +33,8 @@ bool WiFiManager::begin(int serverPort) {
 
 bool WiFiManager::connect() {
     // Connect to Wi-Fi with debugging
-    Serial.println("==========================================");
-    Serial.println("         ESP32-S3 WiFi CONNECTION        ");
-    Serial.println("==========================================");
-    Serial.printf("WiFi SSID: %s\n", wifi_ssid.c_str());
-    Serial.printf("WiFi Password: %s\n", wifi_password.length() > 0 ? "***configured***" : "***NOT SET***");
-    Serial.printf("WiFi Password Length: %d characters\n", wifi_password.length());
-    Serial.println("==========================================");
+    LOG_I(TAG, "SSID: %s, password %s (%d characters)", wifi_ssid.c_str(),
+          wifi_password.length() > 0 ? "configured" : "NOT SET", wifi_password.length());
 
     displayMultiLine("WiFi Debug:",
                      "SSID: " + wifi_ssid,
@@ -42,7 +42,7 @@ bool WiFiManager::connect() {
                      "");
     delay(2000);
 
-    Serial.println("Connecting to Wi-Fi...");
+    LOG_I(TAG, "Connecting...");
     displayText("Connecting to Wi-Fi...");
 
     WiFi.begin(wifi_ssid.c_str(), wifi_password.c_str());
@@ -50,7 +50,6 @@ bool WiFiManager::connect() {
     int wifiAttempts = 0;
     while (WiFi.status() != WL_CONNECTED && wifiAttempts < 30) {
         delay(500);
-        Serial.print(".");
         wifiAttempts++;
 
         // Update display every 5 attempts
@@ -60,22 +59,15 @@ bool WiFiManager::connect() {
 
         // Print detailed status every 5 attempts
         if (wifiAttempts % 5 == 0) {
-            Serial.printf("\nWiFi Status: %d (attempt %d/30)\n", WiFi.status(), wifiAttempts);
-            Serial.printf("MAC Address: %s\n", WiFi.macAddress().c_str());
+            LOG_D(TAG, "Status: %d (attempt %d/30), MAC %s", WiFi.status(), wifiAttempts, WiFi.macAddress().c_str());
         }
     }
 
     if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n==========================================");
-        Serial.println("         WiFi CONNECTED SUCCESSFULLY     ");
-        Serial.println("==========================================");
-        Serial.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
-        Serial.printf("Gateway: %s\n", WiFi.gatewayIP().toString().c_str());
-        Serial.printf("Subnet: %s\n", WiFi.subnetMask().toString().c_str());
-        Serial.printf("DNS: %s\n", WiFi.dnsIP().toString().c_str());
-        Serial.printf("RSSI: %d dBm\n", WiFi.RSSI());
-        Serial.printf("Channel: %d\n", WiFi.channel());
-        Serial.println("==========================================");
+        LOG_I(TAG, "Connected: IP %s, gateway %s, subnet %s, DNS %s",
+              WiFi.localIP().toString().c_str(), WiFi.gatewayIP().toString().c_str(),
+              WiFi.subnetMask().toString().c_str(), WiFi.dnsIP().toString().c_str());
+        LOG_I(TAG, "RSSI %d dBm, channel %d", WiFi.RSSI(), WiFi.channel());
 
         // Call status callback if registered
         if (statusCallback) {
@@ -84,11 +76,7 @@ bool WiFiManager::connect() {
 
         return true;
     } else {
-        Serial.println("\n==========================================");
-        Serial.println("         WiFi CONNECTION FAILED          ");
-        Serial.println("==========================================");
-        Serial.printf("Final Status: %d\n", WiFi.status());
-        Serial.println("WiFi connection failed! Clearing credentials and restarting...");
+        LOG_E(TAG, "Connection failed (status %d), clearing credentials and restarting", WiFi.status());
         clearCredentials();
         displayCenteredText("WiFi Failed!");
         delay(2000);
@@ -104,78 +92,49 @@ void WiFiManager::disconnect() {
     }
 }
 
-void WiFiManager::saveCredentialsToEEPROM(String ssid, String password) {
-    Serial.println("Saving WiFi credentials to EEPROM...");
+void WiFiManager::saveCredentials(String ssid, String password) {
+    LOG_I(TAG, "Saving credentials");
 
-    // Set flag to indicate WiFi is configured
-    EEPROM.write(EEPROM_WIFI_FLAG, 1);
+    BotConfig settings = config->get();
+    settings.wifiConfigured = 1;
+    strncpy(settings.wifiSsid, ssid.c_str(), sizeof(settings.wifiSsid) - 1);
+    strncpy(settings.wifiPassword, password.c_str(), sizeof(settings.wifiPassword) - 1);
 
-    // Save SSID
-    for (int i = 0; i < 32; i++) {
-        if (i < ssid.length()) {
-            EEPROM.write(EEPROM_SSID_START + i, ssid[i]);
-        } else {
-            EEPROM.write(EEPROM_SSID_START + i, 0);
-        }
-    }
-
-    // Save Password
-    for (int i = 0; i < 64; i++) {
-        if (i < password.length()) {
-            EEPROM.write(EEPROM_PASS_START + i, password[i]);
-        } else {
-            EEPROM.write(EEPROM_PASS_START + i, 0);
-        }
+    if (config->save(settings)) {
+        LOG_I(TAG, "Credentials saved");
+    } else {
+        LOG_E(TAG, "Saving credentials failed");
     }
-
-    EEPROM.commit();
-    Serial.println("WiFi credentials saved!");
 }
 
-bool WiFiManager::loadCredentialsFromEEPROM() {
-    Serial.println("Loading WiFi credentials from EEPROM...");
+bool WiFiManager::loadCredentials() {
+    const BotConfig &settings = config->get();
 
     // Check if WiFi is configured
-    if (EEPROM.read(EEPROM_WIFI_FLAG) != 1) {
-        Serial.println("No WiFi credentials found in EEPROM");
+    if (settings.wifiConfigured != 1 || settings.wifiSsid[0] == 0) {
+        LOG_I(TAG, "No stored credentials");
         return false;
     }
 
-    // Load SSID
-    wifi_ssid = "";
-    for (int i = 0; i < 32; i++) {
-        char c = EEPROM.read(EEPROM_SSID_START + i);
-        if (c == 0) break;
-        wifi_ssid += c;
-    }
-
-    // Load Password
-    wifi_password = "";
-    for (int i = 0; i < 64; i++) {
-        char c = EEPROM.read(EEPROM_PASS_START + i);
-        if (c == 0) break;
-        wifi_password += c;
-    }
-
-    if (wifi_ssid.length() > 0) {
-        Serial.println("WiFi credentials loaded from EEPROM");
-        Serial.println("SSID: " + wifi_ssid);
-        return true;
-    }
-
-    return false;
+    wifi_ssid = settings.wifiSsid;
+    wifi_password = settings.wifiPassword;
+    LOG_I(TAG, "Credentials loaded (SSID %s)", wifi_ssid.c_str());
+    return true;
 }
 
 void WiFiManager::clearCredentials() {
-    Serial.println("Clearing WiFi credentials...");
-    EEPROM.write(EEPROM_WIFI_FLAG, 0);
-    EEPROM.commit();
+    BotConfig settings = config->get();
+    settings.wifiConfigured = 0;
+    memset(settings.wifiSsid, 0, sizeof(settings.wifiSsid));
+    memset(settings.wifiPassword, 0, sizeof(settings.wifiPassword));
+    config->save(settings);
     wifi_ssid = "";
     wifi_password = "";
     wifiConfigured = false;
-    Serial.println("WiFi credentials cleared!");
+    LOG_I(TAG, "Credentials cleared");
 }
 
+// Interactive prompt: talks to Serial directly rather than through the log
 void WiFiManager::getCredentialsFromSerial() {
     Serial.println("\n==========================================");
     Serial.println("         WiFi CONFIGURATION SETUP        ");
@@ -217,7 +176,7 @@ void WiFiManager::getCredentialsFromSerial() {
     confirm.toLowerCase();
 
     if (confirm == "y" || confirm == "yes") {
-        saveCredentialsToEEPROM(wifi_ssid, wifi_password);
+        saveCredentials(wifi_ssid, wifi_password);
         wifiConfigured = true;
         Serial.println("Credentials saved! Restarting...");
         displayCenteredText("Saved! Restarting...");
@@ -291,8 +250,7 @@ WiFiServer* WiFiManager::getServer() {
 bool WiFiManager::startServer() {
     if (server && isConnected()) {
         server->begin();
-        Serial.println("Web server started!");
-        Serial.printf("Access at: http://%s\n", getLocalIP().c_str());
+        LOG_I(TAG, "Web server at http://%s", getLocalIP().c_str());
         return true;
     }
     return false;
@@ -301,7 +259,7 @@ bool WiFiManager::startServer() {
 void WiFiManager::stopServer() {
     if (server) {
         server->stop();
-        Serial.println("Web server stopped!");
+        LOG_I(TAG, "Web server stopped");
     }
 }
 
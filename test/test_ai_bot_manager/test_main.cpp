@@ -0,0 +1,803 @@
+// AIBotManager's whole cycle on the host: file frames, settings in memory,
+// and scripts/mock_backend.py started by each test on a free loopback port
+// with the faults it needs. Skipped where python3 is not installed; the https
+// tests also need the openssl command for a throwaway certificate.
+//   pio test -e native -f test_ai_bot_manager
+
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "ai_bot_manager.h"
+#include "config_store.h"
+#include "hal_native.h"
+#include "log.h"
+#include "tls_session.h"
+
+// scripts/mock_backend.py as a child process, killed by stop(). What it
+// prints is kept for output().
+class MockBackend
+{
+public:
+    MockBackend() : pid(-1), port(0), secure(false) {}
+    ~MockBackend() { stop(); }
+
+    // Extra mock_backend.py options, nullptr-terminated
+    bool start(const char *const *options)
+    {
+        port = freePort();
+        std::string portText = std::to_string(port);
+        std::vector<const char *> argv = {"python3", "scripts/mock_backend.py", "--host", "127.0.0.1",
+                                          "--port", portText.c_str(), "--think", "0.05"};
+        secure = false;
+        for (const char *const *option = options; option && *option; option++)
+        {
+            argv.push_back(*option);
+            if (strcmp(*option, "--tls-cert") == 0)
+                secure = true;
+        }
+        argv.push_back(nullptr);
+
+        char path[] = "/tmp/test_ai_bot_manager_mock_XXXXXX";
+        close(mkstemp(path));
+        logPath = path;
+
+        fflush(nullptr); // Or the child's freopen() writes out our buffered output again
+        pid = fork();
+        if (pid == 0)
+        {
+            freopen(logPath.c_str(), "w", stdout);
+            freopen("/dev/null", "w", stderr);
+            execvp(argv[0], (char *const *)argv.data());
+            _exit(127);
+        }
+
+        // Up once it accepts connections
+        for (int i = 0; i < 300; i++)
+        {
+            if (accepts())
+                return true;
+            int status;
+            if (waitpid(pid, &status, WNOHANG) == pid)
+            {
+                pid = -1;
+                return false;
+            }
+            usleep(10000);
+        }
+        return false;
+    }
+
+    void stop()
+    {
+        if (pid <= 0)
+            return;
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+        pid = -1;
+        unlink(logPath.c_str());
+    }
+
+    std::string output() const
+    {
+        std::string text;
+        FILE *f = fopen(logPath.c_str(), "r");
+        if (!f)
+            return text;
+        char buffer[1024];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            text.append(buffer, n);
+        fclose(f);
+        return text;
+    }
+
+    // The certificate names localhost, so https goes there by name
+    String baseUrl() const
+    {
+        return (secure ? "https://localhost:" : "http://127.0.0.1:") + String((unsigned)port);
+    }
+    uint16_t getPort() const { return port; }
+
+    static uint16_t freePort()
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = loopback(0);
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (struct sockaddr *)&addr, &len);
+        close(fd);
+        return ntohs(addr.sin_port);
+    }
+
+private:
+    pid_t pid;
+    uint16_t port;
+    bool secure;
+    std::string logPath;
+
+    static struct sockaddr_in loopback(uint16_t port)
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return addr;
+    }
+
+    bool accepts()
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = loopback(port);
+        bool ok = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        close(fd);
+        return ok;
+    }
+};
+
+// Settings that start out erased, as on a new board
+class MemoryStorage : public Storage
+{
+public:
+    MemoryStorage() { memset(bytes, 0xFF, sizeof(bytes)); }
+
+    size_t size() override { return sizeof(bytes); }
+    uint8_t read(size_t addr) override { return addr < sizeof(bytes) ? bytes[addr] : 0xFF; }
+    void write(size_t addr, uint8_t value) override
+    {
+        if (addr < sizeof(bytes))
+            bytes[addr] = value;
+    }
+    bool commit() override { return true; }
+
+private:
+    uint8_t bytes[ConfigStore::STORAGE_SIZE];
+};
+
+static MockBackend backend;
+static MemoryStorage *storage;
+static ConfigStore *config;
+static JpegFileFrameSource *frames;
+static HostLink *hostLink;
+static HostClock hostClock;
+static AIBotManager *bot;
+static std::vector<std::string> statuses;
+static std::vector<std::string> decisions; // Status when each decision came
+static std::vector<uint8_t> jpeg; // The frame every cycle sends
+
+static void onBotStatus(String status)
+{
+    statuses.push_back(status.c_str());
+}
+
+static void onBotDecision(const String &direction, float distance, bool goalFound)
+{
+    decisions.push_back(bot->getLastBotStatus().c_str());
+}
+
+static bool startBackend(const char *const *options = nullptr)
+{
+    if (system("python3 -c '' 2>/dev/null") != 0)
+        return false;
+    return backend.start(options);
+}
+
+static const char CERT_PATH[] = "/tmp/test_ai_bot_manager_cert.pem";
+static const char KEY_PATH[] = "/tmp/test_ai_bot_manager_key.pem";
+static std::string certPem; // Kept alive for TlsSession::setTrustedCerts()
+
+// A self-signed certificate for localhost, made once; false without openssl
+static bool makeCertificate()
+{
+    if (!certPem.empty())
+        return true;
+    std::string command = std::string("openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes") +
+                          " -days 1 -subj /CN=localhost -addext subjectAltName=DNS:localhost -keyout " + KEY_PATH +
+                          " -out " + CERT_PATH + " >/dev/null 2>&1";
+    if (system(command.c_str()) != 0)
+        return false;
+    FILE *f = fopen(CERT_PATH, "r");
+    if (!f)
+        return false;
+    char buffer[1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        certPem.append(buffer, n);
+    fclose(f);
+    return !certPem.empty();
+}
+
+static bool startHttpsBackend()
+{
+    const char *const options[] = {"--tls-cert", CERT_PATH, "--tls-key", KEY_PATH, nullptr};
+    return makeCertificate() && startBackend(options);
+}
+
+// Brings up the bot on the backend as the web page would set it up
+static void startBot(AIBotManager::UploadMode mode = AIBotManager::UPLOAD_JSON, bool stream = false)
+{
+    bot->begin(frames, hostLink, config, &hostClock);
+    bot->setStatusCallback(onBotStatus);
+    bot->setDecisionCallback(onBotDecision);
+    bot->setApiConfig(backend.baseUrl(), "/message", "/health", mode, stream);
+    bot->setCadence(0, 50);
+    bot->startBot();
+    TEST_ASSERT_TRUE(bot->isBotRunning());
+}
+
+// One cycle the way main.cpp's loop() runs it: loop() until the request
+// the bot started has finished. Returns the status it ended with.
+static String runCycle()
+{
+    uint32_t start = hostMillis();
+    while (bot->getNextRequestIn() > 0)
+        hostClock.delay(1);
+    bot->loop();
+    while (bot->isRequestInFlight())
+    {
+        TEST_ASSERT_TRUE_MESSAGE(hostMillis() - start < 20000, "cycle did not finish");
+        hostClock.delay(1);
+        bot->loop();
+    }
+    return bot->getLastBotStatus();
+}
+
+// A health check run from loop() as main.cpp would: returns its result
+static AIBotManager::HealthCheck runHealthCheck()
+{
+    uint32_t start = hostMillis();
+    bot->requestHealthCheck();
+    while (bot->getHealthCheck() == AIBotManager::HEALTH_CHECKING)
+    {
+        TEST_ASSERT_TRUE_MESSAGE(hostMillis() - start < 20000, "health check did not finish");
+        bot->loop();
+        hostClock.delay(1);
+    }
+    return bot->getHealthCheck();
+}
+
+// The line mock_backend.py prints for an image that arrived intact
+static std::string imageLine(const std::vector<uint8_t> &image)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint8_t b : image)
+        hash = (hash ^ b) * 0x100000001b3ULL;
+    char line[80];
+    snprintf(line, sizeof(line), "image: %u bytes, fnv1a64 %016llx\n", (unsigned)image.size(),
+             (unsigned long long)hash);
+    return line;
+}
+
+static size_t countOf(const std::string &text, const std::string &what)
+{
+    size_t count = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+        count++;
+    return count;
+}
+
+static bool isDirection(const String &direction)
+{
+    return direction == "forward" || direction == "left" || direction == "right" || direction == "stop";
+}
+
+void setUp()
+{
+    storage = new MemoryStorage();
+    config = new ConfigStore();
+    config->begin(storage);
+    frames = new JpegFileFrameSource();
+    hostLink = new HostLink();
+    bot = new AIBotManager();
+    statuses.clear();
+    decisions.clear();
+
+    char path[] = "/tmp/test_ai_bot_manager_XXXXXX";
+    int fd = mkstemp(path);
+    jpeg.assign(20 * 1024, 0);
+    for (size_t i = 0; i < jpeg.size(); i++)
+        jpeg[i] = (uint8_t)(i * 131 + (i >> 7));
+    jpeg[0] = 0xFF;
+    jpeg[1] = 0xD8;
+    write(fd, jpeg.data(), jpeg.size());
+    close(fd);
+    frames->addFile(path);
+    unlink(path);
+}
+
+void tearDown()
+{
+    backend.stop();
+    TlsSession::setTrustedCerts(nullptr);
+    delete bot;
+    delete hostLink;
+    delete frames;
+    delete config;
+    delete storage;
+}
+
+void test_decision_from_whole_response()
+{
+    if (!startBackend())
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(isDirection(bot->getLastDirection()));
+    TEST_ASSERT_TRUE(bot->getLastDistance() > 0.0f);
+    TEST_ASSERT_FALSE(bot->isGoalFound());
+
+    // Status callbacks in the order the OLED shows them
+    TEST_ASSERT_TRUE(statuses.size() >= 3);
+    TEST_ASSERT_EQUAL_STRING("Sending Request", statuses[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("Waiting AI", statuses[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", statuses.back().c_str());
+
+    BotRequestTiming timing = bot->getLastRequestTiming();
+    TEST_ASSERT_FALSE(timing.reused);
+    TEST_ASSERT_GREATER_OR_EQUAL(50, timing.waitMs); // --think 0.05
+    TEST_ASSERT_EQUAL_UINT32(timing.totalMs, timing.directionMs);
+}
+
+void test_context_sent_once_and_connection_kept()
+{
+    if (!startBackend())
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    TEST_ASSERT_FALSE(bot->isContextCached());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(bot->isContextCached());
+
+    // Hash only from here on: the mock answers 409 if it does not know it
+    for (int i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+        TEST_ASSERT_TRUE(bot->getLastRequestTiming().reused);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, bot->getLastRequestTiming().connectionsOpened);
+    TEST_ASSERT_EQUAL_UINT32(0, bot->getContextResends());
+}
+
+void test_forgotten_context_is_resent()
+{
+    const char *const options[] = {"--forget-every", "2", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    // Second message: the mock drops its cache and does not know the hash
+    TEST_ASSERT_EQUAL_STRING("Context Resend", runCycle().c_str());
+    TEST_ASSERT_FALSE(bot->isContextCached());
+    TEST_ASSERT_EQUAL_UINT32(1, bot->getContextResends());
+
+    // Retried straight away with the context in full
+    TEST_ASSERT_EQUAL_UINT32(0, bot->getNextRequestIn());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(bot->isContextCached());
+}
+
+void test_streamed_decision_acted_on_early()
+{
+    const char *const options[] = {"--token-delay", "0.01", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot(AIBotManager::UPLOAD_JSON, true);
+
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(isDirection(bot->getLastDirection()));
+
+    bool directionFirst = false;
+    for (const std::string &status : statuses)
+    {
+        if (status == "Direction Recv")
+            directionFirst = true;
+    }
+    TEST_ASSERT_TRUE(directionFirst);
+
+    // The description takes the mock most of a second more after the decision
+    BotRequestTiming timing = bot->getLastRequestTiming();
+    TEST_ASSERT_LESS_THAN(timing.totalMs, timing.directionMs + 200);
+}
+
+void test_decision_callback_once_per_decision()
+{
+    const char *const options[] = {"--token-delay", "0.01", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+
+    // Whole answers: once each, when parsed, however many statuses came
+    startBot();
+    runCycle();
+    runCycle();
+    TEST_ASSERT_EQUAL(2, decisions.size());
+    TEST_ASSERT_TRUE(statuses.size() >= 6);
+
+    // Streamed: once, when the direction is in, not again when the answer is
+    decisions.clear();
+    bot->setApiConfig(backend.baseUrl(), "/message", "/health", AIBotManager::UPLOAD_JSON, true);
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_EQUAL(1, decisions.size());
+    TEST_ASSERT_EQUAL_STRING("Waiting AI", decisions[0].c_str());
+}
+
+void test_time_to_direction()
+{
+    // 4 characters every 20 ms: the decision keys take about 12 tokens, the
+    // whole answer about 80
+    const char *const options[] = {"--token-delay", "0.02", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot(AIBotManager::UPLOAD_JSON, true);
+
+    for (int cycle = 1; cycle <= 3; cycle++)
+    {
+        TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+        BotRequestTiming timing = bot->getLastRequestTiming();
+        TEST_ASSERT_LESS_THAN(timing.totalMs / 2, timing.directionMs);
+
+        char message[96];
+        snprintf(message, sizeof(message), "cycle %d: direction after %u ms, answer complete after %u ms", cycle,
+                 (unsigned)timing.directionMs, (unsigned)timing.totalMs);
+        TEST_MESSAGE(message);
+    }
+}
+
+void test_stream_cut_after_decision()
+{
+    // The connection goes after 60 characters, past direction and distance
+    const char *const options[] = {"--token-delay", "0.01", "--cut-after", "60", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot(AIBotManager::UPLOAD_JSON, true);
+
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(isDirection(bot->getLastDirection()));
+    TEST_ASSERT_TRUE(bot->isContextCached());
+
+    // Paced as a decision, not backed off as an error (500 ms and up)
+    TEST_ASSERT_LESS_OR_EQUAL(50, bot->getNextRequestIn());
+    BotRequestTiming timing = bot->getLastRequestTiming();
+    TEST_ASSERT_GREATER_THAN(0, timing.directionMs);
+    TEST_ASSERT_LESS_OR_EQUAL(timing.totalMs, timing.directionMs);
+
+    // Next request on a new connection, hash only
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, bot->getContextResends());
+}
+
+void test_json_upload_carries_frame()
+{
+    if (!startBackend())
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot(AIBotManager::UPLOAD_JSON);
+
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str()); // Hash only
+
+    // The mock decodes the base64 back to the very bytes of the frame
+    std::string log = backend.output();
+    TEST_ASSERT_EQUAL(2, countOf(log, imageLine(jpeg)));
+    TEST_ASSERT_EQUAL(2, countOf(log, ", application/json\n"));
+}
+
+void test_multipart_upload_carries_frame()
+{
+    if (!startBackend())
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot(AIBotManager::UPLOAD_MULTIPART);
+    TEST_ASSERT_EQUAL(AIBotManager::UPLOAD_MULTIPART, bot->getUploadMode());
+
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(isDirection(bot->getLastDirection()));
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str()); // Hash only
+    TEST_ASSERT_TRUE(bot->getLastRequestTiming().reused);
+
+    std::string log = backend.output();
+    TEST_ASSERT_EQUAL(2, countOf(log, imageLine(jpeg)));
+    TEST_ASSERT_EQUAL(2, countOf(log, ", multipart/form-data; boundary=----esp32bot"));
+    TEST_ASSERT_EQUAL(1, countOf(log, "context: re-injected"));
+}
+
+void test_upload_sizes()
+{
+    // Same frame, same fields: multipart sends the JPEG as it is
+    if (!startBackend())
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot(AIBotManager::UPLOAD_JSON);
+    runCycle();
+    runCycle();
+    bot->setApiConfig(backend.baseUrl(), "/message", "/health", AIBotManager::UPLOAD_MULTIPART, false);
+    runCycle();
+    runCycle();
+
+    // Hash-only bodies (the second of each pair) differ by the image
+    // encoding less the multipart boundaries
+    std::vector<int> sizes;
+    std::string log = backend.output();
+    for (size_t at = log.find("body: "); at != std::string::npos; at = log.find("body: ", at + 1))
+        sizes.push_back(atoi(log.c_str() + at + 6));
+    TEST_ASSERT_EQUAL(4, sizes.size());
+    int frame = (int)jpeg.size();
+    int base64 = 4 * ((frame + 2) / 3);
+    TEST_ASSERT_GREATER_THAN(base64, sizes[1]);
+    TEST_ASSERT_GREATER_THAN(frame, sizes[3]);
+    TEST_ASSERT_GREATER_THAN(base64 - frame - 1024, sizes[1] - sizes[3]);
+
+    char message[96];
+    snprintf(message, sizeof(message), "%d byte frame: JSON body %d bytes, multipart body %d bytes", frame, sizes[1],
+             sizes[3]);
+    TEST_MESSAGE(message);
+}
+
+void test_injected_delays()
+{
+    // Slow upload reads, 0.4 s of thinking, then the answer 16 bytes at a
+    // time every 20 ms: loop() never waits on any of it
+    const char *const options[] = {"--slow-read", "0.01", "--think", "0.4", "--chunked", "--body-delay", "0.02",
+                                   nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    uint32_t loops = 0;
+    uint32_t slowestUs = 0;
+    bot->loop();
+    while (bot->isRequestInFlight())
+    {
+        hostClock.delay(1);
+        uint32_t start = hostMicros();
+        bot->loop();
+        uint32_t us = hostMicros() - start;
+        slowestUs = us > slowestUs ? us : slowestUs;
+        loops++;
+    }
+    TEST_ASSERT_EQUAL_STRING("Response Recv", bot->getLastBotStatus().c_str());
+
+    BotRequestTiming timing = bot->getLastRequestTiming();
+    TEST_ASSERT_GREATER_OR_EQUAL(400, timing.waitMs);
+    TEST_ASSERT_GREATER_OR_EQUAL(200, timing.downloadMs);
+    TEST_ASSERT_GREATER_THAN(300, loops);
+    TEST_ASSERT_LESS_THAN(20000, slowestUs);
+
+    char message[128];
+    snprintf(message, sizeof(message), "wait %u ms, download %u ms, %u loop() calls, slowest %u us",
+             (unsigned)timing.waitMs, (unsigned)timing.downloadMs, (unsigned)loops, (unsigned)slowestUs);
+    TEST_MESSAGE(message);
+}
+
+void test_api_url_scheme()
+{
+    bot->begin(frames, hostLink, config, &hostClock);
+    TEST_ASSERT_TRUE(bot->setApiConfig(" https://api.example.com/ ", "/message", "/health"));
+    String baseUrl = bot->getApiBaseUrl();
+    TEST_ASSERT_EQUAL_STRING("https://api.example.com", baseUrl.c_str());
+
+    // Refused, and the URL in use stays
+    TEST_ASSERT_FALSE(bot->setApiConfig("ftp://10.0.0.2", "/message", "/health"));
+    baseUrl = bot->getApiBaseUrl();
+    TEST_ASSERT_EQUAL_STRING("https://api.example.com", baseUrl.c_str());
+    TEST_ASSERT_EQUAL_STRING("https://api.example.com", config->get().apiBaseUrl);
+}
+
+void test_stored_unusable_url_kept()
+{
+    BotConfig settings = config->get();
+    strcpy(settings.apiBaseUrl, "ftp://10.0.0.2");
+    TEST_ASSERT_TRUE(config->save(settings));
+
+    // Not used, but not erased either: only a new URL replaces it
+    bot->begin(frames, hostLink, config, &hostClock);
+    TEST_ASSERT_EQUAL_STRING("", bot->getApiBaseUrl().c_str());
+    TEST_ASSERT_EQUAL_STRING("ftp://10.0.0.2", config->get().apiBaseUrl);
+    TEST_ASSERT_EQUAL_STRING("Err: API URL", bot->getLastBotStatus().c_str());
+    bot->startBot();
+    TEST_ASSERT_FALSE(bot->isBotRunning());
+
+    TEST_ASSERT_TRUE(bot->setApiConfig("http://10.0.0.2:8000", "/message", "/health"));
+    TEST_ASSERT_EQUAL_STRING("Idle", bot->getLastBotStatus().c_str());
+}
+
+void test_https_backend()
+{
+    if (!startHttpsBackend())
+        TEST_IGNORE_MESSAGE("python3, openssl or scripts/mock_backend.py not available");
+    TlsSession::setTrustedCerts(certPem.c_str());
+    startBot();
+
+    TEST_ASSERT_EQUAL(AIBotManager::HEALTH_PASSED, runHealthCheck());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(isDirection(bot->getLastDirection()));
+    TEST_ASSERT_TRUE(bot->getLastRequestTiming().reused);
+    TEST_ASSERT_NOT_EQUAL(std::string::npos, backend.output().find(imageLine(jpeg)));
+
+    // The session outlives the request: the next cycle needs no handshake
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, bot->getLastRequestTiming().connectMs);
+    TEST_ASSERT_EQUAL_UINT32(1, bot->getLastRequestTiming().connectionsOpened);
+}
+
+void test_https_untrusted_certificate()
+{
+    if (!startHttpsBackend())
+        TEST_IGNORE_MESSAGE("python3, openssl or scripts/mock_backend.py not available");
+    startBot(); // Default roots: the self-signed certificate is not among them
+
+    TEST_ASSERT_EQUAL_STRING("Err: tls", runCycle().c_str());
+    TEST_ASSERT_EQUAL(AIBotManager::HEALTH_FAILED, runHealthCheck());
+    TEST_ASSERT_EQUAL(-1, bot->getHealthStatusCode());
+    TEST_ASSERT_EQUAL(0, (int)countOf(backend.output(), "POST /message"));
+}
+
+void test_fenced_answer()
+{
+    const char *const options[] = {"--fenced", "--chunked", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(isDirection(bot->getLastDirection()));
+}
+
+void test_backend_drops_request()
+{
+    const char *const options[] = {"--drop", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    String status = runCycle();
+    TEST_ASSERT_TRUE(status.startsWith("Err: "));
+    TEST_ASSERT_EQUAL_STRING("None", bot->getLastDirection().c_str());
+    TEST_ASSERT_FALSE(bot->isContextCached());
+    // Backed off instead of retrying at once
+    TEST_ASSERT_GREATER_THAN(0, bot->getNextRequestIn());
+}
+
+void test_no_backend()
+{
+    // Nothing listens on the port: refused on connect
+    bot->begin(frames, hostLink, config, &hostClock);
+    bot->setApiConfig("http://127.0.0.1:" + String((unsigned)MockBackend::freePort()), "/message", "/health",
+                      AIBotManager::UPLOAD_JSON, false);
+    bot->setCadence(0, 50);
+    bot->startBot();
+
+    TEST_ASSERT_EQUAL_STRING("Err: connect", runCycle().c_str());
+    TEST_ASSERT_EQUAL(AIBotManager::HEALTH_FAILED, runHealthCheck());
+    TEST_ASSERT_EQUAL(-1, bot->getHealthStatusCode());
+}
+
+void test_link_down_sends_nothing()
+{
+    if (!startBackend())
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    hostLink->setConnected(false);
+    TEST_ASSERT_EQUAL_STRING("WiFi Error", runCycle().c_str());
+    TEST_ASSERT_FALSE(bot->isRequestInFlight());
+    TEST_ASSERT_EQUAL(AIBotManager::HEALTH_FAILED, runHealthCheck());
+    TEST_ASSERT_EQUAL_UINT32(0, bot->getLastRequestTiming().connectionsOpened);
+
+    hostLink->setConnected(true);
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+}
+
+void test_health_check_shares_connection()
+{
+    if (!startBackend())
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    TEST_ASSERT_EQUAL(AIBotManager::HEALTH_NONE, bot->getHealthCheck());
+    TEST_ASSERT_EQUAL(AIBotManager::HEALTH_PASSED, runHealthCheck());
+    TEST_ASSERT_EQUAL(200, bot->getHealthStatusCode());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_TRUE(bot->getLastRequestTiming().reused);
+}
+
+void test_health_check_waits_for_bot_request()
+{
+    const char *const options[] = {"--think", "0.3", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    bot->loop();
+    TEST_ASSERT_TRUE(bot->isRequestInFlight());
+
+    // Asked for mid-request (as /save_api_url would): no loop() call waits
+    // on it, and the bot request is neither cancelled nor counted as failed
+    bot->requestHealthCheck();
+    uint32_t slowestUs = 0;
+    uint32_t start = hostMillis();
+    while (bot->getHealthCheck() == AIBotManager::HEALTH_CHECKING && hostMillis() - start < 5000)
+    {
+        uint32_t loopStart = hostMicros();
+        bot->loop();
+        uint32_t loopUs = hostMicros() - loopStart;
+        if (loopUs > slowestUs)
+            slowestUs = loopUs;
+        hostClock.delay(1);
+    }
+    TEST_ASSERT_EQUAL(AIBotManager::HEALTH_PASSED, bot->getHealthCheck());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", bot->getLastBotStatus().c_str());
+    TEST_ASSERT_LESS_THAN(20000, slowestUs);
+
+    // The next cycle went out only after the check, on the same connection
+    TEST_ASSERT_EQUAL_STRING("Response Recv", runCycle().c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, bot->getLastRequestTiming().connectionsOpened);
+    std::string log = backend.output();
+    size_t health = log.find("GET /health");
+    TEST_ASSERT_TRUE(health != std::string::npos);
+    TEST_ASSERT_EQUAL(1, (int)countOf(log.substr(0, health), "POST /message"));
+}
+
+void test_stop_cancels_request()
+{
+    const char *const options[] = {"--think", "5", nullptr};
+    if (!startBackend(options))
+        TEST_IGNORE_MESSAGE("python3 or scripts/mock_backend.py not available");
+    startBot();
+
+    bot->loop();
+    uint32_t start = hostMillis();
+    while (bot->getLastBotStatus() != "Waiting AI" && hostMillis() - start < 5000)
+    {
+        hostClock.delay(1);
+        bot->loop();
+    }
+    TEST_ASSERT_TRUE(bot->isRequestInFlight());
+
+    bot->stopBot();
+    TEST_ASSERT_FALSE(bot->isRequestInFlight());
+    TEST_ASSERT_FALSE(bot->isBotRunning());
+    TEST_ASSERT_EQUAL_STRING("Stopped", bot->getLastBotStatus().c_str());
+
+    // The frame went back to the source: the next one can be had
+    CapturedFrame frame;
+    TEST_ASSERT_TRUE(frames->acquire(frame));
+    frames->release(frame);
+}
+
+int main(int argc, char **argv)
+{
+    Log::setLevel(LOG_LEVEL_WARN);
+    UNITY_BEGIN();
+    RUN_TEST(test_decision_from_whole_response);
+    RUN_TEST(test_context_sent_once_and_connection_kept);
+    RUN_TEST(test_forgotten_context_is_resent);
+    RUN_TEST(test_streamed_decision_acted_on_early);
+    RUN_TEST(test_decision_callback_once_per_decision);
+    RUN_TEST(test_time_to_direction);
+    RUN_TEST(test_stream_cut_after_decision);
+    RUN_TEST(test_json_upload_carries_frame);
+    RUN_TEST(test_multipart_upload_carries_frame);
+    RUN_TEST(test_upload_sizes);
+    RUN_TEST(test_injected_delays);
+    RUN_TEST(test_api_url_scheme);
+    RUN_TEST(test_stored_unusable_url_kept);
+    RUN_TEST(test_https_backend);
+    RUN_TEST(test_https_untrusted_certificate);
+    RUN_TEST(test_fenced_answer);
+    RUN_TEST(test_backend_drops_request);
+    RUN_TEST(test_no_backend);
+    RUN_TEST(test_link_down_sends_nothing);
+    RUN_TEST(test_health_check_shares_connection);
+    RUN_TEST(test_health_check_waits_for_bot_request);
+    RUN_TEST(test_stop_cancels_request);
+    return UNITY_END();
+}
@@ -0,0 +1,293 @@
+// AsyncHttpRequest against loopback listeners: how connect failures treat
+// the cached address of a host name, and the resend when a kept-alive
+// connection turns out closed
+//   pio test -e native -f test_async_http_request
+
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "async_http_request.h"
+#include "hal_native.h"
+
+static const AsyncHttpRequest::Deadlines SHORT_DEADLINES = {300, 1000, 1000, 1000};
+
+// Listening socket on a free loopback port, never accepted from
+static int listenLoopback(int backlog, uint16_t &port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(fd, backlog);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Port nothing listens on
+static uint16_t closedPort()
+{
+    uint16_t port;
+    int fd = listenLoopback(1, port);
+    close(fd);
+    return port;
+}
+
+// Polls until the request leaves stage (or ends)
+static void pollWhile(AsyncHttpRequest &request, AsyncHttpRequest::State stage)
+{
+    uint32_t start = hostMillis();
+    while (request.isBusy() && request.getState() == stage && hostMillis() - start < 2000)
+    {
+        request.poll(hostMillis());
+        usleep(1000);
+    }
+}
+
+// Reads one request on a blocking server socket; returns its body
+static std::string readRequest(int conn)
+{
+    std::string data;
+    char buffer[1024];
+    size_t headEnd;
+    while ((headEnd = data.find("\r\n\r\n")) == std::string::npos)
+    {
+        ssize_t n = recv(conn, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            return "";
+        data.append(buffer, n);
+    }
+    size_t at = data.find("Content-Length: ");
+    size_t length = at < headEnd ? strtoul(data.c_str() + at + 16, nullptr, 10) : 0;
+    while (data.size() < headEnd + 4 + length)
+    {
+        ssize_t n = recv(conn, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            break;
+        data.append(buffer, n);
+    }
+    return data.substr(headEnd + 4);
+}
+
+static void answer(int conn)
+{
+    const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    send(conn, response, sizeof(response) - 1, MSG_NOSIGNAL);
+}
+
+static AsyncHttpRequest::State runToEnd(AsyncHttpRequest &request, const char *url)
+{
+    if (!request.start("GET", url, nullptr, nullptr, hostMillis()))
+        return request.getState();
+    while (request.isBusy())
+    {
+        request.poll(hostMillis());
+        usleep(1000);
+    }
+    return request.getState();
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_refused_connect_forgets_address()
+{
+    char url[64];
+    snprintf(url, sizeof(url), "http://localhost:%u/health", (unsigned)closedPort());
+
+    AsyncHttpRequest request;
+    request.setDeadlines(SHORT_DEADLINES);
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_FAILED, runToEnd(request, url));
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::ERR_CONNECT, request.getError());
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_CONNECTING, request.getFailedStage());
+    request.reset();
+
+    runToEnd(request, url);
+    TEST_ASSERT_EQUAL_UINT32(2, request.getDnsLookups());
+}
+
+void test_connect_deadline_forgets_address()
+{
+    // A full accept queue drops further SYNs, so the handshake never ends
+    uint16_t port;
+    int listener = listenLoopback(0, port);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    int fillers[4];
+    for (int i = 0; i < 4; i++)
+    {
+        fillers[i] = socket(AF_INET, SOCK_STREAM, 0);
+        fcntl(fillers[i], F_SETFL, O_NONBLOCK);
+        connect(fillers[i], (struct sockaddr *)&addr, sizeof(addr));
+    }
+    usleep(50000);
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://localhost:%u/health", (unsigned)port);
+    AsyncHttpRequest request;
+    request.setDeadlines(SHORT_DEADLINES);
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_FAILED, runToEnd(request, url));
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::ERR_TIMEOUT, request.getError());
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_CONNECTING, request.getFailedStage());
+    request.reset();
+
+    runToEnd(request, url);
+    TEST_ASSERT_EQUAL_UINT32(2, request.getDnsLookups());
+
+    for (int i = 0; i < 4; i++)
+        close(fillers[i]);
+    close(listener);
+}
+
+void test_cancel_keeps_address()
+{
+    uint16_t port;
+    int listener = listenLoopback(4, port);
+    char url[64];
+    snprintf(url, sizeof(url), "http://localhost:%u/health", (unsigned)port);
+
+    AsyncHttpRequest request;
+    request.setDeadlines(SHORT_DEADLINES);
+    for (int i = 0; i < 2; i++)
+    {
+        TEST_ASSERT_TRUE(request.start("GET", url, nullptr, nullptr, hostMillis()));
+        request.cancel();
+        request.reset();
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, request.getDnsLookups());
+    close(listener);
+}
+
+// The server drops the kept-alive connection just after start() found it
+// open: the request goes out again, whole, on a new connection
+static void checkResendAfterIdleClose(bool reset)
+{
+    uint16_t port;
+    int listener = listenLoopback(4, port);
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/message", (unsigned)port);
+    static const char text[] = "{\"frame\":\"...\"}";
+
+    AsyncHttpRequest request;
+    request.setDeadlines(SHORT_DEADLINES);
+    RequestBody first(text, sizeof(text) - 1, nullptr, 0, RequestBody::FRAME_RAW, nullptr, 0);
+    TEST_ASSERT_TRUE(request.start("POST", url, "application/json", &first, hostMillis()));
+    pollWhile(request, AsyncHttpRequest::REQ_CONNECTING);
+    pollWhile(request, AsyncHttpRequest::REQ_SENDING);
+    int conn = accept(listener, nullptr, nullptr);
+    TEST_ASSERT_EQUAL_STRING(text, readRequest(conn).c_str());
+    answer(conn);
+    pollWhile(request, AsyncHttpRequest::REQ_AWAIT_HEADERS);
+    pollWhile(request, AsyncHttpRequest::REQ_READING_BODY);
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_DONE, request.getState());
+
+    RequestBody second(text, sizeof(text) - 1, nullptr, 0, RequestBody::FRAME_RAW, nullptr, 0);
+    TEST_ASSERT_TRUE(request.start("POST", url, "application/json", &second, hostMillis()));
+    TEST_ASSERT_TRUE(request.wasReused());
+    TEST_ASSERT_TRUE(request.needsBody());
+    if (reset)
+    {
+        struct linger hard = {1, 0};
+        setsockopt(conn, SOL_SOCKET, SO_LINGER, &hard, sizeof(hard));
+    }
+    close(conn);
+    usleep(10000);
+
+    pollWhile(request, AsyncHttpRequest::REQ_SENDING);
+    pollWhile(request, AsyncHttpRequest::REQ_CONNECTING);
+    pollWhile(request, AsyncHttpRequest::REQ_SENDING);
+    TEST_ASSERT_EQUAL_STRING(AsyncHttpRequest::stateName(AsyncHttpRequest::REQ_AWAIT_HEADERS),
+                             AsyncHttpRequest::stateName(request.getState()));
+    conn = accept(listener, nullptr, nullptr);
+    TEST_ASSERT_EQUAL_STRING(text, readRequest(conn).c_str());
+    answer(conn);
+    pollWhile(request, AsyncHttpRequest::REQ_AWAIT_HEADERS);
+    pollWhile(request, AsyncHttpRequest::REQ_READING_BODY);
+
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_DONE, request.getState());
+    TEST_ASSERT_EQUAL_STRING("ok", request.getResponse());
+    TEST_ASSERT_TRUE(request.wasRetried());
+    TEST_ASSERT_FALSE(request.needsBody());
+    TEST_ASSERT_EQUAL_UINT32(2, request.getConnectionsOpened());
+    close(conn);
+    close(listener);
+}
+
+void test_resend_after_reset()
+{
+    checkResendAfterIdleClose(true);
+}
+
+void test_resend_after_close()
+{
+    checkResendAfterIdleClose(false);
+}
+
+// Once the response has begun, a broken connection is a failure: the
+// server may already have acted on the request
+void test_no_resend_after_response_started()
+{
+    uint16_t port;
+    int listener = listenLoopback(4, port);
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/message", (unsigned)port);
+
+    AsyncHttpRequest request;
+    request.setDeadlines(SHORT_DEADLINES);
+    TEST_ASSERT_TRUE(request.start("GET", url, nullptr, nullptr, hostMillis()));
+    pollWhile(request, AsyncHttpRequest::REQ_CONNECTING);
+    pollWhile(request, AsyncHttpRequest::REQ_SENDING);
+    int conn = accept(listener, nullptr, nullptr);
+    readRequest(conn);
+    answer(conn);
+    pollWhile(request, AsyncHttpRequest::REQ_AWAIT_HEADERS);
+    pollWhile(request, AsyncHttpRequest::REQ_READING_BODY);
+
+    TEST_ASSERT_TRUE(request.start("GET", url, nullptr, nullptr, hostMillis()));
+    TEST_ASSERT_TRUE(request.wasReused());
+    pollWhile(request, AsyncHttpRequest::REQ_SENDING);
+    readRequest(conn);
+    const char partial[] = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nok";
+    send(conn, partial, sizeof(partial) - 1, MSG_NOSIGNAL);
+    close(conn);
+    pollWhile(request, AsyncHttpRequest::REQ_AWAIT_HEADERS);
+    pollWhile(request, AsyncHttpRequest::REQ_READING_BODY);
+
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_FAILED, request.getState());
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::ERR_RECV, request.getError());
+    TEST_ASSERT_FALSE(request.wasRetried());
+    TEST_ASSERT_EQUAL_UINT32(1, request.getConnectionsOpened());
+    close(listener);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_refused_connect_forgets_address);
+    RUN_TEST(test_connect_deadline_forgets_address);
+    RUN_TEST(test_cancel_keeps_address);
+    RUN_TEST(test_resend_after_reset);
+    RUN_TEST(test_resend_after_close);
+    RUN_TEST(test_no_resend_after_response_started);
+    return UNITY_END();
+}
@@ -0,0 +1,248 @@
+// base64Encode: round trips and agreement with a byte-at-a-time reference,
+// plus throughput in MB/s on JPEG-sized inputs against mbedtls_base64_encode
+// (what capturePhoto() used before) and the reference loop.
+//   pio test -e native -f test_base64 -v
+//
+// mbedtls is looked up at run time (libmbedcrypto, as installed with
+// mbedtls or libmbedtls-dev) so the native build needs no extra flags; the
+// mbedtls comparison is skipped on hosts without it.
+
+#include <unity.h>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "base64_encoder.h"
+#include "hal_native.h"
+
+static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+typedef int (*MbedtlsEncode)(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+
+static MbedtlsEncode loadMbedtls()
+{
+    static const char *const LIBRARIES[] = {"libmbedcrypto.so", "libmbedcrypto.so.7", "libmbedcrypto.so.16",
+                                            "libmbedcrypto.dylib"};
+    for (const char *name : LIBRARIES)
+    {
+        void *library = dlopen(name, RTLD_NOW);
+        if (library)
+            return (MbedtlsEncode)dlsym(library, "mbedtls_base64_encode");
+    }
+    return nullptr;
+}
+
+// One character per lookup, as the encoder this replaced did
+static size_t referenceEncode(const uint8_t *in, size_t len, char *out)
+{
+    size_t o = 0;
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3)
+    {
+        out[o++] = ALPHABET[in[i] >> 2];
+        out[o++] = ALPHABET[((in[i] & 3) << 4) | (in[i + 1] >> 4)];
+        out[o++] = ALPHABET[((in[i + 1] & 15) << 2) | (in[i + 2] >> 6)];
+        out[o++] = ALPHABET[in[i + 2] & 63];
+    }
+    if (i < len)
+    {
+        out[o++] = ALPHABET[in[i] >> 2];
+        if (i + 1 < len)
+        {
+            out[o++] = ALPHABET[((in[i] & 3) << 4) | (in[i + 1] >> 4)];
+            out[o++] = ALPHABET[(in[i + 1] & 15) << 2];
+        }
+        else
+        {
+            out[o++] = ALPHABET[(in[i] & 3) << 4];
+            out[o++] = '=';
+        }
+        out[o++] = '=';
+    }
+    return o;
+}
+
+static bool decode(const char *in, size_t len, std::vector<uint8_t> &out)
+{
+    out.clear();
+    if (len % 4 != 0)
+        return false;
+    uint32_t bits = 0;
+    int count = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (in[i] == '=')
+            break;
+        const char *p = strchr(ALPHABET, in[i]);
+        if (!p || !in[i])
+            return false;
+        bits = (bits << 6) | (uint32_t)(p - ALPHABET);
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            out.push_back((uint8_t)(bits >> count));
+        }
+    }
+    return true;
+}
+
+static void fillRandom(std::vector<uint8_t> &data, unsigned seed)
+{
+    srand(seed);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (uint8_t)rand();
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_rfc4648_vectors()
+{
+    const char *plain[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+    const char *encoded[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+    for (int i = 0; i < 7; i++)
+    {
+        char out[16];
+        size_t n = base64Encode((const uint8_t *)plain[i], strlen(plain[i]), out);
+        TEST_ASSERT_EQUAL(strlen(encoded[i]), n);
+        TEST_ASSERT_EQUAL_MEMORY(encoded[i], out, n);
+    }
+}
+
+void test_every_length_round_trips()
+{
+    // Covers the kernels (12 bytes a step) and every tail they leave
+    std::vector<uint8_t> data(700);
+    fillRandom(data, 7);
+    std::vector<char> out(base64EncodedLength(data.size()) + 8);
+    std::vector<char> expected(out.size());
+    std::vector<uint8_t> back;
+
+    for (size_t len = 0; len <= data.size(); len++)
+    {
+        memset(out.data(), '#', out.size());
+        size_t n = base64Encode(data.data(), len, out.data());
+        TEST_ASSERT_EQUAL(base64EncodedLength(len), n);
+        TEST_ASSERT_EQUAL('#', out[n]); // Nothing written past the end
+
+        TEST_ASSERT_EQUAL(n, referenceEncode(data.data(), len, expected.data()));
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), out.data(), n);
+
+        TEST_ASSERT_TRUE(decode(out.data(), n, back));
+        TEST_ASSERT_EQUAL(len, back.size());
+        if (len > 0)
+            TEST_ASSERT_EQUAL_MEMORY(data.data(), back.data(), len);
+    }
+}
+
+void test_unaligned_input()
+{
+    std::vector<uint8_t> data(300);
+    fillRandom(data, 11);
+    char out[512];
+    char expected[512];
+    for (size_t offset = 1; offset < 8; offset++)
+    {
+        size_t len = data.size() - offset;
+        size_t n = base64Encode(data.data() + offset, len, out);
+        referenceEncode(data.data() + offset, len, expected);
+        TEST_ASSERT_EQUAL_MEMORY(expected, out, n);
+    }
+}
+
+void test_every_byte_value()
+{
+    uint8_t data[256 * 3];
+    for (int i = 0; i < 256 * 3; i++)
+        data[i] = (uint8_t)(i * 85 + i / 256);
+    char out[1024];
+    char expected[1024];
+    size_t n = base64Encode(data, sizeof(data), out);
+    referenceEncode(data, sizeof(data), expected);
+    TEST_ASSERT_EQUAL_MEMORY(expected, out, n);
+}
+
+void test_matches_mbedtls()
+{
+    MbedtlsEncode mbedtls = loadMbedtls();
+    if (!mbedtls)
+        TEST_IGNORE_MESSAGE("libmbedcrypto not found");
+
+    std::vector<uint8_t> data(50 * 1024 + 1);
+    fillRandom(data, 3);
+    std::vector<char> out(base64EncodedLength(data.size()));
+    std::vector<unsigned char> expected(out.size() + 1); // mbedtls terminates
+    size_t olen = 0;
+    TEST_ASSERT_EQUAL(0, mbedtls(expected.data(), expected.size(), &olen, data.data(), data.size()));
+    TEST_ASSERT_EQUAL(olen, base64Encode(data.data(), data.size(), out.data()));
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), out.data(), olen);
+}
+
+// Best of a few passes over the whole input, in MB/s of input
+template <typename Encode>
+static double throughput(const std::vector<uint8_t> &data, std::vector<char> &out, Encode encode)
+{
+    uint32_t best = UINT32_MAX;
+    for (int pass = 0; pass < 15; pass++)
+    {
+        uint32_t start = hostMicros();
+        encode(data.data(), data.size(), out.data());
+        uint32_t us = hostMicros() - start;
+        if (us < best)
+            best = us;
+    }
+    return data.size() / (best > 0 ? (double)best : 1.0);
+}
+
+void test_throughput()
+{
+    MbedtlsEncode mbedtls = loadMbedtls();
+    const size_t sizes[] = {50 * 1024, 100 * 1024, 200 * 1024, 400 * 1024}; // VGA .. UXGA JPEGs
+
+    for (size_t size : sizes)
+    {
+        std::vector<uint8_t> data(size);
+        fillRandom(data, (unsigned)size); // JPEG data is close to random
+        std::vector<char> out(base64EncodedLength(size) + 1);
+
+        double kernel = throughput(data, out, base64Encode);
+        double reference = throughput(data, out, referenceEncode);
+        double viaMbedtls = 0;
+        if (mbedtls)
+        {
+            viaMbedtls = throughput(data, out, [&](const uint8_t *in, size_t len, char *dst) {
+                size_t olen;
+                return (size_t)mbedtls((unsigned char *)dst, out.size(), &olen, in, len);
+            });
+        }
+
+        char message[160];
+        snprintf(message, sizeof(message), "%4u KB: base64Encode %7.1f MB/s, mbedtls %7.1f MB/s, byte loop %7.1f MB/s",
+                 (unsigned)(size / 1024), kernel, viaMbedtls, reference);
+        TEST_MESSAGE(message);
+
+        TEST_ASSERT_TRUE(kernel > reference);
+        if (mbedtls)
+            TEST_ASSERT_TRUE(kernel > viaMbedtls);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rfc4648_vectors);
+    RUN_TEST(test_every_length_round_trips);
+    RUN_TEST(test_unaligned_input);
+    RUN_TEST(test_every_byte_value);
+    RUN_TEST(test_matches_mbedtls);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
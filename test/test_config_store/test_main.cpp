@@ -0,0 +1,342 @@
+// ConfigStore on an in-memory Storage: legacy migration, slot validation
+// and the choice between the two slots
+//   pio test -e native -f test_config_store
+
+#include <unity.h>
+
+#include <stddef.h>
+#include <string.h>
+#include "config_store.h"
+
+// EEPROM-like memory that counts commits
+class MemoryStorage : public Storage
+{
+public:
+    uint8_t bytes[ConfigStore::STORAGE_SIZE];
+    int commits;
+
+    MemoryStorage() : commits(0)
+    {
+        memset(bytes, 0xFF, sizeof(bytes));
+    }
+
+    size_t size() override
+    {
+        return sizeof(bytes);
+    }
+
+    uint8_t read(size_t addr) override
+    {
+        return bytes[addr];
+    }
+
+    void write(size_t addr, uint8_t value) override
+    {
+        bytes[addr] = value;
+    }
+
+    bool commit() override
+    {
+        commits++;
+        return true;
+    }
+};
+
+// On-storage slot layout, written by hand so the tests pin the format:
+// magic, version, length, sequence, CRC-32 over header (CRC as 0) + config
+struct SlotHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t sequence;
+    uint32_t crc;
+};
+
+static const uint32_t MAGIC = 0x47464342;
+
+static size_t slotAddress(int slot)
+{
+    return ConfigStore::LEGACY_SIZE + slot * ConfigStore::SLOT_SIZE;
+}
+
+static void writeSlotImage(MemoryStorage &storage, int slot, const BotConfig &config, uint32_t sequence,
+                           uint16_t length = sizeof(BotConfig))
+{
+    SlotHeader header = {MAGIC, ConfigStore::VERSION, length, sequence, 0};
+    header.crc = ConfigStore::crc32(&config, length, ConfigStore::crc32(&header, sizeof(header)));
+    memcpy(storage.bytes + slotAddress(slot), &header, sizeof(header));
+    memcpy(storage.bytes + slotAddress(slot) + sizeof(header), &config, length);
+}
+
+static BotConfig configWithUrl(const char *url)
+{
+    BotConfig config;
+    config.setDefaults();
+    strcpy(config.apiBaseUrl, url);
+    return config;
+}
+
+static void putString(MemoryStorage &storage, size_t addr, const char *text)
+{
+    memcpy(storage.bytes + addr, text, strlen(text) + 1);
+}
+
+// Settings as the managers stored them before ConfigStore
+static void writeLegacyImage(MemoryStorage &storage)
+{
+    memset(storage.bytes, 0, ConfigStore::LEGACY_SIZE);
+    storage.bytes[0] = 1;
+    putString(storage, 1, "robotnet");
+    putString(storage, 34, "secret-pass");
+    putString(storage, 200, "http://192.168.1.20:8000");
+    putString(storage, 300, "/v2/message");
+    putString(storage, 350, "/v2/health");
+    storage.bytes[400] = 1;
+    storage.bytes[401] = 1;
+    int32_t servo[3] = {30, 12, 48};
+    memcpy(storage.bytes + 500, servo, sizeof(servo));
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_erased_storage_gives_defaults()
+{
+    MemoryStorage storage;
+    ConfigStore store;
+    TEST_ASSERT_TRUE(store.begin(&storage));
+    TEST_ASSERT_EQUAL(ConfigStore::SOURCE_DEFAULTS, store.getStats().source);
+    TEST_ASSERT_EQUAL(-1, store.getStats().slot);
+    TEST_ASSERT_EQUAL_STRING("/message", store.get().apiMessageRoute);
+    TEST_ASSERT_EQUAL_INT32(28, store.get().servoCenter);
+    TEST_ASSERT_EQUAL(0, storage.commits);
+}
+
+void test_zeroed_legacy_area_gives_defaults()
+{
+    MemoryStorage storage;
+    memset(storage.bytes, 0, ConfigStore::LEGACY_SIZE);
+    ConfigStore store;
+    store.begin(&storage);
+    TEST_ASSERT_EQUAL(ConfigStore::SOURCE_DEFAULTS, store.getStats().source);
+    TEST_ASSERT_EQUAL_INT32(28, store.get().servoCenter); // Not the zero stored there
+}
+
+void test_legacy_image_migrates()
+{
+    MemoryStorage storage;
+    writeLegacyImage(storage);
+    uint8_t legacy[ConfigStore::LEGACY_SIZE];
+    memcpy(legacy, storage.bytes, sizeof(legacy));
+
+    ConfigStore store;
+    TEST_ASSERT_TRUE(store.begin(&storage));
+    const BotConfig &config = store.get();
+    TEST_ASSERT_EQUAL(ConfigStore::SOURCE_MIGRATED, store.getStats().source);
+    TEST_ASSERT_EQUAL(1, config.wifiConfigured);
+    TEST_ASSERT_EQUAL_STRING("robotnet", config.wifiSsid);
+    TEST_ASSERT_EQUAL_STRING("secret-pass", config.wifiPassword);
+    TEST_ASSERT_EQUAL_STRING("http://192.168.1.20:8000", config.apiBaseUrl);
+    TEST_ASSERT_EQUAL_STRING("/v2/message", config.apiMessageRoute);
+    TEST_ASSERT_EQUAL_STRING("/v2/health", config.apiHealthRoute);
+    TEST_ASSERT_EQUAL(1, config.uploadMode);
+    TEST_ASSERT_EQUAL(1, config.streamResponses);
+    TEST_ASSERT_EQUAL_INT32(30, config.servoCenter);
+    TEST_ASSERT_EQUAL_INT32(12, config.servoLeft);
+    TEST_ASSERT_EQUAL_INT32(48, config.servoRight);
+
+    // Written to slot 0 once; the old layout is left alone
+    TEST_ASSERT_EQUAL(0, store.getStats().slot);
+    TEST_ASSERT_EQUAL_UINT32(1, store.getStats().sequence);
+    TEST_ASSERT_EQUAL(1, storage.commits);
+    TEST_ASSERT_EQUAL_MEMORY(legacy, storage.bytes, sizeof(legacy));
+
+    // Next boot loads the slot without writing anything
+    ConfigStore again;
+    TEST_ASSERT_TRUE(again.begin(&storage));
+    TEST_ASSERT_EQUAL(ConfigStore::SOURCE_SAVED, again.getStats().source);
+    TEST_ASSERT_EQUAL_STRING("robotnet", again.get().wifiSsid);
+    TEST_ASSERT_EQUAL(1, storage.commits);
+}
+
+void test_legacy_unset_servo_keeps_default()
+{
+    MemoryStorage storage;
+    writeLegacyImage(storage);
+    int32_t unset = -1;
+    memcpy(storage.bytes + 504, &unset, sizeof(unset));
+
+    ConfigStore store;
+    store.begin(&storage);
+    TEST_ASSERT_EQUAL_INT32(30, store.get().servoCenter);
+    TEST_ASSERT_EQUAL_INT32(10, store.get().servoLeft);
+}
+
+void test_saves_alternate_slots()
+{
+    MemoryStorage storage;
+    ConfigStore store;
+    store.begin(&storage);
+
+    TEST_ASSERT_TRUE(store.save(configWithUrl("http://a")));
+    TEST_ASSERT_EQUAL(0, store.getStats().slot);
+    TEST_ASSERT_TRUE(store.save(configWithUrl("http://b")));
+    TEST_ASSERT_EQUAL(1, store.getStats().slot);
+    TEST_ASSERT_TRUE(store.save(configWithUrl("http://c")));
+    TEST_ASSERT_EQUAL(0, store.getStats().slot);
+    TEST_ASSERT_EQUAL_UINT32(3, store.getStats().sequence);
+
+    // Same again: nothing written
+    TEST_ASSERT_TRUE(store.save(configWithUrl("http://c")));
+    TEST_ASSERT_EQUAL(3, storage.commits);
+    TEST_ASSERT_EQUAL_UINT32(1, store.getStats().unchanged);
+
+    ConfigStore again;
+    again.begin(&storage);
+    TEST_ASSERT_EQUAL_STRING("http://c", again.get().apiBaseUrl);
+}
+
+void test_corrupt_slot_falls_back_to_other()
+{
+    MemoryStorage storage;
+    ConfigStore store;
+    store.begin(&storage);
+    store.save(configWithUrl("http://older"));
+    store.save(configWithUrl("http://newer")); // Slot 1
+
+    storage.bytes[slotAddress(1) + sizeof(SlotHeader) + offsetof(BotConfig, apiBaseUrl) + 8] ^= 0x01;
+
+    ConfigStore again;
+    TEST_ASSERT_TRUE(again.begin(&storage));
+    TEST_ASSERT_EQUAL(ConfigStore::SOURCE_SAVED, again.getStats().source);
+    TEST_ASSERT_EQUAL(0, again.getStats().slot);
+    TEST_ASSERT_EQUAL_UINT32(1, again.getStats().invalidSlots);
+    TEST_ASSERT_EQUAL_STRING("http://older", again.get().apiBaseUrl);
+
+    // The next save goes over the corrupt slot, not the good one
+    TEST_ASSERT_TRUE(again.save(configWithUrl("http://fixed")));
+    TEST_ASSERT_EQUAL(1, again.getStats().slot);
+    TEST_ASSERT_EQUAL_UINT32(2, again.getStats().sequence);
+}
+
+void test_torn_write_falls_back_to_other()
+{
+    MemoryStorage storage;
+    writeSlotImage(storage, 0, configWithUrl("http://kept"), 7);
+    writeSlotImage(storage, 1, configWithUrl("http://torn"), 8);
+    // Reset halfway through writing slot 1: its tail is still erased
+    memset(storage.bytes + slotAddress(1) + 100, 0xFF, ConfigStore::SLOT_SIZE - 100);
+
+    ConfigStore store;
+    store.begin(&storage);
+    TEST_ASSERT_EQUAL(0, store.getStats().slot);
+    TEST_ASSERT_EQUAL_UINT32(7, store.getStats().sequence);
+    TEST_ASSERT_EQUAL_STRING("http://kept", store.get().apiBaseUrl);
+}
+
+void test_both_slots_corrupt_migrates_again()
+{
+    MemoryStorage storage;
+    writeLegacyImage(storage);
+    writeSlotImage(storage, 0, configWithUrl("http://x"), 1);
+    writeSlotImage(storage, 1, configWithUrl("http://y"), 2);
+    storage.bytes[slotAddress(0)] ^= 0xFF; // Magic
+    storage.bytes[slotAddress(1) + offsetof(SlotHeader, crc)] ^= 0xFF;
+
+    ConfigStore store;
+    store.begin(&storage);
+    TEST_ASSERT_EQUAL(ConfigStore::SOURCE_MIGRATED, store.getStats().source);
+    TEST_ASSERT_EQUAL_UINT32(2, store.getStats().invalidSlots);
+    TEST_ASSERT_EQUAL_STRING("robotnet", store.get().wifiSsid);
+}
+
+void test_sequence_wraparound_picks_newer_slot()
+{
+    struct Case
+    {
+        uint32_t sequence0;
+        uint32_t sequence1;
+        int newest;
+    };
+    const Case cases[] = {
+        {5, 6, 1},
+        {6, 5, 0},
+        {0xFFFFFFFE, 0xFFFFFFFF, 1},
+        {0xFFFFFFFF, 0, 1}, // Slot 1 written after the counter wrapped
+        {0, 0xFFFFFFFF, 0},
+        {1, 0xFFFFFFFF, 0},
+    };
+
+    for (const Case &c : cases)
+    {
+        MemoryStorage storage;
+        writeSlotImage(storage, 0, configWithUrl("http://slot0"), c.sequence0);
+        writeSlotImage(storage, 1, configWithUrl("http://slot1"), c.sequence1);
+
+        ConfigStore store;
+        store.begin(&storage);
+        TEST_ASSERT_EQUAL(c.newest, store.getStats().slot);
+        TEST_ASSERT_EQUAL_STRING(c.newest ? "http://slot1" : "http://slot0", store.get().apiBaseUrl);
+    }
+}
+
+void test_save_across_wraparound_stays_newest()
+{
+    MemoryStorage storage;
+    writeSlotImage(storage, 0, configWithUrl("http://old"), 0xFFFFFFFE);
+    writeSlotImage(storage, 1, configWithUrl("http://current"), 0xFFFFFFFF);
+
+    ConfigStore store;
+    store.begin(&storage);
+    TEST_ASSERT_TRUE(store.save(configWithUrl("http://wrapped")));
+    TEST_ASSERT_EQUAL(0, store.getStats().slot);
+    TEST_ASSERT_EQUAL_UINT32(0, store.getStats().sequence);
+
+    ConfigStore again;
+    again.begin(&storage);
+    TEST_ASSERT_EQUAL_STRING("http://wrapped", again.get().apiBaseUrl);
+}
+
+void test_shorter_older_config_keeps_later_defaults()
+{
+    // Saved by firmware whose BotConfig ended before the servo section
+    MemoryStorage storage;
+    BotConfig config = configWithUrl("http://short");
+    config.servoCenter = 99;
+    writeSlotImage(storage, 0, config, 1, offsetof(BotConfig, servoCenter));
+
+    ConfigStore store;
+    store.begin(&storage);
+    TEST_ASSERT_EQUAL(ConfigStore::SOURCE_SAVED, store.getStats().source);
+    TEST_ASSERT_EQUAL_STRING("http://short", store.get().apiBaseUrl);
+    TEST_ASSERT_EQUAL_INT32(28, store.get().servoCenter);
+}
+
+void test_crc32_check_value()
+{
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, ConfigStore::crc32("123456789", 9));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_erased_storage_gives_defaults);
+    RUN_TEST(test_zeroed_legacy_area_gives_defaults);
+    RUN_TEST(test_legacy_image_migrates);
+    RUN_TEST(test_legacy_unset_servo_keeps_default);
+    RUN_TEST(test_saves_alternate_slots);
+    RUN_TEST(test_corrupt_slot_falls_back_to_other);
+    RUN_TEST(test_torn_write_falls_back_to_other);
+    RUN_TEST(test_both_slots_corrupt_migrates_again);
+    RUN_TEST(test_sequence_wraparound_picks_newer_slot);
+    RUN_TEST(test_save_across_wraparound_stays_newest);
+    RUN_TEST(test_shorter_older_config_keeps_later_defaults);
+    RUN_TEST(test_crc32_check_value);
+    return UNITY_END();
+}
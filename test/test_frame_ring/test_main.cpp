@@ -0,0 +1,242 @@
+// FrameRing bookkeeping: a held frame's slot is never written, the reader
+// always gets the newest frame, and the frame age the bot reports is that of
+// the frame it sent, measured when it sent it.
+//   pio test -e native -f test_frame_ring
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "ai_bot_manager.h"
+#include "config_store.h"
+#include "frame_ring.h"
+#include "hal_native.h"
+#include "log.h"
+
+static FrameRing *ring;
+
+// The capture task's write: claim a slot, fill it, commit
+static int writeFrame(uint32_t timestampMs, uint8_t fill = 0)
+{
+    int index = ring->beginWrite();
+    if (index < 0)
+        return -1;
+    FrameRing::Slot &slot = ring->slot(index);
+    static uint8_t buffers[FrameRing::SLOT_COUNT][16];
+    slot.data = buffers[index];
+    slot.capacity = sizeof(buffers[index]);
+    memset(slot.data, fill, slot.capacity);
+    ring->commitWrite(index, slot.capacity, timestampMs);
+    return index;
+}
+
+// Time that moves only when the test says so
+class ManualClock : public Clock
+{
+public:
+    ManualClock() : nowMs(10000) {}
+
+    uint32_t millis() override { return nowMs; }
+    uint32_t micros() override { return nowMs * 1000; }
+    void delay(uint32_t ms) override { nowMs += ms; }
+
+    uint32_t nowMs;
+};
+
+// FrameCaptureTask's consumer side without the task or its lock
+class RingFrameSource : public FrameSource
+{
+public:
+    explicit RingFrameSource(FrameRing &ring) : acquiredSeq(0), ring(ring) {}
+
+    bool isAvailable() override { return true; }
+    void setActive(bool active) override {}
+
+    bool acquire(CapturedFrame &frame) override
+    {
+        int index = ring.acquireLatest();
+        if (index < 0)
+            return false;
+        FrameRing::Slot &slot = ring.slot(index);
+        frame.slot = index;
+        frame.data = slot.data;
+        frame.len = slot.len;
+        frame.timestampMs = slot.timestampMs;
+        frame.seq = slot.seq;
+        frame.hasSignature = false;
+        acquiredSeq = slot.seq;
+        return true;
+    }
+
+    void release(const CapturedFrame &frame) override { ring.release(frame.slot); }
+
+    uint32_t acquiredSeq;
+
+private:
+    FrameRing &ring;
+};
+
+void setUp()
+{
+    ring = new FrameRing();
+}
+
+void tearDown()
+{
+    delete ring;
+}
+
+void test_empty_ring_has_no_frame()
+{
+    TEST_ASSERT_EQUAL(-1, ring->acquireLatest());
+    TEST_ASSERT_EQUAL_UINT32(0, ring->framesWritten());
+}
+
+void test_newest_frame_taken()
+{
+    writeFrame(100);
+    writeFrame(200);
+    int newest = writeFrame(300);
+
+    int index = ring->acquireLatest();
+    TEST_ASSERT_EQUAL(newest, index);
+    TEST_ASSERT_EQUAL_UINT32(3, ring->slot(index).seq);
+    TEST_ASSERT_EQUAL_UINT32(300, ring->slot(index).timestampMs);
+}
+
+void test_full_ring_overwrites_oldest()
+{
+    int oldest = writeFrame(100);
+    writeFrame(200);
+    writeFrame(300);
+
+    // No reader yet: the stalest frame gives way
+    TEST_ASSERT_EQUAL(oldest, writeFrame(400));
+    TEST_ASSERT_EQUAL_UINT32(1, ring->framesOverwritten());
+    TEST_ASSERT_EQUAL_UINT32(4, ring->framesWritten());
+    TEST_ASSERT_EQUAL_UINT32(400, ring->slot(ring->acquireLatest()).timestampMs);
+}
+
+void test_held_slot_not_reused()
+{
+    writeFrame(100, 0x11);
+    int held = ring->acquireLatest();
+    TEST_ASSERT_EQUAL(FrameRing::SLOT_READING, ring->slot(held).state);
+
+    // The producer keeps going around the other slots
+    for (int i = 0; i < 10; i++)
+        TEST_ASSERT_NOT_EQUAL(held, writeFrame(200 + i, 0x22));
+
+    const FrameRing::Slot &slot = ring->slot(held);
+    TEST_ASSERT_EQUAL_UINT32(1, slot.seq);
+    TEST_ASSERT_EQUAL_UINT32(100, slot.timestampMs);
+    TEST_ASSERT_EQUAL_HEX8(0x11, slot.data[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x11, slot.data[slot.len - 1]);
+    // Two free slots, then each write replaced the older of those two
+    TEST_ASSERT_EQUAL_UINT32(8, ring->framesOverwritten());
+}
+
+void test_release_frees_older_frames()
+{
+    int older = writeFrame(100);
+    writeFrame(200);
+    int index = ring->acquireLatest();
+    ring->release(index);
+
+    // Neither the consumed frame nor the one before it comes back
+    TEST_ASSERT_EQUAL(FrameRing::SLOT_FREE, ring->slot(older).state);
+    TEST_ASSERT_EQUAL(-1, ring->acquireLatest());
+}
+
+void test_release_keeps_newer_frames()
+{
+    writeFrame(100);
+    int index = ring->acquireLatest();
+    int newer = writeFrame(200); // Written while the first was held
+    ring->release(index);
+
+    TEST_ASSERT_EQUAL(newer, ring->acquireLatest());
+}
+
+void test_every_slot_busy()
+{
+    // A consumer holding two frames and a write in progress: nothing left
+    writeFrame(100);
+    ring->acquireLatest();
+    writeFrame(200);
+    ring->acquireLatest();
+    int writing = ring->beginWrite();
+    TEST_ASSERT_TRUE(writing >= 0);
+    TEST_ASSERT_EQUAL(-1, ring->beginWrite());
+
+    ring->abortWrite(writing);
+    TEST_ASSERT_EQUAL(writing, ring->beginWrite());
+}
+
+void test_aborted_write_not_published()
+{
+    int index = ring->beginWrite();
+    ring->abortWrite(index);
+    TEST_ASSERT_EQUAL(-1, ring->acquireLatest());
+    TEST_ASSERT_EQUAL_UINT32(0, ring->framesWritten());
+}
+
+void test_frame_age_at_send()
+{
+    static const char STORAGE_PATH[] = "/tmp/test_frame_ring_settings.bin";
+    unlink(STORAGE_PATH);
+    FileStorage storage(STORAGE_PATH, ConfigStore::STORAGE_SIZE);
+    storage.begin();
+    ConfigStore config;
+    config.begin(&storage);
+    ManualClock clock;
+    HostLink link;
+    RingFrameSource frames(*ring);
+
+    AIBotManager bot;
+    bot.begin(&frames, &link, &config, &clock);
+    // Nothing listens there: the request fails on connect, after the send
+    bot.setApiConfig("http://127.0.0.1:9", "/message", "/health");
+    bot.setCadence(0, 50);
+    bot.startBot();
+    while (bot.getNextRequestIn() > 0)
+        clock.delay(1);
+
+    // Three frames 40 ms apart; the newest is 25 ms old when the bot sends
+    writeFrame(clock.nowMs - 105);
+    writeFrame(clock.nowMs - 65);
+    writeFrame(clock.nowMs - 25);
+    bot.loop();
+
+    TEST_ASSERT_EQUAL_UINT32(3, frames.acquiredSeq);
+    TEST_ASSERT_EQUAL_UINT32(25, bot.getLastFrameAge());
+
+    for (int i = 0; i < 2000 && bot.isRequestInFlight(); i++)
+    {
+        clock.delay(1);
+        usleep(1000);
+        bot.loop();
+    }
+    TEST_ASSERT_FALSE(bot.isRequestInFlight());
+    // Released with the request, and consumed: not handed out a second time
+    TEST_ASSERT_EQUAL(-1, ring->acquireLatest());
+    TEST_ASSERT_EQUAL(0, (int)ring->framesOverwritten());
+    unlink(STORAGE_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    Log::setLevel(LOG_LEVEL_ERROR);
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_ring_has_no_frame);
+    RUN_TEST(test_newest_frame_taken);
+    RUN_TEST(test_full_ring_overwrites_oldest);
+    RUN_TEST(test_held_slot_not_reused);
+    RUN_TEST(test_release_frees_older_frames);
+    RUN_TEST(test_release_keeps_newer_frames);
+    RUN_TEST(test_every_slot_busy);
+    RUN_TEST(test_aborted_write_not_published);
+    RUN_TEST(test_frame_age_at_send);
+    return UNITY_END();
+}
@@ -0,0 +1,441 @@
+// HttpServer on a loopback port, over lib/ArduinoHost's WiFiServer: routing,
+// keep-alive, pipelining, the connection cap, a slow client next to a fast
+// one, and a load test that prints requests/s and p50/p99 latency with
+// MAX_CONNECTIONS clients, on kept-alive connections and on one connection
+// per request. The clients are non-blocking sockets driven from the same
+// loop as the server, as a single-core board would see them.
+//   pio test -e native -f test_http_server -v
+
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "hal_native.h"
+#include "http_server.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+
+static void handleEcho(HttpRequest &req, HttpResponse &res)
+{
+    res.addHeader("X-Request-Index", String((unsigned)req.requestIndex));
+    res.send(200, "text/plain", String(req.method) + " " + req.path + "?" + req.query);
+}
+
+static void handleBye(HttpRequest &req, HttpResponse &res)
+{
+    res.closeAfterSend();
+    res.send(200, "text/plain", "bye");
+}
+
+static void handlePing(HttpRequest &req, HttpResponse &res)
+{
+    res.send(200, "text/plain", "pong");
+}
+
+static constexpr HttpServer::Route ROUTES[] = {
+    {"GET", "/bye", handleBye},
+    {"GET", "/echo", handleEcho},
+    {"GET", "/ping", handlePing},
+};
+static_assert(routeTableSorted(ROUTES), "ROUTES must be sorted");
+
+static const char PING[] = "GET /ping HTTP/1.1\r\nHost: bot\r\n\r\n";
+static const char PING_CLOSE[] = "GET /ping HTTP/1.1\r\nHost: bot\r\nConnection: close\r\n\r\n";
+
+static WiFiServer *listener;
+static HttpServer *http;
+static uint16_t port;
+
+static uint16_t freePort()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+// Connected before the server accepts: the kernel completes the handshake
+static int connectClient()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    return fd;
+}
+
+static void sendText(int fd, const char *text)
+{
+    TEST_ASSERT_EQUAL((int)strlen(text), (int)send(fd, text, strlen(text), MSG_NOSIGNAL));
+}
+
+// Length of the first whole response in text, 0 if it has not all arrived
+static size_t responseLength(const std::string &text)
+{
+    size_t headEnd = text.find("\r\n\r\n");
+    if (headEnd == std::string::npos)
+        return 0;
+    size_t field = text.find("Content-Length: ");
+    if (field == std::string::npos || field > headEnd)
+        return 0;
+    size_t total = headEnd + 4 + strtoul(text.c_str() + field + 16, nullptr, 10);
+    return text.size() >= total ? total : 0;
+}
+
+// Appends what has arrived on fd; false once the peer has closed
+static bool receiveSome(int fd, std::string &into)
+{
+    char buffer[2048];
+    int n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n > 0)
+        into.append(buffer, n);
+    return n != 0 && (n > 0 || errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+// Runs the server until count whole responses have arrived on fd (or 2 s
+// pass) and returns them one per element
+static std::vector<std::string> awaitResponses(int fd, size_t count)
+{
+    std::vector<std::string> responses;
+    std::string pending;
+    uint32_t start = hostMillis();
+    while (responses.size() < count && hostMillis() - start < 2000)
+    {
+        http->loop();
+        receiveSome(fd, pending);
+        size_t len;
+        while (responses.size() < count && (len = responseLength(pending)) > 0)
+        {
+            responses.push_back(pending.substr(0, len));
+            pending.erase(0, len);
+        }
+    }
+    return responses;
+}
+
+static std::string awaitResponse(int fd)
+{
+    std::vector<std::string> responses = awaitResponses(fd, 1);
+    return responses.empty() ? std::string() : responses[0];
+}
+
+// Runs the server until it has closed fd, or 2 s pass
+static bool awaitClose(int fd)
+{
+    std::string ignored;
+    uint32_t start = hostMillis();
+    while (hostMillis() - start < 2000)
+    {
+        http->loop();
+        if (!receiveSome(fd, ignored))
+            return true;
+    }
+    return false;
+}
+
+static bool contains(const std::string &text, const char *part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+static std::string bodyOf(const std::string &response)
+{
+    size_t headEnd = response.find("\r\n\r\n");
+    return headEnd == std::string::npos ? std::string() : response.substr(headEnd + 4);
+}
+
+// Handler runs recorded in /metrics so far
+static long handlerCount()
+{
+    String out;
+    Metrics::writePrometheus(out);
+    const char *line = strstr(out.c_str(), "bot_stage_seconds_count{stage=\"http\"} ");
+    return line ? atol(strchr(line, ' ') + 1) : -1;
+}
+
+void setUp()
+{
+    port = freePort();
+    listener = new WiFiServer(port);
+    listener->begin();
+    http = new HttpServer();
+    http->begin(listener);
+    http->setRoutes(ROUTES, sizeof(ROUTES) / sizeof(ROUTES[0]));
+}
+
+void tearDown()
+{
+    delete http;
+    delete listener;
+}
+
+void test_routes_dispatch()
+{
+    long handled = handlerCount();
+    int fd = connectClient();
+    sendText(fd, "GET /echo?angle=90 HTTP/1.1\r\nHost: bot\r\n\r\n");
+    std::string response = awaitResponse(fd);
+    TEST_ASSERT_TRUE(contains(response, "HTTP/1.1 200 OK\r\n"));
+    TEST_ASSERT_TRUE(contains(response, "Content-Type: text/plain\r\n"));
+    TEST_ASSERT_EQUAL_STRING("GET /echo?angle=90", bodyOf(response).c_str());
+
+    sendText(fd, "GET /missing HTTP/1.1\r\n\r\n");
+    TEST_ASSERT_TRUE(contains(awaitResponse(fd), "HTTP/1.1 404 Not Found\r\n"));
+    sendText(fd, "POST /ping HTTP/1.1\r\n\r\n");
+    TEST_ASSERT_TRUE(contains(awaitResponse(fd), "HTTP/1.1 405 Method Not Allowed\r\n"));
+    TEST_ASSERT_EQUAL(3, (int)http->getRequestCount());
+    // Only the request that reached a route handler is timed
+    TEST_ASSERT_EQUAL(handled + 1, handlerCount());
+    close(fd);
+}
+
+void test_bad_request_closes()
+{
+    int fd = connectClient();
+    sendText(fd, "nonsense\r\n\r\n");
+    std::string response = awaitResponse(fd);
+    TEST_ASSERT_TRUE(contains(response, "HTTP/1.1 400 Bad Request\r\n"));
+    TEST_ASSERT_TRUE(contains(response, "Connection: close\r\n"));
+    TEST_ASSERT_TRUE(awaitClose(fd));
+    close(fd);
+}
+
+void test_keep_alive_reuses_connection()
+{
+    int fd = connectClient();
+    for (int i = 1; i <= 3; i++)
+    {
+        sendText(fd, "GET /echo HTTP/1.1\r\n\r\n");
+        std::string response = awaitResponse(fd);
+        TEST_ASSERT_TRUE(contains(response, "Connection: keep-alive\r\n"));
+        std::string index = "X-Request-Index: " + std::to_string(i) + "\r\n";
+        TEST_ASSERT_TRUE(contains(response, index.c_str()));
+    }
+    TEST_ASSERT_EQUAL(1, http->getConnectionCount());
+
+    // HTTP/1.0 without keep-alive, Connection: close and closeAfterSend() all end it
+    sendText(fd, "GET /bye HTTP/1.1\r\n\r\n");
+    TEST_ASSERT_TRUE(contains(awaitResponse(fd), "Connection: close\r\n"));
+    TEST_ASSERT_TRUE(awaitClose(fd));
+    close(fd);
+
+    fd = connectClient();
+    sendText(fd, PING_CLOSE);
+    TEST_ASSERT_TRUE(contains(awaitResponse(fd), "Connection: close\r\n"));
+    TEST_ASSERT_TRUE(awaitClose(fd));
+    close(fd);
+
+    fd = connectClient();
+    sendText(fd, "GET /ping HTTP/1.0\r\n\r\n");
+    TEST_ASSERT_TRUE(contains(awaitResponse(fd), "Connection: close\r\n"));
+    TEST_ASSERT_TRUE(awaitClose(fd));
+    close(fd);
+    TEST_ASSERT_EQUAL(0, http->getConnectionCount());
+}
+
+void test_pipelined_requests_answered_in_order()
+{
+    int fd = connectClient();
+    sendText(fd, "GET /echo?first HTTP/1.1\r\n\r\nGET /echo?second HTTP/1.1\r\n\r\n");
+    std::vector<std::string> responses = awaitResponses(fd, 2);
+    TEST_ASSERT_EQUAL(2, (int)responses.size());
+    TEST_ASSERT_EQUAL_STRING("GET /echo?first", bodyOf(responses[0]).c_str());
+    TEST_ASSERT_EQUAL_STRING("GET /echo?second", bodyOf(responses[1]).c_str());
+    close(fd);
+}
+
+void test_slow_client_does_not_hold_up_others()
+{
+    int slow = connectClient();
+    sendText(slow, "GET /echo?slow HTTP/1.1\r\nHost: bot\r\n");
+    for (int i = 0; i < 10; i++)
+        http->loop();
+
+    int fast = connectClient();
+    sendText(fast, PING);
+    uint32_t start = hostMillis();
+    TEST_ASSERT_EQUAL_STRING("pong", bodyOf(awaitResponse(fast)).c_str());
+    TEST_ASSERT_LESS_THAN(100, hostMillis() - start);
+
+    sendText(slow, "\r\n");
+    TEST_ASSERT_EQUAL_STRING("GET /echo?slow", bodyOf(awaitResponse(slow)).c_str());
+    close(slow);
+    close(fast);
+}
+
+void test_idle_connection_makes_room()
+{
+    // Every slot holds an idle keep-alive connection
+    int fds[HttpServer::MAX_CONNECTIONS];
+    for (int i = 0; i < HttpServer::MAX_CONNECTIONS; i++)
+    {
+        fds[i] = connectClient();
+        sendText(fds[i], PING);
+        TEST_ASSERT_EQUAL_STRING("pong", bodyOf(awaitResponse(fds[i])).c_str());
+    }
+    TEST_ASSERT_EQUAL(HttpServer::MAX_CONNECTIONS, http->getConnectionCount());
+
+    int extra = connectClient();
+    sendText(extra, PING);
+    TEST_ASSERT_EQUAL_STRING("pong", bodyOf(awaitResponse(extra)).c_str());
+    TEST_ASSERT_EQUAL(HttpServer::MAX_CONNECTIONS, http->getConnectionCount());
+    TEST_ASSERT_TRUE(awaitClose(fds[0]));
+
+    for (int i = 0; i < HttpServer::MAX_CONNECTIONS; i++)
+        close(fds[i]);
+    close(extra);
+}
+
+// One client of the load test: a request in flight at a time
+struct LoadClient
+{
+    int fd;
+    bool waiting;
+    uint32_t sentUs;
+    std::string pending;
+};
+
+struct LoadResult
+{
+    uint32_t requests;
+    uint32_t failures;
+    float perSecond;
+    uint32_t p50Us;
+    uint32_t p99Us;
+};
+
+static LoadResult runLoad(uint32_t requests, bool keepAlive)
+{
+    const char *request = keepAlive ? PING : PING_CLOSE;
+    LoadClient clients[HttpServer::MAX_CONNECTIONS];
+    for (LoadClient &c : clients)
+    {
+        c.fd = -1;
+        c.waiting = false;
+    }
+
+    LatencyHistogram latency;
+    LoadResult result = {0, 0, 0, 0, 0};
+    uint32_t started = 0;
+    uint32_t startUs = hostMicros();
+    uint32_t deadline = hostMillis() + 30000;
+
+    while (result.requests + result.failures < requests && (int32_t)(hostMillis() - deadline) < 0)
+    {
+        http->loop();
+        for (LoadClient &c : clients)
+        {
+            if (!c.waiting)
+            {
+                if (started == requests)
+                    continue;
+                if (c.fd < 0)
+                    c.fd = connectClient();
+                c.sentUs = hostMicros();
+                send(c.fd, request, strlen(request), MSG_NOSIGNAL);
+                c.waiting = true;
+                started++;
+                continue;
+            }
+
+            bool open = receiveSome(c.fd, c.pending);
+            size_t len = responseLength(c.pending);
+            if (len == 0 && open)
+                continue;
+
+            if (len > 0 && c.pending.compare(0, 15, "HTTP/1.1 200 OK") == 0)
+            {
+                latency.record(hostMicros() - c.sentUs, hostMillis());
+                result.requests++;
+            }
+            else
+            {
+                result.failures++;
+            }
+            // The server ends a connection after so many requests; start another
+            bool closing = !open || c.pending.find("Connection: close\r\n") < len;
+            c.pending.erase(0, len > 0 ? len : c.pending.size());
+            c.waiting = false;
+            if (closing)
+            {
+                close(c.fd);
+                c.fd = -1;
+            }
+        }
+    }
+
+    uint32_t elapsedUs = hostMicros() - startUs;
+    for (LoadClient &c : clients)
+    {
+        if (c.fd >= 0)
+            close(c.fd);
+    }
+
+    result.perSecond = result.requests * 1e6f / (elapsedUs ? elapsedUs : 1);
+    result.p50Us = latency.quantile(0.5f, hostMillis());
+    result.p99Us = latency.quantile(0.99f, hostMillis());
+    return result;
+}
+
+static void reportLoad(const char *name, const LoadResult &result)
+{
+    char message[160];
+    snprintf(message, sizeof(message), "%s: %d clients, %u requests, %.0f req/s, p50 %u us, p99 %u us, %u failed",
+             name, HttpServer::MAX_CONNECTIONS, (unsigned)result.requests, result.perSecond,
+             (unsigned)result.p50Us, (unsigned)result.p99Us, (unsigned)result.failures);
+    TEST_MESSAGE(message);
+}
+
+void test_load_keep_alive()
+{
+    LoadResult result = runLoad(20000, true);
+    reportLoad("keep-alive", result);
+    TEST_ASSERT_EQUAL(0, (int)result.failures);
+    TEST_ASSERT_EQUAL(20000, (int)result.requests);
+    TEST_ASSERT_LESS_THAN(50000, result.p99Us);
+}
+
+void test_load_connection_per_request()
+{
+    LoadResult result = runLoad(5000, false);
+    reportLoad("connection per request", result);
+    TEST_ASSERT_EQUAL(0, (int)result.failures);
+    TEST_ASSERT_EQUAL(5000, (int)result.requests);
+    TEST_ASSERT_LESS_THAN(50000, result.p99Us);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_routes_dispatch);
+    RUN_TEST(test_bad_request_closes);
+    RUN_TEST(test_keep_alive_reuses_connection);
+    RUN_TEST(test_pipelined_requests_answered_in_order);
+    RUN_TEST(test_slow_client_does_not_hold_up_others);
+    RUN_TEST(test_idle_connection_makes_room);
+    RUN_TEST(test_load_keep_alive);
+    RUN_TEST(test_load_connection_per_request);
+    return UNITY_END();
+}
@@ -0,0 +1,310 @@
+// LogRing keeps whole lines across the end of its buffer and counts the ones
+// that do not fit; Log cuts long lines with a "...(+N)" marker and resolves
+// each tag's level from its override or the global level.
+//   pio test -e native -f test_log_ring
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "log.h"
+#include "log_ring.h"
+
+static uint8_t storage[32];
+static LogRing *ring;
+
+static std::string popLine(size_t outSize = 64)
+{
+    char out[64];
+    size_t len = ring->pop(out, outSize);
+    return std::string(out, len);
+}
+
+// What a call wrote to Serial, which is stdout on the host: Log has no
+// drain task here, so lines go straight out
+template <typename F>
+static std::string captureSerial(F call)
+{
+    fflush(stdout);
+    int saved = dup(fileno(stdout));
+    FILE *file = tmpfile();
+    dup2(fileno(file), fileno(stdout));
+
+    call();
+
+    fflush(stdout);
+    dup2(saved, fileno(stdout));
+    close(saved);
+
+    std::string text;
+    char buf[256];
+    rewind(file);
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+        text.append(buf, n);
+    fclose(file);
+    return text;
+}
+
+static void clearTagLevels()
+{
+    int level;
+    while (Log::getTagOverrideCount() > 0)
+        Log::setTagLevel(Log::getTagOverride(0, level), -1);
+}
+
+void setUp()
+{
+    ring = new LogRing(storage, sizeof(storage));
+    Log::setLevel(LOG_LEVEL_INFO);
+    clearTagLevels();
+}
+
+void tearDown()
+{
+    delete ring;
+}
+
+void test_lines_come_back_in_order()
+{
+    TEST_ASSERT_TRUE(ring->isEmpty());
+    TEST_ASSERT_TRUE(ring->push("one", 3));
+    TEST_ASSERT_TRUE(ring->push("two", 3));
+    TEST_ASSERT_EQUAL(10, (int)ring->getUsed()); // 2-byte length per line
+
+    TEST_ASSERT_EQUAL_STRING("one", popLine().c_str());
+    TEST_ASSERT_EQUAL_STRING("two", popLine().c_str());
+    TEST_ASSERT_TRUE(ring->isEmpty());
+    TEST_ASSERT_EQUAL(0, (int)ring->pop(nullptr, 0));
+}
+
+void test_line_wraps_around_the_end()
+{
+    // 12 + 12 bytes, then free the first: the third line starts at 24 of 32
+    ring->push("0123456789", 10);
+    ring->push("abcdefghij", 10);
+    popLine();
+    TEST_ASSERT_TRUE(ring->push("ABCDEFGHIJKLMN", 14));
+    TEST_ASSERT_EQUAL(28, (int)ring->getUsed());
+
+    TEST_ASSERT_EQUAL_STRING("abcdefghij", popLine().c_str());
+    TEST_ASSERT_EQUAL_STRING("ABCDEFGHIJKLMN", popLine().c_str());
+    TEST_ASSERT_TRUE(ring->isEmpty());
+
+    // The length header itself split across the end
+    ring->push("0123456789abcdefghijklmnopq", 27); // Next write at 5
+    popLine();
+    ring->push("x", 1);
+    ring->push("0123456789abcdefghijk", 21); // Next write at 31
+    TEST_ASSERT_TRUE(ring->push("yz", 2));
+    TEST_ASSERT_EQUAL_STRING("x", popLine().c_str());
+    TEST_ASSERT_EQUAL_STRING("0123456789abcdefghijk", popLine().c_str());
+    TEST_ASSERT_EQUAL_STRING("yz", popLine().c_str());
+    TEST_ASSERT_EQUAL_UINT32(0, ring->getDropped());
+}
+
+void test_full_ring_drops_and_counts()
+{
+    TEST_ASSERT_TRUE(ring->push("0123456789abcdefghijkl", 22));
+    TEST_ASSERT_TRUE(ring->push("abcdef", 6)); // Exactly full
+    TEST_ASSERT_FALSE(ring->push("x", 1));
+    TEST_ASSERT_FALSE(ring->push("", 0)); // Even an empty line needs its length
+    TEST_ASSERT_EQUAL_UINT32(2, ring->getDropped());
+
+    // Dropped lines leave the ones already in untouched
+    TEST_ASSERT_EQUAL_STRING("0123456789abcdefghijkl", popLine().c_str());
+    TEST_ASSERT_TRUE(ring->push("later", 5));
+    TEST_ASSERT_EQUAL_STRING("abcdef", popLine().c_str());
+    TEST_ASSERT_EQUAL_STRING("later", popLine().c_str());
+
+    TEST_ASSERT_EQUAL_UINT32(2, ring->takeDropped());
+    TEST_ASSERT_EQUAL_UINT32(0, ring->getDropped());
+}
+
+void test_line_larger_than_ring_dropped()
+{
+    TEST_ASSERT_FALSE(ring->push("0123456789abcdefghijklmnopqrstuv", 31));
+    TEST_ASSERT_EQUAL_UINT32(1, ring->getDropped());
+    TEST_ASSERT_TRUE(ring->isEmpty());
+}
+
+void test_pop_into_short_buffer_skips_rest()
+{
+    ring->push("0123456789", 10);
+    ring->push("next", 4);
+    TEST_ASSERT_EQUAL_STRING("0123", popLine(4).c_str());
+    TEST_ASSERT_EQUAL_STRING("next", popLine().c_str());
+    TEST_ASSERT_TRUE(ring->isEmpty());
+}
+
+void test_short_line_written_whole()
+{
+    std::string out = captureSerial([] { Log::write(LOG_LEVEL_WARN, "cam", "fps %d", 12); });
+    // "[     0.123] W cam: fps 12\r\n"
+    TEST_ASSERT_EQUAL('[', out[0]);
+    TEST_ASSERT_TRUE(out.find("] W cam: fps 12\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(out.find("...(+") == std::string::npos);
+}
+
+void test_long_line_cut_with_marker()
+{
+    uint32_t truncated = Log::getTruncated();
+    std::string payload(300, 'x');
+    std::string out = captureSerial([&] { Log::write(LOG_LEVEL_INFO, "bot", "%s", payload.c_str()); });
+
+    size_t prefix = out.find("I bot: ") + strlen("I bot: ");
+    TEST_ASSERT_TRUE(prefix > 0);
+    // The head up to MAX_LINE - 1, then the number of bytes cut
+    size_t kept = Log::MAX_LINE - 1;
+    std::string marker = "...(+" + std::to_string(prefix + payload.size() - kept) + ")\r\n";
+    TEST_ASSERT_EQUAL(kept + marker.size(), out.size());
+    TEST_ASSERT_EQUAL_STRING(marker.c_str(), out.substr(kept).c_str());
+    TEST_ASSERT_EQUAL(kept, out.find_first_not_of('x', prefix));
+    TEST_ASSERT_EQUAL_UINT32(truncated + 1, Log::getTruncated());
+}
+
+void test_line_at_the_limit()
+{
+    // Measure the prefix, then fill the line to exactly MAX_LINE - 1 and one more
+    std::string probe = captureSerial([] { Log::write(LOG_LEVEL_INFO, "bot", "%s", ""); });
+    size_t prefix = probe.size() - 2;
+    uint32_t truncated = Log::getTruncated();
+
+    std::string fits(Log::MAX_LINE - 1 - prefix, 'a');
+    std::string out = captureSerial([&] { Log::write(LOG_LEVEL_INFO, "bot", "%s", fits.c_str()); });
+    TEST_ASSERT_EQUAL(Log::MAX_LINE + 1, out.size()); // Line ending included
+    TEST_ASSERT_EQUAL_UINT32(truncated, Log::getTruncated());
+
+    std::string over = fits + "b";
+    out = captureSerial([&] { Log::write(LOG_LEVEL_INFO, "bot", "%s", over.c_str()); });
+    TEST_ASSERT_TRUE(out.find("a...(+1)\r\n") != std::string::npos);
+    TEST_ASSERT_EQUAL_UINT32(truncated + 1, Log::getTruncated());
+}
+
+void test_global_level()
+{
+    Log::setLevel(LOG_LEVEL_WARN);
+    TEST_ASSERT_TRUE(Log::enabled(LOG_LEVEL_ERROR, "bot"));
+    TEST_ASSERT_TRUE(Log::enabled(LOG_LEVEL_WARN, "bot"));
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_INFO, "bot"));
+
+    Log::setLevel(99); // Clamped
+    TEST_ASSERT_EQUAL(LOG_LEVEL_VERBOSE, Log::getLevel());
+    Log::setLevel(LOG_LEVEL_NONE);
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_ERROR, "bot"));
+}
+
+void test_tag_override_wins_either_way()
+{
+    Log::setLevel(LOG_LEVEL_WARN);
+    Log::setTagLevel("cam", LOG_LEVEL_DEBUG);
+    Log::setTagLevel("net", LOG_LEVEL_NONE);
+
+    TEST_ASSERT_TRUE(Log::enabled(LOG_LEVEL_DEBUG, "cam"));
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_VERBOSE, "cam"));
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_ERROR, "net"));
+    // Other tags, including ones that share a prefix, keep the global level
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_DEBUG, "bot"));
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_DEBUG, "camera"));
+    TEST_ASSERT_TRUE(Log::enabled(LOG_LEVEL_WARN, "bot"));
+
+    // The global level moving does not touch overrides
+    Log::setLevel(LOG_LEVEL_VERBOSE);
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_ERROR, "net"));
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_VERBOSE, "cam"));
+}
+
+void test_tag_override_replaced_and_removed()
+{
+    Log::setLevel(LOG_LEVEL_INFO);
+    Log::setTagLevel("cam", LOG_LEVEL_ERROR);
+    Log::setTagLevel("cam", LOG_LEVEL_DEBUG);
+    TEST_ASSERT_EQUAL(1, Log::getTagOverrideCount());
+    TEST_ASSERT_TRUE(Log::enabled(LOG_LEVEL_DEBUG, "cam"));
+
+    Log::setTagLevel("net", LOG_LEVEL_ERROR);
+    Log::setTagLevel("cam", -1);
+    TEST_ASSERT_EQUAL(1, Log::getTagOverrideCount());
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_DEBUG, "cam"));
+    TEST_ASSERT_TRUE(Log::enabled(LOG_LEVEL_INFO, "cam"));
+    // The override moved into the removed one's place still applies
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_WARN, "net"));
+
+    int level = -1;
+    TEST_ASSERT_EQUAL_STRING("net", Log::getTagOverride(0, level));
+    TEST_ASSERT_EQUAL(LOG_LEVEL_ERROR, level);
+    TEST_ASSERT_NULL(Log::getTagOverride(1, level));
+
+    Log::setTagLevel("unknown", -1); // Nothing to remove
+    TEST_ASSERT_EQUAL(1, Log::getTagOverrideCount());
+}
+
+void test_tag_overrides_full()
+{
+    char tag[8];
+    for (int i = 0; i < Log::MAX_TAG_LEVELS; i++)
+    {
+        snprintf(tag, sizeof(tag), "t%d", i);
+        Log::setTagLevel(tag, LOG_LEVEL_VERBOSE);
+    }
+    // No room for a new tag, but existing ones can still change
+    Log::setTagLevel("extra", LOG_LEVEL_VERBOSE);
+    TEST_ASSERT_EQUAL(Log::MAX_TAG_LEVELS, Log::getTagOverrideCount());
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_DEBUG, "extra"));
+
+    Log::setTagLevel("t3", LOG_LEVEL_ERROR);
+    TEST_ASSERT_FALSE(Log::enabled(LOG_LEVEL_WARN, "t3"));
+    TEST_ASSERT_TRUE(Log::enabled(LOG_LEVEL_VERBOSE, "t7"));
+}
+
+static int evaluated;
+
+static int countEvaluation()
+{
+    return ++evaluated;
+}
+
+void test_disabled_call_skips_arguments()
+{
+    Log::setLevel(LOG_LEVEL_INFO);
+    Log::setTagLevel("cam", LOG_LEVEL_WARN);
+    evaluated = 0;
+
+    std::string out = captureSerial([] {
+        LOG_D("bot", "%d", countEvaluation());
+        LOG_I("cam", "%d", countEvaluation());
+        LOG_W("cam", "%d", countEvaluation());
+    });
+    TEST_ASSERT_EQUAL(1, evaluated);
+    TEST_ASSERT_TRUE(out.find("] W cam: 1\r\n") != std::string::npos);
+}
+
+void test_level_names()
+{
+    for (int level = LOG_LEVEL_NONE; level <= LOG_LEVEL_VERBOSE; level++)
+        TEST_ASSERT_EQUAL(level, Log::parseLevel(Log::levelName(level)));
+    TEST_ASSERT_EQUAL(-1, Log::parseLevel("loud"));
+    TEST_ASSERT_EQUAL_STRING("?", Log::levelName(6));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lines_come_back_in_order);
+    RUN_TEST(test_line_wraps_around_the_end);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_line_larger_than_ring_dropped);
+    RUN_TEST(test_pop_into_short_buffer_skips_rest);
+    RUN_TEST(test_short_line_written_whole);
+    RUN_TEST(test_long_line_cut_with_marker);
+    RUN_TEST(test_line_at_the_limit);
+    RUN_TEST(test_global_level);
+    RUN_TEST(test_tag_override_wins_either_way);
+    RUN_TEST(test_tag_override_replaced_and_removed);
+    RUN_TEST(test_tag_overrides_full);
+    RUN_TEST(test_disabled_call_skips_arguments);
+    RUN_TEST(test_level_names);
+    return UNITY_END();
+}
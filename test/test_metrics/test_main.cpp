@@ -0,0 +1,221 @@
+// LatencyHistogram buckets, quantiles and windows from known samples, and
+// Metrics as /metrics serves it: per-stage quantiles and counters, and the
+// cycle statuses with their "other" bucket.
+//   pio test -e native -f test_metrics
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "latency_histogram.h"
+#include "metrics.h"
+
+static const uint32_t T0 = 1000; // Any start time; windows run from the first sample
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Entries in the JSON object that starts at key, e.g. "\"statuses\":{"
+static int objectSize(const std::string &json, const char *key)
+{
+    size_t start = json.find(key);
+    if (start == std::string::npos)
+        return -1;
+    start += strlen(key);
+    size_t end = json.find('}', start);
+    if (end == start)
+        return 0;
+    int entries = 1;
+    for (size_t i = start; i < end; i++)
+        entries += json[i] == ',';
+    return entries;
+}
+
+void test_buckets_exact_then_within_a_quarter()
+{
+    for (uint32_t us = 0; us < 8; us++)
+    {
+        TEST_ASSERT_EQUAL(us, LatencyHistogram::bucketOf(us));
+        TEST_ASSERT_EQUAL_UINT32(us, LatencyHistogram::bucketUpper(us));
+    }
+
+    int previous = LatencyHistogram::bucketOf(7);
+    for (uint32_t us = 8; us < 70000000; us += us / 7 + 1)
+    {
+        int bucket = LatencyHistogram::bucketOf(us);
+        uint32_t upper = LatencyHistogram::bucketUpper(bucket);
+        TEST_ASSERT_TRUE(bucket >= previous);
+        TEST_ASSERT_TRUE(upper >= us);
+        TEST_ASSERT_TRUE(upper - us <= us / 4);
+        TEST_ASSERT_EQUAL(bucket, LatencyHistogram::bucketOf(upper)); // Upper bound is in the bucket
+        previous = bucket;
+    }
+    TEST_ASSERT_EQUAL(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketOf(0xFFFFFFFF));
+}
+
+void test_quantiles_from_known_samples()
+{
+    // 90 fast, 5 slow, 5 very slow
+    LatencyHistogram h;
+    for (int i = 0; i < 90; i++)
+        h.record(100, T0);
+    for (int i = 0; i < 5; i++)
+        h.record(1000, T0);
+    for (int i = 0; i < 5; i++)
+        h.record(10000, T0);
+
+    // The upper bound of each sample's bucket, but never above the maximum
+    TEST_ASSERT_EQUAL_UINT32(111, h.quantile(0.5f, T0));
+    TEST_ASSERT_EQUAL_UINT32(1023, h.quantile(0.95f, T0));
+    TEST_ASSERT_EQUAL_UINT32(10000, h.quantile(0.99f, T0));
+    TEST_ASSERT_EQUAL_UINT32(111, h.quantile(0.0f, T0)); // Rank 1
+    TEST_ASSERT_EQUAL_UINT32(10000, h.quantile(1.0f, T0));
+
+    TEST_ASSERT_EQUAL_UINT32(100, h.getWindowCount(T0));
+    TEST_ASSERT_EQUAL_UINT32(10000, h.getWindowMax(T0));
+    TEST_ASSERT_EQUAL_UINT32(100, h.getTotalCount());
+    TEST_ASSERT_TRUE(h.getTotalSumUs() == 90 * 100 + 5 * 1000 + 5 * 10000);
+}
+
+void test_empty_histogram()
+{
+    LatencyHistogram h;
+    TEST_ASSERT_EQUAL_UINT32(0, h.quantile(0.5f, T0));
+    TEST_ASSERT_EQUAL_UINT32(0, h.getWindowCount(T0));
+    TEST_ASSERT_EQUAL_UINT32(0, h.getWindowMax(T0));
+}
+
+void test_windows_roll_over()
+{
+    const uint32_t W = LatencyHistogram::WINDOW_MS;
+    LatencyHistogram h;
+    h.record(5000, T0);
+
+    // Next window: the previous one still counts
+    h.record(100, T0 + W);
+    TEST_ASSERT_EQUAL_UINT32(2, h.getWindowCount(T0 + W));
+    TEST_ASSERT_EQUAL_UINT32(5000, h.getWindowMax(T0 + W));
+    TEST_ASSERT_EQUAL_UINT32(5000, h.quantile(0.99f, T0 + W));
+
+    // One more: the first sample's window is gone
+    h.record(100, T0 + 2 * W);
+    TEST_ASSERT_EQUAL_UINT32(2, h.getWindowCount(T0 + 2 * W));
+    TEST_ASSERT_EQUAL_UINT32(100, h.getWindowMax(T0 + 2 * W));
+    TEST_ASSERT_EQUAL_UINT32(100, h.quantile(0.99f, T0 + 2 * W));
+
+    // Quiet for two windows: nothing left, but the totals stay
+    TEST_ASSERT_EQUAL_UINT32(0, h.getWindowCount(T0 + 5 * W));
+    TEST_ASSERT_EQUAL_UINT32(0, h.quantile(0.5f, T0 + 5 * W));
+    TEST_ASSERT_EQUAL_UINT32(3, h.getTotalCount());
+    TEST_ASSERT_TRUE(h.getTotalSumUs() == 5200);
+}
+
+void test_bucket_count_saturates()
+{
+    LatencyHistogram h;
+    for (uint32_t i = 0; i < 70000; i++)
+        h.record(3, T0);
+    h.record(4, T0);
+
+    // The bucket stopped at 0xFFFF; the window and total counts did not
+    TEST_ASSERT_EQUAL_UINT32(70001, h.getWindowCount(T0));
+    TEST_ASSERT_EQUAL_UINT32(70001, h.getTotalCount());
+    TEST_ASSERT_EQUAL_UINT32(3, h.quantile(0.99f, T0));
+    TEST_ASSERT_EQUAL_UINT32(4, h.quantile(1.0f, T0));
+}
+
+// Metrics keeps its numbers for the whole process: each check below uses a
+// stage no other test records to
+
+void test_metrics_json()
+{
+    for (int i = 0; i < 90; i++)
+        Metrics::record(Metrics::STAGE_PARSE, 100);
+    for (int i = 0; i < 5; i++)
+        Metrics::record(Metrics::STAGE_PARSE, 1000);
+    for (int i = 0; i < 5; i++)
+        Metrics::record(Metrics::STAGE_PARSE, 10000);
+    Metrics::record(Metrics::STAGE_COUNT, 1); // Ignored
+
+    String out;
+    Metrics::writeJson(out);
+    const char *json = out.c_str();
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"parse\":{\"window_count\":100,\"p50_us\":111,\"p95_us\":1023,"
+                                      "\"p99_us\":10000,\"max_us\":10000,\"count\":100}"));
+    TEST_ASSERT_NOT_NULL(strstr(json, "\"display\":{\"window_count\":0,\"p50_us\":0,\"p95_us\":0,"
+                                      "\"p99_us\":0,\"max_us\":0,\"count\":0}"));
+    for (int stage = 0; stage < Metrics::STAGE_COUNT; stage++)
+    {
+        std::string key = std::string("\"") + Metrics::stageName((Metrics::Stage)stage) + "\":{";
+        TEST_ASSERT_NOT_NULL(strstr(json, key.c_str()));
+    }
+}
+
+void test_metrics_prometheus()
+{
+    Metrics::record(Metrics::STAGE_BUILD, 250);
+    Metrics::record(Metrics::STAGE_BUILD, 750);
+
+    String out;
+    Metrics::writePrometheus(out);
+    const char *text = out.c_str();
+    TEST_ASSERT_NOT_NULL(strstr(text, "# TYPE bot_stage_seconds summary\n"));
+    // 250 us lands in [224, 255], 750 us in [640, 767] and is the maximum
+    TEST_ASSERT_NOT_NULL(strstr(text, "bot_stage_seconds{stage=\"build\",quantile=\"0.5\"} 0.000255\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "bot_stage_seconds{stage=\"build\",quantile=\"0.99\"} 0.000750\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "bot_stage_seconds_sum{stage=\"build\"} 0.001000\n"));
+    TEST_ASSERT_NOT_NULL(strstr(text, "bot_stage_seconds_count{stage=\"build\"} 2\n"));
+    // No samples: NaN rather than a made-up 0
+    TEST_ASSERT_NOT_NULL(strstr(text, "bot_stage_seconds{stage=\"display\",quantile=\"0.5\"} NaN\n"));
+}
+
+void test_status_counts_and_other()
+{
+    Metrics::countStatus("Response Recv");
+    Metrics::countStatus("Response Recv");
+    Metrics::countStatus("Err: connect");
+    // Fill the table: the last entry is "other", for every status after
+    char status[Metrics::STATUS_MAX];
+    for (int i = 0; i < Metrics::MAX_STATUSES + 3; i++)
+    {
+        snprintf(status, sizeof(status), "Err: HTTP %d", 500 + i);
+        Metrics::countStatus(status);
+    }
+    Metrics::countStatus("Response Recv"); // Known ones still count as themselves
+
+    String out;
+    Metrics::writeJson(out);
+    std::string json = out.c_str();
+    TEST_ASSERT_EQUAL(Metrics::MAX_STATUSES, objectSize(json, "\"statuses\":{"));
+    TEST_ASSERT_TRUE(json.find("\"Response Recv\":3") != std::string::npos);
+    TEST_ASSERT_TRUE(json.find("\"Err: connect\":1") != std::string::npos);
+    TEST_ASSERT_TRUE(json.find("\"Err: HTTP 512\":1") != std::string::npos);
+    // 2 named, 13 of the HTTP errors named, the other 6 as "other"
+    TEST_ASSERT_TRUE(json.find("\"other\":6}") != std::string::npos);
+    TEST_ASSERT_TRUE(json.find("Err: HTTP 513") == std::string::npos);
+
+    out = String();
+    Metrics::writePrometheus(out);
+    TEST_ASSERT_NOT_NULL(strstr(out.c_str(), "bot_cycles_total{status=\"other\"} 6\n"));
+    TEST_ASSERT_NOT_NULL(strstr(out.c_str(), "bot_cycles_total{status=\"Response Recv\"} 3\n"));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_buckets_exact_then_within_a_quarter);
+    RUN_TEST(test_quantiles_from_known_samples);
+    RUN_TEST(test_empty_histogram);
+    RUN_TEST(test_windows_roll_over);
+    RUN_TEST(test_bucket_count_saturates);
+    RUN_TEST(test_metrics_json);
+    RUN_TEST(test_metrics_prometheus);
+    RUN_TEST(test_status_counts_and_other);
+    return UNITY_END();
+}
@@ -0,0 +1,186 @@
+// MotionProfile: limits, continuity, endpoints and replanning, checked by
+// sampling the planned trajectories
+//   pio test -e native -f test_motion_profile
+
+#include <unity.h>
+
+#include <math.h>
+#include "motion_profile.h"
+
+static const MotionProfile::Limits LIMITS = {300.0f, 1500.0f}; // deg/s, deg/s^2
+static const float STEP = 0.0005f;                              // Sampling interval, s
+static const float EPS = 0.01f;
+
+// Walks the whole trajectory and checks every sample against the limits
+// and its neighbour. Returns the extreme positions reached.
+static void checkTrajectory(const MotionProfile &profile, float from, float startVelocity, float &lowest,
+                            float &highest)
+{
+    float duration = profile.getDuration();
+    float vmax = fmaxf(LIMITS.maxVelocity, fabsf(startVelocity));
+    float lastP = profile.positionAt(0);
+    float lastV = profile.velocityAt(0);
+    TEST_ASSERT_FLOAT_WITHIN(EPS, from, lastP);
+    TEST_ASSERT_FLOAT_WITHIN(EPS, startVelocity, lastV);
+    lowest = highest = lastP;
+
+    for (float t = STEP; t < duration + 2 * STEP; t += STEP)
+    {
+        float p = profile.positionAt(t);
+        float v = profile.velocityAt(t);
+        TEST_ASSERT_TRUE(fabsf(v) <= vmax + EPS);
+        // Acceleration limit, and no jumps in position or speed
+        TEST_ASSERT_TRUE(fabsf(v - lastV) <= LIMITS.maxAcceleration * STEP + EPS);
+        TEST_ASSERT_TRUE(fabsf(p - lastP) <= vmax * STEP + EPS);
+        lowest = fminf(lowest, p);
+        highest = fmaxf(highest, p);
+        lastP = p;
+        lastV = v;
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_long_move_cruises_at_limit()
+{
+    MotionProfile profile;
+    profile.plan(0, 0, 180, LIMITS);
+
+    // Rest to rest with a cruise: D / vmax + vmax / a
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 180.0f / 300.0f + 300.0f / 1500.0f, profile.getDuration());
+    TEST_ASSERT_FLOAT_WITHIN(EPS, 300.0f, profile.velocityAt(profile.getDuration() / 2));
+
+    float lowest, highest;
+    checkTrajectory(profile, 0, 0, lowest, highest);
+    TEST_ASSERT_FLOAT_WITHIN(EPS, 0, lowest);
+    TEST_ASSERT_FLOAT_WITHIN(EPS, 180, highest); // No overshoot
+}
+
+void test_short_move_is_triangular()
+{
+    MotionProfile profile;
+    profile.plan(90, 0, 80, LIMITS);
+
+    // Never reaches full speed: 2 * sqrt(D / a)
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 2 * sqrtf(10.0f / 1500.0f), profile.getDuration());
+    TEST_ASSERT_TRUE(fabsf(profile.velocityAt(profile.getDuration() / 2)) < LIMITS.maxVelocity);
+
+    float lowest, highest;
+    checkTrajectory(profile, 90, 0, lowest, highest);
+    TEST_ASSERT_FLOAT_WITHIN(EPS, 80, lowest);
+}
+
+void test_endpoints_are_exact()
+{
+    const float targets[] = {0, 33, 90, 127.5f, 180};
+    MotionProfile profile;
+    for (float from : targets)
+    {
+        for (float to : targets)
+        {
+            profile.plan(from, 0, to, LIMITS);
+            float end = profile.getDuration();
+            TEST_ASSERT_EQUAL_FLOAT(from, profile.positionAt(0));
+            TEST_ASSERT_TRUE(profile.positionAt(end) == to);
+            TEST_ASSERT_TRUE(profile.positionAt(end + 1) == to);
+            TEST_ASSERT_TRUE(profile.velocityAt(end) == 0);
+            TEST_ASSERT_TRUE(profile.isDone(end));
+            TEST_ASSERT_EQUAL_FLOAT(to, profile.getTarget());
+        }
+    }
+}
+
+void test_no_move_has_no_duration()
+{
+    MotionProfile profile;
+    profile.plan(45, 0, 45, LIMITS);
+    TEST_ASSERT_EQUAL_FLOAT(0, profile.getDuration());
+    TEST_ASSERT_TRUE(profile.isDone(0));
+    TEST_ASSERT_EQUAL_FLOAT(45, profile.positionAt(0));
+}
+
+void test_start_heading_away_brakes_first()
+{
+    MotionProfile profile;
+    profile.plan(90, -200, 150, LIMITS);
+
+    float lowest, highest;
+    checkTrajectory(profile, 90, -200, lowest, highest);
+    // Keeps going the wrong way until stopped: v^2 / 2a past the start
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 90 - 200.0f * 200.0f / (2 * 1500.0f), lowest);
+    TEST_ASSERT_FLOAT_WITHIN(EPS, 150, highest);
+
+    // Turns round once the brake has stopped it
+    float turn = 0;
+    while (profile.velocityAt(turn) < 0)
+        turn += STEP;
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 200.0f / 1500.0f, turn);
+}
+
+void test_too_fast_to_stop_overshoots_and_returns()
+{
+    MotionProfile profile;
+    profile.plan(90, 300, 100, LIMITS);
+
+    float lowest, highest;
+    checkTrajectory(profile, 90, 300, lowest, highest);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 90 + 300.0f * 300.0f / (2 * 1500.0f), highest);
+    TEST_ASSERT_TRUE(profile.positionAt(profile.getDuration()) == 100);
+}
+
+void test_start_above_speed_limit_slows_down()
+{
+    MotionProfile profile;
+    profile.plan(0, 400, 180, LIMITS);
+
+    float lowest, highest;
+    checkTrajectory(profile, 0, 400, lowest, highest);
+    float slowed = (400.0f - 300.0f) / 1500.0f;
+    TEST_ASSERT_FLOAT_WITHIN(EPS, 300, profile.velocityAt(slowed + STEP));
+    TEST_ASSERT_FLOAT_WITHIN(EPS, 180, highest);
+}
+
+void test_replan_midway_is_continuous()
+{
+    // New target while moving, as ServoMotionTask does when a newer move
+    // replaces one in progress
+    MotionProfile first;
+    first.plan(0, 0, 180, LIMITS);
+    const float replanTimes[] = {0.05f, 0.3f, first.getDuration() - 0.05f};
+    const float newTargets[] = {20, 90, 170};
+
+    for (float t : replanTimes)
+    {
+        for (float to : newTargets)
+        {
+            float p = first.positionAt(t);
+            float v = first.velocityAt(t);
+            MotionProfile second;
+            second.plan(p, v, to, LIMITS);
+
+            float lowest, highest;
+            checkTrajectory(second, p, v, lowest, highest);
+            TEST_ASSERT_TRUE(second.positionAt(second.getDuration()) == to);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_long_move_cruises_at_limit);
+    RUN_TEST(test_short_move_is_triangular);
+    RUN_TEST(test_endpoints_are_exact);
+    RUN_TEST(test_no_move_has_no_duration);
+    RUN_TEST(test_start_heading_away_brakes_first);
+    RUN_TEST(test_too_fast_to_stop_overshoots_and_returns);
+    RUN_TEST(test_start_above_speed_limit_slows_down);
+    RUN_TEST(test_replan_midway_is_continuous);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+// PageDiffRenderer against a panel that records every run it is sent
+//   pio test -e native -f test_page_diff_renderer
+
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "page_diff_renderer.h"
+
+static const int WIDTH = PageDiffRenderer::WIDTH;
+static const size_t FRAME_BYTES = PageDiffRenderer::FRAME_BYTES;
+
+// Keeps panel memory and the runs that built it; can refuse a run
+class RecordingPanel : public DisplayPanel
+{
+public:
+    struct Run
+    {
+        int page;
+        int column;
+        size_t len;
+    };
+
+    std::vector<Run> runs;
+    uint8_t memory[FRAME_BYTES];
+    int failAt; // Index of the run to refuse, -1 for none
+
+    RecordingPanel() : failAt(-1)
+    {
+        memset(memory, 0, sizeof(memory));
+    }
+
+    bool writeRun(int page, int column, const uint8_t *data, size_t len) override
+    {
+        if ((int)runs.size() == failAt)
+        {
+            failAt = -1;
+            return false;
+        }
+        TEST_ASSERT_TRUE(page >= 0 && page < PageDiffRenderer::PAGES);
+        TEST_ASSERT_TRUE(column >= 0 && column + len <= (size_t)WIDTH);
+        memcpy(memory + page * WIDTH + column, data, len);
+        runs.push_back({page, column, len});
+        return true;
+    }
+};
+
+static PageDiffRenderer *renderer;
+static RecordingPanel *panel;
+static uint8_t frame[FRAME_BYTES];
+
+// First frame goes out in full; start each test with it on the panel
+void setUp()
+{
+    renderer = new PageDiffRenderer();
+    panel = new RecordingPanel();
+    for (size_t i = 0; i < FRAME_BYTES; i++)
+        frame[i] = (uint8_t)(i * 7);
+    renderer->render(frame, panel);
+    panel->runs.clear();
+}
+
+void tearDown()
+{
+    delete renderer;
+    delete panel;
+}
+
+void test_first_frame_sends_every_page()
+{
+    PageDiffRenderer fresh;
+    RecordingPanel blank;
+    size_t sent = fresh.render(frame, &blank);
+
+    TEST_ASSERT_EQUAL(PageDiffRenderer::PAGES, blank.runs.size());
+    for (int page = 0; page < PageDiffRenderer::PAGES; page++)
+    {
+        TEST_ASSERT_EQUAL(page, blank.runs[page].page);
+        TEST_ASSERT_EQUAL(0, blank.runs[page].column);
+        TEST_ASSERT_EQUAL(WIDTH, blank.runs[page].len);
+    }
+    TEST_ASSERT_EQUAL(FRAME_BYTES + PageDiffRenderer::PAGES * PageDiffRenderer::RUN_OVERHEAD, sent);
+    TEST_ASSERT_EQUAL_MEMORY(frame, blank.memory, FRAME_BYTES);
+}
+
+void test_unchanged_frame_sends_nothing()
+{
+    TEST_ASSERT_EQUAL(0, renderer->render(frame, panel));
+    TEST_ASSERT_EQUAL(0, panel->runs.size());
+    TEST_ASSERT_EQUAL_UINT32(1, renderer->getStats().unchanged);
+}
+
+void test_single_byte_is_one_short_run()
+{
+    frame[3 * WIDTH + 40] ^= 0xFF;
+    size_t sent = renderer->render(frame, panel);
+
+    TEST_ASSERT_EQUAL(1, panel->runs.size());
+    TEST_ASSERT_EQUAL(3, panel->runs[0].page);
+    TEST_ASSERT_EQUAL(40, panel->runs[0].column);
+    TEST_ASSERT_EQUAL(1, panel->runs[0].len);
+    TEST_ASSERT_EQUAL(1 + PageDiffRenderer::RUN_OVERHEAD, sent);
+    TEST_ASSERT_EQUAL_MEMORY(frame, panel->memory, FRAME_BYTES);
+}
+
+void test_close_changes_share_a_run()
+{
+    // Gap of RUN_OVERHEAD unchanged bytes: cheaper to resend than to address
+    frame[10] ^= 1;
+    frame[10 + PageDiffRenderer::RUN_OVERHEAD + 1] ^= 1;
+    renderer->render(frame, panel);
+
+    TEST_ASSERT_EQUAL(1, panel->runs.size());
+    TEST_ASSERT_EQUAL(10, panel->runs[0].column);
+    TEST_ASSERT_EQUAL(PageDiffRenderer::RUN_OVERHEAD + 2, panel->runs[0].len);
+}
+
+void test_distant_changes_are_separate_runs()
+{
+    frame[10] ^= 1;
+    frame[10 + PageDiffRenderer::RUN_OVERHEAD + 2] ^= 1;
+    frame[WIDTH - 1] ^= 1;
+    renderer->render(frame, panel);
+
+    TEST_ASSERT_EQUAL(3, panel->runs.size());
+    TEST_ASSERT_EQUAL(WIDTH - 1, panel->runs[2].column);
+    TEST_ASSERT_EQUAL(1, panel->runs[2].len);
+    TEST_ASSERT_EQUAL_MEMORY(frame, panel->memory, FRAME_BYTES);
+}
+
+void test_status_line_costs_far_less_than_full_frame()
+{
+    // One 8 px text line: page 2, a word's worth of columns
+    for (int x = 20; x < 68; x++)
+        frame[2 * WIDTH + x] = ~frame[2 * WIDTH + x];
+    size_t sent = renderer->render(frame, panel);
+
+    TEST_ASSERT_EQUAL(1, panel->runs.size());
+    TEST_ASSERT_EQUAL(48 + PageDiffRenderer::RUN_OVERHEAD, sent);
+    TEST_ASSERT_LESS_THAN(FRAME_BYTES / 10, sent);
+}
+
+void test_failed_run_resends_everything()
+{
+    frame[5 * WIDTH] ^= 1;
+    frame[6 * WIDTH] ^= 1;
+    panel->failAt = 0;
+    renderer->render(frame, panel);
+    TEST_ASSERT_EQUAL_UINT32(1, renderer->getStats().failures);
+    TEST_ASSERT_EQUAL(0, panel->runs.size()); // Stopped at the failure
+
+    renderer->render(frame, panel);
+    TEST_ASSERT_EQUAL(PageDiffRenderer::PAGES, panel->runs.size());
+    TEST_ASSERT_EQUAL_MEMORY(frame, panel->memory, FRAME_BYTES);
+}
+
+void test_invalidate_resends_everything()
+{
+    renderer->invalidate();
+    renderer->render(frame, panel);
+    TEST_ASSERT_EQUAL(PageDiffRenderer::PAGES, panel->runs.size());
+}
+
+void test_random_edits_keep_panel_in_sync()
+{
+    srand(1);
+    for (int round = 0; round < 500; round++)
+    {
+        int edits = rand() % 40;
+        for (int i = 0; i < edits; i++)
+            frame[rand() % FRAME_BYTES] = (uint8_t)rand();
+        size_t sent = renderer->render(frame, panel);
+        TEST_ASSERT_EQUAL_MEMORY(frame, panel->memory, FRAME_BYTES);
+        // Never worse than the full frame
+        TEST_ASSERT_LESS_OR_EQUAL(FRAME_BYTES + PageDiffRenderer::PAGES * PageDiffRenderer::RUN_OVERHEAD, sent);
+    }
+
+    const PageDiffRenderer::Stats &stats = renderer->getStats();
+    TEST_ASSERT_EQUAL_UINT32(501, stats.frames);
+    TEST_ASSERT_EQUAL_UINT32(stats.dataBytes + stats.runs * PageDiffRenderer::RUN_OVERHEAD, stats.busBytes);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_sends_every_page);
+    RUN_TEST(test_unchanged_frame_sends_nothing);
+    RUN_TEST(test_single_byte_is_one_short_run);
+    RUN_TEST(test_close_changes_share_a_run);
+    RUN_TEST(test_distant_changes_are_separate_runs);
+    RUN_TEST(test_status_line_costs_far_less_than_full_frame);
+    RUN_TEST(test_failed_run_resends_everything);
+    RUN_TEST(test_invalidate_resends_everything);
+    RUN_TEST(test_random_edits_keep_panel_in_sync);
+    return UNITY_END();
+}
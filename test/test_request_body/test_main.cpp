@@ -0,0 +1,304 @@
+// RequestBody streaming (prefix, frame raw or base64, suffix, read in
+// pieces of any size), and the capture-to-upload path: a frame from a
+// FrameSource streamed by AsyncHttpRequest into a loopback HTTP sink,
+// compared byte for byte with the body built in one piece. The sink's small
+// receive buffer spreads the upload over many polls; the frame is held
+// throughout and goes back to its source only once the last byte is sent.
+//   pio test -e native -f test_request_body
+
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "async_http_request.h"
+#include "base64_encoder.h"
+#include "hal_native.h"
+#include "request_body.h"
+
+static const char PREFIX[] = "{\"text\":\"Describe the scene.\",\"image\":\"";
+static const char SUFFIX[] = "\"}";
+
+static std::vector<uint8_t> randomFrame(size_t len, unsigned seed)
+{
+    std::vector<uint8_t> frame(len);
+    srand(seed);
+    for (size_t i = 0; i < len; i++)
+        frame[i] = (uint8_t)rand();
+    return frame;
+}
+
+// The whole body built in one piece, as the code before RequestBody did
+static std::string expectedBody(const char *prefix, const std::vector<uint8_t> &frame,
+                                RequestBody::FrameEncoding encoding, const char *suffix)
+{
+    std::string body = prefix;
+    if (encoding == RequestBody::FRAME_BASE64)
+    {
+        std::string encoded(base64EncodedLength(frame.size()), '\0');
+        base64Encode(frame.data(), frame.size(), &encoded[0]);
+        body += encoded;
+    }
+    else
+    {
+        body.append((const char *)frame.data(), frame.size());
+    }
+    return body + suffix;
+}
+
+// Reads the whole body piece by piece, checking the bookkeeping on the way
+static std::string readAll(RequestBody &body, size_t piece)
+{
+    std::string out;
+    std::vector<uint8_t> buffer(piece + 1);
+    size_t total = body.size();
+    while (true)
+    {
+        buffer[piece] = 0xA5;
+        size_t n = body.read(buffer.data(), piece);
+        TEST_ASSERT_EQUAL(0xA5, buffer[piece]); // Nothing past maxLen
+        if (n == 0)
+            break;
+        TEST_ASSERT_TRUE(n <= piece);
+        out.append((const char *)buffer.data(), n);
+        TEST_ASSERT_EQUAL(total - out.size(), body.remaining());
+    }
+    TEST_ASSERT_EQUAL(0, body.remaining());
+    TEST_ASSERT_EQUAL(0, body.read(buffer.data(), piece)); // Stays finished
+    return out;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_empty_body()
+{
+    RequestBody body;
+    uint8_t buffer[8];
+    TEST_ASSERT_EQUAL(0, body.size());
+    TEST_ASSERT_EQUAL(0, body.read(buffer, sizeof(buffer)));
+}
+
+void test_every_piece_size_and_tail()
+{
+    // Frame lengths around each base64 tail, read through buffers smaller
+    // than a quad up to larger than the whole body
+    const RequestBody::FrameEncoding encodings[] = {RequestBody::FRAME_RAW, RequestBody::FRAME_BASE64};
+    for (RequestBody::FrameEncoding encoding : encodings)
+    {
+        for (size_t frameLen = 0; frameLen <= 40; frameLen++)
+        {
+            std::vector<uint8_t> frame = randomFrame(frameLen, (unsigned)frameLen + 1);
+            std::string expected = expectedBody(PREFIX, frame, encoding, SUFFIX);
+            for (size_t piece = 1; piece <= expected.size() + 1; piece++)
+            {
+                RequestBody body(PREFIX, strlen(PREFIX), frame.data(), frame.size(), encoding, SUFFIX,
+                                 strlen(SUFFIX));
+                TEST_ASSERT_EQUAL(expected.size(), body.size());
+                TEST_ASSERT_TRUE(readAll(body, piece) == expected);
+            }
+        }
+    }
+}
+
+void test_no_prefix_or_suffix()
+{
+    std::vector<uint8_t> frame = randomFrame(31, 5);
+    RequestBody body(nullptr, 0, frame.data(), frame.size(), RequestBody::FRAME_BASE64, nullptr, 0);
+    TEST_ASSERT_TRUE(readAll(body, 7) == expectedBody("", frame, RequestBody::FRAME_BASE64, ""));
+}
+
+void test_rewind_mid_quad()
+{
+    // Stopped inside a base64 quad, then read again from the start
+    std::vector<uint8_t> frame = randomFrame(29, 7);
+    RequestBody body(PREFIX, strlen(PREFIX), frame.data(), frame.size(), RequestBody::FRAME_BASE64, SUFFIX,
+                     strlen(SUFFIX));
+    uint8_t buffer[64];
+    body.read(buffer, strlen(PREFIX) + 2);
+    body.rewind();
+    TEST_ASSERT_EQUAL(body.size(), body.remaining());
+    TEST_ASSERT_TRUE(readAll(body, 5) == expectedBody(PREFIX, frame, RequestBody::FRAME_BASE64, SUFFIX));
+}
+
+void test_frame_sized_body_in_send_chunks()
+{
+    // A VGA JPEG read the way AsyncHttpRequest does: SEND_CHUNK at a time
+    std::vector<uint8_t> frame = randomFrame(61 * 1024 + 2, 9);
+    std::string expected = expectedBody(PREFIX, frame, RequestBody::FRAME_BASE64, SUFFIX);
+    RequestBody body(PREFIX, strlen(PREFIX), frame.data(), frame.size(), RequestBody::FRAME_BASE64, SUFFIX,
+                     strlen(SUFFIX));
+    TEST_ASSERT_TRUE(readAll(body, AsyncHttpRequest::SEND_CHUNK) == expected);
+}
+
+// Loopback HTTP server pumped from the test's own loop: takes one request,
+// keeps its head and body, answers 200 once Content-Length bytes are in.
+// A small receive buffer makes the client's sends stall and resume.
+class LoopbackSink
+{
+public:
+    std::string head;
+    std::string body;
+    uint16_t port;
+
+    LoopbackSink() : port(0), listener(-1), client(-1), bodyLength(-1), answered(false)
+    {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+        listen(listener, 1);
+        fcntl(listener, F_SETFL, O_NONBLOCK);
+        socklen_t len = sizeof(addr);
+        getsockname(listener, (struct sockaddr *)&addr, &len);
+        port = ntohs(addr.sin_port);
+    }
+
+    ~LoopbackSink()
+    {
+        if (client >= 0)
+            close(client);
+        close(listener);
+    }
+
+    void poll()
+    {
+        if (client < 0)
+        {
+            client = accept(listener, nullptr, nullptr);
+            if (client < 0)
+                return;
+            int small = 4096;
+            setsockopt(client, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+            fcntl(client, F_SETFL, O_NONBLOCK);
+        }
+
+        char buffer[1024]; // Slow reader: a little per pump
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            if (bodyLength < 0)
+            {
+                head.append(buffer, n);
+                size_t end = head.find("\r\n\r\n");
+                if (end == std::string::npos)
+                    return;
+                body = head.substr(end + 4);
+                head.resize(end + 4);
+                const char *length = strstr(head.c_str(), "Content-Length: ");
+                bodyLength = length ? atol(length + 16) : 0;
+            }
+            else
+            {
+                body.append(buffer, n);
+            }
+        }
+
+        if (!answered && bodyLength >= 0 && (long)body.size() >= bodyLength)
+        {
+            const char reply[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n\r\nok";
+            send(client, reply, sizeof(reply) - 1, 0);
+            answered = true;
+        }
+    }
+
+private:
+    int listener;
+    int client;
+    long bodyLength;
+    bool answered;
+};
+
+// Mirrors AIBotManager::sendBotRequest()/pollBotRequest(): the frame is held
+// while the body is sent, then handed back
+static void uploadFrame(RequestBody::FrameEncoding encoding, const char *contentType)
+{
+    char path[] = "/tmp/test_request_body_XXXXXX";
+    int fd = mkstemp(path);
+    std::vector<uint8_t> jpeg = randomFrame(150 * 1024 + 1, 21);
+    jpeg[0] = 0xFF; // SOI, for looks
+    jpeg[1] = 0xD8;
+    TEST_ASSERT_EQUAL(jpeg.size(), write(fd, jpeg.data(), jpeg.size()));
+    close(fd);
+
+    JpegFileFrameSource source;
+    TEST_ASSERT_TRUE(source.addFile(path));
+    unlink(path);
+
+    CapturedFrame frame;
+    TEST_ASSERT_TRUE(source.acquire(frame));
+    RequestBody body(PREFIX, strlen(PREFIX), frame.data, frame.len, encoding, SUFFIX, strlen(SUFFIX));
+
+    LoopbackSink sink;
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/message", (unsigned)sink.port);
+    AsyncHttpRequest request;
+    TEST_ASSERT_TRUE(request.start("POST", url, contentType, &body, hostMillis()));
+
+    bool held = true;
+    int polls = 0;
+    while (request.isBusy())
+    {
+        sink.poll();
+        AsyncHttpRequest::State state = request.poll(hostMillis());
+        polls++;
+        if (held && state != AsyncHttpRequest::REQ_CONNECTING && state != AsyncHttpRequest::REQ_SENDING)
+        {
+            // Body fully handed to the socket: the frame may go
+            TEST_ASSERT_EQUAL(0, body.remaining());
+            source.release(frame);
+            held = false;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(AsyncHttpRequest::REQ_DONE, request.getState());
+    TEST_ASSERT_EQUAL(200, request.getStatusCode());
+    TEST_ASSERT_EQUAL_STRING("ok", request.getResponse());
+    TEST_ASSERT_FALSE(held);
+    TEST_ASSERT_GREATER_THAN(10, polls); // Sent over many polls, not in one go
+
+    std::string expected = expectedBody(PREFIX, jpeg, encoding, SUFFIX);
+    char header[64];
+    snprintf(header, sizeof(header), "Content-Length: %u\r\n", (unsigned)expected.size());
+    TEST_ASSERT_NOT_NULL(strstr(sink.head.c_str(), header));
+    TEST_ASSERT_NOT_NULL(strstr(sink.head.c_str(), contentType));
+    TEST_ASSERT_EQUAL(expected.size(), sink.body.size());
+    TEST_ASSERT_TRUE(sink.body == expected);
+}
+
+void test_capture_to_upload_base64()
+{
+    uploadFrame(RequestBody::FRAME_BASE64, "application/json");
+}
+
+void test_capture_to_upload_raw()
+{
+    uploadFrame(RequestBody::FRAME_RAW, "image/jpeg");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_body);
+    RUN_TEST(test_every_piece_size_and_tail);
+    RUN_TEST(test_no_prefix_or_suffix);
+    RUN_TEST(test_rewind_mid_quad);
+    RUN_TEST(test_frame_sized_body_in_send_chunks);
+    RUN_TEST(test_capture_to_upload_base64);
+    RUN_TEST(test_capture_to_upload_raw);
+    return UNITY_END();
+}
@@ -0,0 +1,199 @@
+// Route table lookups, and a dispatch microbenchmark against the
+// substring chain the web server used before (request.indexOf("/LED_ON")
+// != -1, else if ...). Prints ns per dispatch for both.
+//   pio test -e native -f test_route_table -v
+
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include "hal_native.h"
+#include "query_string.h"
+#include "route_table.h"
+
+typedef int Handler; // Index of the route, standing in for a function
+
+// Same paths as ROUTES in main.cpp, sorted by path then method
+static constexpr RouteEntry<Handler> TABLE[] = {
+    {"GET", "/", 0},
+    {"GET", "/LED_ON", 1},
+    {"GET", "/api/status", 2},
+    {"GET", "/cadence", 3},
+    {"GET", "/calibrate_servo", 4},
+    {"GET", "/camera_profile", 5},
+    {"GET", "/capture", 6},
+    {"GET", "/clearwifi", 7},
+    {"GET", "/log_level", 8},
+    {"GET", "/metrics", 9},
+    {"GET", "/ping", 10},
+    {"GET", "/save_api_url", 11},
+    {"GET", "/scene_gate", 12},
+    {"GET", "/servo_center", 13},
+    {"GET", "/servo_left", 14},
+    {"GET", "/servo_right", 15},
+    {"GET", "/servo_step", 16},
+    {"GET", "/snapshot.jpg", 17},
+    {"GET", "/start_bot", 18},
+    {"GET", "/stop_bot", 19},
+    {"GET", "/stream", 20},
+    {"GET", "/test", 21},
+};
+static const size_t TABLE_SIZE = sizeof(TABLE) / sizeof(TABLE[0]);
+static_assert(routeTableSorted(TABLE), "TABLE must be sorted");
+
+static constexpr RouteEntry<Handler> UNSORTED[] = {{"GET", "/b", 0}, {"GET", "/a", 1}};
+static_assert(!routeTableSorted(UNSORTED), "out of order tables are caught");
+static constexpr RouteEntry<Handler> DUPLICATED[] = {{"GET", "/a", 0}, {"GET", "/a", 1}};
+static_assert(!routeTableSorted(DUPLICATED), "duplicates are caught");
+static constexpr RouteEntry<Handler> METHODS[] = {{"GET", "/a", 0}, {"POST", "/a", 1}, {"GET", "/b", 2}};
+static_assert(routeTableSorted(METHODS), "one path, several methods");
+
+// The old chain: first substring of the request line wins, in the order
+// the handlers were written (routes added since go at the end)
+static const char *const CHAIN[] = {
+    "/LED_ON", "/clearwifi", "/test", "/capture", "/stream", "/ping", "/calibrate_servo",
+    "/servo_left", "/servo_center", "/servo_right", "/servo_step", "/save_api_url", "/start_bot",
+    "/stop_bot", "/api/status", "/cadence", "/camera_profile", "/log_level", "/metrics",
+    "/scene_gate", "/snapshot.jpg", "/"};
+static const size_t CHAIN_SIZE = sizeof(CHAIN) / sizeof(CHAIN[0]);
+
+static int chainDispatch(const char *requestLine)
+{
+    for (size_t i = 0; i < CHAIN_SIZE; i++)
+    {
+        if (strstr(requestLine, CHAIN[i]))
+            return (int)i;
+    }
+    return -1;
+}
+
+// A request line split the way HttpServer hands it to findRoute()
+static int tableDispatch(const char *method, const char *path)
+{
+    Handler handler;
+    return findRoute(TABLE, TABLE_SIZE, method, path, handler) == ROUTE_FOUND ? handler : -1;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_every_route_is_found()
+{
+    for (size_t i = 0; i < TABLE_SIZE; i++)
+    {
+        Handler handler = -1;
+        TEST_ASSERT_EQUAL(ROUTE_FOUND, findRoute(TABLE, TABLE_SIZE, "GET", TABLE[i].path, handler));
+        TEST_ASSERT_EQUAL((int)i, handler);
+    }
+}
+
+void test_exact_path_only()
+{
+    // The chain sent these to whichever handler's name they contained
+    Handler handler;
+    TEST_ASSERT_EQUAL(ROUTE_NO_PATH, findRoute(TABLE, TABLE_SIZE, "GET", "/testing", handler));
+    TEST_ASSERT_EQUAL(ROUTE_NO_PATH, findRoute(TABLE, TABLE_SIZE, "GET", "/files/capture", handler));
+    TEST_ASSERT_EQUAL(ROUTE_NO_PATH, findRoute(TABLE, TABLE_SIZE, "GET", "/servo", handler));
+    TEST_ASSERT_EQUAL(ROUTE_NO_PATH, findRoute(TABLE, TABLE_SIZE, "GET", "", handler));
+    TEST_ASSERT_EQUAL(ROUTE_NO_PATH, findRoute(TABLE, TABLE_SIZE, "GET", "/zzz", handler));
+
+    TEST_ASSERT_EQUAL_STRING("/test", CHAIN[chainDispatch("GET /testing HTTP/1.1")]);
+    TEST_ASSERT_EQUAL_STRING("/capture", CHAIN[chainDispatch("GET /files/capture HTTP/1.1")]);
+}
+
+void test_wrong_method()
+{
+    Handler handler = -1;
+    TEST_ASSERT_EQUAL(ROUTE_NO_METHOD, findRoute(TABLE, TABLE_SIZE, "POST", "/capture", handler));
+    TEST_ASSERT_EQUAL(-1, handler);
+
+    TEST_ASSERT_EQUAL(ROUTE_FOUND, findRoute(METHODS, 3, "POST", "/a", handler));
+    TEST_ASSERT_EQUAL(1, handler);
+    TEST_ASSERT_EQUAL(ROUTE_NO_METHOD, findRoute(METHODS, 3, "PUT", "/a", handler));
+}
+
+void test_query_values_decode_in_place()
+{
+    QueryString query("base=http%3A%2F%2F10.0.0.2%3A8000&route=%2Fmessage&n=-42&flag&sp=a+b");
+    char value[48];
+    TEST_ASSERT_TRUE(query.get("base", value, sizeof(value)));
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.2:8000", value);
+    TEST_ASSERT_TRUE(query.get("route", value, sizeof(value)));
+    TEST_ASSERT_EQUAL_STRING("/message", value);
+    TEST_ASSERT_TRUE(query.get("sp", value, sizeof(value)));
+    TEST_ASSERT_EQUAL_STRING("a b", value);
+    TEST_ASSERT_TRUE(query.has("flag"));
+    TEST_ASSERT_FALSE(query.has("fla"));
+
+    int n;
+    TEST_ASSERT_TRUE(query.getInt("n", n));
+    TEST_ASSERT_EQUAL(-42, n);
+    TEST_ASSERT_FALSE(query.getInt("route", n));
+
+    char small[5];
+    TEST_ASSERT_TRUE(query.get("base", small, sizeof(small)));
+    TEST_ASSERT_EQUAL_STRING("http", small);
+}
+
+void test_dispatch_benchmark()
+{
+    // Mix of early, late, parameterised and unknown routes
+    struct Sample
+    {
+        const char *line;
+        const char *method;
+        const char *path;
+    };
+    static const Sample SAMPLES[] = {
+        {"GET /api/status HTTP/1.1", "GET", "/api/status"},
+        {"GET /servo_step?delta=5 HTTP/1.1", "GET", "/servo_step"},
+        {"GET /snapshot.jpg HTTP/1.1", "GET", "/snapshot.jpg"},
+        {"GET /save_api_url?base=http%3A%2F%2F10.0.0.2%3A8000&route=%2Fmessage HTTP/1.1", "GET", "/save_api_url"},
+        {"GET /LED_ON HTTP/1.1", "GET", "/LED_ON"},
+        {"GET /metrics?format=json HTTP/1.1", "GET", "/metrics"},
+        {"GET /favicon.ico HTTP/1.1", "GET", "/favicon.ico"},
+        {"GET / HTTP/1.1", "GET", "/"},
+    };
+    const int samples = sizeof(SAMPLES) / sizeof(SAMPLES[0]);
+    const int rounds = 200000;
+
+    volatile int sink = 0;
+    uint32_t start = hostMicros();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < samples; i++)
+            sink += tableDispatch(SAMPLES[i].method, SAMPLES[i].path);
+    }
+    uint32_t tableUs = hostMicros() - start;
+
+    start = hostMicros();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < samples; i++)
+            sink += chainDispatch(SAMPLES[i].line);
+    }
+    uint32_t chainUs = hostMicros() - start;
+
+    double dispatches = (double)rounds * samples;
+    char message[128];
+    snprintf(message, sizeof(message), "dispatch: table %.1f ns, indexOf chain %.1f ns (%d routes)",
+             tableUs * 1000.0 / dispatches, chainUs * 1000.0 / dispatches, (int)TABLE_SIZE);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(chainUs, tableUs);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_route_is_found);
+    RUN_TEST(test_exact_path_only);
+    RUN_TEST(test_wrong_method);
+    RUN_TEST(test_query_values_decode_in_place);
+    RUN_TEST(test_dispatch_benchmark);
+    return UNITY_END();
+}
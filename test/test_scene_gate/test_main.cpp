@@ -0,0 +1,215 @@
+// SceneGate over frame sequences as the bot sees them: RGB565 at 1/8 scale
+// (what jpg2rgb565 hands computeSceneSignature() for a VGA frame), one
+// frame per cycle, each sent frame getting a decision. The sequences are
+// rendered here, deterministically, since the native build has no JPEG
+// decoder: a room with furniture, sensor noise, a cat walking through, the
+// robot turning, and the lights dimming.
+//   pio test -e native -f test_scene_gate
+
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include "scene_gate.h"
+
+static const int WIDTH = 80;  // 640 / 8
+static const int HEIGHT = 60; // 480 / 8
+static const int WORLD_WIDTH = 3 * WIDTH; // Room panorama the robot turns across
+static const uint32_t CYCLE_MS = 1000;
+
+struct Scene
+{
+    int pan;     // Left edge of the view in the panorama
+    int catX;    // Cat's left edge in the view, < 0 for no cat
+    float light; // Brightness factor
+    int noise;   // Sensor noise amplitude, in 6-bit luma steps
+    unsigned seed;
+};
+
+// Grey level 0..63 of the room at panorama column x, row y
+static int roomLuma(int x, int y)
+{
+    int luma = 20 + (y * 20) / HEIGHT; // Floor brighter than ceiling
+    if (x % 90 >= 10 && x % 90 < 40 && y >= 20 && y < 50)
+        luma = 50; // Cupboards
+    if (x % 70 >= 50 && x % 70 < 60 && y >= 5 && y < 25)
+        luma = 8; // Pictures on the wall
+    return luma;
+}
+
+static void render(const Scene &scene, uint8_t *pixels)
+{
+    srand(scene.seed);
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            int luma = roomLuma((scene.pan + x) % WORLD_WIDTH, y);
+            if (scene.catX >= 0 && x >= scene.catX && x < scene.catX + 20 && y >= 36 && y < 56)
+                luma = 4; // Black cat, a metre or so away
+            luma = (int)(luma * scene.light);
+            if (scene.noise)
+                luma += rand() % (2 * scene.noise + 1) - scene.noise;
+            luma = luma < 0 ? 0 : (luma > 63 ? 63 : luma);
+
+            uint16_t c = (uint16_t)(((luma >> 1) << 11) | (luma << 5) | (luma >> 1));
+            pixels[(y * WIDTH + x) * 2] = c >> 8;
+            pixels[(y * WIDTH + x) * 2 + 1] = c & 0xFF;
+        }
+    }
+}
+
+static uint64_t signatureOf(const Scene &scene)
+{
+    static uint8_t pixels[WIDTH * HEIGHT * 2];
+    render(scene, pixels);
+    return sceneSignatureFromRgb565(pixels, WIDTH, HEIGHT);
+}
+
+// Runs frames through the gate the way sendBotRequest()/finishBotRequest()
+// do: a sent frame gets a decision, a skipped one reuses the last. Returns
+// the number sent.
+static int runSequence(SceneGate &gate, const Scene *frames, int count, uint32_t &nowMs)
+{
+    int sent = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t signature = signatureOf(frames[i]);
+        if (gate.shouldSend(signature, nowMs))
+        {
+            gate.recordDecision(signature, nowMs);
+            sent++;
+        }
+        nowMs += CYCLE_MS;
+    }
+    return sent;
+}
+
+static SceneGate gate;
+static Scene frames[120];
+
+void setUp()
+{
+    gate = SceneGate();
+    gate.configure(6, 60000);
+}
+
+void tearDown()
+{
+}
+
+void test_still_room_with_noise_is_sent_once()
+{
+    for (int i = 0; i < 30; i++)
+        frames[i] = {60, -1, 1.0f, 3, (unsigned)i + 1};
+
+    uint32_t now = 0;
+    TEST_ASSERT_EQUAL(1, runSequence(gate, frames, 30, now));
+    TEST_ASSERT_EQUAL_UINT32(1, gate.getSent());
+    TEST_ASSERT_EQUAL_UINT32(29, gate.getSkipped());
+    TEST_ASSERT_LESS_OR_EQUAL(6, gate.getLastDistance());
+}
+
+void test_dimming_lights_do_not_count_as_change()
+{
+    // The hash compares cells to the frame mean, so uniform dimming is not
+    // a new scene
+    for (int i = 0; i < 20; i++)
+        frames[i] = {60, -1, 1.0f - i * 0.02f, 2, (unsigned)i + 1};
+
+    uint32_t now = 0;
+    TEST_ASSERT_EQUAL(1, runSequence(gate, frames, 20, now));
+}
+
+void test_cat_walking_in_is_sent()
+{
+    // Still room, then a cat walks in from the left and stops
+    int count = 0;
+    for (int i = 0; i < 10; i++, count++)
+        frames[count] = {60, -1, 1.0f, 2, (unsigned)count + 1};
+    for (int x = 0; x <= 60; x += 6, count++)
+        frames[count] = {60, x, 1.0f, 2, (unsigned)count + 1};
+    for (int i = 0; i < 10; i++, count++)
+        frames[count] = {60, 60, 1.0f, 2, (unsigned)count + 1};
+
+    uint32_t now = 0;
+    int sent = runSequence(gate, frames, count, now);
+    // First frame plus some of the walk; the cat sitting still is not resent
+    TEST_ASSERT_GREATER_THAN(2, sent);
+    TEST_ASSERT_LESS_THAN(12, sent);
+
+    uint32_t sentBefore = gate.getSent();
+    runSequence(gate, frames + count - 10, 10, now);
+    TEST_ASSERT_EQUAL_UINT32(sentBefore, gate.getSent());
+}
+
+void test_robot_turning_sends_most_frames()
+{
+    // 20 px (about 16 degrees of a VGA view) per cycle
+    for (int i = 0; i < 12; i++)
+        frames[i] = {i * 20, -1, 1.0f, 2, (unsigned)i + 1};
+
+    uint32_t now = 0;
+    TEST_ASSERT_GREATER_OR_EQUAL(10, runSequence(gate, frames, 12, now));
+}
+
+void test_old_decision_is_refreshed()
+{
+    // Nothing changes for 150 s at one frame a second: resent every 60 s
+    for (int i = 0; i < 120; i++)
+        frames[i] = {60, -1, 1.0f, 2, (unsigned)i + 1};
+
+    uint32_t now = 0;
+    int sent = runSequence(gate, frames, 120, now);
+    sent += runSequence(gate, frames, 30, now);
+    TEST_ASSERT_EQUAL(3, sent);
+}
+
+void test_failed_request_forgets_reference()
+{
+    for (int i = 0; i < 4; i++)
+        frames[i] = {60, -1, 1.0f, 2, (unsigned)i + 1};
+    uint32_t now = 0;
+    runSequence(gate, frames, 2, now);
+
+    // finishBotRequest() invalidates after an error: the same view goes out again
+    gate.invalidate();
+    TEST_ASSERT_TRUE(gate.shouldSend(signatureOf(frames[2]), now));
+    TEST_ASSERT_EQUAL(-1, gate.getLastDistance());
+}
+
+void test_threshold_zero_sends_everything()
+{
+    gate.configure(0, 60000);
+    for (int i = 0; i < 10; i++)
+        frames[i] = {60, -1, 1.0f, 0, 1};
+
+    uint32_t now = 0;
+    TEST_ASSERT_EQUAL(10, runSequence(gate, frames, 10, now));
+    TEST_ASSERT_EQUAL_UINT32(0, gate.getSkipped());
+}
+
+void test_signature_distance()
+{
+    TEST_ASSERT_EQUAL(0, sceneSignatureDistance(0x1234, 0x1234));
+    TEST_ASSERT_EQUAL(64, sceneSignatureDistance(0, ~(uint64_t)0));
+    TEST_ASSERT_EQUAL(1, sceneSignatureDistance((uint64_t)1 << 63, 0));
+
+    // Identical frames hash identically
+    Scene scene = {30, 20, 1.0f, 0, 1};
+    TEST_ASSERT_TRUE(signatureOf(scene) == signatureOf(scene));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_still_room_with_noise_is_sent_once);
+    RUN_TEST(test_dimming_lights_do_not_count_as_change);
+    RUN_TEST(test_cat_walking_in_is_sent);
+    RUN_TEST(test_robot_turning_sends_most_frames);
+    RUN_TEST(test_old_decision_is_refreshed);
+    RUN_TEST(test_failed_request_forgets_reference);
+    RUN_TEST(test_threshold_zero_sends_everything);
+    RUN_TEST(test_signature_distance);
+    return UNITY_END();
+}
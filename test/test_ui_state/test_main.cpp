@@ -0,0 +1,213 @@
+// UiState folding screen updates the way the display task sees them: only
+// the latest state survives a burst, a held message covers the base screen
+// until it expires, and needsDraw() only when what is visible changed.
+//   pio test -e native -f test_ui_state
+
+#include <unity.h>
+
+#include <string.h>
+#include "ui_state.h"
+
+static const uint32_t T0 = 5000;
+
+static UiUpdate mainScreen(const char *status, const char *direction = "stop", uint32_t holdMs = 0)
+{
+    UiUpdate update;
+    update.screen.clear(UiScreen::LAYOUT_MAIN);
+    update.screen.setLine(0, "192.168.1.20");
+    update.screen.setLine(1, status);
+    update.screen.setLine(2, direction);
+    update.screen.setLine(3, "42 cm");
+    update.holdMs = holdMs;
+    return update;
+}
+
+static UiUpdate message(const char *text, uint32_t holdMs)
+{
+    UiUpdate update;
+    update.screen.clear(UiScreen::LAYOUT_CENTERED);
+    update.screen.setLine(0, text);
+    update.holdMs = holdMs;
+    return update;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_starts_blank_and_drawn()
+{
+    UiState ui;
+    TEST_ASSERT_EQUAL(UiScreen::LAYOUT_NONE, ui.visible().layout);
+    TEST_ASSERT_FALSE(ui.needsDraw());
+    TEST_ASSERT_EQUAL(-1, ui.msUntilExpiry(T0));
+}
+
+void test_burst_coalesced_to_latest()
+{
+    UiState ui;
+    // Several status changes between two draws: one draw, of the last
+    ui.apply(mainScreen("Sending"), T0);
+    ui.apply(mainScreen("Waiting"), T0 + 1);
+    ui.apply(mainScreen("Response Recv", "left"), T0 + 2);
+    TEST_ASSERT_TRUE(ui.needsDraw());
+    TEST_ASSERT_EQUAL_STRING("Response Recv", ui.visible().lines[1]);
+    TEST_ASSERT_EQUAL_STRING("left", ui.visible().lines[2]);
+
+    ui.markDrawn();
+    TEST_ASSERT_FALSE(ui.needsDraw());
+}
+
+void test_same_screen_not_redrawn()
+{
+    UiState ui;
+    ui.apply(mainScreen("Waiting"), T0);
+    ui.markDrawn();
+
+    ui.apply(mainScreen("Waiting"), T0 + 10);
+    TEST_ASSERT_FALSE(ui.needsDraw());
+
+    // A change and its undo before the next draw: nothing to draw either
+    ui.apply(mainScreen("Sending"), T0 + 20);
+    ui.apply(mainScreen("Waiting"), T0 + 30);
+    TEST_ASSERT_FALSE(ui.needsDraw());
+}
+
+void test_line_rewritten_shorter_compares_equal()
+{
+    // setLine clears the old text, so no stale tail makes screens differ
+    UiScreen a;
+    a.clear(UiScreen::LAYOUT_TEXT);
+    a.setLine(0, "Response Recv");
+    a.setLine(0, "Idle");
+    UiScreen b;
+    b.clear(UiScreen::LAYOUT_TEXT);
+    b.setLine(0, "Idle");
+    TEST_ASSERT_TRUE(a.equals(b));
+
+    a.setLine(UiScreen::LINES, "ignored");
+    TEST_ASSERT_TRUE(a.equals(b));
+}
+
+void test_long_line_cut_to_fit()
+{
+    UiScreen screen;
+    screen.clear(UiScreen::LAYOUT_TEXT);
+    screen.setLine(0, "0123456789012345678901234567890123456789");
+    TEST_ASSERT_EQUAL(UiScreen::LINE_MAX - 1, strlen(screen.lines[0]));
+}
+
+void test_held_message_expires_to_base()
+{
+    UiState ui;
+    ui.apply(mainScreen("Waiting"), T0);
+    ui.markDrawn();
+
+    ui.apply(message("Saved", 2000), T0 + 100);
+    TEST_ASSERT_TRUE(ui.needsDraw());
+    TEST_ASSERT_EQUAL(UiScreen::LAYOUT_CENTERED, ui.visible().layout);
+    TEST_ASSERT_EQUAL(2000, ui.msUntilExpiry(T0 + 100));
+    ui.markDrawn();
+
+    ui.expire(T0 + 2099);
+    TEST_ASSERT_FALSE(ui.needsDraw());
+    TEST_ASSERT_EQUAL(1, ui.msUntilExpiry(T0 + 2099));
+
+    ui.expire(T0 + 2100);
+    TEST_ASSERT_EQUAL(-1, ui.msUntilExpiry(T0 + 2100));
+    TEST_ASSERT_EQUAL(UiScreen::LAYOUT_MAIN, ui.visible().layout);
+    TEST_ASSERT_EQUAL_STRING("Waiting", ui.visible().lines[1]);
+    TEST_ASSERT_TRUE(ui.needsDraw());
+}
+
+void test_base_updates_kept_under_message()
+{
+    UiState ui;
+    ui.apply(mainScreen("Waiting"), T0);
+    ui.apply(message("Saved", 1000), T0);
+    ui.markDrawn();
+
+    // The base screen moves on without cutting the message short
+    ui.apply(mainScreen("Response Recv", "right"), T0 + 200);
+    ui.apply(mainScreen("Waiting", "right"), T0 + 400);
+    TEST_ASSERT_FALSE(ui.needsDraw());
+    TEST_ASSERT_EQUAL_STRING("Saved", ui.visible().lines[0]);
+
+    // ...and shows up, latest first, when it expires
+    ui.expire(T0 + 1000);
+    TEST_ASSERT_TRUE(ui.needsDraw());
+    TEST_ASSERT_EQUAL_STRING("Waiting", ui.visible().lines[1]);
+    TEST_ASSERT_EQUAL_STRING("right", ui.visible().lines[2]);
+}
+
+void test_newer_message_replaces_held_one()
+{
+    UiState ui;
+    ui.apply(mainScreen("Waiting"), T0);
+    ui.apply(message("Saved", 1000), T0);
+    ui.apply(message("Rebooting", 3000), T0 + 500);
+
+    TEST_ASSERT_EQUAL_STRING("Rebooting", ui.visible().lines[0]);
+    // Its own hold, from when it arrived
+    ui.expire(T0 + 1000);
+    TEST_ASSERT_EQUAL_STRING("Rebooting", ui.visible().lines[0]);
+    TEST_ASSERT_EQUAL(2500, ui.msUntilExpiry(T0 + 1000));
+    ui.expire(T0 + 3500);
+    TEST_ASSERT_EQUAL(UiScreen::LAYOUT_MAIN, ui.visible().layout);
+}
+
+void test_message_matching_base_needs_no_draw()
+{
+    UiState ui;
+    ui.apply(mainScreen("Waiting"), T0);
+    ui.markDrawn();
+
+    // Held, but identical to what is on the OLED already
+    ui.apply(mainScreen("Waiting", "stop", 500), T0);
+    TEST_ASSERT_FALSE(ui.needsDraw());
+    ui.expire(T0 + 500);
+    TEST_ASSERT_FALSE(ui.needsDraw());
+}
+
+void test_expiry_across_millis_wrap()
+{
+    UiState ui;
+    ui.apply(mainScreen("Waiting"), 0xFFFFFF00);
+    ui.apply(message("Saved", 0x200), 0xFFFFFF00);
+
+    ui.expire(0x00000050); // Wrapped, still 0xB0 ms to go
+    TEST_ASSERT_EQUAL_STRING("Saved", ui.visible().lines[0]);
+    TEST_ASSERT_EQUAL(0xB0, ui.msUntilExpiry(0x00000050));
+
+    ui.expire(0x00000100);
+    TEST_ASSERT_EQUAL(UiScreen::LAYOUT_MAIN, ui.visible().layout);
+}
+
+void test_late_expiry_reports_zero()
+{
+    UiState ui;
+    ui.apply(message("Saved", 100), T0);
+    // Past due but not yet expired: the display task should wake right away
+    TEST_ASSERT_EQUAL(0, ui.msUntilExpiry(T0 + 250));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_blank_and_drawn);
+    RUN_TEST(test_burst_coalesced_to_latest);
+    RUN_TEST(test_same_screen_not_redrawn);
+    RUN_TEST(test_line_rewritten_shorter_compares_equal);
+    RUN_TEST(test_long_line_cut_to_fit);
+    RUN_TEST(test_held_message_expires_to_base);
+    RUN_TEST(test_base_updates_kept_under_message);
+    RUN_TEST(test_newer_message_replaces_held_one);
+    RUN_TEST(test_message_matching_base_needs_no_draw);
+    RUN_TEST(test_expiry_across_millis_wrap);
+    RUN_TEST(test_late_expiry_reports_zero);
+    return UNITY_END();
+}